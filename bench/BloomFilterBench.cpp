@@ -0,0 +1,78 @@
+// Throughput and measured false positive rate of the MD5 BloomFilter
+// against BlockedBloomFilter, sized for 1% like the frontier's filter.
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BlockedBloomFilter.hpp"
+#include "BloomFilter.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Urls shaped like the ones in emergencylist.txt.
+std::vector<std::string> makeUrls(const std::string& prefix, size_t n) {
+    std::vector<std::string> urls;
+    urls.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        urls.push_back("https://en.wikipedia.org/wiki/" + prefix + "_" +
+                       std::to_string(i * 2654435761u));
+    return urls;
+}
+
+template <typename Filter, typename Insert>
+void run(const std::string& name, Filter& filter, Insert insert,
+         const std::vector<std::string>& inserted,
+         const std::vector<std::string>& absent) {
+    auto start = Clock::now();
+    for (const std::string& url : inserted)
+        insert(filter, url);
+    double insertSecs = secondsSince(start);
+
+    size_t hits = 0;
+    start = Clock::now();
+    for (const std::string& url : inserted)
+        hits += filter.contains(url);
+    double hitSecs = secondsSince(start);
+
+    size_t falsePositives = 0;
+    start = Clock::now();
+    for (const std::string& url : absent)
+        falsePositives += filter.contains(url);
+    double missSecs = secondsSince(start);
+
+    std::cout << name << ": insert " << inserted.size() / insertSecs / 1e6
+              << " M/s, contains(hit) " << inserted.size() / hitSecs / 1e6
+              << " M/s, contains(miss) " << absent.size() / missSecs / 1e6
+              << " M/s, FPR " << 100.0 * falsePositives / absent.size()
+              << "%, " << filter.numBits() / 8 / (1 << 20) << " MiB"
+              << (hits == inserted.size() ? "" : " (MISSING KEYS)")
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    std::vector<std::string> inserted = makeUrls("Page", n);
+    std::vector<std::string> absent = makeUrls("Other", n);
+    std::cout << n << " urls, target FPR 1%" << std::endl;
+
+    BloomFilter md5(n, 0.01);
+    run("md5 BloomFilter", md5,
+        [](BloomFilter& f, const std::string& url) {
+            if (!f.contains(url))
+                f.insert(url);
+        },
+        inserted, absent);
+
+    BlockedBloomFilter blocked(n, 0.01);
+    run("BlockedBloomFilter", blocked,
+        [](BlockedBloomFilter& f, const std::string& url) {
+            f.insertIfAbsent(url);
+        },
+        inserted, absent);
+}
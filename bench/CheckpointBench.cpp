@@ -0,0 +1,97 @@
+// How long serving stops for a checkpoint: a full checkpoint written on the
+// serving thread (how the frontier used to checkpoint), a full snapshot
+// handed to the background writer, and an incremental snapshot after a
+// round of new urls. The dedup store is a Bloom filter sized for many
+// millions of urls, so it dominates the size of a full checkpoint.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Checkpoint.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kBloomCapacity = 50000000;
+constexpr int kQueued = 100000;
+constexpr int kNewPerRound = 10000;
+constexpr int kRounds = 5;
+
+namespace fs = std::filesystem;
+
+std::string url(int i) {
+    return "https://www.host" + std::to_string(i % 5000) + ".com/page/" +
+           std::to_string(i);
+}
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+int main() {
+    std::string dir = (fs::temp_directory_path() / "checkpoint_bench").string();
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::vector<std::unique_ptr<DedupStore>> seen;
+    seen.push_back(makeDedupStore("bloom", kBloomCapacity, ""));
+    ShardedFrontier::Options options;
+    options.capacity = 1000000;
+    options.spillDir = dir + "/spill";
+    ShardedFrontier frontier(std::move(seen), options);
+
+    int next = 0;
+    for (; next < kQueued; ++next)
+        frontier.add(url(next), true);
+    frontier.sync();
+    std::cout << frontier.describeSeen() << ", " << frontier.size()
+              << " urls queued\n";
+    std::cout << "checkpoint                 stall ms        bytes\n";
+
+    // Everything on the serving thread: snapshot and write out.
+    {
+        auto start = Clock::now();
+        ShardedFrontier::Snapshot snap = frontier.snapshot(true);
+        std::ofstream out(dir + "/sync.ckpt", std::ios::binary);
+        for (const ShardedFrontier::Snapshot::Shard& s : snap.shards) {
+            out.write(s.queued.data(), s.queued.size());
+            out.write(s.seen.data(), s.seen.size());
+        }
+        out.close();
+        uint64_t bytes = snap.bytes();
+        std::printf("full, synchronous     %12.2f %12llu\n", msSince(start),
+                    static_cast<unsigned long long>(bytes));
+    }
+
+    CheckpointWriter writer(dir + "/frontier.ckpt");
+    {
+        auto start = Clock::now();
+        writer.write(frontier.snapshot(true));
+        double stall = msSince(start);
+        writer.wait();
+        std::printf("full, background      %12.2f %12llu   (write %.1f ms)\n",
+                    stall,
+                    static_cast<unsigned long long>(writer.stats().lastBytes),
+                    writer.stats().lastWriteMs);
+    }
+
+    for (int round = 0; round < kRounds; ++round) {
+        for (int i = 0; i < kNewPerRound; ++i, ++next)
+            frontier.add(url(next), true);
+        frontier.sync();
+        frontier.take(kNewPerRound / 2);
+
+        auto start = Clock::now();
+        writer.write(frontier.snapshot(false));
+        double stall = msSince(start);
+        writer.wait();
+        std::printf("incremental           %12.2f %12llu   (write %.1f ms)\n",
+                    stall,
+                    static_cast<unsigned long long>(writer.stats().lastBytes),
+                    writer.stats().lastWriteMs);
+    }
+    fs::remove_all(dir);
+}
@@ -0,0 +1,169 @@
+// Aggregate urls/s served by a cluster of 1, 2 and 4 frontier nodes running
+// in this process and talking over loopback. Each node runs the frontier's
+// request loop on its own thread: take a batch, "discover" kFanout new urls
+// per url on random hosts, queue the ones it owns and forward the rest to
+// their owners through PeerExchange. Speedup is bounded by the number of
+// cores on the machine.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClusterMap.hpp"
+#include "PeerExchange.hpp"
+#include "ShardedFrontier.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kBatch = 100;
+constexpr int kFanout = 4;
+constexpr int kHosts = 100000;
+constexpr int kSeedsPerNode = 20000;
+constexpr auto kRunFor = std::chrono::seconds(3);
+
+namespace fs = std::filesystem;
+
+struct Node {
+    ClusterMap map;
+    ShardedFrontier frontier;
+    PeerExchange peers;
+
+    Node(const std::vector<ClusterNode>& nodes, size_t self,
+         const std::string& dir)
+        : map(nodes, self),
+          frontier(seen(), options(dir)),
+          peers(map, PeerExchange::Options()) {}
+
+    static std::vector<std::unique_ptr<DedupStore>> seen() {
+        std::vector<std::unique_ptr<DedupStore>> stores;
+        stores.push_back(makeDedupStore("bloom", 20000000, ""));
+        return stores;
+    }
+
+    static ShardedFrontier::Options options(const std::string& dir) {
+        ShardedFrontier::Options options;
+        options.capacity = 1000000;
+        options.spillDir = dir;
+        return options;
+    }
+
+    void add(const std::string& url) {
+        size_t owner = map.ownerOf(url);
+        if (owner == map.self())
+            frontier.add(url, true);
+        else
+            peers.forward(owner, url);
+    }
+};
+
+struct Result {
+    double urlsPerSecond = 0;
+    uint64_t forwarded = 0;
+    double bytesPerUrl = 0;  // on the wire between nodes
+};
+
+// Runs n nodes for kRunFor.
+Result runCluster(size_t n, int basePort) {
+    std::vector<ClusterNode> list;
+    for (size_t i = 0; i < n; ++i) {
+        list.push_back({"127.0.0.1", basePort + static_cast<int>(i),
+                        basePort + 100 + static_cast<int>(i)});
+    }
+    std::string root = (fs::temp_directory_path() / "cluster_bench").string();
+    fs::remove_all(root);
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    for (size_t i = 0; i < n; ++i) {
+        nodes.push_back(std::make_unique<Node>(
+            list, i, root + "/node-" + std::to_string(i)));
+        if (n > 1 && !nodes.back()->peers.start()) {
+            std::cerr << "Can't bind port " << list[i].peerPort << "\n";
+            return {};
+        }
+    }
+
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> served(n);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < n; ++i) {
+        threads.emplace_back([&, i]() {
+            Node& node = *nodes[i];
+            std::mt19937_64 rng(i + 1);
+            uint64_t next = 0;
+            auto discover = [&]() {
+                return "https://www.host" + std::to_string(rng() % kHosts) +
+                       ".com/n" + std::to_string(i) + "/" +
+                       std::to_string(next++);
+            };
+            for (int s = 0; s < kSeedsPerNode; ++s) {
+                std::string url = discover();
+                if (node.map.owns(url))
+                    node.frontier.add(url, true);
+            }
+            node.frontier.sync();
+
+            std::vector<std::string> fromPeers;
+            while (!stop.load()) {
+                fromPeers.clear();
+                node.peers.receive(fromPeers);
+                for (const std::string& url : fromPeers)
+                    node.frontier.add(url, true);
+
+                std::vector<std::string> urls = node.frontier.take(kBatch, 5);
+                served[i] += urls.size();
+                for (size_t u = 0; u < urls.size() * kFanout; ++u)
+                    node.add(discover());
+                node.frontier.flush();
+                node.peers.flush();
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    std::this_thread::sleep_for(kRunFor);
+    stop.store(true);
+    for (std::thread& t : threads)
+        t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Result result;
+    uint64_t total = 0;
+    for (uint64_t s : served)
+        total += s;
+    result.urlsPerSecond = total / secs;
+    uint64_t bytes = 0, sent = 0;
+    for (auto& node : nodes) {
+        PeerExchange::Stats stats = node->peers.stats();
+        result.forwarded += stats.forwarded;
+        sent += stats.sent;
+        bytes += stats.bytesSent;
+    }
+    result.bytesPerUrl = sent ? double(bytes) / sent : 0;
+    nodes.clear();
+    fs::remove_all(root);
+    return result;
+}
+
+int main() {
+    std::cout << "cores " << std::thread::hardware_concurrency() << ", batch "
+              << kBatch << ", fanout " << kFanout << "\n";
+    std::cout << "nodes      urls/s   speedup   forwarded   bytes/url\n";
+    double base = 0;
+    int port = 43000;
+    for (size_t n : {1, 2, 4}) {
+        Result r = runCluster(n, port);
+        port += 10;
+        if (n == 1)
+            base = r.urlsPerSecond;
+        std::printf("%5zu %11.0f %8.2fx %11llu %11.1f\n", n, r.urlsPerSecond,
+                    r.urlsPerSecond / base,
+                    static_cast<unsigned long long>(r.forwarded),
+                    r.bytesPerUrl);
+    }
+}
@@ -0,0 +1,147 @@
+// Encode/decode cost of FrontierInterface against the original
+// stringstream codec, and bytes on the wire of the LEGACY and COMPACT
+// formats, for batches of 1 to 10k urls. Heap allocations are counted by
+// replacing the global operator new.
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FrontierInterface.hpp"
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+using Clock = std::chrono::steady_clock;
+
+// The codec as it was before EncodeInto/DecodeView, kept as a baseline.
+namespace stream {
+
+std::string Encode(const FrontierMessage& message) {
+    std::ostringstream oss;
+    oss << MessageHeaders[static_cast<int>(message.type)] << '\0';
+    for (const auto* list : {&message.urls, &message.failed}) {
+        uint32_t n = htonl(static_cast<uint32_t>(list->size()));
+        oss.write(reinterpret_cast<char*>(&n), sizeof(n));
+        for (const auto& url : *list) {
+            uint32_t len = htonl(static_cast<uint32_t>(url.size()));
+            oss.write(reinterpret_cast<char*>(&len), sizeof(len));
+            oss.write(url.data(), url.size());
+        }
+    }
+    return oss.str();
+}
+
+FrontierMessage Decode(const std::string& encoded) {
+    std::istringstream iss(encoded);
+    std::string header;
+    std::getline(iss, header, '\0');
+    FrontierMessage message;
+    message.type = FrontierMessageType::URLS;
+    for (auto* list : {&message.urls, &message.failed}) {
+        uint32_t n;
+        iss.read(reinterpret_cast<char*>(&n), sizeof(n));
+        n = ntohl(n);
+        list->reserve(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t len;
+            iss.read(reinterpret_cast<char*>(&len), sizeof(len));
+            len = ntohl(len);
+            std::string url(len, '\0');
+            iss.read(&url[0], len);
+            list->push_back(url);
+        }
+    }
+    return message;
+}
+
+}  // namespace stream
+
+// Runs f over enough iterations to cover ~2M urls and prints ns and heap
+// allocations per message.
+template <typename F>
+void measure(const char* name, size_t batch, F f) {
+    size_t iters = std::max<size_t>(2000000 / batch, 100);
+    f();  // warm up reused buffers
+    size_t before = allocations;
+    auto start = Clock::now();
+    for (size_t i = 0; i < iters; ++i)
+        f();
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    std::cout << "  " << name << ": " << ns / iters << " ns/msg, "
+              << double(allocations - before) / iters << " allocs/msg\n";
+}
+
+int main() {
+    for (size_t batch : {1, 10, 50, 100, 1000, 10000}) {
+        FrontierMessage message{FrontierMessageType::URLS, {}, {}};
+        for (size_t i = 0; i < batch; ++i)
+            message.urls.push_back("https://en.wikipedia.org/wiki/Page_" +
+                                   std::to_string(i * 2654435761u));
+        std::string encoded = FrontierInterface::Encode(message);
+        std::cout << "batch " << batch << " (" << encoded.size()
+                  << " bytes)\n";
+
+        size_t sink = 0;
+        measure("stream Encode", batch,
+                [&] { sink += stream::Encode(message).size(); });
+        measure("Encode", batch,
+                [&] { sink += FrontierInterface::Encode(message).size(); });
+        std::string out;
+        measure("EncodeInto(string)", batch, [&] {
+            FrontierInterface::EncodeInto(message, out);
+            sink += out.size();
+        });
+        std::vector<char> buffer(encoded.size());
+        measure("EncodeInto(buffer)", batch, [&] {
+            sink += FrontierInterface::EncodeInto(message, buffer.data(),
+                                                  buffer.size());
+        });
+
+        measure("stream Decode", batch,
+                [&] { sink += stream::Decode(encoded).urls.size(); });
+        measure("Decode", batch,
+                [&] { sink += FrontierInterface::Decode(encoded).urls.size(); });
+        FrontierMessageView view;
+        measure("DecodeView", batch, [&] {
+            FrontierInterface::DecodeView(encoded, view);
+            sink += view.urls.size();
+        });
+
+        std::string compact =
+            FrontierInterface::Encode(message, FrontierProtocol::COMPACT);
+        std::cout << "  COMPACT: " << compact.size() << " bytes ("
+                  << double(encoded.size()) / compact.size() << "x smaller)\n";
+        measure("EncodeInto(string, COMPACT)", batch, [&] {
+            FrontierInterface::EncodeInto(message, out,
+                                          FrontierProtocol::COMPACT);
+            sink += out.size();
+        });
+        measure("DecodeView(COMPACT)", batch, [&] {
+            FrontierInterface::DecodeView(compact, view);
+            sink += view.urls.size();
+        });
+
+        if (sink == 0)
+            std::cout << "";
+    }
+}
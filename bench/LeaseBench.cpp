@@ -0,0 +1,73 @@
+// Cost of leasing urls to workers at crawl scale: 2000 workers with 250
+// urls each keep 500k urls in flight. Each round every worker comes back,
+// acknowledging its lease, and is leased a new batch, while one worker in
+// a hundred never comes back and has its lease expire. Reports the time
+// per leased url, the time expire() takes per request, and the bytes held
+// per url in flight.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LeaseTable.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kWorkers = 2000;
+constexpr size_t kBatch = 250;
+constexpr int kRounds = 20;
+constexpr int64_t kRoundMs = 5000;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main() {
+    // Batches are made up front, so only the table is timed.
+    std::vector<std::vector<std::string>> batches(kWorkers);
+    for (int w = 0; w < kWorkers; ++w) {
+        for (size_t i = 0; i < kBatch; ++i) {
+            batches[w].push_back("https://host" + std::to_string(w * 7 + i) +
+                                 ".com/some/path/to/page" + std::to_string(i));
+        }
+    }
+
+    LeaseTable leases(30000);
+    size_t redispatched = 0;
+    auto count = [&](std::string_view) { ++redispatched; };
+    double leaseSecs = 0;
+    double expireSecs = 0;
+    size_t requests = 0;
+    size_t maxBytes = 0;
+    size_t maxInFlight = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        for (int w = 0; w < kWorkers; ++w) {
+            // Spread the requests of a round over its five seconds.
+            int64_t now = round * kRoundMs + w * kRoundMs / kWorkers;
+            // Dead workers stop after their first batch.
+            if (round > 0 && w % 100 == 0)
+                continue;
+            auto start = Clock::now();
+            leases.expire(now, count);
+            expireSecs += secondsSince(start);
+            start = Clock::now();
+            leases.ack(w);
+            leases.lease(w, batches[w], now);
+            leaseSecs += secondsSince(start);
+            ++requests;
+        }
+        maxBytes = std::max(maxBytes, leases.bytes());
+        maxInFlight = std::max(maxInFlight, leases.inFlight());
+    }
+
+    std::printf("%zu requests, %zu urls in flight at most\n", requests,
+                maxInFlight);
+    std::printf("ack and lease  %6.1f ns per url\n",
+                leaseSecs * 1e9 / (requests * kBatch));
+    std::printf("expire         %6.1f ns per request, %zu urls redispatched\n",
+                expireSecs * 1e9 / requests, redispatched);
+    std::printf("memory         %6.1f bytes per url in flight\n",
+                static_cast<double>(maxBytes) / maxInFlight);
+}
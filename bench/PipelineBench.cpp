@@ -0,0 +1,215 @@
+// Request latency seen by workers, p50/p99, against the number of workers:
+// the old single-threaded loop (GetMessages, serve every message, sleep
+// 10ms when idle) versus RequestPipeline. Workers are threads talking to
+// an in-process server; each request carries 50 new urls and is answered
+// with a batch of 50 from a real PriorityQueue and BlockedBloomFilter.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlockedBloomFilter.hpp"
+#include "LatencyHistogram.hpp"
+#include "PriorityQueue.hpp"
+#include "RequestPipeline.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRequestsPerWorker = 400;
+constexpr size_t kBatch = 50;
+
+struct Message {
+    std::string senderIp;
+    int senderPort = 0;
+    int senderSock = 0;
+    int receiverSock = 0;
+    std::string msg;
+};
+
+// Same interface as the Gateway server.
+class LoopbackServer {
+   public:
+    explicit LoopbackServer(int workers) : replies(workers) {}
+
+    std::vector<Message> GetMessages() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Message> messages(inbox.begin(), inbox.end());
+        inbox.clear();
+        return messages;
+    }
+
+    std::vector<Message> GetMessagesBlocking() {
+        std::unique_lock<std::mutex> lock(mutex);
+        inboxReady.wait(lock, [this]() { return !inbox.empty() || closed; });
+        std::vector<Message> messages(inbox.begin(), inbox.end());
+        inbox.clear();
+        return messages;
+    }
+
+    void SendMessage(Message m) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies[m.receiverSock].push_back(std::move(m.msg));
+        replyReady.notify_all();
+    }
+
+    void send(int worker, std::string msg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        inbox.push_back(Message{"127.0.0.1", worker, worker, 0, std::move(msg)});
+        inboxReady.notify_one();
+    }
+
+    std::string receive(int worker) {
+        std::unique_lock<std::mutex> lock(mutex);
+        replyReady.wait(lock, [&]() { return !replies[worker].empty(); });
+        std::string msg = std::move(replies[worker].front());
+        replies[worker].pop_front();
+        return msg;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        inboxReady.notify_all();
+    }
+
+   private:
+    std::mutex mutex;
+    std::condition_variable inboxReady;
+    std::condition_variable replyReady;
+    std::deque<Message> inbox;
+    std::vector<std::deque<std::string>> replies;
+    bool closed = false;
+};
+
+// The frontier's per-request work.
+class Core {
+   public:
+    Core() : pq(1000000), seen(10000000, 0.01) {
+        for (int i = 0; i < 100000; ++i)
+            pq.push("https://seed" + std::to_string(i % 1000) + ".com/" +
+                    std::to_string(i));
+    }
+
+    FrontierMessage handle(const FrontierMessageView& request) {
+        for (std::string_view url : request.urls) {
+            if (seen.insertIfAbsent(url) && !pq.full())
+                pq.push(std::string(url));
+        }
+        return FrontierMessage{FrontierMessageType::URLS, pq.popN(kBatch)};
+    }
+
+   private:
+    PriorityQueue pq;
+    BlockedBloomFilter seen;
+};
+
+void report(const char* name, int workers, const std::vector<uint64_t>& us,
+            double secs) {
+    LatencyHistogram h;
+    for (uint64_t v : us)
+        h.record(v);
+    std::cout << name << " workers=" << workers << ": p50 " << h.percentile(50)
+              << " us, p99 " << h.percentile(99) << " us, "
+              << uint64_t(h.count() / secs) << " req/s" << std::endl;
+}
+
+// Collects raw samples from every worker thread under a lock.
+struct Samples {
+    std::mutex mutex;
+    std::vector<uint64_t> us;
+    void add(uint64_t v) {
+        std::lock_guard<std::mutex> lock(mutex);
+        us.push_back(v);
+    }
+};
+
+// Runs workers until each made kRequestsPerWorker requests, recording
+// their round-trip latencies.
+void runClients(LoopbackServer& server, int workers, Samples& samples) {
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w]() {
+            FrontierMessage request{FrontierMessageType::URLS, {}};
+            for (int i = 0; i < kRequestsPerWorker; ++i) {
+                request.urls.clear();
+                for (size_t u = 0; u < kBatch; ++u)
+                    request.urls.push_back(
+                        "https://host" + std::to_string(u * 7 + w) +
+                        ".org/w" + std::to_string(w) + "/" +
+                        std::to_string(i * kBatch + u));
+                auto start = Clock::now();
+                server.send(w, FrontierInterface::Encode(request));
+                FrontierInterface::Decode(server.receive(w));
+                samples.add(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        Clock::now() - start)
+                        .count());
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+}
+
+void benchSerial(int workers) {
+    LoopbackServer server(workers);
+    Core core;
+    std::atomic<bool> done{false};
+    std::thread loop([&]() {
+        FrontierMessageView request;
+        while (!done.load()) {
+            std::vector<Message> messages = server.GetMessages();
+            if (messages.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            for (const Message& m : messages) {
+                FrontierInterface::DecodeView(m.msg, request);
+                Message reply;
+                reply.receiverSock = m.senderSock;
+                reply.msg = FrontierInterface::Encode(core.handle(request));
+                server.SendMessage(reply);
+            }
+        }
+    });
+
+    Samples samples;
+    auto start = Clock::now();
+    runClients(server, workers, samples);
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    done = true;
+    loop.join();
+    report("serial  ", workers, samples.us, secs);
+}
+
+void benchPipeline(int workers) {
+    LoopbackServer server(workers);
+    Core core;
+    RequestPipeline<LoopbackServer> pipeline(
+        server, [&](const Message&, const FrontierMessageView& request) {
+            return core.handle(request);
+        });
+    std::thread loop([&]() { pipeline.run(); });
+
+    Samples samples;
+    auto start = Clock::now();
+    runClients(server, workers, samples);
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    pipeline.stop();
+    server.close();
+    loop.join();
+    report("pipeline", workers, samples.us, secs);
+}
+
+int main() {
+    for (int workers : {1, 4, 16, 64}) {
+        benchSerial(workers);
+        benchPipeline(workers);
+    }
+}
@@ -0,0 +1,156 @@
+// PriorityQueue engines on url distributions shaped like emergencylist.txt
+// (a few hosts with thousands of urls, many with a handful) and
+// seedList.txt (one url per host), scaled to 1M urls by repeating each
+// list under numbered copies of its hosts. For each engine: pushing every
+// url, draining the queue 50 urls at a time, and a steady state where
+// each batch of 50 popped urls is replaced by 50 new ones, pushed one by
+// one and then with pushN(). Last, pop() one url at a time with 1k to
+// 100k TLDs scheduled: every pop changes one TLD's priority and rekey()
+// sifts just that TLD, so the cost per url grows with the log of the
+// number of TLDs, not linearly.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PriorityQueue.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kUrls = 1000000;
+constexpr size_t kBatch = 50;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<std::string> readUrls(const std::string& path) {
+    std::ifstream file(path);
+    std::vector<std::string> urls;
+    for (std::string line; std::getline(file, line);) {
+        size_t scheme = line.find("://");
+        if (scheme != std::string::npos)
+            urls.push_back(line.substr(scheme + 3));
+    }
+    return urls;
+}
+
+// Copy k of the list gets hosts "c<k>.<host>", so the hosts keep their
+// share of the urls while there are as many more of them as copies.
+std::vector<std::string> scale(const std::vector<std::string>& list,
+                               size_t n) {
+    std::vector<std::string> urls;
+    urls.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        urls.push_back("https://c" + std::to_string(i / list.size()) + "." +
+                       list[i % list.size()] + "#" + std::to_string(i));
+    }
+    return urls;
+}
+
+const char* name(PriorityQueue::Engine engine) {
+    switch (engine) {
+        case PriorityQueue::Engine::BINARY_HEAP:
+            return "binary heap";
+        case PriorityQueue::Engine::QUAD_HEAP:
+            return "4-ary heap";
+        case PriorityQueue::Engine::BUCKETS:
+            return "round buckets";
+    }
+    return "";
+}
+
+void run(PriorityQueue::Engine engine, const std::vector<std::string>& urls) {
+    // The first half fills the queue, the second half feeds the steady
+    // state.
+    size_t half = urls.size() / 2;
+    PriorityQueue pq(urls.size(), engine);
+    auto start = Clock::now();
+    for (size_t i = 0; i < half; ++i)
+        pq.push(urls[i]);
+    double pushSecs = secondsSince(start);
+
+    // The second half is split between the two steady states.
+    size_t next = half;
+    double steadyNs[2];
+    for (int batched = 0; batched < 2; ++batched) {
+        size_t end = batched ? urls.size() : half + half / 2;
+        // Batches arrive as vectors, so they are cut outside the clock.
+        std::vector<std::vector<std::string>> batches;
+        for (size_t i = next; batched && i + kBatch <= end; i += kBatch)
+            batches.emplace_back(urls.begin() + i, urls.begin() + i + kBatch);
+        size_t ops = 0;
+        start = Clock::now();
+        while (next + kBatch <= end) {
+            ops += pq.popN(kBatch).size();
+            if (batched) {
+                pq.pushN(batches[(next - half - half / 2) / kBatch]);
+                next += kBatch;
+            } else {
+                for (size_t k = 0; k < kBatch; ++k)
+                    pq.push(urls[next++]);
+            }
+            ops += kBatch;
+        }
+        steadyNs[batched] = secondsSince(start) * 1e9 / ops;
+    }
+
+    start = Clock::now();
+    size_t popped = 0;
+    while (pq.size() > 0)
+        popped += pq.popN(kBatch).size();
+    double drainSecs = secondsSince(start);
+
+    std::printf(
+        "    %-14s push %5.0f ns  steady %5.0f ns/op, with pushN %5.0f ns/op"
+        "  drain %5.0f ns\n",
+        name(engine), pushSecs * 1e9 / half, steadyNs[0], steadyNs[1],
+        drainSecs * 1e9 / popped);
+}
+
+void singlePops() {
+    for (size_t tlds : {1000, 10000, 100000}) {
+        PriorityQueue pq(2 * tlds);
+        for (size_t i = 0; i < 2 * tlds; ++i)
+            pq.push("h" + std::to_string(i % 2) + ".t" +
+                    std::to_string(i / 2));
+        auto start = Clock::now();
+        size_t popped = 0;
+        for (; popped < tlds; ++popped)
+            pq.pop();
+        std::printf("pop() with %6zu TLDs: %5.0f ns per url\n", tlds,
+                    secondsSince(start) * 1e9 / popped);
+    }
+}
+
+int main() {
+    struct Distribution {
+        const char* file;
+        std::vector<std::string> urls;
+    };
+    std::vector<Distribution> distributions;
+    for (const char* file : {"emergencylist.txt", "seedList.txt"}) {
+        std::vector<std::string> list =
+            readUrls(PROJECT_ROOT + std::string(file));
+        if (list.empty()) {
+            std::cerr << "No urls in " << file << "\n";
+            return 1;
+        }
+        distributions.push_back({file, scale(list, kUrls)});
+    }
+    for (const Distribution& d : distributions) {
+        PriorityQueue counter(kUrls);
+        for (const std::string& url : d.urls)
+            counter.push(url);
+        std::printf("%s: %zu urls over %zu hosts\n", d.file, d.urls.size(),
+                    counter.numHosts());
+        for (PriorityQueue::Engine engine :
+             {PriorityQueue::Engine::BINARY_HEAP,
+              PriorityQueue::Engine::QUAD_HEAP,
+              PriorityQueue::Engine::BUCKETS})
+            run(engine, d.urls);
+    }
+    singlePops();
+}
@@ -0,0 +1,121 @@
+// Startup time of --recover. A checkpoint of kUrls queued urls is written
+// once, then loaded back: url by url through add() (how recovery used to
+// refill the shards), and with ShardedFrontier::restore(), where every
+// shard parses its part of the mapped base and builds its queue in one
+// pass. The queue build alone is timed too, pushing the same urls one at a
+// time and with pushN().
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "Checkpoint.hpp"
+#include "PriorityQueue.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kUrls = 5000000;
+constexpr size_t kHosts = 200000;
+
+namespace fs = std::filesystem;
+
+std::string url(size_t i) {
+    static const char* tlds[] = {".com", ".org", ".net", ".io", ".de"};
+    size_t host = i % kHosts;
+    return "https://www.host" + std::to_string(host) + tlds[host % 5] +
+           "/articles/2024/page-" + std::to_string(i) + ".html";
+}
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::unique_ptr<ShardedFrontier> makeFrontier(const std::string& dir,
+                                              size_t shards) {
+    std::vector<std::unique_ptr<DedupStore>> seen;
+    for (size_t i = 0; i < shards; ++i)
+        seen.push_back(makeDedupStore("bloom", 2 * kUrls / shards, ""));
+    ShardedFrontier::Options options;
+    options.capacity = kUrls + 1000;
+    options.spillDir = dir + "/spill";
+    return std::make_unique<ShardedFrontier>(std::move(seen), options);
+}
+
+void buildQueue() {
+    std::vector<std::string> urls;
+    urls.reserve(kUrls);
+    for (size_t i = 0; i < kUrls; ++i)
+        urls.push_back(url(i));
+    // Checkpoints list urls host by host.
+    std::sort(urls.begin(), urls.end(), [](const auto& a, const auto& b) {
+        return PriorityQueue::hostOf(a) < PriorityQueue::hostOf(b);
+    });
+    std::vector<std::string> copy = urls;
+
+    auto start = Clock::now();
+    {
+        PriorityQueue pq(kUrls);
+        for (std::string& u : urls)
+            pq.push(std::move(u));
+        std::printf("push one by one       %12.2f %12.0f\n",
+                    secondsSince(start), kUrls / secondsSince(start));
+    }
+    start = Clock::now();
+    {
+        PriorityQueue pq(kUrls);
+        pq.pushN(copy);
+        std::printf("pushN                 %12.2f %12.0f\n",
+                    secondsSince(start), kUrls / secondsSince(start));
+    }
+}
+
+void recover(const std::string& dir, size_t shards, bool bulk) {
+    std::string path = dir + "/frontier-" + std::to_string(shards) + ".ckpt";
+    if (!fs::exists(path)) {
+        auto frontier = makeFrontier(dir, shards);
+        for (size_t i = 0; i < kUrls; ++i)
+            frontier->add(url(i), true);
+        frontier->sync();
+        CheckpointWriter writer(path);
+        writer.write(frontier->snapshot(true));
+        writer.wait();
+    }
+
+    auto frontier = makeFrontier(dir + "/recovered", shards);
+    auto start = Clock::now();
+    Checkpoint checkpoint = Checkpoint::read(path);
+    double read = secondsSince(start);
+    frontier->loadSeen(path, checkpoint.seen);
+    if (bulk) {
+        frontier->restore([&](size_t i) { return checkpoint.restore(i); });
+    } else {
+        for (size_t i = 0; i < checkpoint.numShards(); ++i) {
+            for (const std::string& u : checkpoint.restore(i).queued)
+                frontier->add(u, false);
+        }
+        frontier->sync();
+    }
+    double secs = secondsSince(start);
+    std::printf("%-10s %2zu shards %12.2f %12.0f   (read %.2f s, %zu "
+                "queued, %.0f MB)\n",
+                bulk ? "restore" : "add", shards, secs, kUrls / secs, read,
+                frontier->size(), fs::file_size(path) / 1e6);
+}
+
+int main() {
+    std::string dir = (fs::temp_directory_path() / "recovery_bench").string();
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::cout << kUrls << " urls on " << kHosts << " hosts\n";
+    std::cout << "queue build                seconds       urls/s\n";
+    buildQueue();
+
+    std::cout << "recovery                   seconds       urls/s\n";
+    for (size_t shards : {1, 4}) {
+        recover(dir, shards, false);
+        recover(dir, shards, true);
+    }
+    fs::remove_all(dir);
+}
@@ -0,0 +1,81 @@
+// Cost of the robots.txt cache at crawl scale: hosts with a handful of
+// rules each are set into a cache big enough to hold them all, then
+// checked with random urls, and the bytes per host reported. The same
+// hosts are then set into a cache bounded to 64 bytes per host, which
+// holds about a third of them and must keep evicting the least recently
+// used; checks of evicted hosts come back unknown.
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "RobotsCache.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Random {
+    uint64_t x = 88172645463325252ull;
+    uint64_t operator()() {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+};
+
+std::string hostName(size_t i) { return "host" + std::to_string(i) + ".com"; }
+
+// Five rules typical of real robots.txt files, one of them a wildcard.
+std::vector<RobotsCache::Rule> rulesFor(size_t i) {
+    std::string id = std::to_string(i % 97);
+    return {{"/admin/", false},
+            {"/search", false},
+            {"/search/about", true},
+            {"/private" + id + "/", false},
+            {"/*.pdf$", false}};
+}
+
+void run(size_t numHosts, size_t maxBytes) {
+    RobotsCache robots(maxBytes);
+    auto start = Clock::now();
+    for (size_t i = 0; i < numHosts; ++i)
+        robots.set(hostName(i), rulesFor(i));
+    double setSecs = secondsSince(start);
+
+    constexpr size_t kChecks = 4000000;
+    static const char* paths[] = {"/", "/admin/users", "/search?q=x",
+                                  "/search/about", "/wiki/Article",
+                                  "/private3/x", "/docs/a.pdf"};
+    std::vector<std::string> urls;
+    Random random;
+    for (size_t i = 0; i < 1 << 16; ++i) {
+        urls.push_back("https://" + hostName(random() % numHosts) +
+                       paths[random() % 7]);
+    }
+    size_t counts[3] = {};
+    start = Clock::now();
+    for (size_t i = 0; i < kChecks; ++i)
+        ++counts[static_cast<size_t>(robots.check(urls[i & 0xFFFF]))];
+    double checkSecs = secondsSince(start);
+
+    std::printf(
+        "%8zu hosts, bound %5zu MB: set %6.0f ns/host, check %4.0f ns/url, "
+        "%5.0f bytes/host, %8zu cached, %8llu evicted, "
+        "%zu unknown / %zu allowed / %zu disallowed\n",
+        numHosts, maxBytes >> 20, setSecs * 1e9 / numHosts,
+        checkSecs * 1e9 / kChecks,
+        static_cast<double>(robots.bytes()) / robots.numHosts(),
+        robots.numHosts(), static_cast<unsigned long long>(robots.evictions()),
+        counts[0], counts[1], counts[2]);
+}
+
+int main() {
+    for (size_t numHosts : {1000, 1000000, 4000000}) {
+        run(numHosts, numHosts * 512);
+        run(numHosts, numHosts * 64);
+    }
+}
@@ -0,0 +1,87 @@
+// Startup time for a large seed list: read with std::getline and added url
+// by url (how the frontier used to load seeds), against mapping it with
+// SeedList and queueing it with ShardedFrontier::addBulk(), which also
+// marks every seed seen. The list has kSeeds lines in no particular order,
+// with one line in kDuplicateEvery repeated.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "SeedList.hpp"
+#include "ShardedFrontier.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kSeeds = 10000000;
+constexpr size_t kHosts = 500000;
+constexpr size_t kDuplicateEvery = 50;
+
+namespace fs = std::filesystem;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::unique_ptr<ShardedFrontier> makeFrontier(const std::string& dir,
+                                              size_t shards) {
+    std::vector<std::unique_ptr<DedupStore>> seen;
+    for (size_t i = 0; i < shards; ++i)
+        seen.push_back(makeDedupStore("bloom", 2 * kSeeds / shards, ""));
+    ShardedFrontier::Options options;
+    options.capacity = kSeeds;
+    options.spillDir = dir + "/spill";
+    return std::make_unique<ShardedFrontier>(std::move(seen), options);
+}
+
+int main() {
+    std::string dir = (fs::temp_directory_path() / "seed_bench").string();
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string path = dir + "/seeds.txt";
+    {
+        std::ofstream out(path);
+        for (size_t i = 0; i < kSeeds; ++i) {
+            // Line i repeats line i / 2, host included.
+            size_t n = i % kDuplicateEvery == 0 ? i / 2 : i;
+            uint64_t host = n * 0x9E3779B97F4A7C15ull;
+            host ^= host >> 29;
+            out << "https://www.site" << host % kHosts << ".com/section/"
+                << n << "\n";
+        }
+    }
+    std::cout << kSeeds << " seeds, " << fs::file_size(path) / 1000000
+              << " MB\n";
+    std::cout << "load                       seconds      seeds/s\n";
+
+    for (size_t shards : {1, 4}) {
+        {
+            auto frontier = makeFrontier(dir, shards);
+            auto start = Clock::now();
+            std::ifstream file(path);
+            std::string url;
+            while (std::getline(file, url))
+                frontier->add(url, false);
+            frontier->sync();
+            double secs = secondsSince(start);
+            std::printf("getline + add %2zu shards %9.2f %12.0f   (%zu "
+                        "queued)\n",
+                        shards, secs, kSeeds / secs, frontier->size());
+        }
+        {
+            auto frontier = makeFrontier(dir, shards);
+            auto start = Clock::now();
+            SeedList seeds = SeedList::read(path);
+            double read = secondsSince(start);
+            frontier->addBulk(seeds.urls(), true);
+            frontier->sync();
+            double secs = secondsSince(start);
+            std::printf("addBulk       %2zu shards %9.2f %12.0f   (%zu "
+                        "queued, read %.2f s)\n",
+                        shards, secs, kSeeds / secs, frontier->size(), read);
+        }
+    }
+    fs::remove_all(dir);
+}
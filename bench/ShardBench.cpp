@@ -0,0 +1,65 @@
+// Urls per second through ShardedFrontier against the number of shards.
+// Each round adds a batch of new urls with dedup and takes a batch out, as
+// the frontier does per request, until every url has been taken. Speedup
+// is bounded by the number of cores on the machine.
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShardedFrontier.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kUrls = 2000000;
+constexpr int kHosts = 50000;
+constexpr size_t kBatch = 500;
+
+namespace fs = std::filesystem;
+
+int main() {
+    std::vector<std::string> urls;
+    urls.reserve(kUrls);
+    for (int i = 0; i < kUrls; ++i) {
+        urls.push_back("https://www.host" + std::to_string(i % kHosts) +
+                       ".com/path/to/page/" + std::to_string(i));
+    }
+    std::string dir = (fs::temp_directory_path() / "shard_bench").string();
+
+    std::cout << "cores " << std::thread::hardware_concurrency() << ", "
+              << kUrls << " urls over " << kHosts << " hosts\n";
+    std::cout << "shards      urls/s   speedup\n";
+    double base = 0;
+    for (size_t n : {1, 2, 4, 8, 16}) {
+        fs::remove_all(dir);
+        std::vector<std::unique_ptr<DedupStore>> seen;
+        for (size_t i = 0; i < n; ++i)
+            seen.push_back(makeDedupStore("bloom", kUrls / n + 1, ""));
+        ShardedFrontier::Options options;
+        options.capacity = kUrls;
+        options.spillDir = dir;
+        ShardedFrontier frontier(std::move(seen), options);
+
+        auto start = Clock::now();
+        size_t taken = 0;
+        for (size_t i = 0; i < urls.size(); i += kBatch) {
+            for (size_t j = i; j < std::min(urls.size(), i + kBatch); ++j)
+                frontier.add(urls[j], true);
+            frontier.flush();
+            taken += frontier.take(kBatch).size();
+        }
+        frontier.sync();
+        while (taken < urls.size() && frontier.size() > 0)
+            taken += frontier.take(kBatch, 100).size();
+        double secs =
+            std::chrono::duration<double>(Clock::now() - start).count();
+
+        double rate = taken / secs;
+        if (n == 1)
+            base = rate;
+        std::printf("%6zu %11.0f %8.2fx\n", n, rate, rate / base);
+    }
+    fs::remove_all(dir);
+}
@@ -0,0 +1,123 @@
+// Memory per queued url and push/pop throughput of the url arena, against
+// one std::string per url as PriorityQueue used to keep them. 2M urls made
+// from emergencylist.txt, spread over 100k hosts, are queued in per-host
+// FIFOs and popped round-robin: first the storage alone, then through
+// PriorityQueue. Memory is what malloc reports in use.
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PriorityQueue.hpp"
+#include "UrlArena.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kUrls = 2000000;
+constexpr size_t kHosts = 100000;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+size_t heapBytes() { return mallinfo2().uordblks; }
+
+void report(const char* name, size_t bytes, double pushSecs, double popSecs) {
+    std::printf("%-28s %6.1f bytes/url %6.0f ns/push %6.0f ns/pop\n", name,
+                static_cast<double>(bytes) / kUrls, pushSecs * 1e9 / kUrls,
+                popSecs * 1e9 / kUrls);
+}
+
+// Pops one url per host in turn until every FIFO is empty.
+template <typename Fifo, typename Pop>
+size_t drain(std::vector<Fifo>& fifos, Pop&& pop) {
+    std::vector<size_t> heads(fifos.size());
+    size_t checksum = 0;
+    for (size_t left = kUrls; left > 0;) {
+        for (size_t h = 0; h < fifos.size(); ++h) {
+            if (heads[h] < fifos[h].size()) {
+                checksum += pop(fifos[h][heads[h]++]).size();
+                --left;
+            }
+        }
+    }
+    return checksum;
+}
+
+void benchStrings(const std::vector<std::string>& urls) {
+    size_t before = heapBytes();
+    auto start = Clock::now();
+    std::vector<std::vector<std::string>> fifos(kHosts);
+    for (size_t i = 0; i < urls.size(); ++i)
+        fifos[i % kHosts].push_back(urls[i]);
+    double pushSecs = secondsSince(start);
+    size_t bytes = heapBytes() - before;
+    start = Clock::now();
+    drain(fifos, [](std::string& url) { return std::string(std::move(url)); });
+    report("std::string per url", bytes, pushSecs, secondsSince(start));
+}
+
+void benchArena(const std::vector<std::string>& urls) {
+    size_t before = heapBytes();
+    auto start = Clock::now();
+    UrlArena arena;
+    std::vector<std::vector<UrlArena::Ref>> fifos(kHosts);
+    for (size_t i = 0; i < urls.size(); ++i)
+        fifos[i % kHosts].push_back(arena.add(urls[i]));
+    double pushSecs = secondsSince(start);
+    size_t bytes = heapBytes() - before;
+    start = Clock::now();
+    drain(fifos, [&arena](UrlArena::Ref ref) {
+        std::string url(arena.get(ref));
+        arena.release(ref);
+        return url;
+    });
+    report("UrlArena", bytes, pushSecs, secondsSince(start));
+}
+
+void benchQueue(const std::vector<std::string>& urls) {
+    size_t before = heapBytes();
+    auto start = Clock::now();
+    PriorityQueue pq(kUrls);
+    for (const std::string& url : urls)
+        pq.push(url);
+    double pushSecs = secondsSince(start);
+    size_t bytes = heapBytes() - before;
+    start = Clock::now();
+    while (pq.size() > 0)
+        pq.popN(50);
+    report("PriorityQueue", bytes, pushSecs, secondsSince(start));
+}
+
+int main() {
+    std::ifstream file(PROJECT_ROOT "emergencylist.txt");
+    std::vector<std::string> paths;
+    for (std::string line; std::getline(file, line);) {
+        if (line.compare(0, 8, "https://") == 0)
+            paths.push_back(line.substr(8));
+    }
+    if (paths.empty()) {
+        std::cerr << "No urls in emergencylist.txt\n";
+        return 1;
+    }
+    // Host i % kHosts in front of each line's own host, so the FIFOs and
+    // the queue see the same hosts.
+    std::vector<std::string> urls;
+    urls.reserve(kUrls);
+    size_t length = 0;
+    for (size_t i = 0; i < kUrls; ++i) {
+        urls.push_back("https://h" + std::to_string(i % kHosts) + "." +
+                       paths[i % paths.size()]);
+        length += urls.back().size();
+    }
+    std::printf("%zu urls over %zu hosts, %.1f bytes long on average\n",
+                kUrls, kHosts, static_cast<double>(length) / kUrls);
+
+    benchStrings(urls);
+    benchArena(urls);
+    benchQueue(urls);
+}
@@ -0,0 +1,87 @@
+// Throughput of url canonicalization on emergencylist.txt (or the file
+// given as the first argument), against the whitespace trim the ingest path
+// used to apply and against parsing alone. Also counts the distinct urls
+// before and after, which is how many seen-filter slots and crawls the
+// canonical form saves.
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Url.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRounds = 200;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+template <typename F>
+void run(const char* name, const std::vector<std::string>& urls, F&& f) {
+    size_t bytes = 0;
+    size_t checksum = 0;
+    auto start = Clock::now();
+    for (int r = 0; r < kRounds; ++r) {
+        for (const std::string& url : urls) {
+            checksum += f(url);
+            bytes += url.size();
+        }
+    }
+    double secs = secondsSince(start);
+    std::printf("%-22s %12.0f %10.1f   (%zu)\n", name,
+                urls.size() * kRounds / secs, bytes / secs / 1e6, checksum);
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : PROJECT_ROOT "emergencylist.txt";
+    std::ifstream file(path);
+    std::vector<std::string> urls;
+    for (std::string line; std::getline(file, line);)
+        urls.push_back(line);
+    if (urls.empty()) {
+        std::cerr << "No urls in " << path << "\n";
+        return 1;
+    }
+
+    std::cout << urls.size() << " urls x " << kRounds << " rounds\n";
+    std::cout << "                             urls/s       MB/s\n";
+    run("trim", urls, [](const std::string& u) { return trim(u).size(); });
+    run("Url::hostOf + tldOf", urls, [](const std::string& u) {
+        return Url::tldOf(Url::hostOf(u)).size();
+    });
+    Url parts;
+    run("Url::parse", urls, [&](const std::string& u) {
+        return Url::parse(u, parts) ? parts.domain.size() : 0;
+    });
+    UrlCanonicalizer canonicalizer;
+    run("canonicalize", urls, [&](const std::string& u) {
+        return canonicalizer.canonicalize(u).size();
+    });
+
+    std::unordered_set<std::string> trimmed, canonical;
+    size_t rejected = 0;
+    for (const std::string& url : urls) {
+        trimmed.emplace(trim(url));
+        std::string_view c = canonicalizer.canonicalize(url);
+        if (c.empty())
+            ++rejected;
+        else
+            canonical.emplace(c);
+    }
+    std::printf("\ndistinct urls: %zu trimmed, %zu canonical, %zu rejected\n",
+                trimmed.size(), canonical.size(), rejected);
+}
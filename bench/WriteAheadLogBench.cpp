@@ -0,0 +1,138 @@
+// Write-ahead log throughput and recovery time. Requests of kPerRequest
+// records are committed either one at a time (the core thread waits for
+// every sync) or grouped (a sender thread waits, as in RequestPipeline,
+// while the core thread goes on). Then kRecords records are logged after a
+// checkpoint and replayed: parsing the log alone, Checkpoint::read with
+// takes cancelling adds, and applying the result to a ShardedFrontier.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Checkpoint.hpp"
+#include "SpscQueue.hpp"
+#include "WriteAheadLog.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kPerRequest = 50;
+constexpr int kRequests = 2000;
+constexpr uint64_t kRecords = 10000000;
+// One url in this many is handed out again before the crash.
+constexpr uint64_t kTakeEvery = 5;
+
+namespace fs = std::filesystem;
+
+std::string url(uint64_t i) {
+    return "https://www.host" + std::to_string(i % 100000) + ".com/page/" +
+           std::to_string(i);
+}
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void commitRequests(const std::string& dir, bool grouped) {
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    WriteAheadLog log(dir + "/log");
+    SpscQueue<uint64_t> tickets(4096);
+    std::thread sender([&]() {
+        uint64_t ticket;
+        while (tickets.pop(ticket))
+            log.waitFor(ticket);
+    });
+
+    uint64_t next = 0;
+    auto start = Clock::now();
+    for (int r = 0; r < kRequests; ++r) {
+        for (int i = 0; i < kPerRequest; ++i)
+            log.add(url(next++));
+        uint64_t ticket = log.mark();
+        if (grouped)
+            tickets.push(ticket);
+        else
+            log.waitFor(ticket);
+    }
+    tickets.close();
+    sender.join();
+    double secs = secondsSince(start);
+    WriteAheadLog::Stats stats = log.stats();
+    std::printf("%-10s %12.0f %12.0f %10llu %14.1f\n",
+                grouped ? "grouped" : "one by one", kRequests / secs,
+                next / secs, static_cast<unsigned long long>(stats.syncs),
+                double(kRequests) / stats.syncs);
+}
+
+std::unique_ptr<ShardedFrontier> makeFrontier(const std::string& dir) {
+    std::vector<std::unique_ptr<DedupStore>> seen;
+    seen.push_back(makeDedupStore("bloom", 2 * kRecords, ""));
+    ShardedFrontier::Options options;
+    options.capacity = 1000000;
+    options.spillDir = dir + "/spill";
+    return std::make_unique<ShardedFrontier>(std::move(seen), options);
+}
+
+int main() {
+    std::string dir = (fs::temp_directory_path() / "wal_bench").string();
+    std::cout << kRequests << " requests of " << kPerRequest << " records\n";
+    std::cout << "commit       requests/s    records/s      syncs  "
+                 "requests/sync\n";
+    commitRequests(dir, false);
+    commitRequests(dir, true);
+
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string path = dir + "/frontier.ckpt";
+    {
+        auto frontier = makeFrontier(dir);
+        CheckpointWriter writer(path);
+        WriteAheadLog log(Checkpoint::logPath(path));
+        writer.write(frontier->snapshot(true), log.rotate());
+        writer.wait();
+
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < kRecords;) {
+            for (int k = 0; k < kPerRequest && i < kRecords; ++k, ++i) {
+                if (i % kTakeEvery == kTakeEvery - 1)
+                    log.take(url(i - 1));
+                else
+                    log.add(url(i));
+            }
+            log.mark();
+        }
+        log.waitFor(log.mark());
+        double secs = secondsSince(start);
+        WriteAheadLog::Stats stats = log.stats();
+        std::printf("\nlogged %llu records, %.1f MB, in %.2f s (%llu syncs)\n",
+                    static_cast<unsigned long long>(stats.records),
+                    stats.bytes / 1e6, secs,
+                    static_cast<unsigned long long>(stats.syncs));
+    }
+
+    std::cout << "replay                     seconds    records/s\n";
+    auto start = Clock::now();
+    uint64_t records = 0;
+    WriteAheadLog::replay(
+        Checkpoint::logPath(path), 0,
+        [&](WriteAheadLog::Op, std::string_view) { ++records; });
+    double secs = secondsSince(start);
+    std::printf("parse log            %12.2f %12.0f\n", secs, records / secs);
+
+    start = Clock::now();
+    Checkpoint checkpoint = Checkpoint::read(path);
+    secs = secondsSince(start);
+    std::printf("read checkpoint      %12.2f %12.0f\n", secs,
+                checkpoint.log.records / secs);
+
+    start = Clock::now();
+    auto frontier = makeFrontier(dir + "/recovered");
+    frontier->restore([&](size_t i) { return checkpoint.restore(i); });
+    secs = secondsSince(start);
+    std::printf("apply to frontier    %12.2f %12.0f   (%zu urls queued)\n",
+                secs, checkpoint.numLogged / secs, frontier->size());
+    frontier.reset();
+    fs::remove_all(dir);
+}
@@ -0,0 +1,76 @@
+#include "BatchSizer.hpp"
+
+#include <algorithm>
+
+namespace {
+// Weight of the newest gap in a worker's fetch time. A batch's urls are
+// fetched together, so one gap already averages many fetches.
+constexpr double kNewWeight = 0.25;
+}  // namespace
+
+BatchSizer::BatchSizer(const Options& options) : options(options) {
+    this->options.min = std::max<uint32_t>(options.min, 1);
+    this->options.max = std::max(options.max, this->options.min);
+    this->options.initial = std::max<uint32_t>(options.initial, 1);
+}
+
+BatchSizer::Worker& BatchSizer::worker(int sock) {
+    size_t i = static_cast<size_t>(std::max(sock, 0));
+    if (i >= workers.size())
+        workers.resize(std::max(i + 1, 2 * workers.size()));
+    return workers[i];
+}
+
+void BatchSizer::restart(int sock) {
+    Worker& w = worker(sock);
+    if (w.usPerUrl > 0)
+        --totals.workers;
+    w = Worker();
+}
+
+size_t BatchSizer::size(int sock, int64_t receivedUs) {
+    if (options.targetMs == 0)
+        return options.initial;
+
+    Worker& w = worker(sock);
+    if (w.servedUs >= 0 && w.urls > 0 && receivedUs > w.servedUs) {
+        double sample = static_cast<double>(receivedUs - w.servedUs) / w.urls;
+        if (w.usPerUrl == 0) {
+            w.usPerUrl = sample;
+            ++totals.workers;
+        } else {
+            w.usPerUrl += kNewWeight * (sample - w.usPerUrl);
+        }
+    }
+    w.servedUs = -1;
+
+    size_t size = options.initial;
+    if (w.usPerUrl > 0) {
+        size = static_cast<size_t>(options.targetMs * 1000.0 / w.usPerUrl);
+        // A worker that got through a batch quickly, say because its hosts
+        // all failed, is not trusted with far more urls at once.
+        if (w.size > 0)
+            size = std::min(size, 2 * size_t{w.size});
+    }
+    size = std::clamp<size_t>(size, options.min, options.max);
+    w.size = static_cast<uint32_t>(size);
+    return size;
+}
+
+void BatchSizer::served(int sock, size_t urls, int64_t receivedUs,
+                        int64_t readyUs) {
+    Worker& w = worker(sock);
+    w.servedUs = urls > 0 ? readyUs : -1;
+    w.urls = static_cast<uint32_t>(urls);
+    if (urls == 0)
+        return;
+    ++totals.requests;
+    totals.urls += urls;
+    totals.idleUs += static_cast<uint64_t>(std::max<int64_t>(
+        readyUs - receivedUs, 0));
+}
+
+double BatchSizer::usPerUrl(int sock) const {
+    size_t i = static_cast<size_t>(std::max(sock, 0));
+    return i < workers.size() ? workers[i].usPerUrl : 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sizes the batch of urls each worker gets per request. A worker's fetch
+// time per url is measured from the gap between a response and its next
+// request, as a moving average, and its batches are sized to keep it busy
+// for about Options::targetMs: fast workers get more urls per round-trip,
+// and slow ones sit on fewer urls that other workers could be fetching.
+//
+// Workers are told apart by the socket of their connection. Sockets are
+// reused once closed, so restart() forgets a socket's worker when a new
+// one starts on it. Single-threaded; times are in microseconds of any
+// monotonic clock.
+class BatchSizer {
+   public:
+    struct Options {
+        uint32_t initial = 4;  // urls for a worker not measured yet
+        uint32_t min = 1;
+        uint32_t max = 1000;
+        // Time a worker should spend fetching one batch; 0 sends every
+        // worker `initial` urls, as a fixed batch size.
+        uint32_t targetMs = 5000;
+    };
+
+    struct Stats {
+        uint64_t requests = 0;  // responses with urls
+        uint64_t urls = 0;
+        // Receipt of a request to its response, summed: time workers spent
+        // waiting on the frontier rather than fetching.
+        uint64_t idleUs = 0;
+        size_t workers = 0;  // measured at least once
+    };
+
+    explicit BatchSizer(const Options& options);
+    BatchSizer() : BatchSizer(Options()) {}
+
+    // Forgets the worker on sock, for a new connection on it.
+    void restart(int sock);
+
+    // Urls to send the worker on sock for a request received at
+    // receivedUs. The gap since its last response updates its fetch time.
+    size_t size(int sock, int64_t receivedUs);
+
+    // Records that `urls` urls were sent for a request received at
+    // receivedUs, with the response ready at readyUs. 0 urls leave
+    // nothing to measure the next request against.
+    void served(int sock, size_t urls, int64_t receivedUs, int64_t readyUs);
+
+    // Measured fetch time per url of the worker on sock, 0 if unknown.
+    double usPerUrl(int sock) const;
+
+    const Stats& stats() const { return totals; }
+    double roundTripsPerMillion() const {
+        return totals.urls == 0 ? 0 : totals.requests * 1e6 / totals.urls;
+    }
+
+   private:
+    struct Worker {
+        int64_t servedUs = -1;  // last response with urls, -1 if none
+        uint32_t urls = 0;      // in that response
+        uint32_t size = 0;      // last size handed out, 0 if none
+        double usPerUrl = 0;    // 0 until measured
+    };
+
+    Options options;
+    std::vector<Worker> workers;  // by socket
+    Stats totals;
+
+    Worker& worker(int sock);
+};
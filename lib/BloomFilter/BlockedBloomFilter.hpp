@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "WordArray.hpp"
+#include "XXHash.hpp"
+
+// Bloom filter where every probe for a key lands in the same 64-byte block,
+// so a lookup costs one cache miss instead of numHashes. Keys are hashed
+// once with XXH64: the high 32 bits pick the block and the probe positions
+// inside the block are drawn from a remix of the full hash.
+//
+// Blocking raises the false positive rate slightly compared to a classic
+// filter of the same size, so the filter is sized for a rate a little below
+// the one requested.
+//
+// Blocks that gained a bit since the last clearDirty() are tracked, so an
+// incremental checkpoint only has to write those. Pages are too coarse for
+// this: hashing spreads inserts over the whole filter, so a few thousand
+// new urls dirty nearly every 4KB page.
+class BlockedBloomFilter {
+   public:
+    static constexpr size_t kBlockBits = 512;
+    static constexpr size_t kBlockWords = kBlockBits / 64;
+
+    BlockedBloomFilter(uint64_t numObjects, double falsePositiveRate)
+        : numBlocks(blocksFor(numObjects, falsePositiveRate)),
+          numHashes(hashesFor(numObjects, numBlocks)),
+          words(numBlocks * kBlockWords),
+          dirty((numBlocks + 63) / 64) {}
+
+    void insert(std::string_view s) { insertHash(xxhash::hash64(s)); }
+
+    bool contains(std::string_view s) const {
+        return containsHash(xxhash::hash64(s));
+    }
+
+    // Inserts s and returns true if it was not already present. Hashes and
+    // touches the block once.
+    bool insertIfAbsent(std::string_view s) {
+        uint64_t h = xxhash::hash64(s);
+        uint64_t* block = blockFor(h);
+        uint64_t x = h;
+        bool absent = false;
+        for (size_t i = 0; i < numHashes; ++i) {
+            uint32_t bit = probe(x, i);
+            uint64_t mask = uint64_t(1) << (bit & 63);
+            absent |= !(block[bit >> 6] & mask);
+            block[bit >> 6] |= mask;
+        }
+        if (absent)
+            markDirty(h);
+        return absent;
+    }
+
+    void insertHash(uint64_t h) {
+        uint64_t* block = blockFor(h);
+        uint64_t x = h;
+        for (size_t i = 0; i < numHashes; ++i) {
+            uint32_t bit = probe(x, i);
+            block[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+        markDirty(h);
+    }
+
+    bool containsHash(uint64_t h) const {
+        const uint64_t* block =
+            const_cast<BlockedBloomFilter*>(this)->blockFor(h);
+        uint64_t x = h;
+        for (size_t i = 0; i < numHashes; ++i) {
+            uint32_t bit = probe(x, i);
+            if (!(block[bit >> 6] & (uint64_t(1) << (bit & 63))))
+                return false;
+        }
+        return true;
+    }
+
+    size_t numBits() const { return numBlocks * kBlockBits; }
+    size_t hashes() const { return numHashes; }
+    size_t popcount() const { return words.popcount(); }
+    double fillRatio() const { return double(popcount()) / numBits(); }
+
+    // Writes the block count, hash count and then the blocks as one
+    // page-aligned block.
+    void save(std::ostream& out) const {
+        uint64_t header[2] = {numBlocks, numHashes};
+        words.save(out, header);
+    }
+
+    // Writes the count of dirty blocks and then each one as its index and
+    // words, and clears them.
+    void saveDirty(std::ostream& out) {
+        uint64_t count = 0;
+        for (uint64_t w : dirty)
+            count += __builtin_popcountll(w);
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        const uint64_t* w = words.data();
+        for (size_t i = 0; i < dirty.size(); ++i) {
+            for (uint64_t bits = dirty[i]; bits; bits &= bits - 1) {
+                uint64_t block = i * 64 + __builtin_ctzll(bits);
+                out.write(reinterpret_cast<const char*>(&block), sizeof(block));
+                out.write(reinterpret_cast<const char*>(w + block * kBlockWords),
+                          kBlockWords * sizeof(uint64_t));
+            }
+        }
+        clearDirty();
+    }
+
+    // Applies blocks written by saveDirty(). Returns false on a short read
+    // or a block outside the filter.
+    bool loadDirty(std::istream& in) {
+        uint64_t count = 0;
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        uint64_t* w = words.data();
+        for (uint64_t i = 0; in && i < count; ++i) {
+            uint64_t block = 0;
+            in.read(reinterpret_cast<char*>(&block), sizeof(block));
+            if (block >= numBlocks)
+                return false;
+            in.read(reinterpret_cast<char*>(w + block * kBlockWords),
+                    kBlockWords * sizeof(uint64_t));
+        }
+        return static_cast<bool>(in);
+    }
+
+    size_t numDirty() const {
+        size_t n = 0;
+        for (uint64_t w : dirty)
+            n += __builtin_popcountll(w);
+        return n;
+    }
+
+    void clearDirty() { std::fill(dirty.begin(), dirty.end(), 0); }
+
+    // Maps a filter written by save() at `offset` of `path`.
+    bool load(const std::string& path, size_t offset) {
+        uint64_t header[2];
+        if (!words.load(path, offset, header, [](const uint64_t* h) {
+                return h[0] * kBlockWords;
+            })) {
+            return false;
+        }
+        numBlocks = header[0];
+        numHashes = header[1];
+        dirty.assign((numBlocks + 63) / 64, 0);
+        return true;
+    }
+
+   private:
+    uint64_t numBlocks;
+    uint64_t numHashes;
+    WordArray words;
+    std::vector<uint64_t> dirty;  // one bit per block
+
+    static uint64_t blocksFor(uint64_t n, double p) {
+        // Aim for half the requested rate to make up for blocking.
+        double bits = -(std::max<uint64_t>(n, 1) * std::log(p / 2)) /
+                      (std::log(2) * std::log(2));
+        return std::max<uint64_t>(1, std::ceil(bits / kBlockBits));
+    }
+
+    static uint64_t hashesFor(uint64_t n, uint64_t blocks) {
+        double k = double(blocks * kBlockBits) / std::max<uint64_t>(n, 1) *
+                   std::log(2);
+        return std::clamp<uint64_t>(std::llround(k), 1, 16);
+    }
+
+    // Maps the high 32 bits onto [0, numBlocks) without a division.
+    uint64_t blockIndex(uint64_t h) const {
+        return ((h >> 32) * numBlocks) >> 32;
+    }
+
+    uint64_t* blockFor(uint64_t h) {
+        return words.data() + blockIndex(h) * kBlockWords;
+    }
+
+    void markDirty(uint64_t h) {
+        uint64_t block = blockIndex(h);
+        dirty[block >> 6] |= uint64_t(1) << (block & 63);
+    }
+
+    // Returns the i-th 9-bit probe position. x is remixed every 7 probes,
+    // since each remix yields 63 usable bits.
+    static uint32_t probe(uint64_t& x, size_t i) {
+        size_t slot = i % 7;
+        if (slot == 0)
+            x = (x ^ (x >> 31)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<uint32_t>(x >> (slot * 9)) & (kBlockBits - 1);
+    }
+};
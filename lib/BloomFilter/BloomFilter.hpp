@@ -1,18 +1,24 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <openssl/md5.h>
 
+#include "WordArray.hpp"
+
 class BloomFilter {
    public:
     BloomFilter(int num_objects, double false_positive_rate)
         : bits(-(num_objects * std::log(false_positive_rate)) /
                std::pow((std::log(2)), 2)),
           numHashes(static_cast<float>(bits) / num_objects * std::log(2)),
-          bloom(bits) {
+          words((bits + 63) / 64) {
         // Determine the size of bits of our data vector, and resize.
 
         // Determine number of hash functions to use.
@@ -25,8 +31,10 @@ class BloomFilter {
         uint64_t rHash = sHash.second;
 
         // Use double hashing to get unique bit, and repeat for each hash function.
-        for (int i = 0; i < numHashes; ++i) {
-            bloom[doubleHash(lHash, rHash, i)] = 1;
+        uint64_t* w = words.data();
+        for (size_t i = 0; i < numHashes; ++i) {
+            size_t bit = doubleHash(lHash, rHash, i);
+            w[bit >> 6] |= uint64_t(1) << (bit & 63);
         }
     }
 
@@ -40,12 +48,42 @@ class BloomFilter {
 
         // If all bits were true, the string is likely inserted, but false positive is possible.
 
-        for (int i = 0; i < numHashes; ++i) {
-            if (!bloom[doubleHash(lHash, rHash, i)])
+        const uint64_t* w = words.data();
+        for (size_t i = 0; i < numHashes; ++i) {
+            size_t bit = doubleHash(lHash, rHash, i);
+            if (!(w[bit >> 6] & (uint64_t(1) << (bit & 63))))
                 return false;
         }
 
-        // This line is for compiling, replace this with own code.
+        return true;
+    }
+
+    size_t numBits() const { return bits; }
+
+    // Number of set bits, one popcount per word.
+    size_t popcount() const { return words.popcount(); }
+
+    // Fraction of bits set. The false positive rate is roughly this to the
+    // power of numHashes.
+    double fillRatio() const { return bits ? double(popcount()) / bits : 0; }
+
+    // Writes the filter as its bit count, hash count and then the words as
+    // one page-aligned block.
+    void save(std::ostream& out) const {
+        uint64_t header[2] = {bits, numHashes};
+        words.save(out, header);
+    }
+
+    // Maps a filter written by save() at `offset` of `path`.
+    bool load(const std::string& path, size_t offset) {
+        uint64_t header[2];
+        if (!words.load(path, offset, header, [](const uint64_t* h) {
+                return (h[0] + 63) / 64;
+            })) {
+            return false;
+        }
+        bits = header[0];
+        numHashes = header[1];
         return true;
     }
 
@@ -53,11 +91,12 @@ class BloomFilter {
     // Add any private member variables that may be neccessary.
     friend class Frontier;
 
-    size_t bits;
-    size_t numHashes;
-    std::vector<bool> bloom;
+    size_t bits = 0;
+    size_t numHashes = 0;
+
+    WordArray words;
 
-    size_t doubleHash(uint64_t lHash, uint64_t rHash, size_t itr) {
+    size_t doubleHash(uint64_t lHash, uint64_t rHash, size_t itr) const {
         return (lHash + itr * rHash) % bits;
     }
 
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Fixed-size array of 64-bit words that is either owned or mapped from a
+// save file. Shared by the Bloom filters for checkpointing.
+class WordArray {
+   public:
+    explicit WordArray(size_t numWords = 0) : owned(alignedWords(numWords)) {
+        count = numWords;
+    }
+
+    WordArray(const WordArray&) = delete;
+    WordArray& operator=(const WordArray&) = delete;
+
+    WordArray(WordArray&& other) noexcept { swap(other); }
+    WordArray& operator=(WordArray&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~WordArray() { unmap(); }
+
+    // Words start on a 64-byte boundary, whether owned or mapped.
+    uint64_t* data() { return mapped ? mapped : alignedData(); }
+    const uint64_t* data() const {
+        return mapped ? mapped : const_cast<WordArray*>(this)->alignedData();
+    }
+    size_t size() const { return count; }
+
+    size_t popcount() const {
+        const uint64_t* w = data();
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+            n += __builtin_popcountll(w[i]);
+        return n;
+    }
+
+    // Writes `header` and then the words as one block starting on a page
+    // boundary, so load() can map it.
+    template <size_t N>
+    void save(std::ostream& out, const uint64_t (&header)[N]) const {
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        size_t pos = static_cast<size_t>(out.tellp());
+        std::string padding(alignUp(pos) - pos, '\0');
+        out.write(padding.data(), padding.size());
+        out.write(reinterpret_cast<const char*>(data()),
+                  count * sizeof(uint64_t));
+    }
+
+    // Reads the header written by save() at `offset` of `path` and maps
+    // numWords(header) words copy-on-write, so this takes milliseconds and
+    // pages are only read in as they are touched. Fails if the file is too
+    // short to hold them. The file must not be truncated while it is
+    // mapped; replace it with a rename instead.
+    template <size_t N, typename NumWords>
+    bool load(const std::string& path, size_t offset, uint64_t (&header)[N],
+              NumWords numWords) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        bool ok = ::pread(fd, header, sizeof(header), offset) ==
+                  static_cast<ssize_t>(sizeof(header));
+        size_t words = ok ? numWords(header) : 0;
+        size_t length = words * sizeof(uint64_t);
+        size_t start = alignUp(offset + sizeof(header));
+        // Touching a page past the end of the file raises SIGBUS, so a
+        // file cut short must be caught here.
+        struct stat st;
+        ok = ok && ::fstat(fd, &st) == 0 &&
+             static_cast<uint64_t>(st.st_size) >= start &&
+             words <= (static_cast<uint64_t>(st.st_size) - start) /
+                          sizeof(uint64_t);
+        void* map = MAP_FAILED;
+        if (ok && length > 0) {
+            map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                         fd, start);
+        }
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return false;
+
+        unmap();
+        std::vector<uint64_t>().swap(owned);
+        mapped = static_cast<uint64_t*>(map);
+        count = words;
+        return true;
+    }
+
+   private:
+    static constexpr size_t kAlignWords = 64 / sizeof(uint64_t);
+
+    std::vector<uint64_t> owned;
+    uint64_t* mapped = nullptr;
+    size_t count = 0;
+
+    // std::vector does not guarantee 64-byte alignment, so over-allocate
+    // and start at the first aligned word.
+    static size_t alignedWords(size_t numWords) {
+        return numWords ? numWords + kAlignWords - 1 : 0;
+    }
+    uint64_t* alignedData() {
+        uintptr_t p = reinterpret_cast<uintptr_t>(owned.data());
+        return reinterpret_cast<uint64_t*>((p + 63) & ~uintptr_t(63));
+    }
+
+    static size_t alignUp(size_t pos) {
+        size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        return (pos + page - 1) / page * page;
+    }
+
+    void unmap() {
+        if (mapped)
+            ::munmap(mapped, count * sizeof(uint64_t));
+        mapped = nullptr;
+    }
+
+    void swap(WordArray& other) {
+        owned.swap(other.owned);
+        std::swap(mapped, other.mapped);
+        std::swap(count, other.count);
+    }
+};
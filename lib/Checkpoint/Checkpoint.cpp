@@ -0,0 +1,572 @@
+#include "Checkpoint.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "Crc32.hpp"
+#include "Durable.hpp"
+#include "XXHash.hpp"
+
+namespace {
+
+constexpr uint64_t kBaseMagic = 0x54504b43544e5246;   // "FRNTCKPT"
+constexpr uint64_t kDeltaMagic = 0x41544c44544e5246;  // "FRNTDLTA"
+
+struct BaseHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t generation;
+    uint64_t numShards;
+    uint64_t logSegment;
+};
+
+struct DeltaHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t generation;
+};
+
+struct RecordHeader {
+    uint64_t length;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// One per shard in the table at the end of the base.
+struct ShardEntry {
+    uint64_t queueOffset;
+    uint64_t queueLength;
+    uint64_t numQueued;
+    uint64_t seenOffset;
+    uint64_t seenLength;
+    uint32_t queueCrc;
+    uint32_t seenCrc;
+};
+
+// Ends the base: the CRC-32C of the header and the table.
+struct Trailer {
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+size_t pageSize() {
+    return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+// Runs f(i) for i in [0, n), each on a thread of its own.
+template <typename F>
+void parallelFor(size_t n, F&& f) {
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < n; ++i)
+        threads.emplace_back([&f, i]() { f(i); });
+    if (n > 0)
+        f(0);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// Bounds-checked cursor over a delta record.
+struct Reader {
+    const char* pos;
+    const char* end;
+
+    uint64_t u64() {
+        if (end - pos < 8)
+            throw std::runtime_error("Truncated checkpoint");
+        uint64_t value;
+        std::memcpy(&value, pos, 8);
+        pos += 8;
+        return value;
+    }
+
+    std::string_view bytes(uint64_t n) {
+        if (uint64_t(end - pos) < n)
+            throw std::runtime_error("Truncated checkpoint");
+        std::string_view s(pos, n);
+        pos += n;
+        return s;
+    }
+
+    // Reads a count and a length, and returns that many bytes of records.
+    std::string_view records(uint64_t& count) {
+        count = u64();
+        return bytes(u64());
+    }
+};
+
+// Calls f(url) for up to count (length, bytes) records in data. The
+// sections were checked against their CRCs, so this only guards against
+// running off the end.
+template <typename F>
+void forEachRecord(std::string_view data, uint64_t count, F&& f) {
+    const char* pos = data.data();
+    const char* end = pos + data.size();
+    for (uint64_t i = 0; i < count && end - pos >= 8; ++i) {
+        uint64_t len;
+        std::memcpy(&len, pos, 8);
+        pos += 8;
+        if (uint64_t(end - pos) < len)
+            return;
+        f(std::string_view(pos, len));
+        pos += len;
+    }
+}
+
+// Takes still to cancel, per url fingerprint. Open addressing on 64-bit
+// XXH64 fingerprints, since recovery may cancel millions of urls and a
+// table of strings is several times slower. A fingerprint collision
+// cancels the wrong url, at odds like FingerprintStore's.
+class TakeCounts {
+   public:
+    explicit TakeCounts(size_t n) {
+        size_t capacity = 16;
+        while (capacity < 2 * n)
+            capacity <<= 1;
+        slots.assign(capacity, Slot{});
+        mask = capacity - 1;
+    }
+
+    void add(uint64_t fp) {
+        Slot& slot = find(fp);
+        slot.fp = fp | 1;
+        ++slot.count;
+    }
+
+    // Cancels one take of fp, if any are left.
+    bool cancel(uint64_t fp) {
+        Slot& slot = find(fp);
+        if (slot.count == 0)
+            return false;
+        --slot.count;
+        return true;
+    }
+
+   private:
+    struct Slot {
+        uint64_t fp = 0;  // 0: empty
+        uint64_t count = 0;
+    };
+    std::vector<Slot> slots;
+    size_t mask;
+
+    // fp's slot, or the empty slot ending its probe.
+    Slot& find(uint64_t fp) {
+        fp |= 1;
+        size_t i = fp & mask;
+        while (slots[i].fp != 0 && slots[i].fp != fp)
+            i = (i + 1) & mask;
+        return slots[i];
+    }
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+        return {};
+    std::string data(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(data.data(), data.size());
+    return data;
+}
+
+// Maps a whole file read-only.
+std::shared_ptr<const char> mapFile(const std::string& path, uint64_t& size) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Can't open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a frontier checkpoint");
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        throw std::runtime_error("Can't map " + path);
+    // Every page is read, first for the CRCs and then to parse.
+    ::madvise(addr, size, MADV_WILLNEED);
+    return std::shared_ptr<const char>(
+        static_cast<const char*>(addr),
+        [size](const char* p) { ::munmap(const_cast<char*>(p), size); });
+}
+
+}  // namespace
+
+Checkpoint Checkpoint::read(const std::string& path) {
+    Checkpoint checkpoint;
+    uint64_t size = 0;
+    checkpoint.base = mapFile(path, size);
+    const char* file = checkpoint.base.get();
+
+    BaseHeader header{};
+    if (size >= sizeof(header))
+        std::memcpy(&header, file, sizeof(header));
+    if (header.magic != kBaseMagic)
+        throw std::runtime_error(path + " is not a frontier checkpoint");
+    if (header.version != kVersion) {
+        throw std::runtime_error(path + " is checkpoint version " +
+                                 std::to_string(header.version) +
+                                 ", expected " + std::to_string(kVersion));
+    }
+    uint64_t numShards = header.numShards;
+    if (numShards == 0 || numShards > size / sizeof(ShardEntry))
+        throw std::runtime_error("Malformed checkpoint " + path);
+    uint64_t table = numShards * sizeof(ShardEntry) + 8;
+    uint64_t footer = table + sizeof(Trailer);
+    if (footer > size - sizeof(header))
+        throw std::runtime_error("Malformed checkpoint " + path);
+
+    // A checkpoint renamed into place is complete, so a mismatch means
+    // the file was damaged afterwards.
+    const char* tableStart = file + size - footer;
+    Trailer trailer;
+    std::memcpy(&trailer, file + size - sizeof(trailer), sizeof(trailer));
+    uint32_t crc = crc32c::extend(0, file, sizeof(header));
+    if (crc32c::extend(crc, tableStart, table) != trailer.crc)
+        throw std::runtime_error("Checksum mismatch in checkpoint " + path);
+
+    std::vector<ShardEntry> entries(numShards);
+    uint64_t tableShards;
+    std::memcpy(entries.data(), tableStart, numShards * sizeof(ShardEntry));
+    std::memcpy(&tableShards, tableStart + numShards * sizeof(ShardEntry), 8);
+    uint64_t limit = size - footer;
+    auto inBounds = [&](uint64_t offset, uint64_t length) {
+        return offset >= sizeof(header) && length <= limit &&
+               offset <= limit - length;
+    };
+    for (const ShardEntry& entry : entries) {
+        if (tableShards != numShards ||
+            !inBounds(entry.queueOffset, entry.queueLength) ||
+            !inBounds(entry.seenOffset, entry.seenLength))
+            throw std::runtime_error("Malformed checkpoint " + path);
+    }
+
+    // Checking gigabytes of queued urls takes seconds on one core, so the
+    // shards' sections are checked in parallel.
+    std::atomic<bool> damaged{false};
+    parallelFor(numShards, [&](size_t i) {
+        const ShardEntry& entry = entries[i];
+        if (crc32c::extend(0, file + entry.queueOffset, entry.queueLength) !=
+                entry.queueCrc ||
+            crc32c::extend(0, file + entry.seenOffset, entry.seenLength) !=
+                entry.seenCrc)
+            damaged = true;
+    });
+    if (damaged)
+        throw std::runtime_error("Checksum mismatch in checkpoint " + path);
+
+    checkpoint.generation = header.generation;
+    checkpoint.logSegment = header.logSegment;
+    checkpoint.shards.resize(numShards);
+    for (size_t i = 0; i < numShards; ++i) {
+        const ShardEntry& entry = entries[i];
+        checkpoint.seen.push_back(entry.seenOffset);
+        checkpoint.shards[i].queued.push_back(
+            Records{std::string_view(file + entry.queueOffset,
+                                     entry.queueLength),
+                    entry.numQueued});
+        checkpoint.numQueued += entry.numQueued;
+    }
+
+    // Deltas of this generation, up to the first one cut short.
+    auto delta = std::make_shared<std::string>(readFile(deltaPath(path)));
+    checkpoint.delta = delta;
+    DeltaHeader dh{};
+    if (delta->size() >= sizeof(dh))
+        std::memcpy(&dh, delta->data(), sizeof(dh));
+    if (dh.magic == kDeltaMagic && dh.version == kVersion &&
+        dh.generation == checkpoint.generation) {
+        const char* pos = delta->data() + sizeof(dh);
+        const char* end = delta->data() + delta->size();
+        RecordHeader rh;
+        while (uint64_t(end - pos) >= sizeof(rh)) {
+            std::memcpy(&rh, pos, sizeof(rh));
+            pos += sizeof(rh);
+            if (uint64_t(end - pos) < rh.length ||
+                crc32c::extend(0, pos, rh.length) != rh.crc)
+                break;
+            Reader record{pos, pos + rh.length};
+            try {
+                uint64_t logSegment = record.u64();
+                std::vector<Records> queued(numShards);
+                std::vector<Records> taken(numShards);
+                std::vector<uint64_t> offsets;
+                for (uint64_t i = 0; i < numShards; ++i) {
+                    queued[i].bytes = record.records(queued[i].count);
+                    taken[i].bytes = record.records(taken[i].count);
+                    uint64_t len = record.u64();
+                    offsets.push_back(record.pos - delta->data());
+                    record.bytes(len);
+                }
+                for (uint64_t i = 0; i < numShards; ++i) {
+                    checkpoint.shards[i].queued.push_back(queued[i]);
+                    checkpoint.shards[i].taken.push_back(taken[i]);
+                    checkpoint.numQueued += queued[i].count;
+                }
+                checkpoint.seenDeltas.push_back(std::move(offsets));
+                checkpoint.logSegment = logSegment;
+            } catch (const std::runtime_error&) {
+                break;
+            }
+            pos += rh.length;
+        }
+    }
+
+    // Then whatever was logged after the last snapshot, sorted by shard.
+    if (checkpoint.logSegment > 0) {
+        checkpoint.log = WriteAheadLog::replay(
+            logPath(path), checkpoint.logSegment,
+            [&](WriteAheadLog::Op op, std::string_view url) {
+                Shard& shard =
+                    checkpoint.shards[numShards == 1
+                                          ? 0
+                                          : ShardedFrontier::shardOf(
+                                                url, numShards)];
+                if (op == WriteAheadLog::Op::ADD ||
+                    op == WriteAheadLog::Op::REQUEUE) {
+                    shard.logged.emplace_back(url);
+                    shard.loggedRequeued.push_back(
+                        op == WriteAheadLog::Op::REQUEUE);
+                    ++checkpoint.numLogged;
+                } else {
+                    shard.loggedTakes.push_back(xxhash::hash64(url));
+                }
+            });
+    }
+    return checkpoint;
+}
+
+ShardedFrontier::Restored Checkpoint::restore(size_t i) {
+    Shard& shard = shards[i];
+    ShardedFrontier::Restored restored;
+
+    size_t numTakes = shard.loggedTakes.size();
+    for (const Records& records : shard.taken)
+        numTakes += records.count;
+    TakeCounts counts(numTakes);
+    for (uint64_t fp : shard.loggedTakes)
+        counts.add(fp);
+    for (const Records& records : shard.taken) {
+        forEachRecord(records.bytes, records.count, [&](std::string_view url) {
+            counts.add(xxhash::hash64(url));
+        });
+    }
+
+    size_t total = 0;
+    for (const Records& records : shard.queued)
+        total += records.count;
+    restored.queued.reserve(total);
+    for (const Records& records : shard.queued) {
+        forEachRecord(records.bytes, records.count, [&](std::string_view url) {
+            if (numTakes == 0 || !counts.cancel(xxhash::hash64(url)))
+                restored.queued.emplace_back(url);
+        });
+    }
+
+    restored.loggedTaken.assign(shard.logged.size(), false);
+    if (numTakes > 0) {
+        for (size_t k = 0; k < shard.logged.size(); ++k) {
+            restored.loggedTaken[k] =
+                counts.cancel(xxhash::hash64(shard.logged[k]));
+        }
+    }
+    restored.logged = std::move(shard.logged);
+    restored.loggedRequeued = std::move(shard.loggedRequeued);
+    shard = Shard();
+    return restored;
+}
+
+CheckpointWriter::CheckpointWriter(std::string path) : path(std::move(path)) {
+    // Continue the generation of an existing base, so the first base
+    // written here never matches a leftover delta.
+    std::ifstream base(this->path, std::ios::binary);
+    BaseHeader header{};
+    base.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (base && header.magic == kBaseMagic)
+        generation = header.generation;
+    thread = std::thread([this]() { run(); });
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    jobs.close();
+    thread.join();
+    if (delta >= 0)
+        ::close(delta);
+}
+
+void CheckpointWriter::write(ShardedFrontier::Snapshot snapshot,
+                             uint64_t logSegment) {
+    if (!snapshot.full && !haveBase)
+        throw std::logic_error("First checkpoint snapshot must be full");
+    haveBase = true;
+    submitted.fetch_add(1);
+    jobs.push(Job{std::move(snapshot), logSegment});
+}
+
+void CheckpointWriter::wait() {
+    uint64_t target = submitted.load();
+    done.wait([&]() { return completed.load() >= target; });
+}
+
+CheckpointWriter::Stats CheckpointWriter::stats() const {
+    return Stats{written.load(), lastBytes.load(), lastWriteMs.load(),
+                 failed.load(), durableSegment.load(),
+                 durableSpillEpoch.load()};
+}
+
+void CheckpointWriter::run() {
+    Job job;
+    while (jobs.pop(job)) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t bytes = 0;
+        bool ok = job.snapshot.full ? writeBase(job, bytes)
+                                    : writeDelta(job, bytes);
+        failed.store(!ok);
+        if (ok) {
+            written.fetch_add(1);
+            lastBytes.store(bytes);
+            lastWriteMs.store(std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count());
+            durableSegment.store(job.logSegment);
+            durableSpillEpoch.store(job.snapshot.spillEpoch);
+        }
+        // Frees the snapshot before waking wait().
+        job = Job();
+        completed.fetch_add(1);
+        done.notify();
+    }
+}
+
+bool CheckpointWriter::writeBase(const Job& job, uint64_t& bytes) {
+    // Write a new file and rename it over the old one. Dedup stores may
+    // be mapped from the old file, which must not be truncated under them.
+    const ShardedFrontier::Snapshot& snapshot = job.snapshot;
+    // Deltas wait for a new base; whatever it ends up being, the old one
+    // is on its way out.
+    if (delta >= 0) {
+        ::close(delta);
+        delta = -1;
+    }
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0)
+        return false;
+    bytes = 0;
+    auto put = [&](const void* data, size_t len) {
+        bytes += len;
+        return durable::writeAll(fd, data, len);
+    };
+
+    uint64_t next = generation + 1;
+    uint64_t numShards = snapshot.shards.size();
+    BaseHeader header{kBaseMagic, Checkpoint::kVersion, 0, next, numShards,
+                      job.logSegment};
+    bool ok = put(&header, sizeof(header));
+
+    std::vector<ShardEntry> entries(numShards);
+    for (size_t i = 0; i < numShards; ++i) {
+        const std::string& queued = snapshot.shards[i].queued;
+        entries[i].queueOffset = bytes;
+        entries[i].queueLength = queued.size();
+        entries[i].numQueued = snapshot.shards[i].numQueued;
+        entries[i].queueCrc = crc32c::hash(queued);
+        ok = ok && put(queued.data(), queued.size());
+    }
+    size_t page = pageSize();
+    std::string padding;
+    for (size_t i = 0; i < numShards; ++i) {
+        const std::string& seen = snapshot.shards[i].seen;
+        uint64_t aligned = (bytes + page - 1) / page * page;
+        padding.assign(aligned - bytes, '\0');
+        entries[i].seenOffset = aligned;
+        entries[i].seenLength = seen.size();
+        entries[i].seenCrc = crc32c::hash(seen);
+        ok = ok && put(padding.data(), padding.size()) &&
+             put(seen.data(), seen.size());
+    }
+
+    Trailer trailer{crc32c::extend(0, &header, sizeof(header)), 0};
+    trailer.crc = crc32c::extend(trailer.crc, entries.data(),
+                                 entries.size() * sizeof(ShardEntry));
+    trailer.crc = crc32c::extend(trailer.crc, &numShards, sizeof(numShards));
+    ok = ok && put(entries.data(), entries.size() * sizeof(ShardEntry)) &&
+         put(&numShards, sizeof(numShards)) &&
+         put(&trailer, sizeof(trailer)) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0 ||
+        !durable::syncDirectory(path))
+        return false;
+
+    // Deltas of the previous base no longer apply.
+    generation = next;
+    std::string deltaFile = Checkpoint::deltaPath(path);
+    fd = ::open(deltaFile.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    DeltaHeader dh{kDeltaMagic, Checkpoint::kVersion, 0, generation};
+    if (!durable::writeAll(fd, &dh, sizeof(dh)) || ::fsync(fd) != 0 ||
+        !durable::syncDirectory(deltaFile)) {
+        ::close(fd);
+        return false;
+    }
+    delta = fd;
+    return true;
+}
+
+bool CheckpointWriter::writeDelta(const Job& job, uint64_t& bytes) {
+    if (delta < 0)
+        return false;
+    const ShardedFrontier::Snapshot& snapshot = job.snapshot;
+
+    // The record's pieces, gathered so the CRC and length can go first.
+    RecordHeader rh{0, 0, 0};
+    std::vector<std::pair<const void*, size_t>> pieces;
+    std::vector<uint64_t> numbers;
+    numbers.reserve(1 + 5 * snapshot.shards.size());
+    auto add = [&](const void* data, size_t len) {
+        pieces.emplace_back(data, len);
+        rh.crc = crc32c::extend(rh.crc, data, len);
+        rh.length += len;
+    };
+    auto addNumber = [&](uint64_t n) {
+        numbers.push_back(n);
+        add(&numbers.back(), sizeof(uint64_t));
+    };
+    addNumber(job.logSegment);
+    for (const ShardedFrontier::Snapshot::Shard& shard : snapshot.shards) {
+        addNumber(shard.numQueued);
+        addNumber(shard.queued.size());
+        add(shard.queued.data(), shard.queued.size());
+        addNumber(shard.numTaken);
+        addNumber(shard.taken.size());
+        add(shard.taken.data(), shard.taken.size());
+        addNumber(shard.seen.size());
+        add(shard.seen.data(), shard.seen.size());
+    }
+
+    bool ok = durable::writeAll(delta, &rh, sizeof(rh));
+    for (const auto& [data, len] : pieces)
+        ok = ok && durable::writeAll(delta, data, len);
+    bytes = sizeof(rh) + rh.length;
+    if (ok && ::fdatasync(delta) == 0)
+        return true;
+    // Recovery stops at a bad record, so nothing may be appended after it
+    // until the next base.
+    ::close(delta);
+    delta = -1;
+    return false;
+}
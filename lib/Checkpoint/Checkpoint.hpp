@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ShardedFrontier.hpp"
+#include "SpscQueue.hpp"
+#include "WriteAheadLog.hpp"
+
+// Checkpoint files of the frontier: a base file written from full
+// snapshots, and "<path>.delta" next to it, which incremental snapshots are
+// appended to. Both carry the generation of the base. Each full snapshot
+// starts a new generation, so deltas left over from an older base are
+// ignored. Changes made after the last snapshot are in the write-ahead log
+// at "<path>.wal"; each snapshot records the first log segment it does not
+// cover.
+//
+// Base:  magic, version, generation, shard count, log segment, each
+//        shard's queued urls as (length, bytes) records, each shard's dedup
+//        store starting on a page boundary (so it can be mapped), a table
+//        with the offset, length and CRC-32C of every shard's urls and
+//        store, the shard count again and a CRC-32C of the header and the
+//        table. The sections have CRCs of their own so they can be checked
+//        in parallel.
+// Delta: magic, version, generation, then one record per snapshot: its
+//        length, CRC-32C, log segment, and per shard the urls queued and
+//        taken since the previous snapshot, each as a count, a length and
+//        records, and the dedup store delta as a length and bytes.
+//
+// Every file is synced before it is renamed into place or acknowledged, so
+// a crash leaves either the old checkpoint or the new one.
+struct Checkpoint {
+    static constexpr uint32_t kVersion = 2;
+
+    uint64_t generation = 0;
+    // Offsets of each shard's dedup store in the base file.
+    std::vector<uint64_t> seen;
+    // Per delta, offsets of each shard's dedup store delta in the delta
+    // file.
+    std::vector<std::vector<uint64_t>> seenDeltas;
+
+    // First log segment after the last snapshot read; 0 if written
+    // without a log.
+    uint64_t logSegment = 0;
+    WriteAheadLog::ReplayStats log;
+
+    // Urls queued in the base and the deltas, and urls added in the log,
+    // before the takes cancel any.
+    uint64_t numQueued = 0;
+    uint64_t numLogged = 0;
+
+    size_t numShards() const { return shards.size(); }
+
+    // Shard i's urls: the ones queued in the base and the deltas less the
+    // ones taken since, and the ones logged after the last snapshot. Every
+    // take cancels the earliest copy of its url. Base urls are parsed
+    // straight from the mapped file. Call once per shard; different shards
+    // can be restored in parallel.
+    ShardedFrontier::Restored restore(size_t shard);
+
+    static std::string deltaPath(const std::string& path) {
+        return path + ".delta";
+    }
+    static std::string logPath(const std::string& path) {
+        return path + ".wal";
+    }
+
+    // Maps the base at path and checks it, then reads every complete delta
+    // of its generation and the log after them. A delta or log block cut
+    // short by a crash ends its chain. Throws std::runtime_error if the
+    // base is missing, malformed, of another version or fails a CRC.
+    static Checkpoint read(const std::string& path);
+
+   private:
+    // A count and (length, bytes) records in the base or delta file.
+    struct Records {
+        std::string_view bytes;
+        uint64_t count = 0;
+    };
+    struct Shard {
+        std::vector<Records> queued;  // base first, then the deltas
+        std::vector<Records> taken;
+        std::vector<std::string> logged;
+        std::vector<bool> loggedRequeued;
+        std::vector<uint64_t> loggedTakes;  // XXH64 fingerprints
+    };
+
+    std::shared_ptr<const char> base;  // the mapped base file
+    std::shared_ptr<const std::string> delta;
+    std::vector<Shard> shards;
+};
+
+// Writes snapshots on a thread of its own, so serving only pauses for
+// ShardedFrontier::snapshot().
+class CheckpointWriter {
+   public:
+    explicit CheckpointWriter(std::string path);
+    // Writes everything handed over, then stops.
+    ~CheckpointWriter();
+
+    // Queues snapshot and returns at once, unless kMaxQueued snapshots are
+    // already waiting. The first snapshot must be full. logSegment is the
+    // first log segment the snapshot does not cover.
+    void write(ShardedFrontier::Snapshot snapshot, uint64_t logSegment = 0);
+
+    // Blocks until every snapshot handed over is written.
+    void wait();
+
+    struct Stats {
+        uint64_t written = 0;
+        uint64_t lastBytes = 0;
+        double lastWriteMs = 0;
+        bool failed = false;  // the last write failed
+        // Log segment of the last snapshot on disk; the ones before it
+        // can go.
+        uint64_t logSegment = 0;
+        // Its spill epoch, for ShardedFrontier::releaseSpill().
+        uint64_t spillEpoch = 0;
+    };
+    Stats stats() const;
+
+   private:
+    static constexpr size_t kMaxQueued = 4;
+
+    struct Job {
+        ShardedFrontier::Snapshot snapshot;
+        uint64_t logSegment = 0;
+    };
+
+    std::string path;
+    uint64_t generation = 0;
+    // Open for appending to the last base written; -1 from the start of
+    // a base until it is on disk, and after a failed write.
+    int delta = -1;
+
+    SpscQueue<Job> jobs{kMaxQueued};
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> completed{0};
+    Event done;
+    bool haveBase = false;
+
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> lastBytes{0};
+    std::atomic<double> lastWriteMs{0};
+    std::atomic<bool> failed{false};
+    std::atomic<uint64_t> durableSegment{0};
+    std::atomic<uint64_t> durableSpillEpoch{0};
+
+    std::thread thread;
+
+    void run();
+    bool writeBase(const Job& job, uint64_t& bytes);
+    bool writeDelta(const Job& job, uint64_t& bytes);
+};
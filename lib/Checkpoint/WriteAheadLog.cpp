@@ -0,0 +1,260 @@
+#include "WriteAheadLog.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "Crc32.hpp"
+#include "Durable.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint64_t kMagic = 0x474f4c544e5246;  // "FRNTLOG"
+constexpr uint32_t kVersion = 1;
+
+struct SegmentHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t segment;
+};
+
+struct BlockHeader {
+    uint32_t length;
+    uint32_t crc;
+};
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(std::string path) : path(std::move(path)) {
+    std::vector<uint64_t> existing = segments(this->path);
+    segment = existing.empty() ? 1 : existing.back() + 1;
+    thread = std::thread([this]() { run(); });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    mark();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    if (fd >= 0)
+        ::close(fd);
+}
+
+void WriteAheadLog::append(Op op, std::string_view url) {
+    staging.push_back(static_cast<char>(op));
+    uint64_t len = url.size();
+    while (len >= 0x80) {
+        staging.push_back(static_cast<char>(len | 0x80));
+        len >>= 7;
+    }
+    staging.push_back(static_cast<char>(len));
+    staging.append(url);
+    ++stagedRecords;
+}
+
+uint64_t WriteAheadLog::mark() {
+    if (staging.empty())
+        return position;
+    position += staging.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pending.empty() && pending.back().segment == segment) {
+            pending.back().records.append(staging);
+        } else {
+            pending.push_back({segment, std::move(staging)});
+        }
+        counters.records += stagedRecords;
+    }
+    staging.clear();
+    stagedRecords = 0;
+    wake.notify_one();
+    return position;
+}
+
+bool WriteAheadLog::waitFor(uint64_t target) {
+    std::unique_lock<std::mutex> lock(mutex);
+    synced.wait(lock,
+                [&]() { return committed >= target || counters.failed; });
+    return !counters.failed;
+}
+
+uint64_t WriteAheadLog::rotate() {
+    mark();
+    return ++segment;
+}
+
+void WriteAheadLog::release(uint64_t below) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        releaseBelow = std::max(releaseBelow, below);
+    }
+    wake.notify_one();
+}
+
+WriteAheadLog::Stats WriteAheadLog::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void WriteAheadLog::run() {
+    std::vector<Chunk> chunks;
+    for (;;) {
+        uint64_t below;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() {
+                return !pending.empty() || stopping || releaseBelow > released;
+            });
+            if (pending.empty() && stopping)
+                return;
+            chunks.swap(pending);
+            below = releaseBelow;
+        }
+
+        // Everything handed over while the last sync ran goes out under
+        // one sync.
+        uint64_t bytes = 0;
+        bool ok = !counters.failed;
+        for (const Chunk& chunk : chunks) {
+            ok = ok && writeChunk(chunk);
+            bytes += chunk.records.size();
+        }
+        if (!chunks.empty())
+            ok = ok && ::fdatasync(fd) == 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                committed += bytes;
+                counters.bytes += bytes;
+                counters.syncs += !chunks.empty();
+            } else {
+                counters.failed = true;
+            }
+        }
+        synced.notify_all();
+        chunks.clear();
+
+        if (below > released)
+            removeReleased(below);
+    }
+}
+
+bool WriteAheadLog::writeChunk(const Chunk& chunk) {
+    if (chunk.segment != openSegment && !openNext(chunk.segment))
+        return false;
+    BlockHeader header{static_cast<uint32_t>(chunk.records.size()),
+                       crc32c::hash(chunk.records)};
+    return durable::writeAll(fd, &header, sizeof(header)) &&
+           durable::writeAll(fd, chunk.records.data(), chunk.records.size());
+}
+
+bool WriteAheadLog::openNext(uint64_t n) {
+    if (fd >= 0) {
+        // The segment being closed must be complete before the next one
+        // is written to.
+        bool ok = ::fdatasync(fd) == 0;
+        ::close(fd);
+        fd = -1;
+        if (!ok)
+            return false;
+    }
+    std::string file = segmentPath(path, n);
+    fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    openSegment = n;
+    SegmentHeader header{kMagic, kVersion, 0, n};
+    if (!durable::writeAll(fd, &header, sizeof(header)) || ::fsync(fd) != 0)
+        return false;
+    durable::syncDirectory(file);
+    return true;
+}
+
+void WriteAheadLog::removeReleased(uint64_t below) {
+    for (uint64_t n : segments(path)) {
+        if (n < below && n != openSegment)
+            fs::remove(segmentPath(path, n));
+    }
+    released = below;
+}
+
+std::vector<uint64_t> WriteAheadLog::segments(const std::string& path) {
+    fs::path dir = fs::path(path).parent_path();
+    std::string prefix = fs::path(path).filename().string() + ".";
+    std::vector<uint64_t> found;
+    std::error_code ec;
+    for (const auto& entry :
+         fs::directory_iterator(dir.empty() ? "." : dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(),
+                                                         prefix) != 0)
+            continue;
+        std::string_view suffix(name);
+        suffix.remove_prefix(prefix.size());
+        if (!std::all_of(suffix.begin(), suffix.end(),
+                         [](char c) { return c >= '0' && c <= '9'; }))
+            continue;
+        found.push_back(std::stoull(std::string(suffix)));
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+WriteAheadLog::ReplayStats WriteAheadLog::replay(
+    const std::string& path, uint64_t from,
+    const std::function<void(Op, std::string_view)>& f) {
+    ReplayStats stats;
+    std::string block;
+    for (uint64_t n : segments(path)) {
+        if (n < from)
+            continue;
+        ++stats.segments;
+        std::ifstream in(segmentPath(path, n), std::ios::binary);
+        SegmentHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || header.magic != kMagic || header.version != kVersion ||
+            header.segment != n) {
+            ++stats.torn;
+            continue;
+        }
+
+        BlockHeader bh;
+        bool torn = false;
+        while (in.read(reinterpret_cast<char*>(&bh), sizeof(bh))) {
+            block.resize(bh.length);
+            if (!in.read(block.data(), bh.length) ||
+                crc32c::hash(block) != bh.crc) {
+                torn = true;
+                break;
+            }
+            // The CRC passed, so the records are as written.
+            const char* p = block.data();
+            const char* end = p + block.size();
+            while (p < end) {
+                Op op = static_cast<Op>(*p++);
+                uint64_t len = 0;
+                for (int shift = 0; p < end; shift += 7) {
+                    unsigned char byte = static_cast<unsigned char>(*p++);
+                    len |= uint64_t(byte & 0x7f) << shift;
+                    if (!(byte & 0x80))
+                        break;
+                }
+                len = std::min<uint64_t>(len, end - p);
+                f(op, std::string_view(p, len));
+                p += len;
+                ++stats.records;
+            }
+        }
+        // A block header cut short is torn too.
+        if (torn || in.gcount() != 0)
+            ++stats.torn;
+    }
+    return stats;
+}
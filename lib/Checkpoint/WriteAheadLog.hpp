@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Log of the frontier's changes since the last checkpoint: urls added to
+// this node's shards, urls handed out to workers and urls put back for
+// another try. The core thread appends records to a buffer of its own and
+// hands them over once per request with mark(). A thread of its own
+// writes whatever was handed over as one block and syncs it, so a single
+// fdatasync commits every request that arrived while the previous one ran
+// (group commit).
+//
+// The log is split into segments "<path>.<n>". rotate() starts the next
+// segment when a checkpoint is taken, and release() deletes the segments
+// a checkpoint on disk covers. A segment is a header (magic, version,
+// segment number) followed by blocks of (length, CRC-32C, records), and a
+// record is an Op byte, a varint length and the url.
+class WriteAheadLog {
+   public:
+    // REQUEUE puts back a url that was taken, such as one whose fetch
+    // failed or whose lease ran out; unlike ADD it is not deduplicated.
+    enum class Op : uint8_t { ADD = 1, TAKE = 2, REQUEUE = 3 };
+
+    // Continues after the highest segment already at path, which is left
+    // alone for recovery until release() says otherwise.
+    explicit WriteAheadLog(std::string path);
+    // Commits everything handed over, then stops.
+    ~WriteAheadLog();
+
+    // Core thread only.
+    void add(std::string_view url) { append(Op::ADD, url); }
+    void take(std::string_view url) { append(Op::TAKE, url); }
+    void requeue(std::string_view url) { append(Op::REQUEUE, url); }
+
+    // Hands the records appended so far to the writer and returns the log
+    // position after them, for waitFor(). Core thread only.
+    uint64_t mark();
+
+    // Blocks until the log is on disk up to position. Returns false if a
+    // write failed, which leaves the log unusable. Any thread.
+    bool waitFor(uint64_t position);
+
+    // Ends the current segment; records from now on go to the returned
+    // one. Core thread only.
+    uint64_t rotate();
+
+    // Deletes the segments before segment once a checkpoint covers them.
+    void release(uint64_t segment);
+
+    struct Stats {
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        uint64_t syncs = 0;
+        bool failed = false;
+    };
+    Stats stats() const;
+
+    struct ReplayStats {
+        uint64_t segments = 0;
+        uint64_t records = 0;
+        // Segments that ended in a block cut short or failing its CRC.
+        uint64_t torn = 0;
+    };
+    // Calls f for every record in the segments at path numbered from on,
+    // in order. The rest of a segment after a bad block is skipped; it was
+    // never committed.
+    static ReplayStats replay(
+        const std::string& path, uint64_t from,
+        const std::function<void(Op, std::string_view)>& f);
+
+    // Numbers of the segments at path, ascending.
+    static std::vector<uint64_t> segments(const std::string& path);
+    static std::string segmentPath(const std::string& path, uint64_t n) {
+        return path + "." + std::to_string(n);
+    }
+
+   private:
+    struct Chunk {
+        uint64_t segment;
+        std::string records;
+    };
+
+    std::string path;
+
+    // Core thread.
+    std::string staging;
+    uint64_t stagedRecords = 0;
+    uint64_t segment;
+    uint64_t position = 0;
+
+    // Shared with the writer.
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable synced;
+    std::vector<Chunk> pending;
+    uint64_t releaseBelow = 0;
+    uint64_t committed = 0;  // log position on disk
+    bool stopping = false;
+    Stats counters;
+
+    // Writer thread.
+    int fd = -1;
+    uint64_t openSegment = 0;
+    uint64_t released = 0;
+    std::thread thread;
+
+    void append(Op op, std::string_view url);
+    void run();
+    bool writeChunk(const Chunk& chunk);
+    bool openNext(uint64_t n);
+    void removeReleased(uint64_t below);
+};
@@ -0,0 +1,72 @@
+#include "ClusterMap.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "PriorityQueue.hpp"
+#include "XXHash.hpp"
+
+namespace {
+
+// Hosts are hashed with their own seed, so which node owns a host says
+// nothing about which of its shards it lands on.
+constexpr uint64_t kClusterSeed = 0x636c7573746572;  // "cluster"
+
+int parsePort(const std::string& s, const std::string& entry) {
+    size_t used = 0;
+    int port = -1;
+    try {
+        port = std::stoi(s, &used);
+    } catch (const std::exception&) {
+    }
+    if (used != s.size() || port <= 0 || port > 65535)
+        throw std::invalid_argument("Bad port in cluster node " + entry);
+    return port;
+}
+
+}  // namespace
+
+std::string ClusterNode::workerAddress() const {
+    return ip + ":" + std::to_string(workerPort);
+}
+
+ClusterMap::ClusterMap() : nodes(1) {}
+
+ClusterMap::ClusterMap(std::vector<ClusterNode> nodes, size_t self)
+    : nodes(std::move(nodes)), selfIndex(self) {
+    if (this->nodes.empty() || selfIndex >= this->nodes.size())
+        throw std::invalid_argument("Node index outside the cluster");
+}
+
+std::vector<ClusterNode> ClusterMap::parse(const std::string& spec) {
+    std::vector<ClusterNode> nodes;
+    std::stringstream list(spec);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        size_t second = entry.rfind(':');
+        size_t first =
+            second == std::string::npos || second == 0
+                ? std::string::npos
+                : entry.rfind(':', second - 1);
+        if (first == std::string::npos || first == 0)
+            throw std::invalid_argument("Expected ip:workerPort:peerPort, got " +
+                                        entry);
+        ClusterNode node;
+        node.ip = entry.substr(0, first);
+        node.workerPort =
+            parsePort(entry.substr(first + 1, second - first - 1), entry);
+        node.peerPort = parsePort(entry.substr(second + 1), entry);
+        nodes.push_back(std::move(node));
+    }
+    if (nodes.empty())
+        throw std::invalid_argument("Empty cluster node list");
+    return nodes;
+}
+
+size_t ClusterMap::ownerOf(std::string_view url) const {
+    if (nodes.size() == 1)
+        return 0;
+    uint64_t h = xxhash::hash64(PriorityQueue::hostOf(url), kClusterSeed);
+    // Maps the high 32 bits onto [0, size) without a division.
+    return ((h >> 32) * nodes.size()) >> 32;
+}
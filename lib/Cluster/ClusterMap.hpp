@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One frontier instance in a cluster: the address workers talk to and the
+// port peers forward urls to.
+struct ClusterNode {
+    std::string ip;
+    int workerPort = 0;
+    int peerPort = 0;
+
+    // "ip:workerPort", as sent to workers in a REDIRECT.
+    std::string workerAddress() const;
+};
+
+// Static assignment of hosts to the nodes of a cluster. Every node is
+// started with the same node list, so they all agree on the owner of a url
+// without talking to each other. A host belongs to exactly one node, which
+// keeps its politeness and dedup state local.
+class ClusterMap {
+   public:
+    // A single node owning every host.
+    ClusterMap();
+
+    ClusterMap(std::vector<ClusterNode> nodes, size_t self);
+
+    // Parses "ip:workerPort:peerPort,ip:workerPort:peerPort,...". Throws
+    // std::invalid_argument on a malformed list.
+    static std::vector<ClusterNode> parse(const std::string& spec);
+
+    size_t size() const { return nodes.size(); }
+    size_t self() const { return selfIndex; }
+    const ClusterNode& node(size_t i) const { return nodes[i]; }
+
+    size_t ownerOf(std::string_view url) const;
+    bool owns(std::string_view url) const { return ownerOf(url) == selfIndex; }
+
+   private:
+    std::vector<ClusterNode> nodes;
+    size_t selfIndex = 0;
+};
@@ -0,0 +1,371 @@
+#include "PeerExchange.hpp"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "FrontierInterface.hpp"
+
+namespace {
+
+// Payload header: sender node (4 bytes), queued urls (8), workers (4),
+// all big-endian, followed by a COMPACT URLS message.
+constexpr size_t kHeaderSize = 16;
+// Largest frame a reader accepts; a 4096-url batch is well under 1MB.
+constexpr uint32_t kMaxFrame = 64u << 20;
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+int connectTo(const ClusterNode& node) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(node.peerPort);
+    if (::inet_pton(AF_INET, node.ip.c_str(), &addr.sin_addr) != 1)
+        return -1;
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // A peer that stops reading must not wedge the sender forever.
+    timeval timeout{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}  // namespace
+
+PeerExchange::PeerExchange(ClusterMap cluster, const Options& options)
+    : map(std::move(cluster)), options(options) {
+    for (size_t i = 0; i < map.size(); ++i) {
+        peers.push_back(i == map.self()
+                            ? nullptr
+                            : std::make_unique<Peer>(options.maxQueuedBatches));
+    }
+}
+
+PeerExchange::~PeerExchange() {
+    stop();
+}
+
+int64_t PeerExchange::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+}
+
+bool PeerExchange::start() {
+    listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        return false;
+    int one = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(map.node(map.self()).peerPort);
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listenFd, static_cast<int>(map.size()) * 2) < 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    started = true;
+    acceptor = std::thread([this]() { runAcceptor(); });
+    for (size_t i = 0; i < peers.size(); ++i) {
+        if (peers[i])
+            peers[i]->sender = std::thread([this, i]() { runSender(i); });
+    }
+    return true;
+}
+
+void PeerExchange::stop() {
+    if (!started)
+        return;
+    started = false;
+    stopping.store(true);
+
+    for (auto& peer : peers) {
+        if (peer) {
+            peer->outbox.close();
+            peer->sender.join();
+        }
+    }
+
+    // Wakes accept() and every blocked recv().
+    ::shutdown(listenFd, SHUT_RDWR);
+    acceptor.join();
+    ::close(listenFd);
+    listenFd = -1;
+    {
+        std::lock_guard<std::mutex> lock(connMutex);
+        for (int fd : connFds)
+            ::shutdown(fd, SHUT_RDWR);
+    }
+    for (std::thread& reader : readers)
+        reader.join();
+    readers.clear();
+    finished.clear();
+}
+
+void PeerExchange::forward(size_t node, std::string_view url) {
+    Peer& peer = *peers[node];
+    if (peer.pending.empty())
+        peer.oldest = Clock::now();
+    peer.pending.emplace_back(url);
+    if (peer.pending.size() >= options.flushUrls)
+        handOver(peer);
+}
+
+void PeerExchange::flush(bool force) {
+    Clock::time_point now = Clock::now();
+    for (auto& peer : peers) {
+        if (!peer || peer->pending.empty())
+            continue;
+        if (force || peer->pending.size() >= options.flushUrls ||
+            now - peer->oldest >= std::chrono::milliseconds(options.flushMs)) {
+            handOver(*peer);
+        }
+    }
+}
+
+void PeerExchange::handOver(Peer& peer) {
+    size_t n = peer.pending.size();
+    // A full outbox means the peer is slow or down; keep collecting.
+    if (peer.outbox.tryPush(peer.pending)) {
+        forwarded.fetch_add(n, std::memory_order_relaxed);
+        peer.pending.clear();
+    }
+}
+
+void PeerExchange::receive(std::vector<std::string>& out) {
+    if (!inboxReady.load(std::memory_order_acquire))
+        return;
+    std::lock_guard<std::mutex> lock(inboxMutex);
+    for (std::string& url : inbox)
+        out.push_back(std::move(url));
+    inbox.clear();
+    inboxReady.store(false, std::memory_order_release);
+}
+
+void PeerExchange::setLoad(uint64_t queued, uint32_t workers) {
+    localQueued.store(queued, std::memory_order_relaxed);
+    localWorkers.store(workers, std::memory_order_relaxed);
+}
+
+PeerExchange::PeerLoad PeerExchange::peerLoad(size_t node) const {
+    PeerLoad load;
+    const Peer* peer = peers[node].get();
+    if (!peer)
+        return load;
+    int64_t heard = peer->lastHeardMs.load(std::memory_order_relaxed);
+    load.alive = heard > 0 && nowMs() - heard < options.peerTimeoutMs;
+    load.queued = peer->queued.load(std::memory_order_relaxed);
+    load.workers = peer->workers.load(std::memory_order_relaxed);
+    return load;
+}
+
+PeerExchange::Stats PeerExchange::stats() const {
+    return Stats{forwarded.load(), sent.load(), received.load(),
+                 bytesSent.load()};
+}
+
+std::string PeerExchange::frame(std::vector<std::string>& urls) const {
+    thread_local std::string body;
+    thread_local FrontierMessage message{FrontierMessageType::URLS, {}, {}};
+    // Borrows the urls for encoding instead of copying them.
+    message.urls.swap(urls);
+    FrontierInterface::EncodeInto(message, body, FrontierProtocol::COMPACT);
+    message.urls.swap(urls);
+
+    uint32_t length = htonl(static_cast<uint32_t>(kHeaderSize + body.size()));
+    uint32_t node = htonl(static_cast<uint32_t>(map.self()));
+    uint64_t queued = htobe64(localQueued.load(std::memory_order_relaxed));
+    uint32_t workers = htonl(localWorkers.load(std::memory_order_relaxed));
+
+    std::string out(sizeof(length) + kHeaderSize + body.size(), '\0');
+    char* p = out.data();
+    std::memcpy(p, &length, 4);
+    std::memcpy(p + 4, &node, 4);
+    std::memcpy(p + 8, &queued, 8);
+    std::memcpy(p + 16, &workers, 4);
+    std::memcpy(p + 20, body.data(), body.size());
+    return out;
+}
+
+void PeerExchange::runSender(size_t node) {
+    Peer& peer = *peers[node];
+    auto heartbeat = std::chrono::milliseconds(options.heartbeatMs);
+    int fd = -1;
+    std::vector<std::string> batch;
+    bool haveBatch = false;
+    Clock::time_point lastSend;
+
+    while (!stopping.load()) {
+        if (!haveBatch)
+            haveBatch = peer.outbox.popFor(batch, heartbeat);
+        if (fd < 0) {
+            fd = connectTo(map.node(node));
+            if (fd < 0) {
+                // Peer not up yet or gone; keep the batch and retry.
+                std::this_thread::sleep_for(
+                    std::min(heartbeat, std::chrono::milliseconds(100)));
+                continue;
+            }
+        }
+        if (!haveBatch && Clock::now() - lastSend < heartbeat)
+            continue;
+
+        std::string out = frame(batch);
+        if (!writeAll(fd, out.data(), out.size())) {
+            ::close(fd);
+            fd = -1;
+            continue;
+        }
+        lastSend = Clock::now();
+        bytesSent.fetch_add(out.size(), std::memory_order_relaxed);
+        sent.fetch_add(batch.size(), std::memory_order_relaxed);
+        batch.clear();
+        haveBatch = false;
+    }
+
+    // Best effort: hand whatever is still queued to a connected peer.
+    if (fd >= 0) {
+        while (haveBatch || peer.outbox.tryPop(batch)) {
+            std::string out = frame(batch);
+            if (!writeAll(fd, out.data(), out.size()))
+                break;
+            sent.fetch_add(batch.size(), std::memory_order_relaxed);
+            batch.clear();
+            haveBatch = false;
+        }
+        ::close(fd);
+    }
+}
+
+void PeerExchange::runAcceptor() {
+    while (!stopping.load()) {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(connMutex);
+        if (stopping.load()) {
+            ::close(fd);
+            break;
+        }
+        // A peer reconnects whenever its connection drops, so readers are
+        // joined as they finish rather than only on stop().
+        reapReaders();
+        connFds.push_back(fd);
+        readers.emplace_back([this, fd]() { runReader(fd); });
+    }
+}
+
+void PeerExchange::reapReaders() {
+    for (size_t i = 0; i < readers.size();) {
+        if (std::find(finished.begin(), finished.end(),
+                      readers[i].get_id()) == finished.end()) {
+            ++i;
+            continue;
+        }
+        readers[i].join();
+        readers[i] = std::move(readers.back());
+        readers.pop_back();
+    }
+    finished.clear();
+}
+
+void PeerExchange::runReader(int fd) {
+    std::string payload;
+    FrontierMessageView view;
+    while (true) {
+        uint32_t length;
+        if (!readAll(fd, reinterpret_cast<char*>(&length), sizeof(length)))
+            break;
+        length = ntohl(length);
+        if (length < kHeaderSize || length > kMaxFrame)
+            break;
+        payload.resize(length);
+        if (!readAll(fd, payload.data(), length))
+            break;
+
+        uint32_t node, workers;
+        uint64_t queued;
+        std::memcpy(&node, payload.data(), 4);
+        std::memcpy(&queued, payload.data() + 4, 8);
+        std::memcpy(&workers, payload.data() + 12, 4);
+        node = ntohl(node);
+        if (node >= peers.size() || !peers[node])
+            break;
+        try {
+            FrontierInterface::DecodeView(
+                std::string_view(payload).substr(kHeaderSize), view);
+        } catch (const std::exception&) {
+            break;
+        }
+
+        Peer& peer = *peers[node];
+        peer.queued.store(be64toh(queued), std::memory_order_relaxed);
+        peer.workers.store(ntohl(workers), std::memory_order_relaxed);
+        peer.lastHeardMs.store(nowMs(), std::memory_order_relaxed);
+        if (view.urls.empty())
+            continue;
+
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        for (std::string_view url : view.urls)
+            inbox.emplace_back(url);
+        inboxReady.store(true, std::memory_order_release);
+        received.fetch_add(view.urls.size(), std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(connMutex);
+    for (size_t i = 0; i < connFds.size(); ++i) {
+        if (connFds[i] == fd) {
+            connFds[i] = connFds.back();
+            connFds.pop_back();
+            break;
+        }
+    }
+    finished.push_back(std::this_thread::get_id());
+    ::close(fd);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ClusterMap.hpp"
+#include "SpscQueue.hpp"
+
+// Moves urls between the nodes of a cluster. Urls a node's workers
+// discover for hosts another node owns are batched per peer and sent over
+// one TCP connection per peer as COMPACT URLS messages, which are deflated
+// once a batch is large enough. Every frame also carries the sender's
+// queue size and worker count, and a sender with nothing to forward still
+// sends an empty frame every heartbeat, so each node knows its peers' load.
+//
+// Frames are a 4-byte big-endian length and then the payload, like the
+// Gateway protocol. A batch that cannot be sent is kept and retried after
+// reconnecting, so a peer that is down only delays its urls. The owner
+// dedups what it receives, so a batch sent twice after a broken
+// connection is harmless.
+//
+// forward(), flush(), receive() and setLoad() are for the frontier's core
+// thread; each peer has its own sender thread and each inbound connection
+// its own reader thread.
+class PeerExchange {
+   public:
+    struct Options {
+        // A peer's urls are sent once this many are pending, or once the
+        // oldest has waited flushMs.
+        size_t flushUrls = 4096;
+        int flushMs = 20;
+        int heartbeatMs = 100;
+        // A peer not heard from for this long is considered down.
+        int peerTimeoutMs = 1000;
+        // Batches queued per peer before forward() keeps them pending.
+        size_t maxQueuedBatches = 64;
+    };
+
+    struct PeerLoad {
+        bool alive = false;
+        uint64_t queued = 0;
+        uint32_t workers = 0;
+    };
+
+    struct Stats {
+        uint64_t forwarded = 0;  // urls handed to sender threads
+        uint64_t sent = 0;       // urls written to a peer
+        uint64_t received = 0;   // urls read from peers
+        uint64_t bytesSent = 0;
+    };
+
+    PeerExchange(ClusterMap cluster, const Options& options);
+    ~PeerExchange();
+
+    // Binds the peer port and starts the threads. Returns false if the
+    // port cannot be bound.
+    bool start();
+    void stop();
+
+    const ClusterMap& cluster() const { return map; }
+
+    // Queues url for the node that owns it, which must not be this one.
+    void forward(size_t node, std::string_view url);
+
+    // Hands pending batches that are full or old enough to the senders;
+    // with force, every pending url.
+    void flush(bool force = false);
+
+    // Appends every url received from peers since the last call.
+    void receive(std::vector<std::string>& out);
+
+    // Load advertised to peers in every frame.
+    void setLoad(uint64_t queued, uint32_t workers);
+
+    PeerLoad peerLoad(size_t node) const;
+    Stats stats() const;
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Peer {
+        std::vector<std::string> pending;
+        Clock::time_point oldest;
+        SpscQueue<std::vector<std::string>> outbox;
+        std::thread sender;
+
+        std::atomic<int64_t> lastHeardMs{0};
+        std::atomic<uint64_t> queued{0};
+        std::atomic<uint32_t> workers{0};
+
+        explicit Peer(size_t maxBatches) : outbox(maxBatches) {}
+    };
+
+    ClusterMap map;
+    Options options;
+    std::vector<std::unique_ptr<Peer>> peers;  // indexed by node; self null
+
+    std::atomic<bool> stopping{false};
+    bool started = false;
+    int listenFd = -1;
+    std::thread acceptor;
+    std::mutex connMutex;
+    std::vector<int> connFds;
+    std::vector<std::thread> readers;
+    // Readers whose connection closed, to be joined on the next accept.
+    std::vector<std::thread::id> finished;
+
+    std::mutex inboxMutex;
+    std::vector<std::string> inbox;
+    std::atomic<bool> inboxReady{false};
+
+    std::atomic<uint64_t> localQueued{0};
+    std::atomic<uint32_t> localWorkers{0};
+
+    std::atomic<uint64_t> forwarded{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> bytesSent{0};
+
+    void handOver(Peer& peer);
+    void runSender(size_t node);
+    void runAcceptor();
+    void runReader(int fd);
+    // Joins the finished readers. Called with connMutex held.
+    void reapReaders();
+
+    // Encodes one frame carrying urls and this node's load.
+    std::string frame(std::vector<std::string>& urls) const;
+
+    static int64_t nowMs();
+};
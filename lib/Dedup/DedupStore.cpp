@@ -0,0 +1,56 @@
+#include "DedupStore.hpp"
+
+#include <fstream>
+#include <sstream>
+
+#include "FingerprintStore.hpp"
+
+void BloomDedup::save(std::ostream& out) {
+    uint64_t kind = static_cast<uint64_t>(DedupKind::BLOOM);
+    out.write(reinterpret_cast<const char*>(&kind), sizeof(kind));
+    filter.save(out);
+    filter.clearDirty();
+}
+
+bool BloomDedup::load(const std::string& path, size_t offset) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(offset);
+    uint64_t kind = 0;
+    in.read(reinterpret_cast<char*>(&kind), sizeof(kind));
+    if (!in || kind != static_cast<uint64_t>(DedupKind::BLOOM))
+        return false;
+    return filter.load(path, offset + sizeof(kind));
+}
+
+void BloomDedup::saveDelta(std::ostream& out) {
+    uint64_t kind = static_cast<uint64_t>(DedupKind::BLOOM);
+    out.write(reinterpret_cast<const char*>(&kind), sizeof(kind));
+    filter.saveDirty(out);
+}
+
+bool BloomDedup::loadDelta(const std::string& path, size_t offset) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(offset);
+    uint64_t kind = 0;
+    in.read(reinterpret_cast<char*>(&kind), sizeof(kind));
+    if (!in || kind != static_cast<uint64_t>(DedupKind::BLOOM))
+        return false;
+    return filter.loadDirty(in);
+}
+
+std::string BloomDedup::describe() const {
+    std::ostringstream oss;
+    oss << "bloom filter: " << filter.numBits() << " bits, " << filter.hashes()
+        << " hashes, " << filter.fillRatio() * 100 << "% set";
+    return oss.str();
+}
+
+std::unique_ptr<DedupStore> makeDedupStore(const std::string& kind,
+                                           uint64_t maxUrls,
+                                           const std::string& dir) {
+    if (kind == "bloom")
+        return std::make_unique<BloomDedup>(maxUrls, 0.01);
+    if (kind == "exact")
+        return std::make_unique<FingerprintStore>(dir);
+    return nullptr;
+}
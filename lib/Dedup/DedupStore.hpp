@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "BlockedBloomFilter.hpp"
+
+// Set of urls the frontier has already seen. Frontier picks a backend at
+// startup: a Bloom filter (fixed size, small false positive rate) or an
+// exact fingerprint store (grows with the crawl, no false positives up to
+// 64-bit fingerprint collisions).
+class DedupStore {
+   public:
+    virtual ~DedupStore() = default;
+
+    // Records url and returns true if it had not been seen before.
+    virtual bool insertIfAbsent(std::string_view url) = 0;
+
+    virtual bool contains(std::string_view url) const = 0;
+
+    // Writes the store into a checkpoint. Backends may keep part of their
+    // state in their own files and only write a reference to it here.
+    virtual void save(std::ostream& out) = 0;
+
+    // Restores a store written by save() at `offset` of `path`.
+    virtual bool load(const std::string& path, size_t offset) = 0;
+
+    // Writes what changed since the last save() or saveDelta(). Applying
+    // each delta in order with loadDelta() on top of load() restores the
+    // store as of the last delta.
+    virtual void saveDelta(std::ostream& out) = 0;
+    virtual bool loadDelta(const std::string& path, size_t offset) = 0;
+
+    // One line summary for the logs.
+    virtual std::string describe() const = 0;
+};
+
+// Tags written first by each backend's save(), so a checkpoint is never
+// loaded into the wrong backend.
+enum class DedupKind : uint64_t {
+    BLOOM = 0x4d4f4f4c42,        // "BLOOM"
+    FINGERPRINT = 0x5250474e4946,  // "FINGPR"
+};
+
+class BloomDedup : public DedupStore {
+   public:
+    BloomDedup(uint64_t maxUrls, double falsePositiveRate)
+        : filter(maxUrls, falsePositiveRate) {}
+
+    bool insertIfAbsent(std::string_view url) override {
+        return filter.insertIfAbsent(url);
+    }
+
+    bool contains(std::string_view url) const override {
+        return filter.contains(url);
+    }
+
+    void save(std::ostream& out) override;
+    bool load(const std::string& path, size_t offset) override;
+    // Only the blocks that gained a bit.
+    void saveDelta(std::ostream& out) override;
+    bool loadDelta(const std::string& path, size_t offset) override;
+    std::string describe() const override;
+
+   private:
+    BlockedBloomFilter filter;
+};
+
+// Builds the backend named by `kind` ("bloom" or "exact"). `dir` is only
+// used by backends that keep files of their own. Returns nullptr for an
+// unknown kind.
+std::unique_ptr<DedupStore> makeDedupStore(const std::string& kind,
+                                           uint64_t maxUrls,
+                                           const std::string& dir);
@@ -0,0 +1,356 @@
+#include "FingerprintStore.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "Durable.hpp"
+#include "XXHash.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Runs are written under a temporary name, synced and renamed into place,
+// then the directory is synced: checkpoints list runs by number, so a run
+// must be whole on disk before one refers to it.
+int openRunFile(const std::string& path) {
+    return ::open((path + ".tmp").c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+// Syncs and closes fd, then puts the run in place if ok, i.e. if every
+// write to it went through.
+bool finishRunFile(int fd, const std::string& path, bool ok) {
+    ok = ok && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    return ok && std::rename((path + ".tmp").c_str(), path.c_str()) == 0 &&
+           durable::syncDirectory(path);
+}
+
+}  // namespace
+
+// Immutable sorted run of fingerprints, mapped from its file.
+struct FingerprintStore::Run {
+    uint64_t seq = 0;
+    const uint64_t* keys = nullptr;
+    size_t n = 0;
+    std::vector<uint64_t> fences;  // keys[0], keys[kFenceStride], ...
+
+    ~Run() {
+        if (keys)
+            ::munmap(const_cast<uint64_t*>(keys), n * sizeof(uint64_t));
+    }
+};
+
+FingerprintStore::FingerprintStore(std::string dir, size_t tableSlots,
+                                   size_t maxRuns)
+    : dir(std::move(dir)), maxRuns(std::max<size_t>(maxRuns, 1)) {
+    size_t slots = 16;
+    while (slots < tableSlots)
+        slots <<= 1;
+    table.assign(slots, 0);
+
+    // Never reuse the name of a run left by an earlier run of the frontier.
+    fs::create_directories(this->dir);
+    for (const auto& entry : fs::directory_iterator(this->dir)) {
+        unsigned long long seq;
+        if (std::sscanf(entry.path().filename().c_str(), "run-%llu.fp",
+                        &seq) == 1) {
+            nextSeq = std::max<uint64_t>(nextSeq, seq + 1);
+        }
+    }
+}
+
+FingerprintStore::~FingerprintStore() {
+    if (merger.joinable())
+        merger.join();
+}
+
+uint64_t FingerprintStore::fingerprint(std::string_view url) {
+    uint64_t fp = xxhash::hash64(url);
+    return fp ? fp : 1;  // 0 marks an empty table slot
+}
+
+std::string FingerprintStore::runPath(uint64_t seq) const {
+    return dir + "/run-" + std::to_string(seq) + ".fp";
+}
+
+bool FingerprintStore::tableContains(uint64_t fp) const {
+    size_t mask = table.size() - 1;
+    for (size_t i = fp & mask; table[i]; i = (i + 1) & mask) {
+        if (table[i] == fp)
+            return true;
+    }
+    return false;
+}
+
+bool FingerprintStore::runContains(const Run& run, uint64_t fp) {
+    // The fence before fp bounds a kFenceStride-key slice of the run.
+    auto fence = std::upper_bound(run.fences.begin(), run.fences.end(), fp);
+    if (fence == run.fences.begin())
+        return false;
+    size_t begin = (fence - run.fences.begin() - 1) * kFenceStride;
+    size_t end = std::min(run.n, begin + kFenceStride);
+    return std::binary_search(run.keys + begin, run.keys + end, fp);
+}
+
+bool FingerprintStore::contains(std::string_view url) const {
+    uint64_t fp = fingerprint(url);
+    if (tableContains(fp))
+        return true;
+    for (const RunPtr& run : runs) {
+        if (runContains(*run, fp))
+            return true;
+    }
+    return false;
+}
+
+bool FingerprintStore::insertIfAbsent(std::string_view url) {
+    if (mergeDone.load(std::memory_order_acquire))
+        installMerge();
+
+    uint64_t fp = fingerprint(url);
+    size_t mask = table.size() - 1;
+    size_t i = fp & mask;
+    for (; table[i]; i = (i + 1) & mask) {
+        if (table[i] == fp)
+            return false;
+    }
+    for (const RunPtr& run : runs) {
+        if (runContains(*run, fp))
+            return false;
+    }
+
+    table[i] = fp;
+    if (++tableCount * 2 >= table.size())
+        flush();
+    return true;
+}
+
+size_t FingerprintStore::size() const {
+    size_t n = tableCount;
+    for (const RunPtr& run : runs)
+        n += run->n;
+    return n;
+}
+
+void FingerprintStore::flush() {
+    if (tableCount == 0)
+        return;
+    std::vector<uint64_t> keys;
+    keys.reserve(tableCount);
+    for (uint64_t& slot : table) {
+        if (slot) {
+            keys.push_back(slot);
+            slot = 0;
+        }
+    }
+    tableCount = 0;
+    runs.push_back(writeRun(nextSeq++, keys));
+    maybeMerge();
+}
+
+// Sorts keys and writes them as run `seq`. The file appears under its
+// final name only once it is complete and on disk.
+FingerprintStore::RunPtr FingerprintStore::writeRun(
+    uint64_t seq, std::vector<uint64_t>& keys) const {
+    std::sort(keys.begin(), keys.end());
+    std::string path = runPath(seq);
+    int fd = openRunFile(path);
+    if (fd < 0)
+        throw std::runtime_error("Couldn't write " + path);
+    bool ok = durable::writeAll(fd, keys.data(),
+                                keys.size() * sizeof(uint64_t));
+    if (!finishRunFile(fd, path, ok))
+        throw std::runtime_error("Couldn't write " + path);
+    return openRun(seq);
+}
+
+FingerprintStore::RunPtr FingerprintStore::openRun(uint64_t seq) const {
+    auto run = std::make_shared<Run>();
+    run->seq = seq;
+
+    int fd = ::open(runPath(seq).c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    ::fstat(fd, &st);
+    run->n = static_cast<size_t>(st.st_size) / sizeof(uint64_t);
+    if (run->n > 0) {
+        void* map = ::mmap(nullptr, run->n * sizeof(uint64_t), PROT_READ,
+                           MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+        ::madvise(map, run->n * sizeof(uint64_t), MADV_RANDOM);
+        run->keys = static_cast<const uint64_t*>(map);
+    }
+    ::close(fd);
+
+    run->fences.reserve(run->n / kFenceStride + 1);
+    for (size_t i = 0; i < run->n; i += kFenceStride)
+        run->fences.push_back(run->keys[i]);
+    return run;
+}
+
+// Starts merging every current run into one in the background once there
+// are too many. Lookups keep using the inputs until the merge is installed.
+void FingerprintStore::maybeMerge() {
+    if (!mergeInputs.empty() || runs.size() <= maxRuns)
+        return;
+
+    mergeInputs = runs;
+    mergeSeq = nextSeq++;
+    merger = std::thread([this]() {
+        using Head = std::pair<uint64_t, size_t>;  // key, input index
+        std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+        std::vector<size_t> pos(mergeInputs.size(), 0);
+        for (size_t r = 0; r < mergeInputs.size(); ++r) {
+            if (mergeInputs[r]->n > 0)
+                heads.push({mergeInputs[r]->keys[0], r});
+        }
+
+        std::string path = runPath(mergeSeq);
+        int fd = openRunFile(path);
+        bool ok = fd >= 0;
+        std::vector<uint64_t> buffer;
+        buffer.reserve(1 << 16);
+        uint64_t last = 0;
+        while (!heads.empty()) {
+            auto [key, r] = heads.top();
+            heads.pop();
+            if (key != last) {
+                buffer.push_back(key);
+                last = key;
+            }
+            if (buffer.size() == buffer.capacity()) {
+                ok = ok && durable::writeAll(fd, buffer.data(),
+                                             buffer.size() * sizeof(uint64_t));
+                buffer.clear();
+            }
+            const Run& run = *mergeInputs[r];
+            if (++pos[r] < run.n)
+                heads.push({run.keys[pos[r]], r});
+        }
+        ok = ok && durable::writeAll(fd, buffer.data(),
+                                     buffer.size() * sizeof(uint64_t));
+        // A failed merge leaves no output, which installMerge() reports.
+        if (fd >= 0 && finishRunFile(fd, path, ok))
+            mergeOutput = openRun(mergeSeq);
+        mergeDone.store(true, std::memory_order_release);
+    });
+}
+
+// Swaps the merged run in for its inputs, which are still at the front of
+// runs since new runs are only ever appended.
+void FingerprintStore::installMerge() {
+    merger.join();
+    mergeDone.store(false, std::memory_order_relaxed);
+    if (!mergeOutput)
+        throw std::runtime_error("Fingerprint run merge failed in " + dir);
+
+    runs.erase(runs.begin(), runs.begin() + mergeInputs.size());
+    runs.insert(runs.begin(), mergeOutput);
+    for (const RunPtr& run : mergeInputs)
+        retired.push_back(run->seq);
+    mergeInputs.clear();
+    mergeOutput.reset();
+    maybeMerge();
+}
+
+void FingerprintStore::waitForMerge() {
+    // Installing a merge starts the next one if runs piled up meanwhile.
+    while (merger.joinable())
+        installMerge();
+}
+
+void FingerprintStore::writeRunList(std::ostream& out) {
+    flush();
+
+    uint64_t header[2] = {static_cast<uint64_t>(DedupKind::FINGERPRINT),
+                          runs.size()};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const RunPtr& run : runs)
+        out.write(reinterpret_cast<const char*>(&run->seq), sizeof(run->seq));
+}
+
+void FingerprintStore::save(std::ostream& out) {
+    writeRunList(out);
+    sweep();
+    retired.clear();
+}
+
+void FingerprintStore::saveDelta(std::ostream& out) {
+    writeRunList(out);
+}
+
+// Deletes run files nothing refers to any more: runs retired before the
+// previous save() and runs left behind by a crash.
+void FingerprintStore::sweep() {
+    std::unordered_set<uint64_t> keep(retired.begin(), retired.end());
+    for (const RunPtr& run : runs)
+        keep.insert(run->seq);
+    if (merger.joinable())
+        keep.insert(mergeSeq);
+
+    std::vector<fs::path> stale;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        unsigned long long seq;
+        if (std::sscanf(entry.path().filename().c_str(), "run-%llu.fp",
+                        &seq) == 1 &&
+            !keep.count(seq)) {
+            stale.push_back(entry.path());
+        }
+    }
+    for (const fs::path& path : stale)
+        fs::remove(path);
+}
+
+bool FingerprintStore::load(const std::string& path, size_t offset) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(offset);
+    uint64_t header[2] = {0, 0};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || header[0] != static_cast<uint64_t>(DedupKind::FINGERPRINT))
+        return false;
+
+    std::vector<RunPtr> loaded;
+    for (uint64_t i = 0; i < header[1]; ++i) {
+        uint64_t seq;
+        in.read(reinterpret_cast<char*>(&seq), sizeof(seq));
+        RunPtr run = in ? openRun(seq) : nullptr;
+        if (!run)
+            return false;
+        loaded.push_back(run);
+        nextSeq = std::max(nextSeq, seq + 1);
+    }
+
+    if (merger.joinable())
+        merger.join();
+    mergeDone.store(false);
+    mergeInputs.clear();
+    mergeOutput.reset();
+    std::fill(table.begin(), table.end(), 0);
+    tableCount = 0;
+    runs = std::move(loaded);
+    maybeMerge();
+    return true;
+}
+
+std::string FingerprintStore::describe() const {
+    std::ostringstream oss;
+    oss << "exact fingerprint store: " << size() << " fingerprints in "
+        << runs.size() << " runs + table, " << dir;
+    return oss.str();
+}
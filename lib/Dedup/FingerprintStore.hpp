@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DedupStore.hpp"
+
+// Exact set of 64-bit url fingerprints that grows without bound.
+//
+// New fingerprints go into an in-memory open-addressing table. When the
+// table is half full it is sorted and written to dir as an immutable run
+// file, which is mapped for lookups. Once there are more than `maxRuns`
+// runs they are merged into one by a background thread, so a lookup checks
+// the table and at most a handful of sorted runs. Each run keeps every
+// kFenceStride-th key in memory, so a probe into a run touches one page.
+//
+// A checkpoint only records the names of the current runs; the run files
+// themselves are the persistent state.
+class FingerprintStore : public DedupStore {
+   public:
+    explicit FingerprintStore(std::string dir, size_t tableSlots = 1 << 22,
+                              size_t maxRuns = 4);
+    ~FingerprintStore() override;
+
+    bool insertIfAbsent(std::string_view url) override;
+    bool contains(std::string_view url) const override;
+    void save(std::ostream& out) override;
+    bool load(const std::string& path, size_t offset) override;
+    // The run list is small, so a delta is the whole list. Unlike save(),
+    // it deletes no run files, since the last save() may still name them.
+    void saveDelta(std::ostream& out) override;
+    bool loadDelta(const std::string& path, size_t offset) override {
+        return load(path, offset);
+    }
+    std::string describe() const override;
+
+    size_t size() const;
+    size_t numRuns() const { return runs.size(); }
+
+    // Writes the table out as a run now.
+    void flush();
+
+    // Blocks until no background merge is left running.
+    void waitForMerge();
+
+    static uint64_t fingerprint(std::string_view url);
+
+   private:
+    struct Run;
+    using RunPtr = std::shared_ptr<const Run>;
+
+    static constexpr size_t kFenceStride = 512;
+
+    std::string dir;
+    size_t maxRuns;
+    uint64_t nextSeq = 0;
+
+    // Open addressing with linear probing; 0 marks an empty slot.
+    std::vector<uint64_t> table;
+    size_t tableCount = 0;
+
+    std::vector<RunPtr> runs;
+    // Runs replaced by a merge since the last save(). The checkpoint on
+    // disk may still name them, so they are deleted one save() later.
+    std::vector<uint64_t> retired;
+
+    std::thread merger;
+    std::atomic<bool> mergeDone{false};
+    std::vector<RunPtr> mergeInputs;
+    RunPtr mergeOutput;
+    uint64_t mergeSeq = 0;
+
+    std::string runPath(uint64_t seq) const;
+    RunPtr writeRun(uint64_t seq, std::vector<uint64_t>& keys) const;
+    RunPtr openRun(uint64_t seq) const;
+    void maybeMerge();
+    void installMerge();
+    void sweep();
+    void writeRunList(std::ostream& out);
+
+    bool tableContains(uint64_t fp) const;
+    static bool runContains(const Run& run, uint64_t fp);
+};
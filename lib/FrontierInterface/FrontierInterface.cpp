@@ -1,101 +1,441 @@
 #include "FrontierInterface.hpp"
 
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
-std::string FrontierInterface::Encode(FrontierMessage message) {
+#ifdef FRONTIER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+constexpr size_t kLenSize = sizeof(uint32_t);
+
+// Front coding lets a few bytes stand for a whole url, so a small message
+// could expand to gigabytes. No real batch comes close to this.
+constexpr size_t kMaxDecodedBytes = 64u << 20;
+
+// COMPACT tag byte: 1vvvxctt. The high bit never appears in the first
+// byte of a LEGACY header, which is ASCII. x is the third type bit, zero
+// for the original four types.
+constexpr uint8_t kCompactBit = 0x80;
+constexpr uint8_t kCompactVersion = 1;
+constexpr uint8_t kCompressedBit = 0x04;
+constexpr uint8_t kTypeMask = 0x03;
+constexpr uint8_t kTypeHighBit = 0x08;
+
+uint8_t typeBits(FrontierMessageType type) {
+    uint8_t t = static_cast<uint8_t>(type);
+    return (t & kTypeMask) | ((t & 0x04) << 1);
+}
+
+FrontierMessageType typeOf(uint8_t tag) {
+    return static_cast<FrontierMessageType>((tag & kTypeMask) |
+                                            ((tag & kTypeHighBit) >> 1));
+}
+
+bool isCompact(std::string_view encoded) {
+    return !encoded.empty() && (uint8_t(encoded[0]) & kCompactBit);
+}
+
+const std::string& headerOf(const FrontierMessage& message) {
     if (static_cast<int>(message.type) < 0 ||
-        static_cast<int>(message.type) > 3) {
+        static_cast<int>(message.type) > 4) {
         throw std::runtime_error("Invalid Message Type header");
     }
-    std::ostringstream oss;
-    oss << MessageHeaders[static_cast<int>(message.type)] << '\0';
+    return MessageHeaders[static_cast<int>(message.type)];
+}
+
+// Compares 8 bytes at a time; urls in a batch often share 30+ bytes.
+size_t sharedPrefix(std::string_view a, std::string_view b) {
+    size_t n = std::min(a.size(), b.size());
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        std::memcpy(&x, a.data() + i, 8);
+        std::memcpy(&y, b.data() + i, 8);
+        if (x != y)
+            return i + __builtin_ctzll(x ^ y) / 8;
+    }
+    while (i < n && a[i] == b[i])
+        ++i;
+    return i;
+}
 
-    // Encode urls
-    {
-        uint32_t numUrls = htonl(static_cast<uint32_t>(message.urls.size()));
-        oss.write(reinterpret_cast<char*>(&numUrls), sizeof(numUrls));
+size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void writeVarint(char*& out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+}
+
+void writeU32(char*& out, uint32_t value) {
+    value = htonl(value);
+    std::memcpy(out, &value, kLenSize);
+    out += kLenSize;
+}
+
+size_t legacyListSize(const std::vector<std::string>& list) {
+    size_t size = kLenSize;
+    for (const auto& s : list)
+        size += kLenSize + s.size();
+    return size;
+}
+
+void writeLegacyList(char*& out, const std::vector<std::string>& list) {
+    writeU32(out, static_cast<uint32_t>(list.size()));
+    for (const auto& s : list) {
+        writeU32(out, static_cast<uint32_t>(s.size()));
+        std::memcpy(out, s.data(), s.size());
+        out += s.size();
+    }
+}
+
+// Each url is (shared prefix length, suffix length, suffix).
+size_t compactListSize(const std::vector<std::string>& list) {
+    size_t size = varintSize(list.size());
+    std::string_view prev;
+    for (const auto& s : list) {
+        size_t shared = sharedPrefix(prev, s);
+        size += varintSize(shared) + varintSize(s.size() - shared) +
+                s.size() - shared;
+        prev = s;
+    }
+    return size;
+}
+
+// Upper bound on compactListSize() that does not compare any urls.
+size_t compactListBound(const std::vector<std::string>& list) {
+    size_t size = 5;
+    for (const auto& s : list)
+        size += 10 + s.size();
+    return size;
+}
+
+void writeCompactList(char*& out, const std::vector<std::string>& list) {
+    writeVarint(out, list.size());
+    std::string_view prev;
+    for (const auto& s : list) {
+        size_t shared = sharedPrefix(prev, s);
+        writeVarint(out, shared);
+        writeVarint(out, s.size() - shared);
+        std::memcpy(out, s.data() + shared, s.size() - shared);
+        out += s.size() - shared;
+        prev = s;
+    }
+}
+
+// Bounds-checked cursor over an encoded message.
+struct Reader {
+    const char* pos;
+    const char* end;
+
+    void need(size_t n) const {
+        if (static_cast<size_t>(end - pos) < n)
+            throw std::runtime_error("Truncated message");
+    }
+
+    uint32_t readU32() {
+        need(kLenSize);
+        uint32_t value;
+        std::memcpy(&value, pos, kLenSize);
+        pos += kLenSize;
+        return ntohl(value);
+    }
+
+    uint64_t readVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            need(1);
+            uint8_t byte = static_cast<uint8_t>(*pos++);
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Malformed varint");
+    }
 
-        for (const auto& url : message.urls) {
-            uint32_t len = htonl(static_cast<uint32_t>(url.size()));
-            oss.write(reinterpret_cast<char*>(&len), sizeof(len));
-            oss.write(url.data(), url.size());
+    void readLegacyList(std::vector<std::string_view>& list) {
+        uint32_t count = readU32();
+        // Every entry takes at least its length prefix, which bounds the
+        // reservation for a corrupt count.
+        need(size_t(count) * kLenSize);
+        list.clear();
+        list.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t len = readU32();
+            need(len);
+            list.emplace_back(pos, len);
+            pos += len;
         }
     }
 
-    // Encode failed
-    {
-        uint32_t numFailed =
-            htonl(static_cast<uint32_t>(message.failed.size()));
-        oss.write(reinterpret_cast<char*>(&numFailed), sizeof(numFailed));
+    // Validates a front-coded list and returns the bytes it expands to,
+    // which must not exceed limit.
+    size_t measureCompactList(size_t limit) {
+        uint64_t count = readVarint();
+        // Every url takes at least two bytes.
+        if (count > static_cast<size_t>(end - pos) / 2)
+            throw std::runtime_error("Truncated message");
+        size_t total = 0;
+        size_t prevSize = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t shared = readVarint();
+            uint64_t suffix = readVarint();
+            if (shared > prevSize)
+                throw std::runtime_error("Malformed front-coded url");
+            need(suffix);
+            pos += suffix;
+            prevSize = shared + suffix;
+            total += prevSize;
+            if (total > limit)
+                throw std::runtime_error("Message expands too far");
+        }
+        return total;
+    }
 
-        // Write each failed URL
-        for (const auto& f : message.failed) {
-            uint32_t len = htonl(static_cast<uint32_t>(f.size()));
-            oss.write(reinterpret_cast<char*>(&len), sizeof(len));
-            oss.write(f.data(), f.size());
+    // Expands a list checked by measureCompactList() into out.
+    void readCompactList(std::vector<std::string_view>& list, char*& out) {
+        uint64_t count = readVarint();
+        list.clear();
+        list.reserve(count);
+        std::string_view prev;
+        for (uint64_t i = 0; i < count; ++i) {
+            size_t shared = readVarint();
+            size_t suffix = readVarint();
+            if (shared)
+                std::memcpy(out, prev.data(), shared);
+            std::memcpy(out + shared, pos, suffix);
+            pos += suffix;
+            prev = list.emplace_back(out, shared + suffix);
+            out += shared + suffix;
         }
     }
+};
+
+void decodeCompactBody(Reader in, FrontierMessageView& out) {
+    Reader measure = in;
+    size_t total = measure.measureCompactList(kMaxDecodedBytes);
+    total += measure.measureCompactList(kMaxDecodedBytes - total);
+
+    // Sized up front so the views never move.
+    out.storage.resize(total);
+    char* dst = out.storage.data();
+    in.readCompactList(out.urls, dst);
+    in.readCompactList(out.failed, dst);
+}
+
+#ifdef FRONTIER_HAVE_ZLIB
+// zlib streams are set up once per thread and reset for every message:
+// setting one up allocates and clears more memory than a batch takes to
+// compress.
+struct Deflater {
+    z_stream z{};
+    Deflater() { deflateInit(&z, Z_BEST_SPEED); }
+    ~Deflater() { deflateEnd(&z); }
+
+    // Compresses in into out; size is out's capacity in, bytes written out.
+    bool run(const char* in, size_t inSize, char* out, size_t& size) {
+        deflateReset(&z);
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        z.avail_in = static_cast<uInt>(inSize);
+        z.next_out = reinterpret_cast<Bytef*>(out);
+        z.avail_out = static_cast<uInt>(size);
+        bool ok = deflate(&z, Z_FINISH) == Z_STREAM_END;
+        size = z.total_out;
+        return ok;
+    }
+};
+
+struct Inflater {
+    z_stream z{};
+    Inflater() { inflateInit(&z); }
+    ~Inflater() { inflateEnd(&z); }
+
+    // Decompresses in into exactly size bytes of out.
+    bool run(const char* in, size_t inSize, char* out, size_t size) {
+        inflateReset(&z);
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        z.avail_in = static_cast<uInt>(inSize);
+        z.next_out = reinterpret_cast<Bytef*>(out);
+        z.avail_out = static_cast<uInt>(size);
+        return inflate(&z, Z_FINISH) == Z_STREAM_END && z.total_out == size;
+    }
+};
+#endif
 
-    return oss.str();
+char* writeCompact(const FrontierMessage& message, char* out) {
+    *out++ = static_cast<char>(kCompactBit | kCompactVersion << 4 |
+                               typeBits(message.type));
+    writeCompactList(out, message.urls);
+    writeCompactList(out, message.failed);
+    return out;
 }
 
-FrontierMessage FrontierInterface::Decode(const std::string& encoded) {
-    std::istringstream iss(encoded);
-    std::string header;
-    std::getline(iss, header, '\0');
+}  // namespace
+
+size_t FrontierInterface::EncodedSize(const FrontierMessage& message,
+                                      FrontierProtocol protocol) {
+    if (protocol == FrontierProtocol::COMPACT) {
+        headerOf(message);
+        return 1 + compactListSize(message.urls) +
+               compactListSize(message.failed);
+    }
+    return headerOf(message).size() + 1 + legacyListSize(message.urls) +
+           legacyListSize(message.failed);
+}
+
+size_t FrontierInterface::EncodeInto(const FrontierMessage& message,
+                                     char* buffer, size_t capacity,
+                                     FrontierProtocol protocol) {
+    size_t size = EncodedSize(message, protocol);
+    if (capacity < size)
+        throw std::runtime_error("Encode buffer too small");
+
+    if (protocol == FrontierProtocol::COMPACT)
+        return writeCompact(message, buffer) - buffer;
+
+    char* out = buffer;
+    const std::string& header = headerOf(message);
+    std::memcpy(out, header.c_str(), header.size() + 1);
+    out += header.size() + 1;
+    writeLegacyList(out, message.urls);
+    writeLegacyList(out, message.failed);
+    return size;
+}
+
+void FrontierInterface::EncodeInto(const FrontierMessage& message,
+                                   std::string& out,
+                                   FrontierProtocol protocol) {
+    if (protocol != FrontierProtocol::COMPACT) {
+        out.resize(EncodedSize(message, protocol));
+        EncodeInto(message, out.data(), out.size(), protocol);
+        return;
+    }
+
+    // Write into a bound and trim, rather than front-coding twice.
+    headerOf(message);
+    out.resize(1 + compactListBound(message.urls) +
+               compactListBound(message.failed));
+    out.resize(writeCompact(message, out.data()) - out.data());
+
+#ifdef FRONTIER_HAVE_ZLIB
+    if (out.size() < kCompressMinBytes)
+        return;
+    // Compressed layout: tag, varint body size, deflated body.
+    thread_local Deflater deflater;
+    thread_local std::string compressed;
+    size_t bodySize = out.size() - 1;
+    size_t deflatedSize = compressBound(bodySize);
+    compressed.resize(1 + varintSize(bodySize) + deflatedSize);
+    char* dst = compressed.data();
+    *dst++ = static_cast<char>(out[0] | kCompressedBit);
+    writeVarint(dst, bodySize);
+    size_t headerSize = dst - compressed.data();
+    if (deflater.run(out.data() + 1, bodySize, dst, deflatedSize) &&
+        headerSize + deflatedSize < out.size()) {
+        out.assign(compressed.data(), headerSize + deflatedSize);
+    }
+#endif
+}
+
+std::string FrontierInterface::Encode(const FrontierMessage& message,
+                                      FrontierProtocol protocol) {
+    std::string encoded;
+    EncodeInto(message, encoded, protocol);
+    return encoded;
+}
+
+bool FrontierInterface::CompressionAvailable() {
+#ifdef FRONTIER_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+FrontierProtocol FrontierInterface::ProtocolOf(std::string_view encoded) {
+    return isCompact(encoded) ? FrontierProtocol::COMPACT
+                              : FrontierProtocol::LEGACY;
+}
+
+void FrontierInterface::DecodeView(std::string_view encoded,
+                                   FrontierMessageView& out) {
+    if (isCompact(encoded)) {
+        uint8_t tag = static_cast<uint8_t>(encoded[0]);
+        if (((tag >> 4) & 0x07) != kCompactVersion)
+            throw std::runtime_error("Unsupported protocol version");
+        out.type = typeOf(tag);
+        if (out.type > FrontierMessageType::REDIRECT)
+            throw std::runtime_error("Invalid message type");
+
+        Reader in{encoded.data() + 1, encoded.data() + encoded.size()};
+        if (tag & kCompressedBit) {
+#ifdef FRONTIER_HAVE_ZLIB
+            uint64_t bodySize = in.readVarint();
+            // Deflate expands at most ~1032x; reject sizes a corrupt header
+            // could use to force a huge allocation.
+            if (bodySize > uint64_t(in.end - in.pos) * 1032 + 64)
+                throw std::runtime_error("Malformed compressed message");
+            thread_local Inflater inflater;
+            out.inflated.resize(bodySize);
+            if (!inflater.run(in.pos, in.end - in.pos, out.inflated.data(),
+                              bodySize)) {
+                throw std::runtime_error("Malformed compressed message");
+            }
+            in = Reader{out.inflated.data(),
+                        out.inflated.data() + out.inflated.size()};
+#else
+            throw std::runtime_error(
+                "Compressed message but built without zlib");
+#endif
+        }
+        decodeCompactBody(in, out);
+        return;
+    }
+
+    size_t nul = encoded.find('\0');
+    std::string_view header = encoded.substr(0, nul);
 
-    FrontierMessageType messageType;
     if (header == "ROBOTS") {
-        messageType = FrontierMessageType::ROBOTS;
+        out.type = FrontierMessageType::ROBOTS;
     } else if (header == "URLS") {
-        messageType = FrontierMessageType::URLS;
+        out.type = FrontierMessageType::URLS;
     } else if (header == "START") {
-        messageType = FrontierMessageType::START;
+        out.type = FrontierMessageType::START;
     } else if (header == "END") {
-        messageType = FrontierMessageType::END;
+        out.type = FrontierMessageType::END;
+    } else if (header == "REDIRECT") {
+        out.type = FrontierMessageType::REDIRECT;
     } else {
-        throw std::runtime_error("Invalid MessageType header" + header);
-    }
-
-    FrontierMessage message;
-    message.type = messageType;
-
-    // Read urls
-    {
-        uint32_t numUrlsN;
-        iss.read(reinterpret_cast<char*>(&numUrlsN), sizeof(numUrlsN));
-        uint32_t numUrls = ntohl(numUrlsN);
-
-        // Read each URL
-        message.urls.reserve(numUrls);
-        for (uint32_t i = 0; i < numUrls; ++i) {
-            uint32_t lenN;
-            iss.read(reinterpret_cast<char*>(&lenN), sizeof(lenN));
-            uint32_t len = ntohl(lenN);
-
-            std::string url(len, '\0');
-            iss.read(&url[0], len);
-            message.urls.push_back(url);
-        }
+        throw std::runtime_error("Invalid MessageType header" +
+                                 std::string(header));
     }
 
-    // Read failed
-    {
-        uint32_t numFailedN;
-        iss.read(reinterpret_cast<char*>(&numFailedN), sizeof(numFailedN));
-        uint32_t numFailed = ntohl(numFailedN);
+    size_t body = nul == std::string_view::npos ? encoded.size() : nul + 1;
+    Reader in{encoded.data() + body, encoded.data() + encoded.size()};
+    in.readLegacyList(out.urls);
+    in.readLegacyList(out.failed);
+}
 
-        // Read each failed URL
-        message.failed.reserve(numFailed);
-        for (uint32_t i = 0; i < numFailed; ++i) {
-            uint32_t lenN;
-            iss.read(reinterpret_cast<char*>(&lenN), sizeof(lenN));
-            uint32_t len = ntohl(lenN);
+FrontierMessage FrontierInterface::Decode(std::string_view encoded) {
+    FrontierMessageView view;
+    DecodeView(encoded, view);
 
-            std::string f(len, '\0');
-            iss.read(&f[0], len);
-            message.failed.push_back(f);
-        }
-    }
+    FrontierMessage message;
+    message.type = view.type;
+    message.urls.assign(view.urls.begin(), view.urls.end());
+    message.failed.assign(view.failed.begin(), view.failed.end());
     return message;
 }
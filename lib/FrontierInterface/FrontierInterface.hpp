@@ -3,13 +3,19 @@
 #include <arpa/inet.h>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class FrontierMessageType {
     START = 0,
     END = 1,
     URLS = 2,
+    // robots.txt rules a worker fetched: a url of the host, then its
+    // "Allow: path" and "Disallow: path" lines, for any number of hosts.
     ROBOTS = 3,
+    // Reply to START in cluster mode: urls[0] is the "ip:port" of the
+    // frontier node the worker should ask instead.
+    REDIRECT = 4,
 };
 
 const std::string MessageHeaders[] = {
@@ -17,6 +23,7 @@ const std::string MessageHeaders[] = {
     "END",
     "URLS",
     "ROBOTS",
+    "REDIRECT",
 };
 
 struct FrontierMessage {
@@ -41,6 +48,9 @@ struct FrontierMessage {
             case FrontierMessageType::END:
                 os << "START";
                 break;
+            case FrontierMessageType::REDIRECT:
+                os << "REDIRECT";
+                break;
             default:
                 os << "UNKNOWN";
                 break;
@@ -66,8 +76,65 @@ struct FrontierMessage {
     }
 };
 
+// Wire formats. LEGACY is the textual header followed by 4-byte lengths.
+// COMPACT is a 1-byte tag (format version, compression flag and type)
+// followed by varint lengths and front-coded url lists, where each url
+// only carries the suffix it does not share with the previous one. Large
+// COMPACT messages may be deflated when built with zlib.
+//
+// Decode accepts both, so a worker opts in by sending its START as COMPACT
+// and the frontier answers every message in the format it arrived in.
+enum class FrontierProtocol {
+    LEGACY = 0,
+    COMPACT = 1,
+};
+
+// Decoded message whose urls point into the encoded buffer, which must
+// outlive it, or into the view's own storage for COMPACT messages. Reusing
+// one view across messages keeps all capacity, so decoding does no
+// allocation at all once it has grown.
+struct FrontierMessageView {
+    FrontierMessageType type;
+    std::vector<std::string_view> urls;
+    std::vector<std::string_view> failed;
+
+    std::string storage;   // expanded front-coded urls
+    std::string inflated;  // decompressed COMPACT body
+};
+
 struct FrontierInterface {
-    static std::string Encode(FrontierMessage message);
+    static std::string Encode(
+        const FrontierMessage& message,
+        FrontierProtocol protocol = FrontierProtocol::LEGACY);
+
+    // Exact number of bytes EncodeInto(buffer) produces for message.
+    static size_t EncodedSize(
+        const FrontierMessage& message,
+        FrontierProtocol protocol = FrontierProtocol::LEGACY);
+
+    // Encodes into buffer and returns the number of bytes written. Throws
+    // if capacity is smaller than EncodedSize(message). Never compresses.
+    static size_t EncodeInto(
+        const FrontierMessage& message, char* buffer, size_t capacity,
+        FrontierProtocol protocol = FrontierProtocol::LEGACY);
+
+    // Encodes into out, reusing its capacity. COMPACT messages of at least
+    // kCompressMinBytes are compressed if that makes them smaller.
+    static void EncodeInto(
+        const FrontierMessage& message, std::string& out,
+        FrontierProtocol protocol = FrontierProtocol::LEGACY);
+
+    static FrontierMessage Decode(std::string_view encoded);
+
+    // Decodes into out without copying any url of a LEGACY message. Throws
+    // on a malformed or truncated message.
+    static void DecodeView(std::string_view encoded, FrontierMessageView& out);
+
+    // Format of an encoded message, to answer in kind.
+    static FrontierProtocol ProtocolOf(std::string_view encoded);
+
+    // Whether this build can compress COMPACT messages.
+    static bool CompressionAvailable();
 
-    static FrontierMessage Decode(const std::string& encoded);
+    static constexpr size_t kCompressMinBytes = 16384;
 };
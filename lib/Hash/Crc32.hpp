@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// CRC-32C (Castagnoli), table driven eight bytes at a time. Guards
+// checkpoint and log files against torn or corrupted writes.
+namespace crc32c {
+
+constexpr uint32_t kPoly = 0x82F63B78;  // reflected
+
+struct Tables {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+
+    constexpr Tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; ++k)
+                crc = (crc >> 1) ^ (kPoly & (0 - (crc & 1)));
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (size_t k = 1; k < 8; ++k)
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+        }
+    }
+};
+
+inline const Tables& tables() {
+    static constexpr Tables kTables;
+    return kTables;
+}
+
+// Continues crc over data; start with 0.
+inline uint32_t extend(uint32_t crc, const void* data, size_t len) {
+    const auto& t = tables().t;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    while (len >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        word ^= crc;
+        crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+              t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+              t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+              t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    return ~crc;
+}
+
+inline uint32_t hash(std::string_view data) {
+    return extend(0, data.data(), data.size());
+}
+
+}  // namespace crc32c
@@ -0,0 +1,67 @@
+#include "LeaseTable.hpp"
+
+LeaseTable::LeaseTable(uint32_t timeoutMs)
+    : timeoutMs(timeoutMs) {}
+
+LeaseTable::Lease* LeaseTable::find(int sock) {
+    if (sock < 0 || static_cast<size_t>(sock) >= leases.size())
+        return nullptr;
+    return &leases[static_cast<size_t>(sock)];
+}
+
+void LeaseTable::end(Lease& lease, bool keepBuffer) {
+    --active;
+    numUrls -= lease.count;
+    lease.active = false;
+    ++lease.generation;
+    lease.count = 0;
+    if (keepBuffer)
+        lease.urls.clear();
+    else
+        std::string().swap(lease.urls);
+}
+
+void LeaseTable::lease(int sock, const std::vector<std::string>& urls,
+                       int64_t nowMs) {
+    if (timeoutMs == 0 || sock < 0 || urls.empty())
+        return;
+    size_t i = static_cast<size_t>(sock);
+    if (i >= leases.size())
+        leases.resize(std::max(i + 1, 2 * leases.size()));
+    Lease& lease = leases[i];
+    if (lease.active)
+        end(lease, true);
+
+    size_t bytes = 0;
+    for (const std::string& url : urls)
+        bytes += sizeof(uint32_t) + url.size();
+    lease.urls.reserve(bytes);
+    for (const std::string& url : urls) {
+        uint32_t length = static_cast<uint32_t>(url.size());
+        lease.urls.append(reinterpret_cast<const char*>(&length),
+                          sizeof(length));
+        lease.urls.append(url);
+    }
+    lease.count = static_cast<uint32_t>(urls.size());
+    lease.deadlineMs = nowMs + timeoutMs;
+    lease.active = true;
+    ++active;
+    numUrls += urls.size();
+    leasedUrls += urls.size();
+
+    wheel.add(Deadline{static_cast<uint32_t>(sock), lease.generation},
+              lease.deadlineMs);
+}
+
+void LeaseTable::ack(int sock) {
+    Lease* lease = find(sock);
+    if (lease != nullptr && lease->active)
+        end(*lease, true);
+}
+
+size_t LeaseTable::bytes() const {
+    size_t total = leases.capacity() * sizeof(Lease) + wheel.bytes();
+    for (const Lease& lease : leases)
+        total += lease.urls.capacity();
+    return total;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TimingWheel.hpp"
+
+// Urls sent to workers and not known to be fetched yet. A response leases
+// its urls to the connection it goes to until a deadline; the worker's
+// next request on that connection returns the lease, and the urls of a
+// lease that runs out are handed back to be sent to another worker. They
+// are in the seen urls already, so without a lease a worker that dies
+// takes its batch with it for good.
+//
+// A connection holds at most one lease, the urls of its last response,
+// packed into one string after their lengths. Deadlines sit on a hashed
+// timing wheel of one-second ticks with one entry per lease, not per url.
+// A returned lease leaves its entry behind to be skipped when its slot
+// comes up, so leasing, returning and expiring are O(1) per lease.
+//
+// Connections are told apart by socket. Single-threaded.
+class LeaseTable {
+   public:
+    // A timeout of 0 leases nothing.
+    explicit LeaseTable(uint32_t timeoutMs = 600000);
+
+    // Leases urls to sock until nowMs plus the timeout, returning the
+    // lease sock held, if any, first.
+    void lease(int sock, const std::vector<std::string>& urls, int64_t nowMs);
+
+    // The worker on sock came back for more: its lease is done.
+    void ack(int sock);
+
+    // The worker on sock is gone, say because a new one started on its
+    // socket: calls redispatch(url) for every url of its lease.
+    template <typename F>
+    void revoke(int sock, F&& redispatch);
+
+    // Calls redispatch(url) for every url of every lease that ran out.
+    template <typename F>
+    void expire(int64_t nowMs, F&& redispatch);
+
+    size_t inFlight() const { return numUrls; }
+    size_t numLeases() const { return active; }
+    uint64_t leased() const { return leasedUrls; }
+    uint64_t expired() const { return expiredUrls; }
+    uint64_t revoked() const { return revokedUrls; }
+
+    // Bytes held by the leases and the wheel.
+    size_t bytes() const;
+
+   private:
+    static constexpr int64_t kTickMs = 1000;
+    static constexpr size_t kWheelSlots = 4096;
+
+    struct Lease {
+        std::string urls;  // each url after its uint32_t length
+        uint32_t count = 0;
+        uint32_t generation = 0;  // bumped when the lease ends
+        int64_t deadlineMs = 0;
+        bool active = false;
+    };
+
+    // A lease's entry on the wheel; stale once the lease's generation
+    // has moved on.
+    struct Deadline {
+        uint32_t sock;
+        uint32_t generation;
+    };
+
+    uint32_t timeoutMs;
+    std::vector<Lease> leases;  // by socket
+    size_t active = 0;
+    size_t numUrls = 0;
+
+    // Deadlines, stale ones included.
+    TimingWheel<Deadline> wheel{kTickMs, kWheelSlots};
+
+    uint64_t leasedUrls = 0;
+    uint64_t expiredUrls = 0;
+    uint64_t revokedUrls = 0;
+
+    Lease* find(int sock);
+    // Ends a lease, keeping its buffer for the socket's next lease unless
+    // the worker is gone.
+    void end(Lease& lease, bool keepBuffer);
+    template <typename F>
+    static void forEachUrl(const Lease& lease, F&& f);
+};
+
+template <typename F>
+void LeaseTable::forEachUrl(const Lease& lease, F&& f) {
+    const char* p = lease.urls.data();
+    const char* end = p + lease.urls.size();
+    while (p < end) {
+        uint32_t length;
+        std::memcpy(&length, p, sizeof(length));
+        p += sizeof(length);
+        f(std::string_view(p, length));
+        p += length;
+    }
+}
+
+template <typename F>
+void LeaseTable::revoke(int sock, F&& redispatch) {
+    Lease* lease = find(sock);
+    if (lease == nullptr || !lease->active)
+        return;
+    revokedUrls += lease->count;
+    forEachUrl(*lease, redispatch);
+    end(*lease, false);
+}
+
+template <typename F>
+void LeaseTable::expire(int64_t nowMs, F&& redispatch) {
+    wheel.advance(nowMs, [&](const Deadline& deadline) {
+        Lease& lease = leases[deadline.sock];
+        if (!lease.active || lease.generation != deadline.generation)
+            return;
+        expiredUrls += lease.count;
+        forEachUrl(lease, redispatch);
+        end(lease, false);
+    });
+}
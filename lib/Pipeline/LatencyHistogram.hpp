@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Log-linear histogram of latencies in microseconds. Values below 16 are
+// exact; above that every power of two is split into 16 buckets, so a
+// percentile is within about 6% of the true value. Recording is a couple
+// of instructions and the histogram never allocates.
+class LatencyHistogram {
+   public:
+    void record(uint64_t micros) {
+        ++buckets[bucketOf(micros)];
+        ++total;
+        maxSeen = std::max(maxSeen, micros);
+    }
+
+    // Upper bound of the bucket holding the p-th percentile, p in [0, 100].
+    uint64_t percentile(double p) const {
+        if (total == 0)
+            return 0;
+        uint64_t rank = std::max<uint64_t>(1, uint64_t(p / 100 * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            seen += buckets[b];
+            if (seen >= rank)
+                return std::min(upperBound(b), maxSeen);
+        }
+        return maxSeen;
+    }
+
+    uint64_t max() const { return maxSeen; }
+    uint64_t count() const { return total; }
+
+    void reset() {
+        buckets.fill(0);
+        total = 0;
+        maxSeen = 0;
+    }
+
+   private:
+    static constexpr int kSubBits = 4;
+    static constexpr uint64_t kSub = 1 << kSubBits;
+
+    std::array<uint64_t, (64 - kSubBits + 1) * kSub> buckets{};
+    uint64_t total = 0;
+    uint64_t maxSeen = 0;
+
+    static size_t bucketOf(uint64_t v) {
+        if (v < kSub)
+            return v;
+        int e = 63 - __builtin_clzll(v);
+        uint64_t sub = (v >> (e - kSubBits)) & (kSub - 1);
+        return (e - kSubBits + 1) * kSub + sub;
+    }
+
+    static uint64_t upperBound(size_t b) {
+        if (b < kSub)
+            return b;
+        int e = b / kSub + kSubBits - 1;
+        uint64_t sub = b % kSub;
+        uint64_t width = uint64_t(1) << (e - kSubBits);
+        return ((kSub + sub) << (e - kSubBits)) + width - 1;
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "FrontierInterface.hpp"
+#include "LatencyHistogram.hpp"
+#include "SpscQueue.hpp"
+
+// Serves requests from a Gateway-style server in three stages connected by
+// SPSC queues:
+//
+//   receiver thread: GetMessagesBlocking, DecodeView
+//   core (caller of run()): handler, the only stage touching frontier state
+//   sender thread: Encode in the request's protocol, SendMessage
+//
+// So decoding and encoding overlap with queue work, and nothing sleeps:
+// the receiver blocks in the server and the other stages wait on events.
+// Server needs GetMessagesBlocking() returning a vector of messages with
+// msg and senderSock, and SendMessage(message) with receiverSock and msg.
+// It is called from both I/O threads at once, which the Gateway server
+// allows since every send goes to a socket the receiver is not reading.
+template <typename Server>
+class RequestPipeline {
+   public:
+    using Message = typename decltype(
+        std::declval<Server&>().GetMessagesBlocking())::value_type;
+    using Handler = std::function<FrontierMessage(
+        const Message& message, const FrontierMessageView& request)>;
+    using Clock = std::chrono::steady_clock;
+
+    RequestPipeline(Server& server, Handler handler, size_t queueDepth = 4096)
+        : server(server),
+          handler(std::move(handler)),
+          requests(queueDepth),
+          responses(queueDepth) {}
+
+    ~RequestPipeline() { stop(); }
+
+    // Called from the receiver thread for messages that fail to decode;
+    // they get no response.
+    void onDecodeError(
+        std::function<void(const Message&, const std::exception&)> f) {
+        decodeError = std::move(f);
+    }
+
+    // Called from the sender thread with the latency histogram, from
+    // receipt to SendMessage returning, every `every` responses.
+    void onLatency(size_t every,
+                   std::function<void(const LatencyHistogram&)> f) {
+        reportEvery = every;
+        report = std::move(f);
+    }
+
+    // Holds each response back until the changes made while handling its
+    // request are durable: mark() runs on the core thread after the handler
+    // and returns a ticket, and wait(ticket) on the sender thread before
+    // sending. Many requests can be handled while one wait is in progress,
+    // so a slow commit covers all of them at once.
+    void onCommit(std::function<uint64_t()> mark,
+                  std::function<void(uint64_t)> wait) {
+        commitMark = std::move(mark);
+        commitWait = std::move(wait);
+    }
+
+    // Starts the I/O threads and runs the core stage on the calling thread
+    // until stop(). The receiver is joined once GetMessagesBlocking returns.
+    void run() {
+        receiver = std::thread([this]() { receiveLoop(); });
+        sender = std::thread([this]() { sendLoop(); });
+
+        std::unique_ptr<Request> request;
+        while (requests.pop(request)) {
+            handling = request->received;
+            Response response{request->message.senderSock, request->protocol,
+                              handler(request->message, request->view),
+                              request->received};
+            if (commitMark)
+                response.commit = commitMark();
+            responses.push(std::move(response));
+        }
+
+        responses.close();
+        sender.join();
+        receiver.join();
+    }
+
+    // Makes run() return after the requests already received are served.
+    // Safe to call from any thread, including the handler.
+    void stop() {
+        stopping.store(true);
+        requests.close();
+    }
+
+    // Requests received but not yet handled.
+    size_t backlog() const { return requests.size(); }
+
+    // When the request being handled was received. For the handler only.
+    Clock::time_point received() const { return handling; }
+
+   private:
+    // Boxed so the decoded views into message.msg stay put while queued.
+    struct Request {
+        Message message;
+        FrontierMessageView view;
+        FrontierProtocol protocol;
+        Clock::time_point received;
+    };
+
+    struct Response {
+        int sock = 0;
+        FrontierProtocol protocol = FrontierProtocol::LEGACY;
+        FrontierMessage message;
+        Clock::time_point received;
+        uint64_t commit = 0;
+    };
+
+    Server& server;
+    Handler handler;
+    SpscQueue<std::unique_ptr<Request>> requests;
+    SpscQueue<Response> responses;
+    std::atomic<bool> stopping{false};
+    std::thread receiver;
+    std::thread sender;
+    Clock::time_point handling;  // core thread only
+
+    std::function<void(const Message&, const std::exception&)> decodeError;
+    std::function<uint64_t()> commitMark;
+    std::function<void(uint64_t)> commitWait;
+    size_t reportEvery = 0;
+    std::function<void(const LatencyHistogram&)> report;
+    LatencyHistogram latency;  // sender thread only
+
+    void receiveLoop() {
+        while (!stopping.load()) {
+            auto messages = server.GetMessagesBlocking();
+            Clock::time_point now = Clock::now();
+            for (auto& m : messages) {
+                auto request = std::make_unique<Request>();
+                request->message = std::move(m);
+                request->received = now;
+                try {
+                    FrontierInterface::DecodeView(request->message.msg,
+                                                  request->view);
+                } catch (const std::runtime_error& e) {
+                    if (decodeError)
+                        decodeError(request->message, e);
+                    continue;
+                }
+                request->protocol =
+                    FrontierInterface::ProtocolOf(request->message.msg);
+                if (!requests.push(std::move(request)))
+                    return;
+            }
+        }
+    }
+
+    void sendLoop() {
+        Response response;
+        while (responses.pop(response)) {
+            Message msg;
+            msg.receiverSock = response.sock;
+            try {
+                msg.msg = FrontierInterface::Encode(response.message,
+                                                    response.protocol);
+            } catch (const std::runtime_error& e) {
+                msg.msg = "";
+            }
+            if (commitWait)
+                commitWait(response.commit);
+            server.SendMessage(msg);
+
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - response.received);
+            latency.record(micros.count());
+            if (report && latency.count() >= reportEvery) {
+                report(latency);
+                latency.reset();
+            }
+        }
+    }
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lets a thread sleep until a condition published through atomics holds,
+// without a syscall on the notify side unless someone is asleep. The
+// waiter spins briefly first, which is enough while the pipeline is busy.
+class Event {
+   public:
+    void notify() {
+        // Orders the caller's store before reading waiters; pairs with the
+        // fence in wait().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_all();
+        }
+    }
+
+    template <typename Ready>
+    void wait(Ready ready) {
+        if (spin(ready))
+            return;
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, ready);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Like wait(), but gives up after timeout. Returns ready().
+    template <typename Ready, typename Rep, typename Period>
+    bool waitFor(Ready ready, std::chrono::duration<Rep, Period> timeout) {
+        if (spin(ready))
+            return true;
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ok;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ok = cv.wait_for(lock, timeout, ready);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return ok;
+    }
+
+   private:
+    static constexpr int kSpins = 64;
+
+    template <typename Ready>
+    static bool spin(Ready& ready) {
+        for (int i = 0; i < kSpins; ++i) {
+            if (ready())
+                return true;
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<int> waiters{0};
+};
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. push() and pop() block on an Event when the queue is
+// full or empty; close() wakes both sides up for shutdown.
+template <typename T>
+class SpscQueue {
+   public:
+    explicit SpscQueue(size_t capacity)
+        : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Moves value in and returns true, or leaves it alone if full.
+    bool tryPush(T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache == slots.size()) {
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache == slots.size())
+                return false;
+        }
+        slots[t & mask] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        notEmpty.notify();
+        return true;
+    }
+
+    // Waits for room. Returns false, dropping value, once closed.
+    bool push(T value) {
+        while (closed.load(std::memory_order_acquire) || !tryPush(value)) {
+            if (closed.load(std::memory_order_acquire))
+                return false;
+            notFull.wait([this]() {
+                return tail.load(std::memory_order_relaxed) -
+                               head.load(std::memory_order_acquire) <
+                           slots.size() ||
+                       closed.load(std::memory_order_acquire);
+            });
+        }
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache) {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache)
+                return false;
+        }
+        out = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        notFull.notify();
+        return true;
+    }
+
+    // Waits for an item. Returns false once closed and drained.
+    bool pop(T& out) {
+        while (!tryPop(out)) {
+            if (closed.load(std::memory_order_acquire))
+                return tryPop(out);
+            notEmpty.wait([this]() {
+                return head.load(std::memory_order_relaxed) !=
+                           tail.load(std::memory_order_acquire) ||
+                       closed.load(std::memory_order_acquire);
+            });
+        }
+        return true;
+    }
+
+    // Like pop(), but gives up after timeout. Returns false if nothing
+    // arrived.
+    template <typename Rep, typename Period>
+    bool popFor(T& out, std::chrono::duration<Rep, Period> timeout) {
+        if (tryPop(out))
+            return true;
+        notEmpty.waitFor(
+            [this]() {
+                return head.load(std::memory_order_relaxed) !=
+                           tail.load(std::memory_order_acquire) ||
+                       closed.load(std::memory_order_acquire);
+            },
+            timeout);
+        return tryPop(out);
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+        notEmpty.notify();
+        notFull.notify();
+    }
+
+    // Exact only when called from the producer or consumer thread.
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) -
+               head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+   private:
+    static size_t roundUp(size_t n) {
+        size_t size = 2;
+        while (size < n)
+            size <<= 1;
+        return size;
+    }
+
+    std::vector<T> slots;
+    size_t mask;
+
+    // Consumer side, and the producer side on its own cache line.
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tailCache = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t headCache = 0;
+
+    alignas(64) std::atomic<bool> closed{false};
+    Event notEmpty;
+    Event notFull;
+};
@@ -0,0 +1,72 @@
+#include "Politeness.hpp"
+
+#include <chrono>
+#include <cmath>
+
+Politeness::Politeness(uint32_t delayMs, uint32_t burst)
+    : defaultDelayMs(delayMs),
+      burst(std::max<uint32_t>(burst, 1)) {}
+
+int64_t Politeness::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Politeness::ensure(uint32_t host) {
+    if (!enabled())
+        return;
+    if (host >= state.size())
+        state.resize(host + 1, HostState{0, -1, defaultDelayMs});
+}
+
+void Politeness::setDelay(uint32_t host, uint32_t delayMs) {
+    if (delayMs <= defaultDelayMs && !enabled())
+        return;
+    overridden = true;
+    ensure(host);
+    state[host].delayMs = std::max(delayMs, defaultDelayMs);
+}
+
+// Adds the tokens earned since the last refill. A host seen for the first
+// time starts with a full bucket.
+void Politeness::refill(HostState& s, int64_t nowMs) {
+    if (s.tokens < 0) {
+        s.tokens = burst;
+    } else if (nowMs > s.lastRefillMs) {
+        s.tokens = std::min<double>(
+            burst, s.tokens + double(nowMs - s.lastRefillMs) / s.delayMs);
+    }
+    s.lastRefillMs = std::max(s.lastRefillMs, nowMs);
+}
+
+bool Politeness::tryDispatch(uint32_t host, int64_t nowMs) {
+    // Hosts past the end were never given a delay.
+    if (host >= state.size() || state[host].delayMs == 0)
+        return true;
+    HostState& s = state[host];
+    refill(s, nowMs);
+    if (s.tokens < 1)
+        return false;
+    s.tokens -= 1;
+    return true;
+}
+
+void Politeness::defer(uint32_t host, int64_t nowMs) {
+    if (limits(host))
+        state[host].lastRefillMs = std::max(state[host].lastRefillMs, nowMs);
+}
+
+int64_t Politeness::readyAt(uint32_t host, int64_t nowMs) {
+    if (host >= state.size() || state[host].delayMs == 0)
+        return nowMs;
+    HostState& s = state[host];
+    refill(s, nowMs);
+    if (s.tokens >= 1)
+        return nowMs;
+    return nowMs + static_cast<int64_t>(std::ceil((1 - s.tokens) * s.delayMs));
+}
+
+void Politeness::park(uint32_t host, int64_t atMs) {
+    wheel.add(host, atMs);
+}
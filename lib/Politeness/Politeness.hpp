@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "TimingWheel.hpp"
+
+// Per-host rate limiting. Every host has a token bucket that holds up to
+// `burst` dispatches and refills one token every `delayMs`, so with the
+// default burst of 1 this is a plain minimum delay between dispatches.
+// With a default delay of 0 only hosts given a delay of their own are
+// limited.
+//
+// Hosts are identified by dense ids owned by the caller. Hosts that are in
+// cooldown are parked on a hashed timing wheel and handed back by release()
+// once they are ready, so both dispatching and waking a host are O(1)
+// amortized no matter how many hosts are tracked.
+class Politeness {
+   public:
+    explicit Politeness(uint32_t delayMs = 0, uint32_t burst = 1);
+
+    // False while the default delay is 0 and no host has a delay of its
+    // own; nothing is limited then.
+    bool enabled() const { return defaultDelayMs > 0 || overridden; }
+
+    // Makes room for host ids up to and including `host`.
+    void ensure(uint32_t host);
+
+    // Overrides the delay for one host, e.g. from a robots.txt crawl-delay,
+    // but never below the default delay. 0 goes back to the default.
+    void setDelay(uint32_t host, uint32_t delayMs);
+
+    // Consumes a token for `host` if it has one. Returns false if the host
+    // is in cooldown.
+    bool tryDispatch(uint32_t host, int64_t nowMs);
+
+    // True if `host` has a delay.
+    bool limits(uint32_t host) const {
+        return host < state.size() && state[host].delayMs > 0;
+    }
+
+    // Counts the host's last dispatch as made at nowMs rather than when
+    // its token was taken: nothing is earned for the time in between.
+    void defer(uint32_t host, int64_t nowMs);
+
+    // Earliest time at which `host` can be dispatched to again.
+    int64_t readyAt(uint32_t host, int64_t nowMs);
+
+    // Parks `host` until `atMs`.
+    void park(uint32_t host, int64_t atMs);
+
+    // Calls f(host) for every parked host whose time has come. Hosts f
+    // parks again wait for the next call.
+    template <typename F>
+    void release(int64_t nowMs, F&& f);
+
+    size_t parked() const { return wheel.size(); }
+
+    static int64_t nowMs();
+
+   private:
+    struct HostState {
+        int64_t lastRefillMs = 0;
+        double tokens = -1;  // < 0 until the host is first seen
+        uint32_t delayMs = 0;  // 0: not limited
+    };
+
+    static constexpr size_t kWheelSlots = 1024;
+
+    uint32_t defaultDelayMs;
+    uint32_t burst;
+    bool overridden = false;  // some host has a delay of its own
+    std::vector<HostState> state;
+
+    // Parked hosts, in one-millisecond ticks.
+    TimingWheel<uint32_t> wheel{1, kWheelSlots};
+
+    void refill(HostState& s, int64_t nowMs);
+};
+
+template <typename F>
+void Politeness::release(int64_t nowMs, F&& f) {
+    wheel.advance(nowMs, [&](uint32_t host) { f(host); });
+}
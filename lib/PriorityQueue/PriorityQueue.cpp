@@ -2,126 +2,690 @@
 #include <algorithm>
 #include <utility>
 
+#include "Url.hpp"
+#include "XXHash.hpp"
+
+namespace {
+// Id reserved for hosts without a '.', which always have priority 0.
+constexpr uint32_t kNoTld = 0;
+
+// Priorities TLDs start with; every other TLD starts at 0.
+struct DefaultPriority {
+    const char* tld;
+    int priority;
+};
+constexpr DefaultPriority kDefaultPriorities[] = {
+    {".edu", 5}, {".gov", 4}, {".org", 3}, {".com", 2}, {".net", 1}};
+
+// Whether k entries out of n in a heap are better ordered by heapifying
+// all n, which is linear, than by sifting the k up one by one.
+bool heapifyCheaper(size_t k, size_t n) {
+    size_t depth = 1;
+    while ((size_t{1} << depth) < n)
+        ++depth;
+    return k * depth >= n;
+}
+}  // namespace
+
 // Constructor: reserves capacity and initializes the priority map.
-PriorityQueue::PriorityQueue(size_t reserveCapacity)
-    : maxCapacity(reserveCapacity)  // store the max capacity
+PriorityQueue::PriorityQueue(size_t reserveCapacity, Engine engine)
+    : hostSlots(64),
+      engine(engine),
+      heapShift(engine == Engine::QUAD_HEAP ? 2 : 1),
+      maxCapacity(reserveCapacity)  // store the max capacity
 {
-    data.reserve(reserveCapacity);
-    // Default priorities for known TLDs.
-    priorityMap = {
-        {".edu", 5}, {".gov", 4}, {".org", 3}, {".com", 2}, {".net", 1}};
-}
-
-// Computes the priority of a URL based on its top-level domain.
-int PriorityQueue::computePriority(const std::string& url) {
-    size_t pos = url.rfind('.');
-    if (pos != std::string::npos) {
-        std::string tld = url.substr(pos);
-        if (priorityMap.find(tld) == priorityMap.end()) {
-            // New TLDs start with a default priority of 0.
-            priorityMap[tld] = 0;
+    internTld("");
+    for (const DefaultPriority& d : kDefaultPriorities)
+        tldPriority[internTld(d.tld)] = d.priority;
+}
+
+UrlArena::Ref PriorityQueue::UrlQueue::pop() {
+    UrlArena::Ref url = items[head++];
+    if (head == items.size()) {
+        items.clear();
+        head = 0;
+    } else if (head * 2 >= items.size() && head >= 16) {
+        items.erase(items.begin(), items.begin() + head);
+        head = 0;
+    }
+    return url;
+}
+
+std::string_view PriorityQueue::hostOf(std::string_view url) {
+    return Url::hostOf(url);
+}
+
+// Returns the id of a TLD, registering it with priority 0 if it is new.
+uint32_t PriorityQueue::internTld(const std::string& tld) {
+    auto it = tldIds.find(tld);
+    if (it != tldIds.end())
+        return it->second;
+    uint32_t id = static_cast<uint32_t>(tldPriority.size());
+    tldIds.emplace(tld, id);
+    tldPriority.push_back(0);
+    tldHosts.emplace_back();
+    tldHeapPos.push_back(kNotScheduled);
+    tldKey.push_back(0);
+    return id;
+}
+
+// Returns the id of the url's host, registering it if it is new. This is
+// the only place a url is parsed; the host's TLD is interned once here.
+uint32_t PriorityQueue::internHost(std::string_view url) {
+    std::string_view name = hostOf(url);
+    uint64_t hash = xxhash::hash64(name);
+    size_t slot = findHostSlot(name, hash);
+    if (hostSlots[slot].id != kNoHost)
+        return hostSlots[slot].id;
+
+    std::string_view tldName = Url::tldOf(name);
+    uint32_t tld =
+        tldName.empty() ? kNoTld : internTld(std::string(tldName));
+    uint32_t id = static_cast<uint32_t>(hosts.size());
+    hosts.push_back(Host{std::string(name), tld});
+    politeness.ensure(id);
+
+    // Kept at most half full.
+    if (2 * hosts.size() > hostSlots.size()) {
+        std::vector<HostSlot> old(2 * hostSlots.size());
+        old.swap(hostSlots);
+        size_t mask = hostSlots.size() - 1;
+        for (const HostSlot& s : old) {
+            if (s.id == kNoHost)
+                continue;
+            size_t i = s.hash & mask;
+            while (hostSlots[i].id != kNoHost)
+                i = (i + 1) & mask;
+            hostSlots[i] = s;
         }
-        return priorityMap[tld];
+        slot = findHostSlot(name, hash);
+    }
+    hostSlots[slot] = HostSlot{hash, id};
+    return id;
+}
+
+// Returns name's slot, or the empty slot where it would go.
+size_t PriorityQueue::findHostSlot(std::string_view name,
+                                   uint64_t hash) const {
+    size_t mask = hostSlots.size() - 1;
+    size_t i = hash & mask;
+    while (hostSlots[i].id != kNoHost &&
+           (hostSlots[i].hash != hash || hosts[hostSlots[i].id].name != name))
+        i = (i + 1) & mask;
+    return i;
+}
+
+// Adjusts the priority for a TLD (e.g., after one of its urls is popped).
+// The TLD heap keeps the old priority until the next rekey().
+void PriorityQueue::adjustPriority(uint32_t tld) {
+    if (tld == kNoTld)
+        return;
+    // Only TLDs being served are adjusted, and those are scheduled, so an
+    // up to date key means the TLD is not listed yet.
+    if (tldKey[tld] == tldPriority[tld])
+        changedTlds.push_back(tld);
+    ++tldPriority[tld];
+}
+
+// Returns true if host key 'a' should be served before 'b' of the same
+// TLD: earlier round first, then alphabetically.
+bool PriorityQueue::lessKey(const HostKey& a, const HostKey& b) const {
+    if (a.round != b.round)
+        return a.round < b.round;
+    return hosts[a.id].name < hosts[b.id].name;
+}
+
+// Returns true if the top host of TLD 'a' should be served before the top
+// host of TLD 'b': earlier round first, then higher priority, then
+// alphabetically.
+bool PriorityQueue::compareTld(uint32_t a, uint32_t b) const {
+    const Host& ha = hosts[hostsTop(tldHosts[a])];
+    const Host& hb = hosts[hostsTop(tldHosts[b])];
+    if (ha.nextRound != hb.nextRound)
+        return ha.nextRound < hb.nextRound;
+    if (tldKey[a] != tldKey[b])
+        return tldKey[a] > tldKey[b];
+    return ha.name < hb.name;
+}
+
+void PriorityQueue::rekey() {
+    if (changedTlds.empty())
+        return;
+
+    // Priorities only go up, which only moves a TLD up the heap, so the
+    // few TLDs a batch served are sifted up one by one. Only TLDs are
+    // keyed by priority, so even the full rebuild is linear in the number
+    // of scheduled TLDs no matter how many hosts they hold.
+    if (!heapifyCheaper(changedTlds.size(), tldHeap.size())) {
+        for (uint32_t tld : changedTlds) {
+            if (tldHeapPos[tld] == kNotScheduled ||
+                tldKey[tld] == tldPriority[tld])
+                continue;
+            tldKey[tld] = tldPriority[tld];
+            siftUpTld(tldHeapPos[tld]);
+        }
+        changedTlds.clear();
+        return;
+    }
+    changedTlds.clear();
+    for (uint32_t tld : tldHeap)
+        tldKey[tld] = tldPriority[tld];
+    std::make_heap(
+        tldHeap.begin(), tldHeap.end(),
+        [this](uint32_t a, uint32_t b) { return compareTld(b, a); });
+    for (size_t i = 0; i < tldHeap.size(); ++i)
+        tldHeapPos[tldHeap[i]] = i;
+}
+
+void PriorityQueue::push(std::string_view url) {
+    if (count >= maxCapacity)
+        return;
+
+    uint32_t id = internHost(url);
+    Host& host = hosts[id];
+    bool wasIdle = host.urls.empty();
+    host.urls.push(arena.add(url));
+    ++count;
+
+    if (wasIdle) {
+        ++activeHosts;
+        if (!host.parked)
+            schedule(id);
     }
-    return 0;
 }
 
-// Adjusts the priority for the URL's TLD (e.g., after it is popped).
-void PriorityQueue::adjustPriority(const std::string& url) {
-    size_t pos = url.rfind('.');
-    if (pos != std::string::npos) {
-        std::string tld = url.substr(pos);
-        if (priorityMap.find(tld) == priorityMap.end()) {
-            priorityMap[tld] = 0;
+size_t PriorityQueue::pushN(const std::vector<std::string>& urls) {
+    size_t n =
+        std::min(urls.size(), maxCapacity - std::min(count, maxCapacity));
+    std::vector<uint32_t> woken;
+    // Bulk loads come host by host and links often point to their own
+    // page's host, so each run of urls of one host is looked up once and
+    // its FIFO grown once.
+    for (size_t i = 0, end; i < n; i = end) {
+        std::string_view name = hostOf(urls[i]);
+        for (end = i + 1; end < n && hostOf(urls[end]) == name; ++end) {
+        }
+        uint32_t id = internHost(urls[i]);
+        Host& host = hosts[id];
+        if (host.urls.empty()) {
+            ++activeHosts;
+            if (!host.parked)
+                woken.push_back(id);
         }
-        ++priorityMap[tld];
+        std::vector<UrlArena::Ref>& items = host.urls.items;
+        if (items.capacity() < items.size() + (end - i))
+            items.reserve(std::max(items.size() + (end - i),
+                                   2 * items.capacity()));
+        for (size_t k = i; k < end; ++k)
+            items.push_back(arena.add(urls[k]));
     }
+    count += n;
+    if (!woken.empty())
+        scheduleAll(woken);
+    return n;
 }
 
-// Returns true if URL 'a' has a higher priority than URL 'b'.
-// If priorities are equal, it compares them lexicographically.
-bool PriorityQueue::compareURL(const std::string& a, const std::string& b) {
-    int pa = computePriority(a);
-    int pb = computePriority(b);
-    if (pa == pb)
-        return a < b;
-    return pa > pb;
+// Schedules the woken hosts as schedule() would one by one, but appends
+// each TLD's hosts together and orders them once, and does the same for
+// the TLDs in the TLD heap.
+void PriorityQueue::scheduleAll(std::vector<uint32_t>& woken) {
+    // Stable, so buckets keep the hosts in the order they woke in.
+    std::stable_sort(woken.begin(), woken.end(),
+                     [this](uint32_t a, uint32_t b) {
+                         return hosts[a].tld < hosts[b].tld;
+                     });
+    size_t numTlds = 0;
+    for (size_t i = 0; i < woken.size(); ++i) {
+        if (i == 0 || hosts[woken[i]].tld != hosts[woken[i - 1]].tld)
+            ++numTlds;
+    }
+    bool heapifyTlds = heapifyCheaper(numTlds, tldHeap.size() + numTlds);
+
+    for (size_t i = 0, end; i < woken.size(); i = end) {
+        uint32_t tld = hosts[woken[i]].tld;
+        TldHosts& t = tldHosts[tld];
+        size_t from = t.size;
+        for (end = i; end < woken.size() && hosts[woken[end]].tld == tld;
+             ++end) {
+            Host& host = hosts[woken[end]];
+            host.nextRound = std::max(host.nextRound, round);
+            hostsAppend(t, woken[end]);
+        }
+        hostsBuild(t, from);
+
+        if (tldHeapPos[tld] == kNotScheduled) {
+            tldKey[tld] = tldPriority[tld];
+            tldHeap.push_back(tld);
+            placeTld(tldHeap.size() - 1, tld);
+        }
+        // Adding hosts can only move a TLD up.
+        if (!heapifyTlds)
+            siftUpTld(tldHeapPos[tld]);
+    }
+    scheduledHosts += woken.size();
+
+    if (!heapifyTlds)
+        return;
+    std::make_heap(
+        tldHeap.begin(), tldHeap.end(),
+        [this](uint32_t a, uint32_t b) { return compareTld(b, a); });
+    for (size_t i = 0; i < tldHeap.size(); ++i)
+        tldHeapPos[tldHeap[i]] = i;
 }
 
-void PriorityQueue::push(std::string elm) {
-    data.push_back(std::move(elm));
-    siftUp(data.size() - 1);
+// Adds a host to its TLD's hosts. A host that was idle or parked joins the
+// current round.
+void PriorityQueue::schedule(uint32_t id) {
+    Host& host = hosts[id];
+    host.nextRound = std::max(host.nextRound, round);
 
-    if (data.size() > maxCapacity) {
-        data.pop_back();
+    hostsPush(tldHosts[host.tld], id);
+    ++scheduledHosts;
+
+    if (tldHeapPos[host.tld] == kNotScheduled) {
+        tldKey[host.tld] = tldPriority[host.tld];
+        tldHeap.push_back(host.tld);
+        placeTld(tldHeap.size() - 1, host.tld);
     }
+    // Adding a host can only move its TLD up.
+    siftUpTld(tldHeapPos[host.tld]);
 }
 
-std::string PriorityQueue::pop() {
-    if (data.empty())
-        throw std::runtime_error("PriorityQueue is empty");
+uint32_t PriorityQueue::topHost() const {
+    return hostsTop(tldHosts[tldHeap[0]]);
+}
+
+// Removes the top host from the heaps.
+void PriorityQueue::unscheduleTop() {
+    uint32_t tld = tldHeap[0];
+    TldHosts& t = tldHosts[tld];
+    hostsPopTop(t);
+    --scheduledHosts;
+
+    if (t.size > 0) {
+        siftDownTld(0);
+        return;
+    }
+
+    tldHeapPos[tld] = kNotScheduled;
+    uint32_t last = tldHeap.back();
+    tldHeap.pop_back();
+    if (!tldHeap.empty()) {
+        placeTld(0, last);
+        siftDownTld(0);
+    }
+}
 
-    std::string top = std::move(data[0]);
+// Serves one url from the top host without rekeying. The caller is
+// responsible for calling rekey() first if it should see fresh priorities
+// and for checking that the host is not in cooldown.
+std::string PriorityQueue::takeTop(int64_t nowMs) {
+    uint32_t id = topHost();
+    Host& host = hosts[id];
+    UrlArena::Ref ref = host.urls.pop();
+    std::string url(arena.get(ref));
+    arena.release(ref);
+    --count;
 
     // Adjust the priority of the popped URL.
-    adjustPriority(top);
+    adjustPriority(host.tld);
 
-    data[0] = std::move(data.back());
-    data.pop_back();
+    round = host.nextRound;
+    host.nextRound = round + 1 + host.penalty;
+    bool hold = readAhead && politeness.limits(id);
+    if (readAhead)
+        popped.push_back(id);
+    if (host.urls.empty()) {
+        --activeHosts;
+        unscheduleTop();
+        // Parked, so urls pushed meanwhile do not schedule it.
+        host.parked = host.held = hold;
+        return url;
+    }
 
-    if (!data.empty())
-        siftDown(0);
+    if (hold) {
+        unscheduleTop();
+        host.parked = host.held = true;
+        return url;
+    }
+    if (politeness.enabled()) {
+        int64_t readyAt = politeness.readyAt(id, nowMs);
+        if (readyAt > nowMs) {
+            unscheduleTop();
+            host.parked = true;
+            politeness.park(id, readyAt);
+            return url;
+        }
+    }
+    // The host moved to a later round.
+    hostsRetop(tldHosts[host.tld]);
+    siftDownTld(0);
+    return url;
+}
 
-    return top;
+std::string PriorityQueue::pop() {
+    if (count == 0)
+        throw std::runtime_error("PriorityQueue is empty");
+
+    std::vector<std::string> urls = popN(1);
+    if (urls.empty())
+        throw std::runtime_error("Every queued host is in cooldown");
+    return std::move(urls[0]);
 }
 
 std::vector<std::string> PriorityQueue::popN(size_t N) {
+    return popN(N, politeness.enabled() ? Politeness::nowMs() : 0);
+}
+
+std::vector<std::string> PriorityQueue::popN(size_t N, int64_t nowMs) {
+    // Bring back hosts whose cooldown has passed.
+    politeness.release(nowMs, [this](uint32_t id) {
+        Host& host = hosts[id];
+        host.parked = false;
+        if (!host.urls.empty())
+            schedule(id);
+    });
+
     std::vector<std::string> result;
-    result.reserve(N);
-    for (size_t i = 0; i < N && !data.empty(); ++i)
-        result.push_back(pop());
+    result.reserve(std::min(N, count));
+    rekey();
+    while (result.size() < N && !tldHeap.empty()) {
+        uint32_t id = topHost();
+        if (!politeness.tryDispatch(id, nowMs)) {
+            // A host that went idle right after a dispatch is scheduled
+            // again as soon as new urls arrive, so it can still be cooling
+            // down here; park it instead of serving it.
+            unscheduleTop();
+            hosts[id].parked = true;
+            politeness.park(id, politeness.readyAt(id, nowMs));
+            continue;
+        }
+        result.push_back(takeTop(nowMs));
+    }
+    if (arena.wantsCompaction())
+        compactArena();
     return result;
 }
 
+void PriorityQueue::handedOn(size_t n, int64_t nowMs) {
+    for (; n > 0 && !popped.empty(); --n) {
+        uint32_t id = popped.front();
+        popped.pop_front();
+        Host& host = hosts[id];
+        if (!host.held)
+            continue;
+        host.held = false;
+        politeness.defer(id, nowMs);
+        int64_t readyAt = politeness.readyAt(id, nowMs);
+        if (readyAt > nowMs) {
+            politeness.park(id, readyAt);
+            continue;
+        }
+        host.parked = false;
+        if (!host.urls.empty())
+            schedule(id);
+    }
+}
+
+// Copies every queued url into a fresh arena, host by host, freeing chunks
+// that only a few urls kept alive. This is a full pass over all live urls
+// and every host ever seen, not an incremental one. It runs only once dead
+// bytes outweigh live ones, and bytes die only when urls are popped, so the
+// bytes copied are fewer than the bytes popped since the last compaction.
+void PriorityQueue::compactArena() {
+    UrlArena fresh;
+    for (Host& host : hosts) {
+        for (size_t i = host.urls.head; i < host.urls.items.size(); ++i)
+            host.urls.items[i] = fresh.add(arena.get(host.urls.items[i]));
+    }
+    arena = std::move(fresh);
+}
+
+void PriorityQueue::setPoliteness(uint32_t delayMs, uint32_t burst) {
+    politeness = Politeness(delayMs, burst);
+    for (uint32_t id = 0; id < hosts.size(); ++id)
+        politeness.ensure(id);
+}
+
+void PriorityQueue::setCrawlDelay(std::string_view host, uint32_t delayMs) {
+    // The host is registered, so the delay holds for urls queued later.
+    politeness.setDelay(internHost(host), delayMs);
+}
+
+void PriorityQueue::demote(std::string_view host, uint32_t rounds) {
+    uint32_t id = hostSlots[findHostSlot(host, xxhash::hash64(host))].id;
+    if (id != kNoHost)
+        hosts[id].penalty = rounds;
+}
+
+void PriorityQueue::clear() {
+    for (Host& host : hosts)
+        host.urls = UrlQueue();
+    arena.clear();
+    for (uint32_t tld : tldHeap) {
+        hostsClear(tldHosts[tld]);
+        tldHeapPos[tld] = kNotScheduled;
+    }
+    tldHeap.clear();
+    count = 0;
+    activeHosts = 0;
+    scheduledHosts = 0;
+}
+
 size_t PriorityQueue::size() {
-    return data.size();
+    return count;
+}
+
+size_t PriorityQueue::numHosts() const {
+    return activeHosts;
+}
+
+size_t PriorityQueue::numParkedHosts() const {
+    return activeHosts - scheduledHosts;
+}
+
+uint32_t PriorityQueue::hostsTop(const TldHosts& t) const {
+    if (engine != Engine::BUCKETS)
+        return t.heap[0].id;
+    const Bucket& b = t.buckets[t.base & (t.buckets.size() - 1)];
+    return b.ids[b.head];
+}
+
+void PriorityQueue::hostsPush(TldHosts& t, uint32_t id) {
+    if (engine != Engine::BUCKETS) {
+        t.heap.push_back(HostKey{hosts[id].nextRound, id});
+        siftUpHost(t.heap, t.heap.size() - 1);
+        t.size = t.heap.size();
+        return;
+    }
+    placeInBucket(t, hosts[id].nextRound, id);
+}
+
+void PriorityQueue::hostsPopTop(TldHosts& t) {
+    if (engine != Engine::BUCKETS) {
+        t.heap[0] = t.heap.back();
+        t.heap.pop_back();
+        t.size = t.heap.size();
+        if (!t.heap.empty())
+            siftDownHost(t.heap, 0);
+        return;
+    }
+    size_t mask = t.buckets.size() - 1;
+    Bucket& b = t.buckets[t.base & mask];
+    if (++b.head == b.ids.size()) {
+        b.ids.clear();
+        b.head = 0;
+    }
+    // Rounds only move forward, so the scan is paid for by the rounds
+    // that were served.
+    if (--t.size > 0) {
+        while (t.buckets[t.base & mask].ids.empty())
+            ++t.base;
+    }
+}
+
+void PriorityQueue::hostsRetop(TldHosts& t) {
+    if (engine != Engine::BUCKETS) {
+        t.heap[0].round = hosts[t.heap[0].id].nextRound;
+        siftDownHost(t.heap, 0);
+        return;
+    }
+    uint32_t id = hostsTop(t);
+    hostsPopTop(t);
+    placeInBucket(t, hosts[id].nextRound, id);
+}
+
+void PriorityQueue::hostsAppend(TldHosts& t, uint32_t id) {
+    if (engine != Engine::BUCKETS) {
+        t.heap.push_back(HostKey{hosts[id].nextRound, id});
+        t.size = t.heap.size();
+        return;
+    }
+    placeInBucket(t, hosts[id].nextRound, id);
 }
 
-void PriorityQueue::siftUp(size_t i) {
+// Sifts the appended hosts up, or orders the whole heap bottom-up, which
+// is linear in its size, when they are many. Buckets are in order already.
+void PriorityQueue::hostsBuild(TldHosts& t, size_t from) {
+    size_t n = t.heap.size();
+    if (engine == Engine::BUCKETS || n < 2)
+        return;
+    if (!heapifyCheaper(n - from, n)) {
+        for (size_t i = from; i < n; ++i)
+            siftUpHost(t.heap, i);
+        return;
+    }
+    for (size_t i = ((n - 2) >> heapShift) + 1; i-- > 0;)
+        siftDownHost(t.heap, i);
+}
+
+void PriorityQueue::hostsClear(TldHosts& t) {
+    t.heap.clear();
+    for (Bucket& b : t.buckets) {
+        b.ids.clear();
+        b.head = 0;
+    }
+    t.size = 0;
+}
+
+// Appends a host to the bucket of its round. The ring doubles when the
+// rounds held span more buckets than it has, which penalties and parked
+// hosts can make longer than the usual two.
+void PriorityQueue::placeInBucket(TldHosts& t, uint64_t hostRound,
+                                  uint32_t id) {
+    if (t.size == 0) {
+        t.base = t.last = hostRound;
+        if (t.buckets.empty())
+            t.buckets.resize(4);
+    }
+    uint64_t base = std::min(t.base, hostRound);
+    uint64_t last = std::max(t.last, hostRound);
+    if (last - base >= t.buckets.size()) {
+        size_t size = t.buckets.size();
+        while (last - base >= size)
+            size *= 2;
+        std::vector<Bucket> old(size);
+        old.swap(t.buckets);
+        for (uint64_t r = t.base; r <= t.last && t.size > 0; ++r) {
+            Bucket& from = old[r & (old.size() - 1)];
+            Bucket& to = t.buckets[r & (size - 1)];
+            to.ids.assign(from.ids.begin() + from.head, from.ids.end());
+        }
+    }
+    t.base = base;
+    t.last = last;
+    t.buckets[hostRound & (t.buckets.size() - 1)].ids.push_back(id);
+    ++t.size;
+}
+
+void PriorityQueue::siftUpHost(std::vector<HostKey>& heap, size_t i) {
+    HostKey key = heap[i];
     while (i > 0) {
-        size_t parent = (i - 1) / 2;
-        if (compareURL(data[i], data[parent])) {
-            std::swap(data[i], data[parent]);
-            i = parent;
-        } else {
+        size_t parent = (i - 1) >> heapShift;
+        if (!lessKey(key, heap[parent]))
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = key;
+}
+
+void PriorityQueue::siftDownHost(std::vector<HostKey>& heap, size_t i) {
+    size_t n = heap.size();
+    size_t arity = size_t{1} << heapShift;
+    HostKey key = heap[i];
+    while (true) {
+        size_t first = (i << heapShift) + 1;
+        if (first >= n)
             break;
+        size_t best = first;
+        size_t end = std::min(first + arity, n);
+        for (size_t c = first + 1; c < end; ++c) {
+            if (lessKey(heap[c], heap[best]))
+                best = c;
         }
+        if (!lessKey(heap[best], key))
+            break;
+        heap[i] = heap[best];
+        i = best;
+    }
+    heap[i] = key;
+}
+
+void PriorityQueue::placeTld(size_t i, uint32_t tld) {
+    tldHeap[i] = tld;
+    tldHeapPos[tld] = i;
+}
+
+void PriorityQueue::siftUpTld(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!compareTld(tldHeap[i], tldHeap[parent]))
+            break;
+        uint32_t tld = tldHeap[i];
+        placeTld(i, tldHeap[parent]);
+        placeTld(parent, tld);
+        i = parent;
     }
 }
 
-void PriorityQueue::siftDown(size_t i) {
-    size_t n = data.size();
+void PriorityQueue::siftDownTld(size_t i) {
+    size_t n = tldHeap.size();
     while (true) {
         size_t left = 2 * i + 1;
         size_t right = 2 * i + 2;
         size_t best = i;
 
-        if (left < n && compareURL(data[left], data[best]))
+        if (left < n && compareTld(tldHeap[left], tldHeap[best]))
             best = left;
-        if (right < n && compareURL(data[right], data[best]))
+        if (right < n && compareTld(tldHeap[right], tldHeap[best]))
             best = right;
 
-        if (best != i) {
-            std::swap(data[i], data[best]);
-            i = best;
-        } else {
+        if (best == i)
             break;
-        }
+        uint32_t tld = tldHeap[i];
+        placeTld(i, tldHeap[best]);
+        placeTld(best, tld);
+        i = best;
     }
 }
 
 // New public accessor: returns the current priority for the given TLD.
 int PriorityQueue::getPriorityForTld(const std::string& tld) const {
-    auto it = priorityMap.find(tld);
-    return (it != priorityMap.end()) ? it->second : 0;
+    auto it = tldIds.find(tld);
+    return (it != tldIds.end()) ? tldPriority[it->second] : 0;
+}
+
+int PriorityQueue::defaultPriorityOf(std::string_view url) {
+    std::string_view tld = Url::tldOf(hostOf(url));
+    for (const DefaultPriority& d : kDefaultPriorities) {
+        if (tld == d.tld)
+            return d.priority;
+    }
+    return 0;
+}
+
+int PriorityQueue::priorityOf(const std::string& url) const {
+    std::string_view tld = Url::tldOf(hostOf(url));
+    return tld.empty() ? 0 : getPriorityForTld(std::string(tld));
 }
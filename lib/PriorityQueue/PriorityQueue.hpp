@@ -1,35 +1,260 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "Politeness.hpp"
+#include "UrlArena.hpp"
+
+// Two-level frontier queue. Urls are kept in a FIFO per host, and hosts are
+// scheduled by the round in which they are next eligible, then by their TLD
+// priority, so every host with queued urls gets one url per round before
+// any host gets a second one.
+//
+// Each TLD keeps a heap of its hosts ordered by round, and a small heap
+// over TLDs picks the next host. TLD priority changes therefore only
+// reorder the TLD heap, however many hosts share the TLD. Hosts in
+// politeness cooldown are parked outside the heaps and are never served
+// until they are ready.
+//
+// The bytes of queued urls live in a UrlArena; host FIFOs only hold
+// references into it, so a queued url costs its length plus 12 bytes.
 class PriorityQueue {
    public:
-    explicit PriorityQueue(size_t reserveCapacity = 100);
+    // How each TLD orders its scheduled hosts by round.
+    enum class Engine : uint8_t {
+        // Heaps of (round, host) keys, with ties broken by host name.
+        BINARY_HEAP,
+        QUAD_HEAP,  // half as deep, and a node's children share a line
+        // A FIFO of hosts per round: O(1) to schedule and to serve a
+        // host, but ties go in the order hosts were scheduled in.
+        BUCKETS,
+    };
+
+    explicit PriorityQueue(size_t reserveCapacity = 100,
+                           Engine engine = Engine::BINARY_HEAP);
 
-    void push(std::string elm);
+    // Urls pushed while the queue is full are dropped; callers that must
+    // not lose them check full() first.
+    void push(std::string_view url);
     std::string pop();
 
+    // Pushes as many urls from the front of urls as fit and returns how
+    // many, with the same result as pushing them one by one. Each run of
+    // urls of one host is looked up once, and each heap is restored once
+    // per batch: by sifting its new entries up if they are few next to
+    // the ones already there, or by heapifying in linear time, as when
+    // millions of urls are loaded at startup.
+    size_t pushN(const std::vector<std::string>& urls);
+
+    bool full() const { return count >= maxCapacity; }
+    size_t capacity() const { return maxCapacity; }
+
+    // Pops up to N urls. TLD priority adjustments for the whole batch are
+    // applied once the batch has been taken. May return fewer than N urls
+    // if the remaining hosts are in cooldown.
     std::vector<std::string> popN(size_t N);
+    std::vector<std::string> popN(size_t N, int64_t nowMs);
+
+    // For callers that pop urls ahead of time and hand them on later. With
+    // read-ahead on, a host with a delay is held back after each url
+    // popN() takes from it until handedOn() reports that url handed on,
+    // and its delay runs from then. Urls popped ahead therefore never pile
+    // up for one host. handedOn(n) reports the next n urls popped, in the
+    // order they were popped.
+    void setReadAhead(bool on) { readAhead = on; }
+    void handedOn(size_t n, int64_t nowMs);
+
+    // Enables per-host rate limiting: at most `burst` urls back to back per
+    // host, then one every `delayMs`. A delay of 0 disables it.
+    void setPoliteness(uint32_t delayMs, uint32_t burst = 1);
+
+    // Overrides the delay for a single host, such as its robots.txt
+    // Crawl-delay, even if setPoliteness() left rate limiting off. Never
+    // below the default delay; 0 goes back to it.
+    void setCrawlDelay(std::string_view host, uint32_t delayMs);
+
+    // Serves host only every rounds + 1 rounds from its next url on, so a
+    // host whose fetches keep failing gets fewer of them. 0 restores it.
+    // Does nothing for a host that has never had urls.
+    void demote(std::string_view host, uint32_t rounds);
 
     int getPriorityForTld(const std::string& tld) const;
 
+    // Current priority of the url's TLD.
+    int priorityOf(const std::string& url) const;
+
+    // Priority the url's TLD starts with, before any pop raised it. Fixed
+    // and one of a handful of values, so it can bucket urls kept outside
+    // the queue.
+    static int defaultPriorityOf(std::string_view url);
+
+    // Applies TLD priority changes made since the last rekey to the TLD
+    // heap. Called lazily before the next pop, so a batch of pops pays
+    // for its TLDs' changes once; callers only need it to force the work
+    // early.
+    void rekey();
+
+    // Drops every queued url. Host and TLD state is kept.
+    void clear();
+
     size_t size();
 
+    // Number of hosts that currently have queued urls.
+    size_t numHosts() const;
+
+    // Number of hosts with queued urls that are waiting out a cooldown.
+    size_t numParkedHosts() const;
+
+    // Calls f(url) for every queued url, host by host in FIFO order. The
+    // string_views are only valid until the queue changes.
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const Host& host : hosts) {
+            for (size_t i = host.urls.head; i < host.urls.items.size(); ++i)
+                f(arena.get(host.urls.items[i]));
+        }
+    }
+
+    // Bytes held for the urls themselves.
+    size_t urlBytes() const { return arena.bytes(); }
+
+    // Returns the host part of a url ("https://a.com:81/x" -> "a.com"), as
+    // Url::hostOf does.
+    static std::string_view hostOf(std::string_view url);
+
    private:
     friend class Frontier;
 
-    std::vector<std::string> data;
-    std::unordered_map<std::string, int> priorityMap;
+    // FIFO of urls in the arena. A vector with a moving head is much
+    // lighter than a std::deque when most hosts only ever hold a handful
+    // of urls.
+    struct UrlQueue {
+        std::vector<UrlArena::Ref> items;
+        size_t head = 0;
+
+        bool empty() const { return head == items.size(); }
+        size_t size() const { return items.size() - head; }
+        void push(UrlArena::Ref url) { items.push_back(url); }
+        UrlArena::Ref pop();
+    };
+
+    struct Host {
+        std::string name;
+        uint32_t tld;
+        uint64_t nextRound = 0;
+        uint32_t penalty = 0;  // rounds skipped after each url, see demote()
+        bool parked = false;
+        bool held = false;  // parked until its popped url is handed on
+        UrlQueue urls;
+    };
+
+    // Every host ever seen, indexed by id. A host is in its TLD's heap
+    // exactly when its queue is non-empty and it is not parked.
+    std::vector<Host> hosts;
+
+    // Host name -> id, by open addressing on the name's XXH64 hash. A
+    // lookup touches one slot and, on a hash match, the host itself; a
+    // node-based map misses the cache several times per url once there are
+    // hundreds of thousands of hosts.
+    static constexpr uint32_t kNoHost = static_cast<uint32_t>(-1);
+    struct HostSlot {
+        uint64_t hash = 0;
+        uint32_t id = kNoHost;
+    };
+    std::vector<HostSlot> hostSlots;
+
+    // Round of the most recently served host.
+    uint64_t round = 0;
+    size_t count = 0;
+    size_t activeHosts = 0;
+    size_t scheduledHosts = 0;
+
+    Politeness politeness;
+    UrlArena arena;
+
+    // With read-ahead on, the host of every url popped and not yet handed
+    // on, oldest first.
+    bool readAhead = false;
+    std::deque<uint32_t> popped;
+
+    // Interned TLDs: tldIds maps ".com" -> id, tldPriority[id] is its score.
+    std::unordered_map<std::string, uint32_t> tldIds;
+    std::vector<int> tldPriority;
+
+    // A TLD's scheduled hosts, ordered by the engine. Heap entries keep
+    // the host's round next to its id, so only ties look at the host.
+    // BUCKETS keeps buckets[r & (size - 1)] for every round r from base to
+    // last, so scheduling a host is an append and the next host is at the
+    // head of the base bucket.
+    struct HostKey {
+        uint64_t round;
+        uint32_t id;
+    };
+    struct Bucket {
+        std::vector<uint32_t> ids;
+        size_t head = 0;
+    };
+    struct TldHosts {
+        std::vector<HostKey> heap;
+        std::vector<Bucket> buckets;
+        uint64_t base = 0;
+        uint64_t last = 0;
+        size_t size = 0;
+    };
+    Engine engine;
+    unsigned heapShift;  // log2 of the heap's arity
+
+    // tldHosts[tld] holds the TLD's scheduled hosts. tldHeap orders TLDs
+    // with scheduled hosts by their top host and by tldKey, the priority
+    // as of the last rekey. tldHeapPos[tld] is the TLD's index in tldHeap,
+    // or kNotScheduled.
+    static constexpr size_t kNotScheduled = static_cast<size_t>(-1);
+    std::vector<TldHosts> tldHosts;
+    std::vector<uint32_t> tldHeap;
+    std::vector<size_t> tldHeapPos;
+    std::vector<int> tldKey;
+    // TLDs whose priority changed since the last rekey. A scheduled TLD
+    // whose tldKey lags its priority is always listed.
+    std::vector<uint32_t> changedTlds;
 
     // Add this private member:
     size_t maxCapacity;
 
-    int computePriority(const std::string& url);
-    void adjustPriority(const std::string& url);
-    bool compareURL(const std::string& a, const std::string& b);
-    void siftUp(size_t i);
-    void siftDown(size_t i);
+    uint32_t internTld(const std::string& tld);
+    uint32_t internHost(std::string_view url);
+    size_t findHostSlot(std::string_view name, uint64_t hash) const;
+    void adjustPriority(uint32_t tld);
+    std::string takeTop(int64_t nowMs);
+    uint32_t topHost() const;
+    void schedule(uint32_t id);
+    void scheduleAll(std::vector<uint32_t>& woken);
+    void unscheduleTop();
+    bool compareTld(uint32_t a, uint32_t b) const;
+
+    // The engine's operations on a TLD's hosts. A host's round is read
+    // from its nextRound when it is added.
+    uint32_t hostsTop(const TldHosts& t) const;
+    void hostsPush(TldHosts& t, uint32_t id);
+    void hostsPopTop(TldHosts& t);
+    // The top host's nextRound went up.
+    void hostsRetop(TldHosts& t);
+    // Adds a host without ordering it; hostsBuild() orders the hosts
+    // appended since t held `from` of them.
+    void hostsAppend(TldHosts& t, uint32_t id);
+    void hostsBuild(TldHosts& t, size_t from);
+    void hostsClear(TldHosts& t);
+    bool lessKey(const HostKey& a, const HostKey& b) const;
+    void siftUpHost(std::vector<HostKey>& heap, size_t i);
+    void siftDownHost(std::vector<HostKey>& heap, size_t i);
+    void placeInBucket(TldHosts& t, uint64_t round, uint32_t id);
+    void siftUpTld(size_t i);
+    void siftDownTld(size_t i);
+    void placeTld(size_t i, uint32_t tld);
+    void compactArena();
 };
@@ -0,0 +1,80 @@
+#include "UrlArena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Returns an empty chunk of at least size bytes.
+uint32_t UrlArena::newChunk(size_t size) {
+    if (size <= kChunkSize && !spare.empty()) {
+        uint32_t i = spare.back();
+        spare.pop_back();
+        return i;
+    }
+    uint32_t i;
+    if (vacant.empty()) {
+        i = static_cast<uint32_t>(chunks.size());
+        chunks.emplace_back();
+    } else {
+        i = vacant.back();
+        vacant.pop_back();
+    }
+    size = std::max(size, kChunkSize);
+    chunks[i].data.reset(new char[size]);
+    chunks[i].size = static_cast<uint32_t>(size);
+    allocated += size;
+    return i;
+}
+
+UrlArena::Ref UrlArena::add(std::string_view url) {
+    // A url longer than a chunk gets a chunk of its own and leaves the
+    // current one open.
+    if (url.size() > kChunkSize) {
+        uint32_t i = newChunk(url.size());
+        std::memcpy(chunks[i].data.get(), url.data(), url.size());
+        chunks[i].used = chunks[i].live = static_cast<uint32_t>(url.size());
+        live += url.size();
+        return Ref{i, 0, static_cast<uint32_t>(url.size())};
+    }
+    if (current == kNoChunk ||
+        chunks[current].size - chunks[current].used < url.size()) {
+        uint32_t old = current;
+        current = newChunk(url.size());
+        // Every url of the old chunk may be gone already.
+        if (old != kNoChunk)
+            release(Ref{old, 0, 0});
+    }
+    Chunk& chunk = chunks[current];
+    Ref ref{current, chunk.used, static_cast<uint32_t>(url.size())};
+    std::memcpy(chunk.data.get() + chunk.used, url.data(), url.size());
+    chunk.used += ref.length;
+    chunk.live += ref.length;
+    live += ref.length;
+    return ref;
+}
+
+void UrlArena::release(Ref ref) {
+    Chunk& chunk = chunks[ref.chunk];
+    chunk.live -= ref.length;
+    live -= ref.length;
+    // The current chunk stays open for appends.
+    if (chunk.live > 0 || ref.chunk == current)
+        return;
+    chunk.used = 0;
+    if (chunk.size == kChunkSize && spare.size() < kMaxSpare) {
+        spare.push_back(ref.chunk);
+        return;
+    }
+    allocated -= chunk.size;
+    chunk.data.reset();
+    chunk.size = 0;
+    vacant.push_back(ref.chunk);
+}
+
+void UrlArena::clear() {
+    chunks.clear();
+    spare.clear();
+    vacant.clear();
+    current = kNoChunk;
+    live = 0;
+    allocated = 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Storage for the bytes of queued urls. Urls are appended to large chunks
+// and referred to by a 12-byte Ref, so queueing a url costs its length and
+// no heap allocation of its own, and host queues hold plain PODs.
+//
+// Bytes are reclaimed a chunk at a time: a chunk whose urls have all been
+// released is reused. Chunks that keep a few urls alive hold on to the
+// rest of their bytes, so once more than half of the arena is dead the
+// owner should copy the live urls into a fresh arena (see wantsCompaction).
+class UrlArena {
+   public:
+    struct Ref {
+        uint32_t chunk;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    Ref add(std::string_view url);
+    std::string_view get(Ref ref) const {
+        return std::string_view(chunks[ref.chunk].data.get() + ref.offset,
+                                ref.length);
+    }
+    // Marks ref's bytes dead. ref must not be used again.
+    void release(Ref ref);
+
+    // Bytes of the urls not released yet, and of the chunks holding them.
+    size_t liveBytes() const { return live; }
+    size_t bytes() const { return allocated; }
+
+    // Whether most of the bytes in chunks still holding urls are dead.
+    bool wantsCompaction() const {
+        size_t inUse = allocated - spare.size() * kChunkSize;
+        return inUse > 4 * kChunkSize && inUse - live > live;
+    }
+
+    void clear();
+
+   private:
+    static constexpr size_t kChunkSize = 1 << 18;
+    static constexpr uint32_t kNoChunk = static_cast<uint32_t>(-1);
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        uint32_t size = 0;
+        uint32_t used = 0;
+        uint32_t live = 0;  // bytes not released
+    };
+
+    // Emptied chunks kept for reuse, with their memory; past kMaxSpare
+    // their memory is freed and their index left vacant.
+    static constexpr size_t kMaxSpare = 4;
+
+    std::vector<Chunk> chunks;
+    std::vector<uint32_t> spare;
+    std::vector<uint32_t> vacant;
+    uint32_t current = kNoChunk;
+    size_t live = 0;
+    size_t allocated = 0;
+
+    uint32_t newChunk(size_t size);
+};
@@ -0,0 +1,164 @@
+#include "RetryQueue.hpp"
+
+#include <algorithm>
+
+#include "Url.hpp"
+#include "XXHash.hpp"
+
+namespace {
+
+// Returns the slot holding fingerprint key, or the empty slot where it
+// would go.
+size_t findAttempts(const std::vector<uint64_t>& table, uint64_t key,
+                    uint64_t countMask) {
+    size_t mask = table.size() - 1;
+    size_t i = (key >> 4) & mask;
+    while (table[i] != 0 && (table[i] & ~countMask) != key)
+        i = (i + 1) & mask;
+    return i;
+}
+
+}  // namespace
+
+RetryQueue::RetryQueue(const Options& options)
+    : options(options), hosts(64) {
+    // Counts saturate at kCountMask.
+    this->options.maxAttempts = std::min<uint32_t>(
+        std::max<uint32_t>(options.maxAttempts, 1), kCountMask);
+    attempts[0].assign(64, 0);
+    attempts[1].assign(64, 0);
+}
+
+// Counts a failure of url and returns its failures so far. The count is
+// taken from the older generation if the current one doesn't have it.
+uint32_t RetryQueue::countAttempt(std::string_view url) {
+    uint64_t key = xxhash::hash64(url) & ~kCountMask;
+    if (key == 0)
+        key = kCountMask + 1;
+    std::vector<uint64_t>& table = attempts[current];
+    size_t slot = findAttempts(table, key, kCountMask);
+    uint64_t count = table[slot] & kCountMask;
+    if (table[slot] == 0) {
+        const std::vector<uint64_t>& older = attempts[current ^ 1];
+        count = older[findAttempts(older, key, kCountMask)] & kCountMask;
+    }
+    count = std::min(count + 1, kCountMask);
+    if (table[slot] != 0) {
+        table[slot] = key | count;
+        return static_cast<uint32_t>(count);
+    }
+
+    table[slot] = key | count;
+    // Kept at most half full.
+    if (2 * ++tracked[current] > table.size()) {
+        std::vector<uint64_t> old(2 * table.size(), 0);
+        old.swap(table);
+        for (uint64_t s : old) {
+            if (s != 0)
+                table[findAttempts(table, s & ~kCountMask, kCountMask)] = s;
+        }
+    }
+    if (tracked[current] >= options.maxTracked) {
+        current ^= 1;
+        attempts[current].assign(64, 0);
+        tracked[current] = 0;
+    }
+    return static_cast<uint32_t>(count);
+}
+
+RetryQueue::Host& RetryQueue::findHost(std::string_view host) {
+    uint64_t hash = xxhash::hash64(host);
+    size_t mask = hosts.size() - 1;
+    size_t i = hash & mask;
+    while (hosts[i].used && hosts[i].hash != hash)
+        i = (i + 1) & mask;
+    if (hosts[i].used)
+        return hosts[i];
+
+    hosts[i].used = true;
+    hosts[i].hash = hash;
+    // Kept at most half full.
+    if (2 * ++numHosts > hosts.size()) {
+        std::vector<Host> old(2 * hosts.size());
+        old.swap(hosts);
+        mask = hosts.size() - 1;
+        for (const Host& h : old) {
+            if (!h.used)
+                continue;
+            size_t j = h.hash & mask;
+            while (hosts[j].used)
+                j = (j + 1) & mask;
+            hosts[j] = h;
+            if (h.hash == hash)
+                i = j;
+        }
+    }
+    return hosts[i];
+}
+
+uint32_t RetryQueue::penaltyFor(uint32_t streak) const {
+    if (options.demoteAfter == 0 || streak < options.demoteAfter)
+        return 0;
+    uint32_t level = std::min<uint32_t>(streak / options.demoteAfter, 31);
+    return std::min(options.maxPenalty, (1u << level) - 1);
+}
+
+void RetryQueue::delay(std::string key, int64_t atMs, bool host) {
+    wheel.add(Delayed{std::move(key), host}, atMs);
+}
+
+bool RetryQueue::fail(std::string_view url, int64_t nowMs) {
+    ++failed;
+    uint32_t count = countAttempt(url);
+
+    std::string_view name = Url::hostOf(url);
+    Host& host = findHost(name);
+    if (nowMs - host.lastFailMs > options.maxDelayMs)
+        host.streak = 0;
+    ++host.streak;
+    host.lastFailMs = nowMs;
+    uint32_t penalty = penaltyFor(host.streak);
+    if (penalty != host.penalty) {
+        // A streak that started over restores the host right away.
+        if (penalty == 0) {
+            --demoted;
+        } else if (host.penalty == 0) {
+            ++demoted;
+            delay(std::string(name), nowMs + options.maxDelayMs, true);
+        }
+        host.penalty = penalty;
+        demotions.emplace_back(name, penalty);
+    }
+
+    if (count >= options.maxAttempts) {
+        ++dropped;
+        return false;
+    }
+    uint32_t doublings = std::min<uint32_t>(std::max(count, host.streak), 32);
+    uint64_t delayMs = std::min<uint64_t>(
+        uint64_t{options.baseDelayMs} << (doublings - 1), options.maxDelayMs);
+    delay(std::string(url), nowMs + static_cast<int64_t>(delayMs), false);
+    ++numPending;
+    return true;
+}
+
+bool RetryQueue::restore(std::string_view name, int64_t nowMs) {
+    Host& host = findHost(name);
+    int64_t quietAt = host.lastFailMs + options.maxDelayMs;
+    if (host.penalty == 0)
+        return false;
+    if (quietAt > nowMs) {
+        delay(std::string(name), quietAt, true);
+        return false;
+    }
+    host.penalty = 0;
+    host.streak = 0;
+    --demoted;
+    return true;
+}
+
+size_t RetryQueue::bytes() const {
+    return (attempts[0].capacity() + attempts[1].capacity()) *
+               sizeof(uint64_t) +
+           hosts.capacity() * sizeof(Host);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "TimingWheel.hpp"
+
+// Urls whose fetch failed, held back and handed out again with
+// exponential backoff until they run out of attempts, and the hosts whose
+// fetches keep failing, which the caller demotes in its queue.
+//
+// Attempts are counted per url by its XXH64 fingerprint, 8 bytes each with
+// the count in the low bits, in two generations of open-addressing tables:
+// once the current one holds Options::maxTracked urls the older one is
+// dropped, so urls that stopped failing are forgotten without ever being
+// reported as fetched. Hosts are kept by hash with their run of failures.
+// A url waits baseDelayMs doubled for every earlier failure of the url or
+// of its host in a row, whichever is more, on a hashed timing wheel of
+// one-second ticks.
+//
+// Single-threaded.
+class RetryQueue {
+   public:
+    struct Options {
+        // Fetches per url, counting the first; at most 15.
+        uint32_t maxAttempts = 3;
+        uint32_t baseDelayMs = 30000;
+        uint32_t maxDelayMs = 3600000;
+        // Failures in a row after which a host's urls are served only
+        // every 2 rounds, then every 4, 8, ... after as many failures more,
+        // skipping at most maxPenalty rounds. A host is restored once it
+        // has gone maxDelayMs without a failure. 0 never demotes.
+        uint32_t demoteAfter = 5;
+        uint32_t maxPenalty = 63;
+        size_t maxTracked = 1 << 20;  // urls per generation
+    };
+
+    explicit RetryQueue(const Options& options);
+    RetryQueue() : RetryQueue(Options()) {}
+
+    // Records a failed fetch of url. Returns false if url has used up its
+    // attempts and is dropped.
+    bool fail(std::string_view url, int64_t nowMs);
+
+    // Calls demote(host, rounds) for every host whose penalty changed
+    // since the last call, 0 meaning restored, then retry(url) for every
+    // url whose backoff has passed.
+    template <typename Retry, typename Demote>
+    void release(int64_t nowMs, Retry&& retry, Demote&& demote);
+
+    size_t pending() const { return numPending; }
+    size_t numDemoted() const { return demoted; }
+    uint64_t failures() const { return failed; }
+    uint64_t retries() const { return retried; }
+    uint64_t givenUp() const { return dropped; }
+
+    // Bytes held by the attempt counts and the host table.
+    size_t bytes() const;
+
+   private:
+    static constexpr int64_t kTickMs = 1000;
+    static constexpr size_t kWheelSlots = 4096;
+    // Low bits of an attempts slot; the rest is the fingerprint.
+    static constexpr uint64_t kCountMask = 0xF;
+
+    struct Host {
+        uint64_t hash = 0;
+        int64_t lastFailMs = 0;
+        uint32_t streak = 0;   // failures with no gap over maxDelayMs
+        uint32_t penalty = 0;  // rounds, as last reported
+        bool used = false;
+    };
+
+    // A url due for a retry, or a demoted host due for a look at whether
+    // it can be restored.
+    struct Delayed {
+        std::string key;
+        bool host;
+    };
+
+    Options options;
+    std::vector<uint64_t> attempts[2];  // [current], older generation
+    size_t tracked[2] = {0, 0};
+    size_t current = 0;
+    std::vector<Host> hosts;
+    size_t numHosts = 0;
+    // Penalty changes not reported by release() yet.
+    std::vector<std::pair<std::string, uint32_t>> demotions;
+
+    TimingWheel<Delayed> wheel{kTickMs, kWheelSlots};
+    size_t numPending = 0;
+
+    size_t demoted = 0;
+    uint64_t failed = 0;
+    uint64_t retried = 0;
+    uint64_t dropped = 0;
+
+    uint32_t countAttempt(std::string_view url);
+    Host& findHost(std::string_view host);
+    uint32_t penaltyFor(uint32_t streak) const;
+    void delay(std::string key, int64_t atMs, bool host);
+    // Decides whether a host due for a look is restored or looked at
+    // again later; returns true if it is restored.
+    bool restore(std::string_view host, int64_t nowMs);
+};
+
+template <typename Retry, typename Demote>
+void RetryQueue::release(int64_t nowMs, Retry&& retry, Demote&& demote) {
+    for (const auto& [host, rounds] : demotions)
+        demote(std::string_view(host), rounds);
+    demotions.clear();
+
+    wheel.advance(nowMs, [&](Delayed& d) {
+        if (!d.host) {
+            --numPending;
+            ++retried;
+            retry(std::string_view(d.key));
+        } else if (restore(d.key, nowMs)) {
+            demote(std::string_view(d.key), 0u);
+        }
+    });
+}
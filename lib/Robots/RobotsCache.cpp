@@ -0,0 +1,394 @@
+#include "RobotsCache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include "Url.hpp"
+#include "XXHash.hpp"
+
+namespace {
+
+using Access = RobotsCache::Access;
+
+// Longer paths don't fit a node's label; no real robots.txt has them.
+constexpr size_t kMaxPath = 0xFFFF;
+
+// Longer crawl delays would all but stop a host; they are cut to this.
+constexpr double kMaxCrawlDelayMs = 60000;
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+// Urls are checked in canonical form, with their host in lowercase.
+std::string lowercase(std::string_view s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    return out;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) ==
+                      std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+// Matches a robots.txt pattern against the start of path: '*' matches any
+// run of bytes and a final '$' makes the pattern match all of path.
+bool matchWildcard(std::string_view pattern, std::string_view path) {
+    bool anchored = !pattern.empty() && pattern.back() == '$';
+    if (anchored)
+        pattern.remove_suffix(1);
+    size_t p = 0, s = 0;
+    size_t star = std::string_view::npos, mark = 0;
+    while (s < path.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            mark = s;
+        } else if (p < pattern.size() && pattern[p] == path[s]) {
+            ++p;
+            ++s;
+        } else if (p == pattern.size() && !anchored) {
+            return true;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            s = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        ++p;
+    return p == pattern.size();
+}
+
+struct Plain {
+    std::string_view path;
+    Access access;
+};
+
+// Lays out the subtree for plain[lo, hi), which share their first depth
+// bytes, under nodes[node]. Children are allocated side by side before
+// any of them is filled in.
+template <typename Builder>
+void build(Builder& out, const std::vector<Plain>& plain, size_t lo, size_t hi,
+           size_t depth, size_t node) {
+    if (lo < hi && plain[lo].path.size() == depth)
+        out.nodes[node].access = plain[lo++].access;
+
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t i = lo; i < hi;) {
+        size_t j = i + 1;
+        while (j < hi && plain[j].path[depth] == plain[i].path[depth])
+            ++j;
+        groups.emplace_back(i, j);
+        i = j;
+    }
+    if (groups.empty())
+        return;
+    size_t first = out.nodes.size();
+    out.nodes.resize(first + groups.size());
+    out.nodes[node].child = static_cast<uint32_t>(first);
+    out.nodes[node].numChildren = static_cast<uint16_t>(groups.size());
+    for (size_t k = 0; k < groups.size(); ++k) {
+        auto [a, b] = groups[k];
+        // Sorted, so the first and last paths share the least.
+        std::string_view x = plain[a].path, y = plain[b - 1].path;
+        size_t common = depth + 1;
+        while (common < x.size() && common < y.size() &&
+               x[common] == y[common])
+            ++common;
+        auto& child = out.nodes[first + k];
+        child.label = static_cast<uint32_t>(out.labels.size());
+        child.labelLength = static_cast<uint16_t>(common - depth);
+        out.labels.append(x.substr(depth, common - depth));
+        build(out, plain, a, b, common, first + k);
+    }
+}
+
+}  // namespace
+
+RobotsCache::RobotsCache(size_t maxBytes)
+    : maxBytes(maxBytes), slots(64, kNone) {}
+
+RobotsCache::Rules RobotsCache::compile(const std::vector<Rule>& rules) {
+    struct {
+        std::vector<Node> nodes;
+        std::string labels;
+    } out;
+    std::vector<Wildcard> wildcards;
+    std::vector<Plain> plain;
+    for (const Rule& rule : rules) {
+        // An empty Disallow allows everything, an empty Allow does nothing.
+        if (rule.path.empty() || rule.path.size() > kMaxPath)
+            continue;
+        if (rule.path.find_first_of("*$") != std::string::npos) {
+            wildcards.push_back({static_cast<uint32_t>(out.labels.size()),
+                                 static_cast<uint16_t>(rule.path.size()),
+                                 rule.allow});
+            out.labels += rule.path;
+        } else {
+            plain.push_back(
+                {rule.path, rule.allow ? Access::ALLOWED : Access::DISALLOWED});
+        }
+    }
+    // Allow sorts first among equal paths and wins the tie.
+    std::sort(plain.begin(), plain.end(), [](const Plain& a, const Plain& b) {
+        return a.path != b.path ? a.path < b.path : a.access < b.access;
+    });
+    plain.erase(std::unique(plain.begin(), plain.end(),
+                            [](const Plain& a, const Plain& b) {
+                                return a.path == b.path;
+                            }),
+                plain.end());
+    if (!plain.empty()) {
+        out.nodes.emplace_back();
+        build(out, plain, 0, plain.size(), 0, 0);
+    }
+    if (out.nodes.empty() && wildcards.empty())
+        return Rules();
+
+    Header header{static_cast<uint32_t>(out.nodes.size()),
+                  static_cast<uint32_t>(wildcards.size())};
+    Rules packed;
+    packed.size = sizeof(Header) + out.nodes.size() * sizeof(Node) +
+                  wildcards.size() * sizeof(Wildcard) + out.labels.size();
+    packed.data.reset(new char[packed.size]);
+    char* p = packed.data.get();
+    p = reinterpret_cast<char*>(new (p) Header(header) + 1);
+    p = reinterpret_cast<char*>(std::uninitialized_copy(
+        out.nodes.begin(), out.nodes.end(), reinterpret_cast<Node*>(p)));
+    p = reinterpret_cast<char*>(
+        std::uninitialized_copy(wildcards.begin(), wildcards.end(),
+                                reinterpret_cast<Wildcard*>(p)));
+    std::copy(out.labels.begin(), out.labels.end(), p);
+    return packed;
+}
+
+// Bytes held for an entry, counting the two index slots it keeps at half
+// load.
+size_t RobotsCache::entryBytes(const Entry& entry) {
+    return sizeof(Entry) + 2 * sizeof(uint32_t) + entry.rules.size;
+}
+
+Access RobotsCache::Rules::check(std::string_view path) const {
+    if (!data)
+        return Access::UNKNOWN;
+    const Header* header = reinterpret_cast<const Header*>(data.get());
+    const Node* nodes = reinterpret_cast<const Node*>(header + 1);
+    const Wildcard* wildcards =
+        reinterpret_cast<const Wildcard*>(nodes + header->numNodes);
+    const char* labels =
+        reinterpret_cast<const char*>(wildcards + header->numWildcards);
+
+    Access best = Access::UNKNOWN;
+    size_t bestLength = 0;
+    if (header->numNodes > 0) {
+        // The deepest rule on the way down is the longest match.
+        uint32_t n = 0;
+        size_t pos = 0;
+        while (true) {
+            const Node& node = nodes[n];
+            if (node.access != Access::UNKNOWN) {
+                best = node.access;
+                bestLength = pos;
+            }
+            if (pos == path.size())
+                break;
+            uint32_t next = kNone;
+            for (uint32_t c = node.child; c < node.child + node.numChildren;
+                 ++c) {
+                if (labels[nodes[c].label] == path[pos]) {
+                    next = c;
+                    break;
+                }
+            }
+            if (next == kNone ||
+                path.substr(pos, nodes[next].labelLength) !=
+                    std::string_view(labels + nodes[next].label,
+                                     nodes[next].labelLength))
+                break;
+            pos += nodes[next].labelLength;
+            n = next;
+        }
+    }
+    for (uint32_t w = 0; w < header->numWildcards; ++w) {
+        const Wildcard& rule = wildcards[w];
+        if (!matchWildcard(
+                std::string_view(labels + rule.pattern, rule.length), path))
+            continue;
+        if (best == Access::UNKNOWN || rule.length > bestLength ||
+            (rule.length == bestLength && rule.allow)) {
+            best = rule.allow ? Access::ALLOWED : Access::DISALLOWED;
+            bestLength = rule.length;
+        }
+    }
+    return best;
+}
+
+void RobotsCache::set(std::string_view host, const std::vector<Rule>& rules) {
+    uint64_t hash = xxhash::hash64(lowercase(host));
+    size_t slot = findSlot(hash);
+    uint32_t i = slots[slot];
+    if (i != kNone) {
+        used -= entryBytes(entries[i]);
+        unlink(i);
+    } else {
+        if (freeEntries.empty()) {
+            i = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+        } else {
+            i = freeEntries.back();
+            freeEntries.pop_back();
+        }
+        entries[i].hash = hash;
+        slots[slot] = i;
+        if (2 * ++hosts > slots.size())
+            growSlots();
+    }
+    entries[i].rules = compile(rules);
+    used += entryBytes(entries[i]);
+    pushFront(i);
+    // The host just set stays even if it alone is over the bound.
+    while (used > maxBytes && tail != i)
+        evictOne();
+}
+
+Access RobotsCache::check(std::string_view url) {
+    if (hosts == 0)
+        return Access::UNKNOWN;
+    std::string_view host = Url::hostOf(url);
+    uint32_t i = slots[findSlot(xxhash::hash64(host))];
+    if (i == kNone)
+        return Access::UNKNOWN;
+    if (i != head) {
+        unlink(i);
+        pushFront(i);
+    }
+
+    size_t start = url.find('/', host.data() + host.size() - url.data());
+    std::string_view path =
+        start == std::string_view::npos ? "/" : url.substr(start);
+    path = path.substr(0, path.find('#'));
+    Access access = entries[i].rules.check(path);
+    return access == Access::UNKNOWN ? Access::ALLOWED : access;
+}
+
+size_t RobotsCache::load(const std::vector<std::string_view>& lines,
+                         const CrawlDelayFn& crawlDelay) {
+    size_t loaded = 0;
+    std::string host;
+    std::vector<Rule> rules;
+    auto finish = [&]() {
+        if (!host.empty()) {
+            set(host, rules);
+            ++loaded;
+        }
+        rules.clear();
+    };
+    for (std::string_view line : lines) {
+        line = trim(line);
+        if (equalsIgnoreCase(line.substr(0, 7), "http://") ||
+            equalsIgnoreCase(line.substr(0, 8), "https://")) {
+            finish();
+            host = lowercase(Url::hostOf(line));
+            continue;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos)
+            continue;
+        std::string_view key = trim(line.substr(0, colon));
+        std::string value(trim(line.substr(colon + 1)));
+        if (equalsIgnoreCase(key, "allow"))
+            rules.push_back({std::move(value), true});
+        else if (equalsIgnoreCase(key, "disallow"))
+            rules.push_back({std::move(value), false});
+        else if (equalsIgnoreCase(key, "crawl-delay") && crawlDelay &&
+                 !host.empty()) {
+            char* end = nullptr;
+            double seconds = std::strtod(value.c_str(), &end);
+            if (end != value.c_str() && seconds >= 0) {
+                crawlDelay(host, static_cast<uint32_t>(std::min(
+                                     seconds * 1000, kMaxCrawlDelayMs)));
+            }
+        }
+    }
+    finish();
+    return loaded;
+}
+
+size_t RobotsCache::findSlot(uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    while (slots[i] != kNone && entries[slots[i]].hash != hash)
+        i = (i + 1) & mask;
+    return i;
+}
+
+// Empties slot and shifts later entries of its probe run back, so lookups
+// never stop early at the hole.
+void RobotsCache::eraseSlot(size_t slot) {
+    size_t mask = slots.size() - 1;
+    size_t j = slot;
+    while (true) {
+        slots[slot] = kNone;
+        while (true) {
+            j = (j + 1) & mask;
+            if (slots[j] == kNone)
+                return;
+            size_t home = entries[slots[j]].hash & mask;
+            // The entry at j stays if its home lies in (slot, j].
+            bool stays = slot <= j ? (slot < home && home <= j)
+                                   : (slot < home || home <= j);
+            if (!stays)
+                break;
+        }
+        slots[slot] = slots[j];
+        slot = j;
+    }
+}
+
+void RobotsCache::growSlots() {
+    std::vector<uint32_t> old(2 * slots.size(), kNone);
+    old.swap(slots);
+    for (uint32_t i : old) {
+        if (i != kNone)
+            slots[findSlot(entries[i].hash)] = i;
+    }
+}
+
+void RobotsCache::unlink(uint32_t i) {
+    Entry& e = entries[i];
+    (e.prev == kNone ? head : entries[e.prev].next) = e.next;
+    (e.next == kNone ? tail : entries[e.next].prev) = e.prev;
+    e.prev = e.next = kNone;
+}
+
+void RobotsCache::pushFront(uint32_t i) {
+    entries[i].prev = kNone;
+    entries[i].next = head;
+    (head == kNone ? tail : entries[head].prev) = i;
+    head = i;
+}
+
+void RobotsCache::evictOne() {
+    uint32_t i = tail;
+    unlink(i);
+    eraseSlot(findSlot(entries[i].hash));
+    used -= entryBytes(entries[i]);
+    entries[i].rules = Rules();
+    freeEntries.push_back(i);
+    --hosts;
+    ++evicted;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// robots.txt rules per host, as workers report them, bounded in memory by
+// evicting the least recently used hosts.
+//
+// A host's Allow and Disallow rules are compiled into a radix trie of
+// their paths, flattened into one array with each node's children side
+// by side, so checking a url walks its path once and touches a handful of
+// cache lines. As in Google's robots.txt spec, the longest matching rule
+// decides and Allow wins a tie. Rules with '*' or '$' are kept apart and
+// matched one by one; few robots.txt files have more than a couple.
+//
+// Hosts are found by the XXH64 hash of their name alone, in an
+// open-addressing table, and are kept in a doubly-linked LRU list of
+// indices. Single-threaded.
+class RobotsCache {
+   public:
+    enum class Access : uint8_t { UNKNOWN, ALLOWED, DISALLOWED };
+
+    struct Rule {
+        std::string path;
+        bool allow;
+    };
+
+    // maxBytes bounds the rules and the per-host bookkeeping together.
+    explicit RobotsCache(size_t maxBytes = 256u << 20);
+
+    // Replaces host's rules, whatever the case of host. No rules means
+    // everything is allowed.
+    void set(std::string_view host, const std::vector<Rule>& rules);
+
+    // UNKNOWN if the url's host has no rules cached. A hit makes the host
+    // the most recently used.
+    Access check(std::string_view url);
+
+    // Called with a host, in lowercase, and its crawl delay.
+    using CrawlDelayFn =
+        std::function<void(std::string_view host, uint32_t delayMs)>;
+
+    // Applies the lines of a ROBOTS message: a url starts a host, and the
+    // "Allow: path" and "Disallow: path" lines after it are its rules. A
+    // "Crawl-delay: seconds" line is passed to crawlDelay, if given, in
+    // milliseconds and at most a minute. Other lines are ignored. Returns
+    // the number of hosts set.
+    size_t load(const std::vector<std::string_view>& lines,
+                const CrawlDelayFn& crawlDelay = nullptr);
+
+    size_t numHosts() const { return hosts; }
+    size_t bytes() const { return used; }
+    uint64_t evictions() const { return evicted; }
+
+   private:
+    static constexpr uint32_t kNone = static_cast<uint32_t>(-1);
+
+    // A trie node. Its label is the part of the path it adds to its
+    // parent's; its children start at child and are ordered by the first
+    // byte of their label.
+    struct Node {
+        uint32_t label = 0;  // offset in the labels
+        uint32_t child = 0;
+        uint16_t labelLength = 0;
+        uint16_t numChildren = 0;
+        Access access = Access::UNKNOWN;  // set if a rule ends here
+    };
+
+    // A rule with '*' or '$', matched on its own.
+    struct Wildcard {
+        uint32_t pattern = 0;  // offset in the labels
+        uint16_t length = 0;
+        bool allow = false;
+    };
+
+    // A host's compiled rules in one allocation, so a check misses the
+    // cache a few times at most: a Header, the nodes (nodes[0] is the
+    // root), the wildcards, then the bytes of every label and pattern.
+    struct Header {
+        uint32_t numNodes = 0;
+        uint32_t numWildcards = 0;
+    };
+    struct Rules {
+        std::unique_ptr<char[]> data;  // null if there are no rules
+        size_t size = 0;
+
+        Access check(std::string_view path) const;
+    };
+
+    struct Entry {
+        uint64_t hash = 0;
+        uint32_t prev = kNone;
+        uint32_t next = kNone;
+        Rules rules;
+    };
+
+    size_t maxBytes;
+    size_t used = 0;
+    size_t hosts = 0;
+    uint64_t evicted = 0;
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+    uint32_t head = kNone;  // most recently used
+    uint32_t tail = kNone;
+    // Entry index per slot, by linear probing on the hash.
+    std::vector<uint32_t> slots;
+
+    static Rules compile(const std::vector<Rule>& rules);
+    static size_t entryBytes(const Entry& entry);
+
+    size_t findSlot(uint64_t hash) const;
+    void eraseSlot(size_t slot);
+    void growSlots();
+    void unlink(uint32_t i);
+    void pushFront(uint32_t i);
+    void evictOne();
+};
@@ -0,0 +1,60 @@
+#include "SeedList.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+}  // namespace
+
+SeedList SeedList::read(const std::string& path) {
+    SeedList seeds;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Can't open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can't stat " + path);
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return seeds;
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        throw std::runtime_error("Can't map " + path);
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+    seeds.data = std::shared_ptr<const char>(
+        static_cast<const char*>(addr),
+        [size](const char* p) { ::munmap(const_cast<char*>(p), size); });
+
+    const char* pos = seeds.data.get();
+    const char* end = pos + size;
+    while (pos < end) {
+        const char* newline =
+            static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+        const char* lineEnd = newline ? newline : end;
+        const char* first = pos;
+        const char* last = lineEnd;
+        while (first < last && isSpace(*first))
+            ++first;
+        while (last > first && isSpace(last[-1]))
+            --last;
+        if (first < last && *first != '#')
+            seeds.lines.emplace_back(first, last - first);
+        pos = lineEnd + 1;
+    }
+    return seeds;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A seed list, one url per line, mapped into memory. Lines are split in
+// place, so loading millions of seeds copies nothing until they are queued.
+// Whitespace around a url (including the "\r" of CRLF files) is trimmed,
+// and empty lines and lines starting with '#' are skipped.
+class SeedList {
+   public:
+    // Throws std::runtime_error if path can't be opened or mapped.
+    static SeedList read(const std::string& path);
+
+    // Valid as long as this SeedList.
+    const std::vector<std::string_view>& urls() const { return lines; }
+    size_t size() const { return lines.size(); }
+
+   private:
+    std::shared_ptr<const char> data;  // the mapped file
+    std::vector<std::string_view> lines;
+};
@@ -0,0 +1,604 @@
+#include "ShardedFrontier.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "Politeness.hpp"
+#include "PriorityQueue.hpp"
+#include "SpillStore.hpp"
+#include "UrlFilter.hpp"
+#include "XXHash.hpp"
+
+namespace {
+
+constexpr size_t kInboxBatches = 1024;
+// Batches ingested per pass, so the ready queue is topped up in between.
+constexpr size_t kBatchesPerPass = 16;
+
+void appendRecord(std::string& out, std::string_view url) {
+    size_t len = url.size();
+    out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.append(url);
+}
+
+}  // namespace
+
+struct ShardedFrontier::Shard {
+    size_t index;
+    PriorityQueue pq;
+    SpillStore spill;
+    std::unique_ptr<DedupStore> seen;
+    HostQuota quota;
+    size_t readyDepth;
+
+    SpscQueue<Batch> inbox{kInboxBatches};
+    SpscQueue<std::string> ready;
+    Event wake;
+    Event* readyEvent;
+
+    // Published after every pass for the owning thread's readers. The
+    // ready queue is counted by the reader, which is what drains it.
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> hosts{0};
+    std::atomic<size_t> parked{0};
+    std::atomic<size_t> spilled{0};
+    std::atomic<size_t> overQuota{0};
+
+    // A task posted by runOn(), run between passes.
+    std::mutex taskMutex;
+    std::condition_variable taskDone;
+    std::function<void(Shard&)> task;
+    std::atomic<bool> hasTask{false};
+
+    // Urls that entered the queue since the last snapshot, as records.
+    std::string addLog;
+    uint64_t addCount = 0;
+
+    // Set while snapshot() takes the ready queue back.
+    std::atomic<bool> holdReady{false};
+
+    // Urls handed on from the ready queue, counted by the reader, and how
+    // many of them the queue has been told about.
+    std::atomic<uint64_t> handedOn{0};
+    uint64_t settled = 0;
+
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    Shard(size_t index, std::unique_ptr<DedupStore> seen, size_t capacity,
+          const std::string& spillDir, size_t readyDepth, Event* readyEvent,
+          uint32_t maxUrlsPerHost, PriorityQueue::Engine queueEngine)
+        : index(index),
+          pq(capacity, queueEngine),
+          // Segments must fit in the room left when a refill is triggered.
+          spill(spillDir, std::clamp<size_t>(capacity / 4, 1, 4096)),
+          seen(std::move(seen)),
+          quota(maxUrlsPerHost),
+          readyDepth(readyDepth),
+          ready(readyDepth),
+          readyEvent(readyEvent) {
+        pq.setReadAhead(true);
+    }
+
+    void start() {
+        thread = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        stopping.store(true);
+        wake.notify();
+        thread.join();
+    }
+
+    // Queues a batch of urls in one pushN and spills what does not fit.
+    // Urls in the spill tier are on disk already, so only urls entering
+    // the queue are logged.
+    void enqueue(const std::vector<std::string>& urls) {
+        size_t pushed = pq.pushN(urls);
+        for (size_t i = 0; i < pushed; ++i)
+            appendRecord(addLog, urls[i]);
+        addCount += pushed;
+        for (size_t i = pushed; i < urls.size(); ++i)
+            spill.append(urls[i], PriorityQueue::defaultPriorityOf(urls[i]));
+    }
+
+    // Queues urls with one linear-time build, spilling what does not fit.
+    // Only for bulk loads, which the next (full) snapshot covers, so the
+    // urls are not logged.
+    void load(std::vector<std::string>& urls) {
+        size_t pushed = pq.pushN(urls);
+        for (size_t i = pushed; i < urls.size(); ++i)
+            spill.append(urls[i], PriorityQueue::defaultPriorityOf(urls[i]));
+        topUp();
+        publish();
+    }
+
+    // Moves spilled urls back into the queue once it runs low. Their
+    // segments are kept until the next checkpoint is written and deleted
+    // then, so the urls are logged like new ones for it to hold.
+    void refill() {
+        if (spill.size() == 0 || pq.size() >= pq.capacity() / 2)
+            return;
+        enqueue(spill.refill(pq.capacity() - pq.size()));
+    }
+
+    bool ingest(size_t maxBatches = kBatchesPerPass) {
+        bool worked = false;
+        Batch batch;
+        for (size_t i = 0; i < maxBatches && inbox.tryPop(batch); ++i) {
+            for (const auto& [host, rounds] : batch.demotions)
+                pq.demote(host, rounds);
+            for (const auto& [host, delayMs] : batch.crawlDelays)
+                pq.setCrawlDelay(host, delayMs);
+            // The urls to queue are moved to the front of the batch and
+            // pushed together.
+            size_t kept = 0;
+            for (size_t j = 0; j < batch.urls.size(); ++j) {
+                std::string& url = batch.urls[j];
+                if (batch.dedup) {
+                    std::string_view host = PriorityQueue::hostOf(url);
+                    if (batch.queue && !quota.allows(host)) {
+                        overQuota.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    if (!seen->insertIfAbsent(url))
+                        continue;
+                    quota.count(host);
+                }
+                if (!batch.queue)
+                    continue;
+                if (j != kept)
+                    batch.urls[kept] = std::move(url);
+                ++kept;
+            }
+            batch.urls.resize(kept);
+            enqueue(batch.urls);
+            worked = true;
+        }
+        return worked;
+    }
+
+    // Tells the queue which urls left the ready queue, so hosts held back
+    // behind them can be served again once their delay has passed.
+    bool settle() {
+        uint64_t n = handedOn.load(std::memory_order_acquire);
+        if (n == settled)
+            return false;
+        pq.handedOn(n - settled, Politeness::nowMs());
+        settled = n;
+        return true;
+    }
+
+    bool canTopUp() {
+        return !holdReady.load() && ready.size() <= readyDepth / 2 &&
+               pq.numHosts() > pq.numParkedHosts();
+    }
+
+    bool topUp() {
+        size_t room = ready.capacity() - ready.size();
+        if (room == 0 || pq.size() == 0 || holdReady.load())
+            return false;
+        std::vector<std::string> urls = pq.popN(room, Politeness::nowMs());
+        for (std::string& url : urls)
+            ready.tryPush(url);
+        if (!urls.empty())
+            readyEvent->notify();
+        return !urls.empty();
+    }
+
+    void publish() {
+        queued.store(pq.size() + spill.size(),
+                     std::memory_order_relaxed);
+        hosts.store(pq.numHosts(), std::memory_order_relaxed);
+        parked.store(pq.numParkedHosts(), std::memory_order_relaxed);
+        spilled.store(spill.size(), std::memory_order_relaxed);
+    }
+
+    void runTask() {
+        // Everything flushed before the task was posted is handled first.
+        ingest(SIZE_MAX);
+        std::lock_guard<std::mutex> lock(taskMutex);
+        task(*this);
+        task = nullptr;
+        hasTask.store(false);
+        taskDone.notify_all();
+    }
+
+    void run() {
+        while (!stopping.load()) {
+            bool worked = ingest();
+            if (hasTask.load(std::memory_order_acquire)) {
+                runTask();
+                worked = true;
+            }
+            refill();
+            settle();
+            worked |= topUp();
+            publish();
+            if (worked)
+                continue;
+
+            // Hosts in cooldown come back within a wheel tick.
+            auto timeout = pq.numParkedHosts() > 0
+                               ? std::chrono::milliseconds(1)
+                               : std::chrono::milliseconds(1000);
+            wake.waitFor(
+                [this]() {
+                    return inbox.size() > 0 || hasTask.load() ||
+                           stopping.load() || canTopUp() ||
+                           handedOn.load() != settled ||
+                           (spill.size() > 0 && pq.size() < pq.capacity() / 2);
+                },
+                timeout);
+        }
+    }
+};
+
+ShardedFrontier::ShardedFrontier(std::vector<std::unique_ptr<DedupStore>> seen,
+                                 const Options& options)
+    : pending(seen.size()), takeLogs(seen.size()), takeCounts(seen.size()) {
+    size_t n = seen.size();
+    for (size_t i = 0; i < n; ++i) {
+        auto shard = std::make_unique<Shard>(
+            i, std::move(seen[i]), std::max<size_t>(options.capacity / n, 1),
+            shardDir(options.spillDir, i, n), options.readyDepth, &readyEvent,
+            options.maxUrlsPerHost, options.queueEngine);
+        shard->pq.setPoliteness(options.crawlDelayMs, options.hostBurst);
+        shards.push_back(std::move(shard));
+    }
+    for (auto& shard : shards)
+        shard->start();
+}
+
+ShardedFrontier::~ShardedFrontier() {
+    for (auto& shard : shards)
+        shard->stop();
+}
+
+std::string ShardedFrontier::shardDir(const std::string& dir, size_t i,
+                                      size_t numShards) {
+    return numShards == 1 ? dir : dir + "/shard-" + std::to_string(i);
+}
+
+size_t ShardedFrontier::shardOf(std::string_view url) const {
+    return shardOf(url, shards.size());
+}
+
+size_t ShardedFrontier::shardOf(std::string_view url, size_t numShards) {
+    // Same host extraction as PriorityQueue, so a host maps to one shard.
+    return xxhash::hash64(PriorityQueue::hostOf(url)) % numShards;
+}
+
+void ShardedFrontier::add(std::string_view url, bool dedup) {
+    append(url, dedup, true);
+}
+
+void ShardedFrontier::demote(std::string_view host, uint32_t rounds) {
+    // A bare host is its own host part, so it maps like its urls.
+    size_t i = shards.size() == 1 ? 0 : shardOf(host);
+    pending[i].demotions.emplace_back(host, rounds);
+}
+
+void ShardedFrontier::setCrawlDelay(std::string_view host, uint32_t delayMs) {
+    size_t i = shards.size() == 1 ? 0 : shardOf(host);
+    pending[i].crawlDelays.emplace_back(host, delayMs);
+}
+
+void ShardedFrontier::markSeen(std::string_view url) {
+    append(url, true, false);
+}
+
+void ShardedFrontier::append(std::string_view url, bool dedup, bool queue) {
+    size_t i = shards.size() == 1 ? 0 : shardOf(url);
+    Batch& batch = pending[i];
+    if ((batch.dedup != dedup || batch.queue != queue) && !batch.urls.empty())
+        send(i);
+    batch.dedup = dedup;
+    batch.queue = queue;
+    batch.urls.emplace_back(url);
+}
+
+void ShardedFrontier::send(size_t i) {
+    shards[i]->inbox.push(std::move(pending[i]));
+    shards[i]->wake.notify();
+    pending[i] = Batch{};
+}
+
+void ShardedFrontier::flush() {
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (!pending[i].urls.empty() || !pending[i].demotions.empty() ||
+            !pending[i].crawlDelays.empty())
+            send(i);
+    }
+}
+
+void ShardedFrontier::runOn(size_t i, const std::function<void(Shard&)>& f) {
+    Shard& shard = *shards[i];
+    {
+        std::lock_guard<std::mutex> lock(shard.taskMutex);
+        shard.task = f;
+        shard.hasTask.store(true, std::memory_order_release);
+    }
+    shard.wake.notify();
+    std::unique_lock<std::mutex> lock(shard.taskMutex);
+    shard.taskDone.wait(lock, [&shard]() { return !shard.hasTask.load(); });
+}
+
+void ShardedFrontier::runOnAll(const std::function<void(Shard&)>& f) {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->taskMutex);
+        shard->task = f;
+        shard->hasTask.store(true, std::memory_order_release);
+    }
+    for (auto& shard : shards)
+        shard->wake.notify();
+    for (auto& shard : shards) {
+        std::unique_lock<std::mutex> lock(shard->taskMutex);
+        shard->taskDone.wait(lock,
+                             [&shard]() { return !shard->hasTask.load(); });
+    }
+}
+
+void ShardedFrontier::sync() {
+    flush();
+    runOnAll([](Shard& shard) {
+        shard.refill();
+        shard.settle();
+        shard.topUp();
+        shard.publish();
+    });
+}
+
+std::vector<std::string> ShardedFrontier::take(size_t n, int waitMs) {
+    std::vector<std::string> urls;
+    urls.reserve(n);
+    while (!carry.empty() && urls.size() < n) {
+        urls.push_back(std::move(carry.front()));
+        carry.pop_front();
+    }
+
+    for (const std::string& url : urls)
+        logTake(shards.size() == 1 ? 0 : shardOf(url), url);
+
+    auto gather = [&]() {
+        // One url per shard in turn; a pass that finds nothing ends it.
+        std::string url;
+        bool progress = true;
+        while (urls.size() < n && progress) {
+            progress = false;
+            for (size_t k = 0; k < shards.size() && urls.size() < n; ++k) {
+                size_t i = nextShard;
+                nextShard = (nextShard + 1) % shards.size();
+                if (shards[i]->ready.tryPop(url)) {
+                    logTake(i, url);
+                    urls.push_back(std::move(url));
+                    progress = true;
+                }
+            }
+        }
+        for (auto& shard : shards)
+            shard->wake.notify();
+    };
+
+    gather();
+    if (urls.empty() && waitMs > 0 && size() > 0) {
+        readyEvent.waitFor(
+            [this]() {
+                for (auto& shard : shards) {
+                    if (shard->ready.size() > 0)
+                        return true;
+                }
+                return false;
+            },
+            std::chrono::milliseconds(waitMs));
+        gather();
+    }
+    return urls;
+}
+
+void ShardedFrontier::logTake(size_t shard, std::string_view url) {
+    appendRecord(takeLogs[shard], url);
+    ++takeCounts[shard];
+    shards[shard]->handedOn.fetch_add(1, std::memory_order_release);
+}
+
+void ShardedFrontier::clear() {
+    flush();
+    // Dropped urls are handed on too, or their hosts would stay held.
+    for (const std::string& u : carry)
+        shards[shards.size() == 1 ? 0 : shardOf(u)]->handedOn.fetch_add(1);
+    carry.clear();
+    std::string url;
+    runOnAll([](Shard& shard) {
+        shard.pq.clear();
+        shard.spill.clear();
+    });
+    // The shards are idle between tasks, so their ready queues only drain.
+    for (auto& shard : shards) {
+        while (shard->ready.tryPop(url))
+            shard->handedOn.fetch_add(1);
+    }
+    runOnAll([](Shard& shard) { shard.publish(); });
+}
+
+size_t ShardedFrontier::size() const {
+    size_t n = carry.size();
+    for (const auto& shard : shards) {
+        n += shard->queued.load(std::memory_order_relaxed) +
+             shard->ready.size();
+    }
+    return n;
+}
+
+size_t ShardedFrontier::numHosts() const {
+    size_t n = 0;
+    for (const auto& shard : shards)
+        n += shard->hosts.load(std::memory_order_relaxed);
+    return n;
+}
+
+size_t ShardedFrontier::numParkedHosts() const {
+    size_t n = 0;
+    for (const auto& shard : shards)
+        n += shard->parked.load(std::memory_order_relaxed);
+    return n;
+}
+
+size_t ShardedFrontier::spilled() const {
+    size_t n = 0;
+    for (const auto& shard : shards)
+        n += shard->spilled.load(std::memory_order_relaxed);
+    return n;
+}
+
+size_t ShardedFrontier::overQuota() const {
+    size_t n = 0;
+    for (const auto& shard : shards)
+        n += shard->overQuota.load(std::memory_order_relaxed);
+    return n;
+}
+
+ShardedFrontier::Snapshot ShardedFrontier::snapshot(bool full) {
+    flush();
+    Snapshot snap;
+    snap.full = full;
+    snap.shards.resize(shards.size());
+    snap.spillEpoch = ++spillEpoch;
+    runOnAll([&](Shard& shard) {
+        Snapshot::Shard& out = snap.shards[shard.index];
+        std::ostringstream seen;
+        if (full) {
+            shard.pq.forEach(
+                [&](std::string_view url) { appendRecord(out.queued, url); });
+            out.numQueued = shard.pq.size();
+            shard.seen->save(seen);
+            shard.holdReady.store(true);
+        } else {
+            out.queued = std::move(shard.addLog);
+            out.numQueued = shard.addCount;
+            shard.seen->saveDelta(seen);
+        }
+        shard.addLog.clear();
+        shard.addCount = 0;
+        shard.spill.flush();
+        shard.spill.markCheckpoint(snap.spillEpoch);
+        out.seen = std::move(seen).str();
+    });
+
+    if (full) {
+        // Urls the shards popped ahead are not in their queues any more;
+        // write them first, since they are next, and serve them from carry
+        // afterwards.
+        std::string url;
+        for (auto& shard : shards) {
+            while (shard->ready.tryPop(url))
+                carry.push_back(std::move(url));
+            shard->holdReady.store(false);
+            shard->wake.notify();
+        }
+        std::vector<std::string> carried(shards.size());
+        for (const std::string& u : carry) {
+            size_t i = shards.size() == 1 ? 0 : shardOf(u);
+            appendRecord(carried[i], u);
+            ++snap.shards[i].numQueued;
+        }
+        for (size_t i = 0; i < shards.size(); ++i) {
+            if (!carried[i].empty())
+                snap.shards[i].queued.insert(0, carried[i]);
+        }
+    }
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (!full) {
+            snap.shards[i].taken = std::move(takeLogs[i]);
+            snap.shards[i].numTaken = takeCounts[i];
+        }
+        takeLogs[i].clear();
+        takeCounts[i] = 0;
+    }
+    return snap;
+}
+
+void ShardedFrontier::releaseSpill(uint64_t epoch) {
+    if (epoch == 0)
+        return;
+    runOnAll([&](Shard& shard) { shard.spill.release(epoch); });
+}
+
+void ShardedFrontier::restore(
+    const std::function<Restored(size_t shard)>& source) {
+    flush();
+    runOnAll([&](Shard& shard) {
+        Restored restored = source(shard.index);
+        for (size_t i = 0; i < restored.logged.size(); ++i) {
+            std::string& url = restored.logged[i];
+            bool fresh = shard.seen->insertIfAbsent(url);
+            if ((fresh || restored.loggedRequeued[i]) &&
+                !restored.loggedTaken[i]) {
+                restored.queued.push_back(std::move(url));
+            }
+        }
+        shard.load(restored.queued);
+    });
+}
+
+void ShardedFrontier::addBulk(const std::vector<std::string_view>& urls,
+                              bool dedup) {
+    flush();
+    std::vector<std::vector<std::string_view>> byShard;
+    if (shards.size() > 1) {
+        byShard.resize(shards.size());
+        for (std::string_view url : urls)
+            byShard[shardOf(url)].push_back(url);
+    }
+    runOnAll([&](Shard& shard) {
+        const std::vector<std::string_view>& mine =
+            byShard.empty() ? urls : byShard[shard.index];
+        std::vector<std::string> queued;
+        queued.reserve(mine.size());
+        for (std::string_view url : mine) {
+            if (!dedup || shard.seen->insertIfAbsent(url))
+                queued.emplace_back(url);
+        }
+        shard.load(queued);
+    });
+}
+
+bool ShardedFrontier::loadSeen(const std::string& path,
+                               const std::vector<uint64_t>& offsets) {
+    if (offsets.size() != shards.size())
+        return false;
+    std::atomic<bool> ok{true};
+    runOnAll([&](Shard& shard) {
+        if (!shard.seen->load(path, offsets[shard.index]))
+            ok = false;
+    });
+    return ok;
+}
+
+bool ShardedFrontier::loadSeenDelta(const std::string& path,
+                                    const std::vector<uint64_t>& offsets) {
+    if (offsets.size() != shards.size())
+        return false;
+    std::atomic<bool> ok{true};
+    runOnAll([&](Shard& shard) {
+        if (!shard.seen->loadDelta(path, offsets[shard.index]))
+            ok = false;
+    });
+    return ok;
+}
+
+std::string ShardedFrontier::describeSeen() {
+    std::string description;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        runOn(i, [&](Shard& shard) {
+            if (!description.empty())
+                description += "; ";
+            description += shard.seen->describe();
+        });
+    }
+    return description;
+}
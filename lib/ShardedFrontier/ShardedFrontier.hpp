@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "DedupStore.hpp"
+#include "PriorityQueue.hpp"
+#include "SpscQueue.hpp"
+
+// Frontier state split by host into shards. Each shard owns a
+// PriorityQueue, a spill tier and a dedup store and runs on its own thread,
+// so ingesting and scheduling urls scales with the number of shards. Urls
+// go to the shard picked by a hash of their host, which keeps politeness
+// and round-robin per host exact.
+//
+// The caller (the frontier's core thread) feeds urls in with add() and
+// flush(), and takes urls out with take(). Every shard keeps a small queue
+// of urls popped ahead of time, so take() only gathers from those queues,
+// round-robin across shards, and never waits for a shard to schedule. A
+// host with a crawl delay has at most one url in that queue, and its delay
+// counts from when take() hands the url out.
+//
+// All methods must be called from one thread.
+class ShardedFrontier {
+   public:
+    struct Options {
+        size_t capacity = 10000;  // in-memory urls, split across shards
+        uint32_t crawlDelayMs = 0;
+        uint32_t hostBurst = 1;
+        std::string spillDir;
+        size_t readyDepth = 256;  // urls each shard pops ahead of take()
+        // New urls admitted per host through add(..., true); 0 for no cap.
+        // Urls over the cap are dropped before the dedup store sees them.
+        uint32_t maxUrlsPerHost = 0;
+        PriorityQueue::Engine queueEngine = PriorityQueue::Engine::BINARY_HEAP;
+    };
+
+    // One shard per dedup store.
+    ShardedFrontier(std::vector<std::unique_ptr<DedupStore>> seen,
+                    const Options& options);
+    ~ShardedFrontier();
+
+    size_t numShards() const { return shards.size(); }
+    size_t shardOf(std::string_view url) const;
+    static size_t shardOf(std::string_view url, size_t numShards);
+
+    // Queues url for its shard; flush() hands queued urls over. With dedup,
+    // the shard drops urls its store has already seen.
+    void add(std::string_view url, bool dedup);
+    void flush();
+
+    // Adds many urls at once, such as a seed list. The urls are sorted by
+    // shard here, then every shard deduplicates its own and builds its
+    // queue in one pass, in parallel, spilling what does not fit. Like
+    // restore(), the urls are not part of the next delta.
+    void addBulk(const std::vector<std::string_view>& urls, bool dedup);
+
+    // Demotes host in its shard's queue (PriorityQueue::demote), in order
+    // with add().
+    void demote(std::string_view host, uint32_t rounds);
+
+    // Sets host's own crawl delay in its shard's queue
+    // (PriorityQueue::setCrawlDelay), in order with add().
+    void setCrawlDelay(std::string_view host, uint32_t delayMs);
+
+    // Records url as seen without queueing it, in order with add(). For
+    // replaying urls that were queued and taken before a restart.
+    void markSeen(std::string_view url);
+
+    // Blocks until every shard has handled everything flushed so far.
+    void sync();
+
+    // Takes up to n urls, one shard at a time in turn. If no url is ready
+    // but some are queued, waits up to waitMs for a shard to catch up.
+    std::vector<std::string> take(size_t n, int waitMs = 0);
+
+    // Drops every queued url, spilled ones included.
+    void clear();
+
+    // Queued urls across shards, in memory, ready and spilled. Updated by
+    // the shards as they go, so it may lag behind add() and take().
+    size_t size() const;
+    size_t numHosts() const;
+    size_t numParkedHosts() const;
+    size_t spilled() const;
+    // Urls dropped for being over Options::maxUrlsPerHost.
+    size_t overQuota() const;
+
+    // State for a checkpoint, copied on the shard threads in parallel so a
+    // background writer can persist it while serving goes on. Kept per
+    // shard, so recovery can load the shards in parallel.
+    //
+    // A full snapshot holds every queued url, as (length, bytes) records,
+    // and each shard's whole dedup store. A delta holds the urls queued and
+    // the urls taken since the previous snapshot and what each dedup store
+    // changed. Spill segments are flushed; they are already on disk and are
+    // not part of either. Segments read back into the queues before the
+    // snapshot are kept until it is written; see releaseSpill().
+    struct Snapshot {
+        struct Shard {
+            std::string queued;
+            uint64_t numQueued = 0;
+            std::string taken;  // deltas only
+            uint64_t numTaken = 0;
+            std::string seen;
+        };
+        bool full = false;
+        std::vector<Shard> shards;
+        uint64_t spillEpoch = 0;
+
+        size_t bytes() const {
+            size_t n = 0;
+            for (const Shard& shard : shards) {
+                n += shard.queued.size() + shard.taken.size() +
+                     shard.seen.size();
+            }
+            return n;
+        }
+    };
+    Snapshot snapshot(bool full);
+
+    // Deletes the spill segments covered by snapshots up to and including
+    // the one with spillEpoch `epoch`, once they are on disk.
+    void releaseSpill(uint64_t epoch);
+
+    // A shard's urls read back from a checkpoint. Queued urls go straight
+    // into the queue. Logged urls go through the dedup store in order, as
+    // they did the first time, except requeued ones, which were seen
+    // already, and the ones taken again are only marked seen.
+    struct Restored {
+        std::vector<std::string> queued;
+        std::vector<std::string> logged;
+        std::vector<bool> loggedTaken;
+        std::vector<bool> loggedRequeued;
+    };
+
+    // Refills the shards in parallel: source(i) runs on shard i's thread
+    // and its urls are loaded with one linear-time queue build, spilling
+    // what does not fit. Load the dedup stores first. Restored urls are not
+    // part of the next delta, so the next snapshot must be full.
+    void restore(const std::function<Restored(size_t shard)>& source);
+
+    // Loads full snapshots of the dedup stores at offsets[i] of path, one
+    // per shard, then deltas the same way.
+    bool loadSeen(const std::string& path, const std::vector<uint64_t>& offsets);
+    bool loadSeenDelta(const std::string& path,
+                       const std::vector<uint64_t>& offsets);
+
+    std::string describeSeen();
+
+    // Directory for shard i's files under dir; dir itself for one shard,
+    // so an unsharded frontier keeps its layout.
+    static std::string shardDir(const std::string& dir, size_t i,
+                                size_t numShards);
+
+   private:
+    struct Batch {
+        std::vector<std::string> urls;
+        bool dedup = true;
+        bool queue = true;  // false: only insert into the dedup store
+        // Hosts to demote before the urls are queued, with their penalty.
+        std::vector<std::pair<std::string, uint32_t>> demotions;
+        // Hosts with a crawl delay of their own, set before the urls too.
+        std::vector<std::pair<std::string, uint32_t>> crawlDelays;
+    };
+    struct Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Batch> pending;  // per shard, not flushed yet
+    std::deque<std::string> carry;  // ready urls taken back by snapshot()
+    size_t nextShard = 0;
+    uint64_t spillEpoch = 0;  // of the last snapshot
+    // Urls taken since the last snapshot, per shard, as records.
+    std::vector<std::string> takeLogs;
+    std::vector<uint64_t> takeCounts;
+    Event readyEvent;
+
+    void send(size_t shard);
+    void append(std::string_view url, bool dedup, bool queue);
+    // Logs a url take() hands out and tells its shard it is gone.
+    void logTake(size_t shard, std::string_view url);
+
+    // Runs f(shard) on every shard's thread in parallel and waits.
+    void runOnAll(const std::function<void(Shard&)>& f);
+
+    // Runs f(shard) on shard i's thread and waits.
+    void runOn(size_t i, const std::function<void(Shard&)>& f);
+};
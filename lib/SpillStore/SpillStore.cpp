@@ -0,0 +1,237 @@
+#include "SpillStore.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "Durable.hpp"
+
+namespace fs = std::filesystem;
+
+SpillStore::SpillStore(std::string dir, size_t segmentUrls)
+    : dir(std::move(dir)), segmentUrls(std::max<size_t>(segmentUrls, 1)) {
+    fs::create_directories(this->dir);
+    recover();
+}
+
+SpillStore::~SpillStore() {
+    for (auto& [priority, bucket] : buckets) {
+        if (bucket.fd >= 0) {
+            durable::writeAll(bucket.fd, bucket.buffer.data(),
+                              bucket.buffer.size());
+            ::close(bucket.fd);
+        }
+    }
+}
+
+std::string SpillStore::openPath(int priority, uint64_t seq) const {
+    return dir + "/" + std::to_string(priority) + "-" + std::to_string(seq) +
+           ".open";
+}
+
+std::string SpillStore::sealedPath(int priority, const Segment& segment) const {
+    return dir + "/" + std::to_string(priority) + "-" +
+           std::to_string(segment.seq) + "-" + std::to_string(segment.urls) +
+           ".seg";
+}
+
+void SpillStore::append(const std::string& url, int priority) {
+    Bucket& bucket = buckets[priority];
+    if (bucket.fd < 0) {
+        if (numOpen >= kMaxOpen)
+            sealIdlest();
+        bucket.openSeq = nextSeq++;
+        bucket.openUrls = 0;
+        bucket.fd = ::open(openPath(priority, bucket.openSeq).c_str(),
+                           O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (bucket.fd < 0)
+            throw std::runtime_error("Couldn't open spill segment in " + dir);
+        ++numOpen;
+    }
+    bucket.lastAppend = ++appends;
+
+    uint32_t len = static_cast<uint32_t>(url.size());
+    bucket.buffer.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    bucket.buffer.append(url);
+    ++bucket.openUrls;
+    ++count;
+
+    if (bucket.openUrls >= segmentUrls)
+        seal(priority, bucket);
+    else if (bucket.buffer.size() >= kBufferBytes)
+        write(bucket);
+}
+
+void SpillStore::write(Bucket& bucket) {
+    if (!durable::writeAll(bucket.fd, bucket.buffer.data(),
+                           bucket.buffer.size()))
+        throw std::runtime_error("Couldn't write spill segment in " + dir);
+    bucket.buffer.clear();
+}
+
+void SpillStore::seal(int priority, Bucket& bucket) {
+    // On disk before the rename, so a sealed segment is never short.
+    write(bucket);
+    if (::fsync(bucket.fd) != 0)
+        throw std::runtime_error("Couldn't sync spill segment in " + dir);
+    ::close(bucket.fd);
+    bucket.fd = -1;
+    std::string().swap(bucket.buffer);
+    --numOpen;
+    Segment segment{bucket.openSeq, bucket.openUrls};
+    fs::rename(openPath(priority, bucket.openSeq), sealedPath(priority, segment));
+    bucket.sealed.push_back(segment);
+    bucket.openUrls = 0;
+}
+
+void SpillStore::sealIdlest() {
+    int idlest = 0;
+    Bucket* oldest = nullptr;
+    for (auto& [priority, bucket] : buckets) {
+        if (bucket.fd >= 0 &&
+            (oldest == nullptr || bucket.lastAppend < oldest->lastAppend)) {
+            idlest = priority;
+            oldest = &bucket;
+        }
+    }
+    if (oldest != nullptr)
+        seal(idlest, *oldest);
+}
+
+std::vector<std::string> SpillStore::refill(size_t maxUrls) {
+    std::vector<std::string> urls;
+    for (auto& [priority, bucket] : buckets) {
+        while (true) {
+            if (bucket.sealed.empty() && bucket.openUrls > 0 &&
+                urls.size() + bucket.openUrls <= maxUrls) {
+                seal(priority, bucket);
+            }
+            if (bucket.sealed.empty())
+                break;
+
+            const Segment& segment = bucket.sealed.front();
+            if (urls.size() + segment.urls > maxUrls)
+                return urls;
+
+            std::string path = sealedPath(priority, segment);
+            count -= std::min(count, readSegment(path, urls));
+            consumed.push_back(Consumed{std::move(path), 0});
+            bucket.sealed.pop_front();
+        }
+    }
+    return urls;
+}
+
+void SpillStore::flush() {
+    for (auto& [priority, bucket] : buckets) {
+        if (bucket.fd < 0)
+            continue;
+        write(bucket);
+        if (::fsync(bucket.fd) != 0)
+            throw std::runtime_error("Couldn't sync spill segment in " + dir);
+    }
+    // Renames and new segments since the last flush.
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+void SpillStore::markCheckpoint(uint64_t epoch) {
+    // Untagged segments are at the back.
+    for (auto it = consumed.rbegin(); it != consumed.rend() && it->epoch == 0;
+         ++it) {
+        it->epoch = epoch;
+    }
+}
+
+void SpillStore::release(uint64_t epoch) {
+    while (!consumed.empty() && consumed.front().epoch != 0 &&
+           consumed.front().epoch <= epoch) {
+        fs::remove(consumed.front().path);
+        consumed.pop_front();
+    }
+}
+
+void SpillStore::clear() {
+    for (auto& [priority, bucket] : buckets) {
+        if (bucket.fd >= 0) {
+            ::close(bucket.fd);
+            fs::remove(openPath(priority, bucket.openSeq));
+        }
+        for (const Segment& segment : bucket.sealed)
+            fs::remove(sealedPath(priority, segment));
+    }
+    buckets.clear();
+    for (const Consumed& segment : consumed)
+        fs::remove(segment.path);
+    consumed.clear();
+    count = 0;
+    numOpen = 0;
+}
+
+size_t SpillStore::readSegment(const std::string& path,
+                               std::vector<std::string>& out) {
+    // One sequential read of the whole segment.
+    std::ifstream in(path, std::ios::binary);
+    std::string buffer(fs::file_size(path), '\0');
+    in.read(buffer.data(), buffer.size());
+    buffer.resize(in.gcount());
+
+    size_t records = 0;
+    size_t pos = 0;
+    while (pos + sizeof(uint32_t) <= buffer.size()) {
+        uint32_t len;
+        std::memcpy(&len, buffer.data() + pos, sizeof(len));
+        pos += sizeof(len);
+        if (pos + len > buffer.size())
+            break;  // torn write at the end of an unsealed segment
+        out.emplace_back(buffer.data() + pos, len);
+        pos += len;
+        ++records;
+    }
+    return records;
+}
+
+// Picks up segments left by a previous run. Segments that were still open
+// are counted and sealed as they are. Segments read back but not released
+// are read again, since no checkpoint is known to hold their urls.
+void SpillStore::recover() {
+    std::vector<fs::path> paths;
+    for (const auto& entry : fs::directory_iterator(dir))
+        paths.push_back(entry.path());
+
+    std::vector<std::pair<int, Segment>> found;
+    for (const fs::path& path : paths) {
+        std::string name = path.filename().string();
+        int priority;
+        unsigned long long seq, urls;
+        char tail;
+        if (std::sscanf(name.c_str(), "%d-%llu-%llu.se%c", &priority, &seq,
+                        &urls, &tail) == 4) {
+            found.push_back({priority, Segment{seq, urls}});
+        } else if (std::sscanf(name.c_str(), "%d-%llu.ope%c", &priority, &seq,
+                               &tail) == 3) {
+            std::vector<std::string> records;
+            Segment segment{seq, readSegment(path.string(), records)};
+            fs::rename(path, sealedPath(priority, segment));
+            found.push_back({priority, segment});
+        }
+    }
+
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        return a.second.seq < b.second.seq;
+    });
+    for (const auto& [priority, segment] : found) {
+        buckets[priority].sealed.push_back(segment);
+        nextSeq = std::max<uint64_t>(nextSeq, segment.seq + 1);
+        count += segment.urls;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// On-disk overflow tier for the frontier. Urls that do not fit in the
+// in-memory queue are appended to segment files bucketed by priority, and
+// are read back a whole segment at a time, highest priority bucket first
+// and oldest segment first within a bucket.
+//
+// Segments live in `dir` as "<priority>-<seq>.open" while they are being
+// written and are renamed to "<priority>-<seq>-<urls>.seg" once sealed.
+// Each record is a uint32_t length followed by the url bytes. Segments
+// already in `dir` are picked up on construction.
+//
+// Priorities should be a small, fixed set of classes: every bucket keeps
+// a file open while it is written, and at most kMaxOpen are; past that the
+// bucket appended to longest ago has its segment sealed early.
+//
+// Urls read back live only in memory until a checkpoint covers them, so
+// segments that were read stay on disk until then: markCheckpoint() tags
+// them with the checkpoint about to be taken and release() deletes them
+// once it is written. A crash in between reads them back again.
+class SpillStore {
+   public:
+    explicit SpillStore(std::string dir, size_t segmentUrls = 4096);
+    // Writes out buffered records; segments still open are sealed by the
+    // next run.
+    ~SpillStore();
+
+    SpillStore(const SpillStore&) = delete;
+    SpillStore& operator=(const SpillStore&) = delete;
+
+    void append(const std::string& url, int priority);
+
+    // Reads whole segments, best bucket first, as long as they fit in
+    // maxUrls.
+    std::vector<std::string> refill(size_t maxUrls);
+
+    // Writes out and syncs segments that are still being written, along
+    // with the directory.
+    void flush();
+
+    // Segments read so far are covered by checkpoint `epoch`. Epochs
+    // start at 1 and increase.
+    void markCheckpoint(uint64_t epoch);
+    // Checkpoints up to `epoch` are on disk: deletes the segments they
+    // cover.
+    void release(uint64_t epoch);
+
+    // Drops every url, deleting their segments and the ones read back.
+    void clear();
+
+    size_t size() const { return count; }
+    // Segments read back and not released yet.
+    size_t numConsumed() const { return consumed.size(); }
+
+   private:
+    static constexpr size_t kMaxOpen = 8;
+    static constexpr size_t kBufferBytes = 64 * 1024;
+
+    struct Segment {
+        uint64_t seq;
+        size_t urls;
+    };
+
+    struct Bucket {
+        std::deque<Segment> sealed;
+        int fd = -1;  // segment being written, if any
+        std::string buffer;  // its records not written yet
+        uint64_t openSeq = 0;
+        size_t openUrls = 0;
+        uint64_t lastAppend = 0;
+    };
+
+    std::string dir;
+    size_t segmentUrls;
+    uint64_t nextSeq = 0;
+    size_t count = 0;
+    uint64_t appends = 0;
+    size_t numOpen = 0;
+    std::map<int, Bucket, std::greater<int>> buckets;
+
+    // A segment read back, with the checkpoint that covers it; 0 until
+    // the next markCheckpoint().
+    struct Consumed {
+        std::string path;
+        uint64_t epoch;
+    };
+    std::deque<Consumed> consumed;
+
+    std::string openPath(int priority, uint64_t seq) const;
+    std::string sealedPath(int priority, const Segment& segment) const;
+    void write(Bucket& bucket);
+    void seal(int priority, Bucket& bucket);
+    // Seals the open segment appended to longest ago.
+    void sealIdlest();
+    void recover();
+
+    // Appends the records of a segment file to out and returns how many
+    // complete records it held.
+    static size_t readSegment(const std::string& path,
+                              std::vector<std::string>& out);
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Hashed timing wheel: items due at some time, handed back once it has
+// come. An item goes in slot (atMs / tickMs) % slots; items more than a
+// turn ahead stay in their slot until a later pass. Adding is O(1), and
+// advancing visits each slot at most once however far time has moved, so
+// an item costs O(1) amortized plus a look per turn it waits.
+//
+// Single-threaded.
+template <typename T>
+class TimingWheel {
+   public:
+    TimingWheel(int64_t tickMs, size_t slots)
+        : tickMs(std::max<int64_t>(tickMs, 1)),
+          wheel(std::max<size_t>(slots, 1)) {}
+
+    // Adds item, due at atMs. Items due before the last tick visited go
+    // in that tick's slot, so the next advance() hands them back.
+    void add(T item, int64_t atMs) {
+        int64_t tick = std::max(atMs / tickMs, lastTick);
+        wheel[static_cast<size_t>(tick) % wheel.size()].push_back(
+            Entry{std::move(item), atMs});
+        ++count;
+    }
+
+    // Calls f(item) for every item due by nowMs. f may add items, which
+    // wait for the next call even if due, but must not advance the wheel.
+    template <typename F>
+    void advance(int64_t nowMs, F&& f);
+
+    size_t size() const { return count; }
+
+    // Bytes held by the slots.
+    size_t bytes() const {
+        size_t total = wheel.size() * sizeof(std::vector<Entry>);
+        for (const std::vector<Entry>& slot : wheel)
+            total += slot.capacity() * sizeof(Entry);
+        return total;
+    }
+
+   private:
+    struct Entry {
+        T item;
+        int64_t atMs;
+    };
+
+    int64_t tickMs;
+    std::vector<std::vector<Entry>> wheel;
+    int64_t lastTick = 0;  // the last tick visited
+    size_t count = 0;
+    std::vector<Entry> due;  // kept for its capacity
+};
+
+template <typename T>
+template <typename F>
+void TimingWheel<T>::advance(int64_t nowMs, F&& f) {
+    int64_t nowTick = nowMs / tickMs;
+    if (count == 0 || nowTick < lastTick) {
+        lastTick = std::max(lastTick, nowTick);
+        return;
+    }
+    // Visit each slot from the last tick visited up to now, at most once.
+    // The last tick is visited again for what was added to it since.
+    int64_t turn = static_cast<int64_t>(wheel.size());
+    int64_t first = std::max(lastTick, nowTick - turn + 1);
+    for (int64_t tick = first; tick <= nowTick && due.size() < count;
+         ++tick) {
+        std::vector<Entry>& slot = wheel[static_cast<size_t>(tick % turn)];
+        size_t kept = 0;
+        for (size_t j = 0; j < slot.size(); ++j) {
+            if (slot[j].atMs <= nowMs)
+                due.push_back(std::move(slot[j]));
+            else
+                slot[kept++] = std::move(slot[j]);
+        }
+        slot.resize(kept);
+        // A burst of items should not pin its memory to the slot.
+        if (kept == 0 && slot.capacity() > 4096)
+            std::vector<Entry>().swap(slot);
+    }
+    lastTick = nowTick;
+    count -= due.size();
+    // Handed back after the pass, so f can add to the slots.
+    for (Entry& entry : due)
+        f(entry.item);
+    due.clear();
+}
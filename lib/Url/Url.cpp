@@ -0,0 +1,330 @@
+#include "Url.hpp"
+
+#include <algorithm>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+           c == '\v';
+}
+
+bool isAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+int hexValue(char c) {
+    if (isDigit(c))
+        return c - '0';
+    c = toLower(c);
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+bool isUnreserved(char c) {
+    return isAlpha(c) || isDigit(c) || c == '-' || c == '.' || c == '_' ||
+           c == '~';
+}
+
+bool equalsLower(std::string_view s, std::string_view lower) {
+    if (s.size() != lower.size())
+        return false;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (toLower(s[i]) != lower[i])
+            return false;
+    }
+    return true;
+}
+
+bool isIp(std::string_view host) {
+    if (!host.empty() && host[0] == '[')
+        return true;
+    return std::all_of(host.begin(), host.end(),
+                       [](char c) { return isDigit(c) || c == '.'; });
+}
+
+// Appends s with escapes of unreserved characters decoded ("%7E" -> "~")
+// and the hex digits of the others uppercased ("%2f" -> "%2F").
+void appendNormalized(std::string& out, std::string_view s) {
+    static const char kHex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < s.size(); ++i) {
+        // Most urls have no escapes; copy up to the next one at once.
+        size_t percent = std::min(s.find('%', i), s.size());
+        out.append(s.data() + i, percent - i);
+        i = percent;
+        if (i == s.size())
+            break;
+        int hi, lo;
+        if (i + 2 < s.size() &&
+            (hi = hexValue(s[i + 1])) >= 0 && (lo = hexValue(s[i + 2])) >= 0) {
+            char c = static_cast<char>(hi * 16 + lo);
+            if (isUnreserved(c)) {
+                out += c;
+            } else {
+                out += '%';
+                out += kHex[hi];
+                out += kHex[lo];
+            }
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+}
+
+// Url::parse without the domain and TLD, which canonicalize() finds on the
+// lowercased host instead.
+bool split(std::string_view url, Url& parts) {
+    size_t colon = url.find(':');
+    if (colon == 0 || colon == std::string_view::npos || !isAlpha(url[0]))
+        return false;
+    for (size_t i = 1; i < colon; ++i) {
+        char c = url[i];
+        if (!isAlpha(c) && !isDigit(c) && c != '+' && c != '-' && c != '.')
+            return false;
+    }
+    if (url.compare(colon + 1, 2, "//") != 0)
+        return false;
+    parts = Url();
+    parts.scheme = url.substr(0, colon);
+
+    size_t start = colon + 3;
+    size_t end = start;
+    while (end < url.size() && url[end] != '/' && url[end] != '?' &&
+           url[end] != '#')
+        ++end;
+    std::string_view authority = url.substr(start, end - start);
+    size_t at = authority.rfind('@');
+    if (at != std::string_view::npos)
+        authority.remove_prefix(at + 1);
+    size_t portColon = authority.rfind(':');
+    if (!authority.empty() && authority[0] == '[') {
+        size_t bracket = authority.find(']');
+        if (bracket == std::string_view::npos)
+            return false;
+        portColon = authority.find(':', bracket);
+    }
+    if (portColon != std::string_view::npos) {
+        parts.port = authority.substr(portColon + 1);
+        authority = authority.substr(0, portColon);
+    }
+    if (authority.empty())
+        return false;
+    parts.host = authority;
+
+    std::string_view rest = url.substr(end);
+    size_t hash = rest.find('#');
+    if (hash != std::string_view::npos) {
+        parts.fragment = rest.substr(hash + 1);
+        rest = rest.substr(0, hash);
+    }
+    size_t question = rest.find('?');
+    if (question != std::string_view::npos) {
+        parts.query = rest.substr(question + 1);
+        rest = rest.substr(0, question);
+    }
+    parts.path = rest;
+    return true;
+}
+
+}  // namespace
+
+bool Url::parse(std::string_view url, Url& parts) {
+    if (!split(url, parts))
+        return false;
+    parts.tld = tldOf(parts.host);
+    parts.domain = domainOf(parts.host);
+    return true;
+}
+
+std::string_view Url::hostOf(std::string_view url) {
+    size_t start = url.find("://");
+    start = (start == std::string_view::npos) ? 0 : start + 3;
+    // A plain loop; find_first_of tests every byte against the set one
+    // character at a time, and hosts are looked up for every url pushed.
+    size_t end = start;
+    size_t at = std::string_view::npos;
+    size_t colon = std::string_view::npos;
+    for (; end < url.size(); ++end) {
+        char c = url[end];
+        if (c == '/' || c == '?' || c == '#')
+            break;
+        if (c == '@')
+            at = end;
+        else if (c == ':')
+            colon = end;
+        else if (c == ']')
+            colon = std::string_view::npos;
+    }
+    if (at != std::string_view::npos) {
+        start = at + 1;
+        if (colon != std::string_view::npos && colon < start)
+            colon = std::string_view::npos;
+    }
+    if (colon != std::string_view::npos)
+        end = colon;
+    return url.substr(start, end - start);
+}
+
+std::string_view Url::tldOf(std::string_view host) {
+    if (isIp(host))
+        return {};
+    size_t dot = host.rfind('.');
+    if (dot == std::string_view::npos || dot + 1 == host.size())
+        return {};
+    return host.substr(dot);
+}
+
+std::string_view Url::domainOf(std::string_view host) {
+    if (isIp(host))
+        return host;
+    size_t last = host.rfind('.');
+    if (last == std::string_view::npos || last == 0)
+        return host;
+    size_t second = host.rfind('.', last - 1);
+    if (second == std::string_view::npos)
+        return host;
+
+    // Second levels under which ccTLDs register names (co.uk, com.au).
+    static const std::string_view kGeneric[] = {
+        "ac", "co", "com", "edu", "go", "gob", "gov", "mil", "ne", "net",
+        "or", "org"};
+    std::string_view level = host.substr(second + 1, last - second - 1);
+    if (host.size() - last - 1 == 2 && second > 0 &&
+        std::find(std::begin(kGeneric), std::end(kGeneric), level) !=
+            std::end(kGeneric)) {
+        size_t third = host.rfind('.', second - 1);
+        return third == std::string_view::npos ? host
+                                               : host.substr(third + 1);
+    }
+    return host.substr(second + 1);
+}
+
+bool UrlCanonicalizer::isTrackingParam(std::string_view key) {
+    static const std::string_view kTracking[] = {
+        "_ga", "dclid", "fbclid", "gbraid", "gclid", "igshid", "mc_cid",
+        "mc_eid", "msclkid", "wbraid", "yclid"};
+    return key.compare(0, 4, "utm_") == 0 ||
+           std::find(std::begin(kTracking), std::end(kTracking), key) !=
+               std::end(kTracking);
+}
+
+std::string_view UrlCanonicalizer::canonicalize(std::string_view url) {
+    while (!url.empty() && isSpace(url.front()))
+        url.remove_prefix(1);
+    while (!url.empty() && isSpace(url.back()))
+        url.remove_suffix(1);
+
+    Url u;
+    if (!split(url, u))
+        return {};
+    bool https = equalsLower(u.scheme, "https");
+    if (!https && !equalsLower(u.scheme, "http"))
+        return {};
+    if (!std::all_of(u.port.begin(), u.port.end(), isDigit))
+        return {};
+    if (!https && options.upgradeHttp && (u.port.empty() || u.port == "80")) {
+        https = true;
+        u.port = {};
+    }
+    if (u.port == (https ? "443" : "80"))
+        u.port = {};
+    while (!u.host.empty() && u.host.back() == '.')
+        u.host.remove_suffix(1);
+    if (u.host.empty())
+        return {};
+
+    out.clear();
+    out += https ? "https://" : "http://";
+    size_t host = out.size();
+    for (char c : u.host)
+        out += toLower(c);
+    size_t hostEnd = out.size();
+    if (!u.port.empty()) {
+        out += ':';
+        out += u.port;
+    }
+    size_t path = out.size();
+    appendPath(u.path);
+    size_t pathEnd = out.size();
+    appendQuery(u.query);
+
+    std::string_view result = out;
+    last = Url();
+    last.scheme = result.substr(0, https ? 5 : 4);
+    last.host = result.substr(host, hostEnd - host);
+    if (!u.port.empty())
+        last.port = result.substr(hostEnd + 1, path - hostEnd - 1);
+    last.path = result.substr(path, pathEnd - path);
+    if (pathEnd < result.size())
+        last.query = result.substr(pathEnd + 1);
+    last.tld = Url::tldOf(last.host);
+    last.domain = Url::domainOf(last.host);
+    return result;
+}
+
+// Appends path with its dot segments resolved as in RFC 3986 5.2.4.
+// segments holds where each appended segment starts, so ".." truncates.
+void UrlCanonicalizer::appendPath(std::string_view path) {
+    size_t base = out.size();
+    scratch.clear();
+    appendNormalized(scratch, path);
+    segments.clear();
+    for (size_t i = 1; i <= scratch.size();) {
+        size_t end = std::min(scratch.find('/', i), scratch.size());
+        std::string_view segment(scratch.data() + i, end - i);
+        bool final = end == scratch.size();
+        if (segment == "." || segment == "..") {
+            if (segment == ".." && !segments.empty()) {
+                out.resize(segments.back());
+                segments.pop_back();
+            }
+            // "/a/." and "/a/b/.." both name the directory "/a/".
+            if (final)
+                out += '/';
+        } else {
+            segments.push_back(out.size());
+            out += '/';
+            out += segment;
+        }
+        i = end + 1;
+    }
+    if (out.size() == base)
+        out += '/';
+    if (options.dropTrailingSlash && out.size() > base + 1 &&
+        out.back() == '/')
+        out.pop_back();
+}
+
+// Appends "?" and the query's parameters, less empty and tracking ones.
+void UrlCanonicalizer::appendQuery(std::string_view query) {
+    if (query.empty())
+        return;
+    scratch.clear();
+    appendNormalized(scratch, query);
+    params.clear();
+    std::string_view rest = scratch;
+    while (!rest.empty()) {
+        size_t amp = std::min(rest.find('&'), rest.size());
+        std::string_view param = rest.substr(0, amp);
+        rest.remove_prefix(std::min(amp + 1, rest.size()));
+        if (param.empty() || isTrackingParam(param.substr(0, param.find('='))))
+            continue;
+        params.push_back(param);
+    }
+    if (params.empty())
+        return;
+    if (options.sortQuery)
+        std::sort(params.begin(), params.end());
+    char separator = '?';
+    for (std::string_view param : params) {
+        out += separator;
+        out += param;
+        separator = '&';
+    }
+}
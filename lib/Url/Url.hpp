@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Url parsing without allocation. Every part is a view into the url it
+// was parsed from.
+struct Url {
+    std::string_view scheme;    // "https"
+    std::string_view host;      // "news.bbc.co.uk", no userinfo or port
+    std::string_view port;      // "8080", empty if none
+    std::string_view path;      // "/a/b", empty if none
+    std::string_view query;     // without the '?'
+    std::string_view fragment;  // without the '#'
+    std::string_view domain;    // registered domain: "bbc.co.uk"
+    std::string_view tld;       // ".uk", empty for IPs and bare names
+
+    // Splits url, which needs a scheme and a host. Returns false
+    // otherwise; parts are not case-folded.
+    static bool parse(std::string_view url, Url& parts);
+
+    // Host of a url, with or without a scheme ("https://a.com:81/x" and
+    // "a.com" both give "a.com").
+    static std::string_view hostOf(std::string_view url);
+
+    // TLD of a host, with its dot as PriorityQueue keys TLDs (".com").
+    static std::string_view tldOf(std::string_view host);
+
+    // The registrable part of a host: its last two labels, or three under
+    // a ccTLD's generic second level ("bbc.co.uk", "abc.com.au"). An
+    // approximation of the Public Suffix List that needs no data file.
+    static std::string_view domainOf(std::string_view host);
+};
+
+// Rewrites urls into one canonical form, so the variants of a page take a
+// single slot in the seen filter and are crawled once. The scheme and host
+// are lowercased, a default port, userinfo and the fragment are dropped,
+// dot segments are resolved, percent-escapes of unreserved characters are
+// decoded and the others uppercased, and tracking parameters (utm_*,
+// gclid, ...) are removed from the query, whose other parameters are
+// sorted. Only http(s) urls with a host are accepted.
+//
+// The result lives in a buffer reused by the next call, so one
+// canonicalizer per thread allocates nothing once it has warmed up.
+class UrlCanonicalizer {
+   public:
+    struct Options {
+        // http urls on the default port become https, so both crawl once.
+        bool upgradeHttp = true;
+        // "/a/" becomes "/a"; the root path is kept.
+        bool dropTrailingSlash = true;
+        bool sortQuery = true;
+    };
+
+    UrlCanonicalizer() : UrlCanonicalizer(Options()) {}
+    explicit UrlCanonicalizer(Options options) : options(options) {}
+
+    // Canonical form of url, valid until the next call, or an empty view
+    // if url is not an http(s) url.
+    std::string_view canonicalize(std::string_view url);
+
+    // Parts of the url last canonicalized, as views into its canonical
+    // form.
+    const Url& parts() const { return last; }
+
+    static bool isTrackingParam(std::string_view key);
+
+   private:
+    Options options;
+    std::string out;
+    Url last;
+    // Scratch space kept across calls.
+    std::vector<size_t> segments;
+    std::vector<std::string_view> params;
+    std::string scratch;
+
+    void appendPath(std::string_view path);
+    void appendQuery(std::string_view query);
+};
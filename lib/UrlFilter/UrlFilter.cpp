@@ -0,0 +1,212 @@
+#include "UrlFilter.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+#include "XXHash.hpp"
+
+namespace {
+
+// Segments of a path past this many are not compared for loops; the depth
+// limit rejects such paths first unless it was raised.
+constexpr size_t kMaxSegments = 64;
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+}  // namespace
+
+UrlFilter::UrlFilter(const Options& options) : options(options) {
+    build(options.deny);
+}
+
+const char* UrlFilter::describe(Verdict verdict) {
+    switch (verdict) {
+        case Verdict::ACCEPT:
+            return "accepted";
+        case Verdict::DENIED:
+            return "denied by a rule";
+        case Verdict::TOO_LONG:
+            return "too long";
+        case Verdict::TOO_DEEP:
+            return "too deep";
+        case Verdict::LOOP:
+            return "repeating a segment";
+    }
+    return "";
+}
+
+// Builds the trie of the rules, then turns it into a DFA breadth first:
+// a missing transition goes where the longest proper suffix that is in the
+// trie would, and a state matches if its suffix does. '^' rules don't
+// carry over to suffixes; check() only honours them at the right depth.
+// Bytes no rule uses share class 0, so a state's row only has a column per
+// byte that can make progress.
+void UrlFilter::build(const std::vector<std::string>& deny) {
+    classOf.fill(0);
+    numClasses = 1;
+    for (const std::string& rule : deny) {
+        for (size_t i = (!rule.empty() && rule[0] == '^'); i < rule.size();
+             ++i) {
+            uint8_t& c = classOf[static_cast<unsigned char>(rule[i])];
+            if (c == 0)
+                c = static_cast<uint8_t>(numClasses++);
+        }
+    }
+
+    next.assign(numClasses, 0);
+    flags.assign(1, 0);
+    depth.assign(1, 0);
+    for (const std::string& rule : deny) {
+        bool anchored = !rule.empty() && rule[0] == '^';
+        std::string_view pattern = std::string_view(rule).substr(anchored);
+        if (pattern.empty())
+            continue;
+        uint32_t state = 0;
+        for (unsigned char c : pattern) {
+            uint32_t child = next[state * numClasses + classOf[c]];
+            if (child == 0) {
+                child = static_cast<uint32_t>(flags.size());
+                next.resize(next.size() + numClasses, 0);
+                flags.push_back(0);
+                depth.push_back(depth[state] + 1);
+                next[state * numClasses + classOf[c]] = child;
+            }
+            state = child;
+        }
+        flags[state] |= anchored ? kAnchored : kMatch;
+        ++rules;
+    }
+
+    std::vector<uint32_t> fail(flags.size(), 0);
+    std::vector<uint32_t> queue;
+    // Class 0 always leads back to the root.
+    for (size_t c = 1; c < numClasses; ++c) {
+        if (next[c] != 0)
+            queue.push_back(next[c]);
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint32_t state = queue[head];
+        for (size_t c = 1; c < numClasses; ++c) {
+            uint32_t& to = next[state * numClasses + c];
+            uint32_t viaFail = next[fail[state] * numClasses + c];
+            if (to == 0) {
+                to = viaFail;
+            } else {
+                fail[to] = viaFail;
+                flags[to] |= flags[viaFail] & kMatch;
+                queue.push_back(to);
+            }
+        }
+    }
+}
+
+UrlFilter::Verdict UrlFilter::check(std::string_view url) const {
+    if (url.size() > options.maxLength)
+        return Verdict::TOO_LONG;
+    size_t scheme = url.find("://");
+    if (scheme != std::string_view::npos)
+        url.remove_prefix(scheme + 3);
+
+    if (rules > 0) {
+        uint32_t state = 0;
+        for (size_t i = 0; i < url.size(); ++i) {
+            state = next[state * numClasses +
+                         classOf[static_cast<unsigned char>(url[i])]];
+            uint8_t f = flags[state];
+            if (f != 0 && ((f & kMatch) || depth[state] == i + 1))
+                return Verdict::DENIED;
+        }
+    }
+
+    size_t start = std::min(url.find('/'), url.size());
+    size_t end = std::min(url.find_first_of("?#", start), url.size());
+    std::string_view path = url.substr(start, end - start);
+    size_t segments = 0;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '/' && i + 1 < path.size() && path[i + 1] != '/')
+            ++segments;
+    }
+    if (segments > options.maxDepth)
+        return Verdict::TOO_DEEP;
+    if (segments > options.maxRepeats && loops(path))
+        return Verdict::LOOP;
+    return Verdict::ACCEPT;
+}
+
+bool UrlFilter::loops(std::string_view path) const {
+    std::string_view segments[kMaxSegments];
+    size_t n = 0;
+    for (size_t i = 0; i < path.size() && n < kMaxSegments;) {
+        size_t end = std::min(path.find('/', i), path.size());
+        if (end > i)
+            segments[n++] = path.substr(i, end - i);
+        i = end + 1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        size_t seen = 1;
+        for (size_t j = i + 1; j < n; ++j) {
+            if (segments[j] == segments[i] && ++seen > options.maxRepeats)
+                return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> UrlFilter::readRules(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("can't open " + path);
+    std::vector<std::string> rules;
+    for (std::string line; std::getline(file, line);) {
+        std::string_view rule = trim(line);
+        if (!rule.empty() && rule[0] != '#')
+            rules.emplace_back(rule);
+    }
+    return rules;
+}
+
+HostQuota::HostQuota(uint32_t limit)
+    : limit(limit), slots(limit > 0 ? 64 : 0) {}
+
+size_t HostQuota::find(uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    while (slots[i].count != 0 && slots[i].hash != hash)
+        i = (i + 1) & mask;
+    return i;
+}
+
+bool HostQuota::allows(std::string_view host) const {
+    if (!enabled())
+        return true;
+    return slots[find(xxhash::hash64(host))].count < limit;
+}
+
+void HostQuota::count(std::string_view host) {
+    if (!enabled())
+        return;
+    uint64_t hash = xxhash::hash64(host);
+    Slot& slot = slots[find(hash)];
+    if (slot.count > 0) {
+        slot.count = std::min(slot.count, limit - 1) + 1;
+        return;
+    }
+    slot = Slot{hash, 1};
+    // Kept at most half full.
+    if (2 * ++used > slots.size()) {
+        std::vector<Slot> old(2 * slots.size());
+        old.swap(slots);
+        for (const Slot& s : old) {
+            if (s.count != 0)
+                slots[find(s.hash)] = s;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Rejects urls that are not worth a fetch before they take a seen-filter
+// slot or a place in the queue: urls matching a deny rule, urls too long or
+// too deep, and urls whose path repeats a segment, the mark of relative
+// links looping back into themselves (/a/b/a/b/a/b).
+//
+// Rules are substrings of the url after "scheme://", so they can name a
+// host, a path or a query parameter ("/wiki/Special:", "sessionid=").
+// A rule starting with '^' only matches at the start of the host. The rules
+// are compiled once into an Aho-Corasick automaton with a full transition
+// table over the bytes the rules use, so checking a url is a single pass
+// over it, however many rules there are.
+//
+// Urls are expected in canonical form (see UrlCanonicalizer). Immutable
+// once built; check() may be called from any thread.
+class UrlFilter {
+   public:
+    struct Options {
+        std::vector<std::string> deny;
+        size_t maxLength = 2048;
+        size_t maxDepth = 16;   // path segments
+        size_t maxRepeats = 3;  // times one segment may appear in a path
+    };
+
+    enum class Verdict : uint8_t { ACCEPT, DENIED, TOO_LONG, TOO_DEEP, LOOP };
+    static constexpr size_t kNumVerdicts = 5;
+    static const char* describe(Verdict verdict);
+
+    explicit UrlFilter(const Options& options);
+    UrlFilter() : UrlFilter(Options()) {}
+
+    Verdict check(std::string_view url) const;
+
+    size_t numRules() const { return rules; }
+
+    // Reads rules, one per line; blank lines and lines starting with '#'
+    // are skipped. Throws std::runtime_error if path can't be read.
+    static std::vector<std::string> readRules(const std::string& path);
+
+   private:
+    static constexpr uint8_t kMatch = 1;     // a rule ends here
+    static constexpr uint8_t kAnchored = 2;  // a '^' rule ends here
+
+    Options options;
+    size_t rules = 0;
+    // next[state * numClasses + classOf[byte]]; state 0 is the root.
+    std::array<uint8_t, 256> classOf;
+    size_t numClasses = 1;
+    std::vector<uint32_t> next;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> depth;
+
+    void build(const std::vector<std::string>& deny);
+    bool loops(std::string_view path) const;
+};
+
+// Counts the urls admitted per host and caps them, so a calendar or a
+// session-id trap on one host can't fill the frontier. Hosts are kept by
+// their XXH64 hash alone, 16 bytes each in an open-addressing table.
+class HostQuota {
+   public:
+    // A limit of 0 admits everything and counts nothing.
+    explicit HostQuota(uint32_t limit = 0);
+
+    bool enabled() const { return limit > 0; }
+
+    // Whether host may have another url. Doesn't count it; count() does
+    // once the url is known to be new.
+    bool allows(std::string_view host) const;
+    void count(std::string_view host);
+
+    size_t numHosts() const { return used; }
+
+   private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t count = 0;  // 0: empty
+    };
+
+    uint32_t limit;
+    std::vector<Slot> slots;
+    size_t used = 0;
+
+    size_t find(uint64_t hash) const;
+};
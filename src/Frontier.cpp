@@ -1,292 +1,529 @@
 #include "Frontier.hpp"
 #include <sys/types.h>
+#include <algorithm>
 #include <chrono>
 
-Frontier::Frontier(int port, int maxClients, uint32_t maxUrls, int batchSize,
+Frontier::Frontier(int port, int maxClients, uint32_t maxUrls,
+                   BatchSizer::Options batchOptions,
                    std::string seedList, std::string saveFileName,
-                   int checkpointFrequency, int frontierCapacity, std::string emergencyRecovery)
+                   int checkpointFrequency, int frontierCapacity, std::string emergencyRecovery,
+                   int crawlDelay, int hostBurst, std::string spillDir,
+                   std::vector<std::unique_ptr<DedupStore>> seen,
+                   ClusterMap cluster, int fullCheckpointEvery,
+                   bool writeAheadLog, UrlFilter urlFilter,
+                   uint32_t maxUrlsPerHost, size_t robotsBytes,
+                   RetryQueue::Options retryOptions,
+                   PriorityQueue::Engine queueEngine,
+                   uint32_t leaseTimeoutMs)
     : _server(Server(port, maxClients)),
-      _pq(PriorityQueue(frontierCapacity)),
-      _filter(BloomFilter(maxUrls, 0.01)),
+      _pipeline(_server,
+                [this](const Message& m, const FrontierMessageView& request) {
+                    return _serve(m, request);
+                }),
+      _shards(std::move(seen),
+              ShardedFrontier::Options{static_cast<size_t>(frontierCapacity),
+                                       static_cast<uint32_t>(crawlDelay),
+                                       static_cast<uint32_t>(hostBurst),
+                                       spillDir, 256, maxUrlsPerHost,
+                                       queueEngine}),
+      _urlFilter(std::move(urlFilter)),
+      _robots(robotsBytes),
+      _retries(retryOptions),
+      _batches(batchOptions),
+      _leases(leaseTimeoutMs),
+      _cluster(std::move(cluster)),
       _saveFileName(saveFileName),
+      _checkpointWriter(saveFileName),
+      _fullCheckpointEvery(std::max(fullCheckpointEvery, 1)),
       _maxUrls(maxUrls),
-      _batchSize(batchSize),
       _checkpointFrequency(checkpointFrequency),
       _lastCheckpoint(0),
       _maxFrontierSize(frontierCapacity), 
       _seedList(seedList),
       _emergencyRecovery(emergencyRecovery) {
-    spdlog::info("Bloom filter size {}", _filter.bloom.size());
-    spdlog::info("Bloom filter num hashes {}", _filter.numHashes);
-
-    std::ifstream file(seedList);
-    if (!file) {
-        spdlog::error("Couldn't open {}", seedList);
-        exit(EXIT_FAILURE);
+    spdlog::info("{} shards, seen urls: {}", _shards.numShards(),
+                 _shards.describeSeen());
+    if (writeAheadLog) {
+        _log = std::make_unique<WriteAheadLog>(
+            Checkpoint::logPath(_saveFileName));
     }
 
-    std::string url;
-    while (std::getline(file, url)) {
-        _pq.push(url);
+    if (_cluster.size() > 1) {
+        _peers = std::make_unique<PeerExchange>(_cluster,
+                                                PeerExchange::Options());
+        if (!_peers->start()) {
+            spdlog::error("Couldn't listen for peers on port {}",
+                          _cluster.node(_cluster.self()).peerPort);
+            exit(EXIT_FAILURE);
+        }
+        _redirects.resize(_cluster.size());
+        spdlog::info("Node {} of {}, peers on port {}", _cluster.self(),
+                     _cluster.size(), _cluster.node(_cluster.self()).peerPort);
     }
-    file.close();
 }
 
 Frontier::~Frontier() {}
 
-void Frontier::_checkpoint() {
-    spdlog::info("Checkpointing");
-    std::ofstream saveFile(_saveFileName, std::ios::out | std::ios::trunc);
-
-    // Write size of pq
-    size_t pqSize = _pq.data.size();
-    saveFile.write(reinterpret_cast<char*>(&pqSize), sizeof(pqSize));
-    // Write pq
-    for (const std::string& url : _pq.data) {
-        size_t len = url.size();
-        saveFile.write(reinterpret_cast<char*>(&len), sizeof(len));
-        saveFile.write(url.data(), len);
-    }
-    spdlog::info("Writing {} pq elements to {}", _pq.size(), _saveFileName);
-
-    // Write filter attributes
-    spdlog::info("Writing {} bits to file", _filter.bits);
-    saveFile.write(reinterpret_cast<char*>(&_filter.bits),
-                   sizeof(_filter.bits));
-    spdlog::info("Writing {} numHashes to file", _filter.numHashes);
-    saveFile.write(reinterpret_cast<char*>(&_filter.numHashes),
-                   sizeof(_filter.numHashes));
-
-    // Write size of filter
-    uint64_t i = 0;
-    uint64_t logInterval = _filter.bits / 10; // Log every 10%
-    for (const bool& b : _filter.bloom) {
-        saveFile.write(reinterpret_cast<const char*>(&b), sizeof(b));
-        i++;
-        if (i % logInterval == 0) {
-            spdlog::info("{:.2f}% done", (double(i) / _filter.bits) * 100);
+void Frontier::queueSeeds() {
+    auto start = std::chrono::steady_clock::now();
+    SeedList seeds;
+    try {
+        seeds = SeedList::read(_seedList);
+    } catch (const std::runtime_error& err) {
+        spdlog::error("Couldn't open {}: {}", _seedList, err.what());
+        exit(EXIT_FAILURE);
+    }
+
+    // Every node reads the same seed list and keeps the hosts it owns.
+    // Seeds are marked seen, so a page linking back to one doesn't queue
+    // it again.
+    // Canonical seeds are copied into one buffer, then viewed once it no
+    // longer moves.
+    std::string canonical;
+    std::vector<std::pair<size_t, size_t>> spans;
+    for (std::string_view url : seeds.urls()) {
+        std::string_view cleaned = _canonicalizer.canonicalize(url);
+        if (!cleaned.empty() && _accept(cleaned) && _cluster.owns(cleaned)) {
+            spans.emplace_back(canonical.size(), cleaned.size());
+            canonical += cleaned;
         }
     }
-    spdlog::info("Finished checkpointing");
-    saveFile.close();
+    std::vector<std::string_view> owned;
+    owned.reserve(spans.size());
+    for (auto [offset, length] : spans)
+        owned.emplace_back(canonical.data() + offset, length);
+    _shards.addBulk(owned, true);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    spdlog::info("Queued {} of {} seeds in {} ms", _shards.size(),
+                 seeds.size(), ms);
+    spdlog::info("Spill tier holds {} urls", _shards.spilled());
 }
 
-void Frontier::recoverFilter(std::string filePath) {
-    spdlog::info("Recovering pq and filter");
-    std::ifstream saveFile(filePath, std::ios::binary);
+void Frontier::_checkpoint() {
+    // The first checkpoint of a run is full, and so is the one after a
+    // failed write, since a delta only makes sense on top of its base.
+    CheckpointWriter::Stats written = _checkpointWriter.stats();
+    bool full = _sinceFullCheckpoint == 0 || written.failed;
+    if (written.failed) {
+        spdlog::error("Failed to write checkpoint {}", _saveFileName);
+    } else if (written.written > 0) {
+        spdlog::info("Last checkpoint wrote {} bytes in {:.1f} ms",
+                     written.lastBytes, written.lastWriteMs);
+    }
+
+    // Log segments before the last checkpoint on disk are not needed, nor
+    // are the spill segments it read back.
+    uint64_t logSegment = 0;
+    if (_log) {
+        _log->release(written.logSegment);
+        logSegment = _log->rotate();
+    }
+    _shards.releaseSpill(written.spillEpoch);
+
+    // Serving only pauses while the shards copy their state; the writer
+    // thread does the I/O.
+    auto start = std::chrono::steady_clock::now();
+    ShardedFrontier::Snapshot snapshot = _shards.snapshot(full);
+    size_t bytes = snapshot.bytes();
+    _checkpointWriter.write(std::move(snapshot), logSegment);
+    auto stall = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    _sinceFullCheckpoint = full ? 1 : (_sinceFullCheckpoint + 1) % _fullCheckpointEvery;
+
+    spdlog::info("{} checkpoint of {} urls: serving paused {} us, {} bytes "
+                 "handed to the writer",
+                 full ? "Full" : "Incremental", _shards.size(), stall, bytes);
+    if (_log) {
+        WriteAheadLog::Stats log = _log->stats();
+        spdlog::info("Log: {} records, {} bytes in {} syncs", log.records,
+                     log.bytes, log.syncs);
+    }
+}
 
-    size_t pqSize = 0;
-    saveFile.read(reinterpret_cast<char*>(&pqSize), sizeof(pqSize));
-    if (pqSize <= 0) {
+bool Frontier::recoverFilter(std::string filePath) {
+    spdlog::info("Recovering pq and filter");
+    Checkpoint checkpoint;
+    try {
+        checkpoint = Checkpoint::read(filePath);
+    } catch (const std::runtime_error& err) {
+        spdlog::warn("{}, skipping recovery", err.what());
+        return false;
+    }
+    if (checkpoint.numQueued == 0 && checkpoint.numLogged == 0) {
         spdlog::warn("Checkpoint file pq size is <= 0, skipping recovery");
-        return;
+        return false;
+    }
+    if (checkpoint.numShards() != _shards.numShards()) {
+        spdlog::error("{} has {} shards, not {} (written with a different "
+                      "--shards?)", filePath, checkpoint.numShards(),
+                      _shards.numShards());
+        exit(EXIT_FAILURE);
     }
 
-    _pq.data.resize(pqSize);
-    for (size_t i = 0; i < pqSize; ++i) {
-        size_t len;
-        saveFile.read(reinterpret_cast<char*>(&len), sizeof(len));
-        _pq.data[i].resize(len);
-        saveFile.read(_pq.data[i].data(), len);
-    }
-    
-    // if (_pq.size() < 1000) {
-    //     spdlog::warn("Emergency, pq is too small.");
-    //         std::ifstream file(_emergencyRecovery);
-    //     if (!file) {
-    //         spdlog::error("Couldn't open {}", _emergencyRecovery);
-    //         exit(EXIT_FAILURE);
-    //     }
-    //
-    //     std::string url;
-    //     while (std::getline(file, url)) {
-    //         _pq.push(url);
-    //     }
-    //     file.close();
-    // }
-
-    size_t bits;
-    size_t numHashes;
-    saveFile.read(reinterpret_cast<char*>(&bits), sizeof(bits));
-    saveFile.read(reinterpret_cast<char*>(&numHashes), sizeof(numHashes));
-    spdlog::info("Read in bloom filter bits {}", bits);
-    spdlog::info("Read in bloom filter num hashes {}", numHashes);
-
-    if (bits <= 0) {
-        spdlog::warn("Filter pq size is <= 0");
-    }
-    spdlog::info("Read in bloom filter size {}", bits);
-
-    _filter.bloom.resize(bits);
-    _filter.bits = bits;
-    _filter.numHashes = numHashes;
-    for (size_t i = 0; i < bits; ++i) {
-        char b;
-        saveFile.read(&b, sizeof(b));
-        _filter.bloom[i] = static_cast<bool>(b);
+    // The seen stores are mapped straight from the file or their own
+    // files, then brought up to date by the deltas.
+    if (!_shards.loadSeen(filePath, checkpoint.seen)) {
+        spdlog::error("Couldn't load seen urls from {}", filePath);
+        exit(EXIT_FAILURE);
+    }
+    for (const std::vector<uint64_t>& offsets : checkpoint.seenDeltas) {
+        if (!_shards.loadSeenDelta(Checkpoint::deltaPath(filePath), offsets)) {
+            spdlog::error("Couldn't apply seen url deltas from {}",
+                          Checkpoint::deltaPath(filePath));
+            exit(EXIT_FAILURE);
+        }
     }
+
+    // Every shard parses its own urls from the mapped base and builds its
+    // queue in one pass. Urls logged after the last snapshot go through
+    // the seen stores again, in order, so duplicates are dropped as they
+    // were the first time.
+    auto start = std::chrono::steady_clock::now();
+    _shards.restore([&](size_t shard) { return checkpoint.restore(shard); });
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    spdlog::info("Read {} urls from the base and {} incremental checkpoints "
+                 "and {} log records from {} segments ({} torn): {} urls "
+                 "queued in {} ms",
+                 checkpoint.numQueued, checkpoint.seenDeltas.size(),
+                 checkpoint.log.records, checkpoint.log.segments,
+                 checkpoint.log.torn, _shards.size(), ms);
+    spdlog::info("Read in {}", _shards.describeSeen());
     spdlog::info("Done receovering pq and filter");
+    return true;
 }
 
 void Frontier::start() {
-    spdlog::info("Starting pq size {}", _pq.size());
-    auto startTime = std::chrono::steady_clock::now();
-    auto lastTime = startTime;
-    uint32_t lastNumUrls = 0;
-    while (_numUrls < _maxUrls) {
-        if (_pq.size() == 0) {
-            spdlog::error("Frontier size is 0. Killing frontier and restarting");
-            exit(EXIT_FAILURE);
-        }
-        auto timeBeforeMessage = std::chrono::steady_clock::now();
-        std::vector<Message> messages = _server.GetMessages();
-        auto timeAfterMessage = std::chrono::steady_clock::now();
-        if (messages.size() == 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
-        }
-        for (auto m : messages) {
-            spdlog::info("Request from {}:{}", m.senderIp, m.senderPort);
-
-            FrontierMessage decodedMessage;
-            try {
-                decodedMessage = FrontierInterface::Decode(m.msg);
-            } catch (const std::runtime_error& e) {
-                spdlog::error("Error decoding message");
-                continue;
-            }
-            FrontierMessage response = _handleMessage(decodedMessage);
-
-            Message msg;
-            msg.receiverSock = m.senderSock;
-            try {
-                msg.msg = FrontierInterface::Encode(response);
-            } catch (const std::runtime_error& e) {
-                spdlog::error("Error encoding message");
-                msg.msg = "";
-            }
+    spdlog::info("Starting pq size {}", _shards.size());
+    _startTime = std::chrono::steady_clock::now();
+    _lastTime = _startTime;
 
-            _server.SendMessage(msg);
-        }
-        auto now = std::chrono::steady_clock::now();
-        double elapsedSeconds =
-            std::chrono::duration_cast<std::chrono::duration<double>>(now -
-                                                                      startTime)
-                .count();
-        double elapsedSinceLastSeconds =
-            std::chrono::duration_cast<std::chrono::duration<double>>(now -
-                                                                      lastTime)
-                .count();
-        double timeWaitingMessage =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                timeAfterMessage - timeBeforeMessage)
-                .count();
-
-        double timeProcessingRequest =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                now - timeAfterMessage)
-                .count();
-
-        uint32_t documentDiff = _numUrls - lastNumUrls;
-        lastNumUrls = _numUrls;
-
-        double elapsedMinutes = elapsedSeconds / 60.0;
-        lastTime = now;
-
-        spdlog::info("Served {} out of {}", _numUrls, _maxUrls);
-        spdlog::info("Frontier size: {}", _pq.size());
-
-        if (elapsedSeconds > 0) {
-            double urlsPerSecond = _numUrls / elapsedSeconds;
-            spdlog::info("Elapsed time: {:.2f} minutes", elapsedMinutes);
-            spdlog::info("{:.2f} URLs/second", urlsPerSecond);
-            spdlog::info(
-                "{} seconds since last request, delta since last {:.2f}",
-                elapsedSinceLastSeconds,
-                documentDiff / elapsedSinceLastSeconds);
-            spdlog::info("Time waiting for message {} ms", timeWaitingMessage);
-            spdlog::info("Time processing request {} ms",
-                         timeProcessingRequest);
-        }
+    _pipeline.onDecodeError([](const Message& m, const std::exception& e) {
+        spdlog::error("Error decoding message from {}:{}: {}", m.senderIp,
+                      m.senderPort, e.what());
+    });
+    _pipeline.onLatency(1000, [](const LatencyHistogram& latency) {
+        spdlog::info("Request latency p50 {} us, p99 {} us, max {} us over {} "
+                     "requests",
+                     latency.percentile(50), latency.percentile(99),
+                     latency.max(), latency.count());
+    });
+    if (_log) {
+        _pipeline.onCommit([this]() { return _log->mark(); },
+                           [this](uint64_t position) {
+                               if (!_log->waitFor(position)) {
+                                   spdlog::error("Failed to write the log, "
+                                                 "exiting to recover");
+                                   exit(EXIT_FAILURE);
+                               }
+                           });
+    }
 
-        if (_numUrls >= _lastCheckpoint + _checkpointFrequency) {
-            _checkpoint();
-            _lastCheckpoint = _numUrls;
-        }
+    // The log only holds changes from here on, so start from a checkpoint
+    // of the seeds or the recovered state.
+    _checkpoint();
+    _pipeline.run();
+}
+
+FrontierMessage Frontier::_serve(const Message& m,
+                                 const FrontierMessageView& request) {
+    if (_numUrls >= _maxUrls) {
+        spdlog::info("Request from {}:{}. Sending END message back",
+                     m.senderIp, m.senderPort);
+        return FrontierMessage{FrontierMessageType::END, {}};
     }
 
-    while (true) {
-        std::vector<Message> messages = _server.GetMessagesBlocking();
-        for (auto m : messages) {
-            spdlog::info("Request from {}:{}. Sending END message back",
-                         m.senderIp, m.senderPort);
-
-            FrontierMessage endMessage{FrontierMessageType::END, {}};
-            Message msg;
-            msg.receiverSock = m.senderSock;
-            try {
-                msg.msg = FrontierInterface::Encode(endMessage);
-            } catch (const std::runtime_error& e) {
-                spdlog::error("Error encoding message");
-                msg.msg = "";
-            }
+    _exchange();
+    // A cluster node can run dry while its peers still forward urls to it.
+    if (_shards.size() == 0 && !_peers) {
+        spdlog::error("Frontier size is 0. Killing frontier and restarting");
+        exit(EXIT_FAILURE);
+    }
 
-            _server.SendMessage(msg);
-        }
+    spdlog::info("Request from {}:{}", m.senderIp, m.senderPort);
+    if (request.type == FrontierMessageType::START &&
+        FrontierInterface::ProtocolOf(m.msg) == FrontierProtocol::COMPACT) {
+        spdlog::info("{}:{} uses the compact protocol", m.senderIp,
+                     m.senderPort);
     }
-}
 
-std::string trim(const std::string& str) {
-    auto start = std::find_if_not(str.begin(), str.end(), [](unsigned char c) {
-        return std::isspace(c);
-    });
+    if (request.type == FrontierMessageType::START && _peers) {
+        size_t target = _redirectTarget();
+        if (target != _cluster.self()) {
+            std::string address = _cluster.node(target).workerAddress();
+            spdlog::info("Redirecting {}:{} to node {} at {}", m.senderIp,
+                         m.senderPort, target, address);
+            _addUrls(request);
+            _peers->flush();
+            return FrontierMessage{FrontierMessageType::REDIRECT, {address}};
+        }
+        ++_workers;
+    }
+    if (request.type == FrontierMessageType::START) {
+        _batches.restart(m.senderSock);
+    }
 
-    auto end = std::find_if_not(str.rbegin(), str.rend(), [](unsigned char c) {
-                   return std::isspace(c);
-               }).base();
+    auto timeBeforeRequest = std::chrono::steady_clock::now();
+    FrontierMessage response = _handleMessage(m.senderSock, request);
+    auto now = std::chrono::steady_clock::now();
+
+    double elapsedSeconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(now -
+                                                                  _startTime)
+            .count();
+    double elapsedSinceLastSeconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(now -
+                                                                  _lastTime)
+            .count();
+    double timeProcessingRequest =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - timeBeforeRequest)
+            .count();
+
+    uint32_t documentDiff = _numUrls - _lastNumUrls;
+    _lastNumUrls = _numUrls;
+
+    double elapsedMinutes = elapsedSeconds / 60.0;
+    _lastTime = now;
+
+    spdlog::info("Served {} out of {}", _numUrls, _maxUrls);
+    spdlog::info("Frontier size: {} across {} hosts ({} in cooldown)",
+                 _shards.size(), _shards.numHosts(), _shards.numParkedHosts());
+
+    if (elapsedSeconds > 0) {
+        double urlsPerSecond = _numUrls / elapsedSeconds;
+        spdlog::info("Elapsed time: {:.2f} minutes", elapsedMinutes);
+        spdlog::info("{:.2f} URLs/second", urlsPerSecond);
+        spdlog::info("{} seconds since last request, delta since last {:.2f}",
+                     elapsedSinceLastSeconds,
+                     documentDiff / elapsedSinceLastSeconds);
+        spdlog::info("Time processing request {} us, {} requests queued",
+                     timeProcessingRequest, _pipeline.backlog());
+    }
+    spdlog::info("Filtered: {} accepted, {} denied by a rule, {} too long, "
+                 "{} too deep, {} looping, {} over the host cap",
+                 _filtered[0], _filtered[1], _filtered[2], _filtered[3],
+                 _filtered[4], _shards.overQuota());
+    spdlog::info("Robots: {} hosts in {} bytes, {} evicted, {} urls disallowed",
+                 _robots.numHosts(), _robots.bytes(), _robots.evictions(),
+                 _disallowed);
+    spdlog::info("Retries: {} failed, {} retried, {} given up, {} waiting, "
+                 "{} hosts demoted ({} bytes)",
+                 _retries.failures(), _retries.retries(), _retries.givenUp(),
+                 _retries.pending(), _retries.numDemoted(), _retries.bytes());
+    spdlog::info("Leases: {} urls in flight to {} workers ({} bytes), {} "
+                 "expired and {} revoked urls sent again",
+                 _leases.inFlight(), _leases.numLeases(), _leases.bytes(),
+                 _leases.expired(), _leases.revoked());
+    const BatchSizer::Stats& batches = _batches.stats();
+    if (batches.requests > 0) {
+        spdlog::info("Batches: {:.1f} urls on average, {:.0f} round-trips "
+                     "per 1M urls, workers waited {:.2f} ms per request "
+                     "({} ms in all), {} workers measured",
+                     static_cast<double>(batches.urls) / batches.requests,
+                     _batches.roundTripsPerMillion(),
+                     batches.idleUs / 1000.0 / batches.requests,
+                     batches.idleUs / 1000, batches.workers);
+    }
+    if (_peers) {
+        PeerExchange::Stats stats = _peers->stats();
+        spdlog::info("Forwarded {} urls to peers ({} bytes), received {}",
+                     stats.forwarded, stats.bytesSent, stats.received);
+    }
 
-    if (start >= end)
-        return "";
-    return std::string(start, end);
+    if (_numUrls >= _lastCheckpoint + _checkpointFrequency) {
+        _checkpoint();
+        _lastCheckpoint = _numUrls;
+    }
+    return response;
 }
 
-FrontierMessage Frontier::_handleMessage(FrontierMessage msg) {
+FrontierMessage Frontier::_handleMessage(int sock,
+                                         const FrontierMessageView& msg) {
     if (msg.type == FrontierMessageType::START) {
     } else if (msg.type == FrontierMessageType::ROBOTS) {
-        // Add to robots.txt set
+        // Crawl delays go to the shards of the hosts this node owns; a bare
+        // host maps like its urls.
+        size_t hosts = _robots.load(
+            msg.urls, [this](std::string_view host, uint32_t delayMs) {
+                if (_cluster.ownerOf(host) == _cluster.self()) {
+                    _shards.setCrawlDelay(host, delayMs);
+                }
+            });
+        _shards.flush();
+        spdlog::info("Robots rules for {} hosts; {} hosts cached in {} bytes",
+                     hosts, _robots.numHosts(), _robots.bytes());
         return FrontierMessage{FrontierMessageType::URLS, {}};
     }
 
     // Add to priority queue
     spdlog::info("Received {}", msg.urls.size());
+    _settleLeases(sock, msg);
+    _addUrls(msg);
+    _retryFailed(msg);
+
+    auto micros = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   t.time_since_epoch())
+            .count();
+    };
+    int64_t received = micros(_pipeline.received());
+    size_t batchSize = _batches.size(sock, received);
+
+    if (_shards.size() < 1000) {
+        _batches.served(sock, 1, received,
+                        micros(std::chrono::steady_clock::now()));
+        return FrontierMessage{FrontierMessageType::URLS, {"https://en.wikipedia.org/wiki/Wikipedia:Random"}};
+    }
 
-    for (auto url : msg.urls) {
-        if (_pq.size() >= _maxFrontierSize ) {
-            break;
+    std::vector<std::string> urls = _shards.take(batchSize, 5);
+    if (_log) {
+        for (const std::string& url : urls) {
+            _log->take(url);
         }
-        std::string cleaned = trim(url);
-        if (cleaned == "") {
+    }
+    // Urls queued before their host's rules arrived are dropped here.
+    urls.erase(std::remove_if(urls.begin(), urls.end(),
+                              [this](const std::string& url) {
+                                  return !_allowedByRobots(url);
+                              }),
+               urls.end());
+    _numUrls += urls.size();
+    _leases.lease(sock, urls, Politeness::nowMs());
+    _batches.served(sock, urls.size(), received,
+                    micros(std::chrono::steady_clock::now()));
+
+    return FrontierMessage{FrontierMessageType::URLS, urls};
+}
+
+void Frontier::_addUrls(const FrontierMessageView& msg) {
+    // Each url goes to the node and then the shard owning its host, which
+    // drops it if seen.
+    for (std::string_view url : msg.urls) {
+        std::string_view cleaned = _canonicalizer.canonicalize(url);
+        if (cleaned.empty() || !_accept(cleaned)) {
             continue;
         }
-        if (!_filter.contains(cleaned)) {
-            _filter.insert(cleaned);
-            _pq.push(cleaned);
+        size_t owner = _cluster.ownerOf(cleaned);
+        if (owner == _cluster.self()) {
+            if (!_allowedByRobots(cleaned)) {
+                continue;
+            }
+            _shards.add(cleaned, true);
+            if (_log) {
+                _log->add(cleaned);
+            }
+        } else {
+            _peers->forward(owner, cleaned);
         }
     }
+    _shards.flush();
+    if (_peers) {
+        _peers->flush();
+    }
+}
 
-    if (_pq.size () < 1000) {
-        return FrontierMessage{FrontierMessageType::URLS, {"https://en.wikipedia.org/wiki/Wikipedia:Random"}};
+void Frontier::_settleLeases(int sock, const FrontierMessageView& msg) {
+    // Urls handed back were counted as served. _addUrls flushes them to
+    // the shards.
+    auto redispatch = [this](std::string_view url) {
+        _requeue(url);
+        --_numUrls;
+    };
+    if (msg.type == FrontierMessageType::START) {
+        _leases.revoke(sock, redispatch);
+    } else {
+        _leases.ack(sock);
     }
+    _leases.expire(Politeness::nowMs(), redispatch);
+}
 
-    // Add failed urls back to queue
-    // for (auto url : msg.failed) {
-    //     _pq.push(url);
-    // }
+void Frontier::_retryFailed(const FrontierMessageView& msg) {
+    int64_t now = Politeness::nowMs();
+    for (std::string_view url : msg.failed) {
+        _retries.fail(url, now);
+    }
+    _retries.release(
+        now, [this](std::string_view url) { _requeue(url); },
+        [this](std::string_view host, uint32_t rounds) {
+            _shards.demote(host, rounds);
+        });
+    _shards.flush();
+}
 
-    std::vector<std::string> urls = _pq.popN(_batchSize);
-    _numUrls += urls.size();
+void Frontier::_requeue(std::string_view url) {
+    _shards.add(url, false);
+    if (_log) {
+        _log->requeue(url);
+    }
+}
 
-    return FrontierMessage{FrontierMessageType::URLS, urls};
+bool Frontier::_accept(std::string_view url) {
+    UrlFilter::Verdict verdict = _urlFilter.check(url);
+    ++_filtered[static_cast<size_t>(verdict)];
+    return verdict == UrlFilter::Verdict::ACCEPT;
+}
+
+bool Frontier::_allowedByRobots(std::string_view url) {
+    if (_robots.check(url) != RobotsCache::Access::DISALLOWED) {
+        return true;
+    }
+    ++_disallowed;
+    return false;
+}
+
+void Frontier::_exchange() {
+    if (!_peers) {
+        return;
+    }
+    _fromPeers.clear();
+    _peers->receive(_fromPeers);
+    for (const std::string& url : _fromPeers) {
+        if (!_allowedByRobots(url)) {
+            continue;
+        }
+        _shards.add(url, true);
+        if (_log) {
+            _log->add(url);
+        }
+    }
+    _shards.flush();
+    _peers->flush();
+    _peers->setLoad(_shards.size(), _workers);
+}
+
+size_t Frontier::_redirectTarget() {
+    // Peers advertise their worker count every heartbeat. Workers sent
+    // somewhere since its count last changed are added on top, so a burst
+    // of STARTs is not all sent to the same node.
+    size_t best = _cluster.self();
+    uint32_t bestWorkers = _workers;
+    for (size_t i = 0; i < _cluster.size(); ++i) {
+        if (i == _cluster.self()) {
+            continue;
+        }
+        PeerExchange::PeerLoad load = _peers->peerLoad(i);
+        if (!load.alive) {
+            continue;
+        }
+        if (load.workers != _redirects[i].advertised) {
+            _redirects[i] = {load.workers, 0};
+        }
+        uint32_t workers = load.workers + _redirects[i].sent;
+        // Needs a gap of two, so a worker is never bounced back.
+        if (workers + 1 < bestWorkers) {
+            best = i;
+            bestWorkers = workers;
+        }
+    }
+    if (best != _cluster.self()) {
+        ++_redirects[best].sent;
+    }
+    return best;
 }
 
 int main(int argc, char** argv) {
@@ -308,7 +545,22 @@ int main(int argc, char** argv) {
 
     program.add_argument("-b", "--batchsize")
         .default_value(4)
-        .help("Number of urls to send in one response")
+        .help("Number of urls to send a worker until its fetch rate is known")
+        .scan<'i', int>();
+
+    program.add_argument("--minbatch")
+        .default_value(1)
+        .help("Fewest urls to send in one response")
+        .scan<'i', int>();
+
+    program.add_argument("--maxbatch")
+        .default_value(1000)
+        .help("Most urls to send in one response")
+        .scan<'i', int>();
+
+    program.add_argument("--batchtarget")
+        .default_value(5000)
+        .help("Milliseconds of fetching to send each worker per response; 0 always sends --batchsize")
         .scan<'i', int>();
 
     program.add_argument("-s", "--savefile")
@@ -333,6 +585,90 @@ int main(int argc, char** argv) {
         .default_value(10000)
         .scan<'i', int>();
 
+    program.add_argument("-d", "--crawldelay")
+        .default_value(0)
+        .help("Minimum milliseconds between urls sent for the same host, 0 to disable")
+        .scan<'i', int>();
+
+    program.add_argument("--hostburst")
+        .default_value(1)
+        .help("Number of urls a host can be sent back to back before --crawldelay applies")
+        .scan<'i', int>();
+
+    program.add_argument("--spilldir")
+        .default_value("../frontier_spill")
+        .help("Directory for urls that overflow --frontiercapacity");
+
+    program.add_argument("--dedup")
+        .default_value("bloom")
+        .help("Seen url store: bloom (fixed memory, ~1% false positives) or exact");
+
+    program.add_argument("--dedupdir")
+        .default_value("../frontier_seen")
+        .help("Directory for the run files of --dedup exact");
+
+    program.add_argument("--fullevery")
+        .default_value(10)
+        .help("Make every n-th checkpoint full; the others only write what changed")
+        .scan<'i', int>();
+
+    program.add_argument("--nowal")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Don't log changes between checkpoints; a crash loses them");
+
+    program.add_argument("--shards")
+        .default_value(1)
+        .help("Number of cores the queue and seen urls are partitioned over, by host")
+        .scan<'i', int>();
+
+    program.add_argument("--cluster")
+        .default_value("")
+        .help("Cluster nodes as ip:workerPort:peerPort,...; empty to run alone");
+
+    program.add_argument("--node")
+        .default_value(0)
+        .help("Index of this node in --cluster")
+        .scan<'i', int>();
+
+    program.add_argument("--urlfilter")
+        .default_value("")
+        .help("File of deny rules for urls, such as urlFilter.txt; empty for none");
+
+    program.add_argument("--maxdepth")
+        .default_value(16)
+        .help("Drop urls with more path segments than this")
+        .scan<'i', int>();
+
+    program.add_argument("--maxperhost")
+        .default_value(0)
+        .help("Queue at most this many urls per host; 0 for no limit")
+        .scan<'i', int>();
+
+    program.add_argument("--robotsmemory")
+        .default_value(256)
+        .help("MB of robots.txt rules to cache; least recently used hosts are evicted")
+        .scan<'i', int>();
+
+    program.add_argument("--retries")
+        .default_value(3)
+        .help("Fetches per url before a failed url is dropped, at most 15")
+        .scan<'i', int>();
+
+    program.add_argument("--retrydelay")
+        .default_value(30)
+        .help("Seconds before a failed url is retried, doubled per failure")
+        .scan<'i', int>();
+
+    program.add_argument("--queue")
+        .default_value("binary")
+        .help("Host scheduler of the priority queue: binary, quad (4-ary heap) or buckets (FIFO per round)");
+
+    program.add_argument("--leasetimeout")
+        .default_value(600)
+        .help("Seconds a worker has to come back before its urls are sent to another worker; 0 to never resend")
+        .scan<'i', int>();
+
     program.add_argument("-e", "--emergencyRecovery") 
         .required()
         .help("File with links in case frontier runs out");
@@ -349,30 +685,127 @@ int main(int argc, char** argv) {
     int maxClients = program.get<int>("-m");
     int numUrls = program.get<int>("-n");
     int batchSize = program.get<int>("-b");
+    BatchSizer::Options batchOptions;
+    batchOptions.initial = static_cast<uint32_t>(std::max(batchSize, 1));
+    batchOptions.min =
+        static_cast<uint32_t>(std::max(program.get<int>("--minbatch"), 1));
+    batchOptions.max =
+        static_cast<uint32_t>(std::max(program.get<int>("--maxbatch"), 1));
+    batchOptions.targetMs =
+        static_cast<uint32_t>(std::max(program.get<int>("--batchtarget"), 0));
     std::string saveFile = program.get<std::string>("-s");
     std::string seedList = program.get<std::string>("-l");
     int checkpointFrequency = program.get<int>("-f");
     bool recover = program.get<bool>("--recover");
     int frontierCapacity = program.get<int>("-c");
     std::string emergencyRecoveryFile = program.get<std::string>("-e");
+    int crawlDelay = program.get<int>("-d");
+    int hostBurst = program.get<int>("--hostburst");
+    std::string spillDir = program.get<std::string>("--spilldir");
+    std::string dedup = program.get<std::string>("--dedup");
+    std::string dedupDir = program.get<std::string>("--dedupdir");
+    int numShards = std::max(program.get<int>("--shards"), 1);
+    int fullEvery = program.get<int>("--fullevery");
+    bool writeAheadLog = !program.get<bool>("--nowal");
+    std::string clusterSpec = program.get<std::string>("--cluster");
+    int node = program.get<int>("--node");
+    std::string urlFilterFile = program.get<std::string>("--urlfilter");
+    int maxDepth = program.get<int>("--maxdepth");
+    int maxPerHost = std::max(program.get<int>("--maxperhost"), 0);
+    int robotsMemory = std::max(program.get<int>("--robotsmemory"), 1);
+    RetryQueue::Options retryOptions;
+    retryOptions.maxAttempts =
+        static_cast<uint32_t>(std::max(program.get<int>("--retries"), 1));
+    // Delays are capped at an hour anyway.
+    retryOptions.baseDelayMs = static_cast<uint32_t>(
+        std::clamp(program.get<int>("--retrydelay"), 1, 3600) * 1000);
+    // At most a day, which keeps it in range as milliseconds.
+    int leaseTimeout =
+        std::clamp(program.get<int>("--leasetimeout"), 0, 24 * 3600);
+    std::string queue = program.get<std::string>("--queue");
+    PriorityQueue::Engine queueEngine;
+    if (queue == "binary") {
+        queueEngine = PriorityQueue::Engine::BINARY_HEAP;
+    } else if (queue == "quad") {
+        queueEngine = PriorityQueue::Engine::QUAD_HEAP;
+    } else if (queue == "buckets") {
+        queueEngine = PriorityQueue::Engine::BUCKETS;
+    } else {
+        spdlog::error("Unknown --queue {}", queue);
+        exit(EXIT_FAILURE);
+    }
 
     spdlog::info("Port {}", port);
     spdlog::info("Max clients {}", maxClients);
     spdlog::info("Number of urls {}", numUrls);
-    spdlog::info("Batch size {}", batchSize);
+    spdlog::info("Batch size {} at first, {} to {} for {} ms of fetching",
+                 batchSize, batchOptions.min, batchOptions.max,
+                 batchOptions.targetMs);
     spdlog::info("Save file path {}", saveFile);
     spdlog::info("Seed list file path {}", seedList);
     spdlog::info("Checkpoint frequency {}", checkpointFrequency);
-    spdlog::info("PQ capacity {}", frontierCapacity);
+    spdlog::info("PQ capacity {}, engine {}", frontierCapacity, queue);
     spdlog::info("Emergency file path {}", emergencyRecoveryFile);
+    spdlog::info("Crawl delay {} ms, host burst {}", crawlDelay, hostBurst);
+    spdlog::info("Spill directory {}", spillDir);
+    spdlog::info("Dedup store {}, directory {}", dedup, dedupDir);
+    spdlog::info("Shards {}", numShards);
+
+    ClusterMap cluster;
+    if (!clusterSpec.empty()) {
+        try {
+            cluster = ClusterMap(ClusterMap::parse(clusterSpec),
+                                 static_cast<size_t>(node));
+        } catch (const std::invalid_argument& err) {
+            spdlog::error("Bad --cluster: {}", err.what());
+            exit(EXIT_FAILURE);
+        }
+        if (cluster.node(cluster.self()).workerPort != port) {
+            spdlog::warn("--port {} differs from node {}'s port {} in --cluster",
+                         port, node, cluster.node(cluster.self()).workerPort);
+        }
+    }
 
-    spdlog::info("======= Frontier Started =======");
-    Frontier frontier(port, maxClients, numUrls, batchSize, seedList, saveFile,
-                      checkpointFrequency, frontierCapacity, emergencyRecoveryFile);
+    // Hosts are spread evenly, so each shard sees about numUrls / numShards.
+    std::vector<std::unique_ptr<DedupStore>> seen;
+    for (int i = 0; i < numShards; ++i) {
+        seen.push_back(makeDedupStore(
+            dedup, numUrls / numShards + 1,
+            ShardedFrontier::shardDir(dedupDir, i, numShards)));
+        if (!seen.back()) {
+            spdlog::error("Unknown --dedup {}", dedup);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    if (recover) {
-        frontier.recoverFilter(saveFile);
+    UrlFilter::Options filterOptions;
+    filterOptions.maxDepth = static_cast<size_t>(std::max(maxDepth, 1));
+    if (!urlFilterFile.empty()) {
+        try {
+            filterOptions.deny = UrlFilter::readRules(urlFilterFile);
+        } catch (const std::runtime_error& err) {
+            spdlog::error("Bad --urlfilter: {}", err.what());
+            exit(EXIT_FAILURE);
+        }
     }
+    spdlog::info("Url filter: {} rules, depth {}, {} urls per host",
+                 filterOptions.deny.size(), filterOptions.maxDepth,
+                 maxPerHost);
+
+    spdlog::info("======= Frontier Started =======");
+    Frontier frontier(port, maxClients, numUrls, batchOptions, seedList, saveFile,
+                      checkpointFrequency, frontierCapacity, emergencyRecoveryFile,
+                      crawlDelay, hostBurst, spillDir, std::move(seen),
+                      std::move(cluster), fullEvery, writeAheadLog,
+                      UrlFilter(filterOptions),
+                      static_cast<uint32_t>(maxPerHost),
+                      static_cast<size_t>(robotsMemory) << 20,
+                      retryOptions, queueEngine,
+                      static_cast<uint32_t>(leaseTimeout) * 1000);
+
+    // Seeds are in the recovered state already.
+    if (!recover || !frontier.recoverFilter(saveFile))
+        frontier.queueSeeds();
 
     frontier.start();
     spdlog::info("======= Frontier Finished =======");
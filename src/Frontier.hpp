@@ -5,26 +5,57 @@
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
 #include <argparse/argparse.hpp>
+#include <array>
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "BloomFilter.hpp"
+#include "BatchSizer.hpp"
+#include "Checkpoint.hpp"
+#include "ClusterMap.hpp"
+#include "DedupStore.hpp"
 #include "FrontierInterface.hpp"
 #include "GatewayServer.hpp"
+#include "LeaseTable.hpp"
+#include "PeerExchange.hpp"
 #include "PriorityQueue.hpp"
+#include "RequestPipeline.hpp"
+#include "RetryQueue.hpp"
+#include "RobotsCache.hpp"
+#include "SeedList.hpp"
+#include "ShardedFrontier.hpp"
+#include "Url.hpp"
+#include "UrlFilter.hpp"
+#include "WriteAheadLog.hpp"
 
 using std::cout, std::endl;
 
 class Frontier {
    public:
-    Frontier(int port, int MAX_CLIENTS, uint32_t maxUrls, int batchSize,
+    Frontier(int port, int MAX_CLIENTS, uint32_t maxUrls,
+             BatchSizer::Options batchOptions,
              std::string seedList, std::string saveFile,
-             int checkpointFrequency, int maxFrontierSize, std::string emergencyRecovery);
+             int checkpointFrequency, int maxFrontierSize, std::string emergencyRecovery,
+             int crawlDelay, int hostBurst, std::string spillDir,
+             std::vector<std::unique_ptr<DedupStore>> seen,
+             ClusterMap cluster = ClusterMap(), int fullCheckpointEvery = 10,
+             bool writeAheadLog = true, UrlFilter urlFilter = UrlFilter(),
+             uint32_t maxUrlsPerHost = 0, size_t robotsBytes = 256u << 20,
+             RetryQueue::Options retryOptions = RetryQueue::Options(),
+             PriorityQueue::Engine queueEngine =
+                 PriorityQueue::Engine::BINARY_HEAP,
+             uint32_t leaseTimeoutMs = 600000);
 
-    void recoverFilter(std::string filePath);
+    // Queues the seeds this node owns and marks them seen.
+    void queueSeeds();
+
+    // Restores the queue and seen urls from a checkpoint and the log after
+    // it. Returns false if there was nothing to recover.
+    bool recoverFilter(std::string filePath);
 
     void start();
 
@@ -34,15 +65,63 @@ class Frontier {
     void _checkpoint();
 
     Server _server;
-    PriorityQueue _pq;
-    BloomFilter _filter;
+    // Decodes and encodes on I/O threads; _serve runs on the thread that
+    // called start() and is the only code touching the state below.
+    RequestPipeline<Server> _pipeline;
+    // Queue, spill tier and seen urls, one shard per dedup store.
+    ShardedFrontier _shards;
+    // Urls from workers and the seed list are canonicalized before they
+    // are routed and deduplicated; peers forward canonical urls.
+    UrlCanonicalizer _canonicalizer;
+    // Drops canonical urls not worth a fetch before they are routed; the
+    // shards cap the urls per host. Counts are per UrlFilter::Verdict.
+    UrlFilter _urlFilter;
+    std::array<uint64_t, UrlFilter::kNumVerdicts> _filtered{};
+    // robots.txt rules from ROBOTS messages, for the hosts this node owns.
+    // Urls they disallow are dropped on the way in and, if queued before
+    // the rules arrived, on the way out. Not checkpointed; workers fetch
+    // robots.txt again after a restart.
+    RobotsCache _robots;
+    uint64_t _disallowed = 0;
+    // Urls workers failed to fetch, waiting out their backoff before they
+    // are queued again, and the hosts to demote for failing. Not
+    // checkpointed: urls waiting here at a crash are lost.
+    RetryQueue _retries;
+    // Urls per response, sized for each worker from how fast it gets
+    // through its batches.
+    BatchSizer _batches;
+    // Urls sent to each worker until its next request, sent to another
+    // worker if it doesn't come back in time. Not checkpointed; the log
+    // has the urls as taken, so urls in flight at a crash are lost.
+    LeaseTable _leases;
+
+    // Hosts this node owns and the links to the other nodes of the
+    // cluster; no links when running alone.
+    ClusterMap _cluster;
+    std::unique_ptr<PeerExchange> _peers;
+    std::vector<std::string> _fromPeers;
+    // Workers that started here, and per node the workers redirected there
+    // since it last advertised a new count.
+    uint32_t _workers = 0;
+    struct Redirects {
+        uint32_t advertised = 0;
+        uint32_t sent = 0;
+    };
+    std::vector<Redirects> _redirects;
 
     std::string _saveFileName;
+    // Persists checkpoints in the background. Every _fullCheckpointEvery-th
+    // checkpoint is full; the others only append what changed.
+    CheckpointWriter _checkpointWriter;
+    int _fullCheckpointEvery;
+    int _sinceFullCheckpoint = 0;
+    // Urls added and taken since the last checkpoint. A response is only
+    // sent once its request's records are on disk.
+    std::unique_ptr<WriteAheadLog> _log;
 
     uint32_t _numUrls = 0;
     uint32_t _maxUrls = 0;
 
-    int _batchSize;
     int _checkpointFrequency;
     int _lastCheckpoint = 0;
     int _maxFrontierSize = 0;
@@ -50,5 +129,41 @@ class Frontier {
     std::string _seedList;
     std::string _emergencyRecovery;
 
-    FrontierMessage _handleMessage(FrontierMessage msg);
+    std::chrono::steady_clock::time_point _startTime;
+    std::chrono::steady_clock::time_point _lastTime;
+    uint32_t _lastNumUrls = 0;
+
+    // Handles one request on the core thread, logs and checkpoints.
+    FrontierMessage _serve(const Message& m, const FrontierMessageView& request);
+
+    FrontierMessage _handleMessage(int sock, const FrontierMessageView& msg);
+
+    // Queues the urls of a request here or forwards them to their owner.
+    void _addUrls(const FrontierMessageView& msg);
+
+    // Checks a canonical url against _urlFilter and counts the verdict.
+    bool _accept(std::string_view url);
+
+    // Hands the request's failed urls to _retries, and queues the urls
+    // whose backoff has passed.
+    void _retryFailed(const FrontierMessageView& msg);
+
+    // Queues a url that was handed out already for another try. It is in
+    // the seen urls, so it is logged as a requeue, which replay does not
+    // deduplicate.
+    void _requeue(std::string_view url);
+
+    // Ends the worker's lease on sock and queues the urls of leases that
+    // ran out, or were held by a worker gone from sock, again.
+    void _settleLeases(int sock, const FrontierMessageView& msg);
+
+    // Checks a url of a host this node owns against _robots.
+    bool _allowedByRobots(std::string_view url);
+
+    // Ingests urls forwarded by peers and advertises this node's load.
+    void _exchange();
+
+    // Node a starting worker should go to instead, if another node has
+    // clearly fewer workers. Returns the node itself otherwise.
+    size_t _redirectTarget();
 };
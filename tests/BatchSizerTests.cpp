@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "BatchSizer.hpp"
+
+namespace {
+
+BatchSizer::Options options() {
+    BatchSizer::Options options;
+    options.initial = 10;
+    options.min = 5;
+    options.max = 400;
+    options.targetMs = 1000;
+    return options;
+}
+
+// Serves the worker on sock `rounds` times, fetching each url in usPerUrl
+// and answering each request in 100 us. Returns the last size.
+size_t serve(BatchSizer& sizer, int sock, int64_t& now, int64_t usPerUrl,
+             int rounds) {
+    size_t size = 0;
+    for (int i = 0; i < rounds; ++i) {
+        size = sizer.size(sock, now);
+        sizer.served(sock, size, now, now + 100);
+        now += 100 + static_cast<int64_t>(size) * usPerUrl;
+    }
+    return size;
+}
+
+}  // namespace
+
+TEST(BatchSizerTest, UnmeasuredWorkerGetsInitialSize) {
+    BatchSizer sizer(options());
+    EXPECT_EQ(sizer.size(3, 0), 10);
+    EXPECT_EQ(sizer.usPerUrl(3), 0);
+    EXPECT_EQ(sizer.stats().workers, 0);
+}
+
+TEST(BatchSizerTest, SizesBatchesToTheTargetFetchTime) {
+    BatchSizer sizer(options());
+    int64_t now = 0;
+    // 10 ms per url: 100 urls fill the one-second target.
+    EXPECT_EQ(serve(sizer, 4, now, 10000, 20), 100);
+    EXPECT_NEAR(sizer.usPerUrl(4), 10000, 100);
+    EXPECT_EQ(sizer.stats().workers, 1);
+}
+
+TEST(BatchSizerTest, ClampsFastAndSlowWorkers) {
+    BatchSizer sizer(options());
+    int64_t fast = 0;
+    int64_t slow = 0;
+    EXPECT_EQ(serve(sizer, 1, fast, 10, 30), 400);
+    EXPECT_EQ(serve(sizer, 2, slow, 1000000, 30), 5);
+    EXPECT_EQ(sizer.stats().workers, 2);
+}
+
+TEST(BatchSizerTest, GrowsAtMostTwofoldPerRequest) {
+    BatchSizer sizer(options());
+    int64_t now = 0;
+    EXPECT_EQ(serve(sizer, 1, now, 10, 1), 10);
+    EXPECT_EQ(serve(sizer, 1, now, 10, 1), 20);
+    EXPECT_EQ(serve(sizer, 1, now, 10, 1), 40);
+}
+
+TEST(BatchSizerTest, RestartForgetsTheWorker) {
+    BatchSizer sizer(options());
+    int64_t now = 0;
+    serve(sizer, 7, now, 10, 10);
+    EXPECT_GT(sizer.usPerUrl(7), 0);
+    sizer.restart(7);
+    EXPECT_EQ(sizer.usPerUrl(7), 0);
+    EXPECT_EQ(sizer.stats().workers, 0);
+    EXPECT_EQ(sizer.size(7, now + 5000000), 10);
+}
+
+TEST(BatchSizerTest, EmptyResponseIsNotMeasured) {
+    BatchSizer sizer(options());
+    EXPECT_EQ(sizer.size(1, 0), 10);
+    sizer.served(1, 0, 0, 100);
+    // Nothing was fetched, so the long gap says nothing about the worker.
+    EXPECT_EQ(sizer.size(1, 60000000), 10);
+    EXPECT_EQ(sizer.usPerUrl(1), 0);
+}
+
+TEST(BatchSizerTest, ZeroTargetKeepsTheInitialSize) {
+    BatchSizer::Options fixed = options();
+    fixed.targetMs = 0;
+    BatchSizer sizer(fixed);
+    int64_t now = 0;
+    EXPECT_EQ(serve(sizer, 1, now, 10, 10), 10);
+}
+
+TEST(BatchSizerTest, CountsRoundTripsAndIdleTime) {
+    BatchSizer sizer(options());
+    sizer.served(1, 50, 0, 300);
+    sizer.served(2, 150, 1000, 1100);
+    EXPECT_EQ(sizer.stats().requests, 2);
+    EXPECT_EQ(sizer.stats().urls, 200);
+    EXPECT_EQ(sizer.stats().idleUs, 400);
+    EXPECT_DOUBLE_EQ(sizer.roundTripsPerMillion(), 10000);
+}
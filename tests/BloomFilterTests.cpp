@@ -1,7 +1,111 @@
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
 
+#include "BlockedBloomFilter.hpp"
 #include "BloomFilter.hpp"
 
 TEST(BloomFilter, Example) {
     EXPECT_TRUE(true);
 }
+
+TEST(BloomFilter, InsertAndContains) {
+    BloomFilter filter(1000, 0.01);
+    for (int i = 0; i < 1000; ++i)
+        filter.insert("https://example.com/" + std::to_string(i));
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_TRUE(filter.contains("https://example.com/" + std::to_string(i)));
+
+    int falsePositives = 0;
+    for (int i = 0; i < 10000; ++i)
+        falsePositives += filter.contains("https://other.com/" + std::to_string(i));
+    EXPECT_LT(falsePositives, 300);
+    EXPECT_GT(filter.popcount(), 0);
+}
+
+TEST(BloomFilter, SaveAndMapRoundTrip) {
+    std::string path = ::testing::TempDir() + "bloom_roundtrip";
+    BloomFilter filter(1000, 0.01);
+    for (int i = 0; i < 500; ++i)
+        filter.insert("https://example.com/" + std::to_string(i));
+
+    size_t offset;
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write("prefix", 6);  // the filter does not start the file
+        offset = static_cast<size_t>(out.tellp());
+        filter.save(out);
+    }
+
+    BloomFilter loaded(1, 0.5);
+    ASSERT_TRUE(loaded.load(path, offset));
+    std::remove(path.c_str());  // the mapping outlives the file name
+
+    EXPECT_EQ(loaded.numBits(), filter.numBits());
+    EXPECT_EQ(loaded.popcount(), filter.popcount());
+    for (int i = 0; i < 500; ++i)
+        EXPECT_TRUE(loaded.contains("https://example.com/" + std::to_string(i)));
+
+    // Writes go to private pages.
+    loaded.insert("https://new.com/");
+    EXPECT_TRUE(loaded.contains("https://new.com/"));
+}
+
+TEST(BloomFilter, LoadRejectsATruncatedFile) {
+    std::string path = ::testing::TempDir() + "bloom_truncated";
+    BloomFilter filter(100000, 0.01);
+    filter.insert("https://example.com/");
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        filter.save(out);
+    }
+    std::filesystem::resize_file(path,
+                                 std::filesystem::file_size(path) - 4096);
+
+    BloomFilter loaded(1, 0.5);
+    EXPECT_FALSE(loaded.load(path, 0));
+    std::remove(path.c_str());
+    // The filter is left as it was.
+    EXPECT_EQ(loaded.numBits(), BloomFilter(1, 0.5).numBits());
+}
+
+TEST(BlockedBloomFilter, InsertIfAbsent) {
+    BlockedBloomFilter filter(1000, 0.01);
+    EXPECT_TRUE(filter.insertIfAbsent("https://example.com/"));
+    EXPECT_FALSE(filter.insertIfAbsent("https://example.com/"));
+    EXPECT_TRUE(filter.contains("https://example.com/"));
+}
+
+TEST(BlockedBloomFilter, FalsePositiveRate) {
+    BlockedBloomFilter filter(10000, 0.01);
+    for (int i = 0; i < 10000; ++i)
+        filter.insert("https://example.com/" + std::to_string(i));
+    for (int i = 0; i < 10000; ++i)
+        EXPECT_TRUE(filter.contains("https://example.com/" + std::to_string(i)));
+
+    int falsePositives = 0;
+    for (int i = 0; i < 100000; ++i)
+        falsePositives += filter.contains("https://other.com/" + std::to_string(i));
+    EXPECT_LT(falsePositives, 1000);
+}
+
+TEST(BlockedBloomFilter, SaveAndMapRoundTrip) {
+    std::string path = ::testing::TempDir() + "blocked_bloom_roundtrip";
+    BlockedBloomFilter filter(1000, 0.01);
+    for (int i = 0; i < 500; ++i)
+        filter.insert("https://example.com/" + std::to_string(i));
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        filter.save(out);
+    }
+
+    BlockedBloomFilter loaded(1, 0.5);
+    ASSERT_TRUE(loaded.load(path, 0));
+    std::remove(path.c_str());
+    EXPECT_EQ(loaded.numBits(), filter.numBits());
+    EXPECT_EQ(loaded.hashes(), filter.hashes());
+    for (int i = 0; i < 500; ++i)
+        EXPECT_TRUE(loaded.contains("https://example.com/" + std::to_string(i)));
+}
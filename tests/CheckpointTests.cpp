@@ -0,0 +1,478 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "Checkpoint.hpp"
+#include "Crc32.hpp"
+#include "WriteAheadLog.hpp"
+
+namespace fs = std::filesystem;
+
+class CheckpointTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        dir = (fs::temp_directory_path() /
+               ("checkpoint_" + std::string(::testing::UnitTest::GetInstance()
+                                                ->current_test_info()
+                                                ->name())))
+                  .string();
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        path = dir + "/frontier.ckpt";
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    std::unique_ptr<ShardedFrontier> make(size_t n,
+                                          const std::string& kind = "bloom") {
+        std::vector<std::unique_ptr<DedupStore>> seen;
+        for (size_t i = 0; i < n; ++i) {
+            seen.push_back(makeDedupStore(
+                kind, 100000, ShardedFrontier::shardDir(dir + "/seen", i, n)));
+        }
+        ShardedFrontier::Options options;
+        options.spillDir = dir + "/spill";
+        return std::make_unique<ShardedFrontier>(std::move(seen), options);
+    }
+
+    std::string url(int i) {
+        return "https://host" + std::to_string(i % 37) + ".com/page/" +
+               std::to_string(i);
+    }
+
+    // Every shard's queued urls, as recovery restores them.
+    std::multiset<std::string> queued(Checkpoint& checkpoint) {
+        std::multiset<std::string> urls;
+        for (size_t i = 0; i < checkpoint.numShards(); ++i) {
+            for (std::string& u : checkpoint.restore(i).queued)
+                urls.insert(std::move(u));
+        }
+        return urls;
+    }
+
+    void addRange(ShardedFrontier& frontier, int from, int to) {
+        for (int i = from; i < to; ++i)
+            frontier.add(url(i), true);
+        frontier.sync();
+    }
+
+    std::string dir;
+    std::string path;
+};
+
+TEST_F(CheckpointTest, BaseAndDeltasRestoreQueueAndSeen) {
+    std::set<std::string> expected;
+    {
+        auto frontier = make(2);
+        CheckpointWriter writer(path);
+        addRange(*frontier, 0, 300);
+        writer.write(frontier->snapshot(true));
+
+        addRange(*frontier, 300, 400);
+        std::set<std::string> taken;
+        for (std::string& u : frontier->take(50))
+            taken.insert(std::move(u));
+        writer.write(frontier->snapshot(false));
+
+        addRange(*frontier, 400, 450);
+        for (std::string& u : frontier->take(25))
+            taken.insert(std::move(u));
+        writer.write(frontier->snapshot(false));
+        writer.wait();
+        EXPECT_EQ(writer.stats().written, 3);
+        EXPECT_FALSE(writer.stats().failed);
+
+        for (int i = 0; i < 450; ++i) {
+            if (!taken.count(url(i)))
+                expected.insert(url(i));
+        }
+    }
+
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(checkpoint.numQueued, 450);
+    std::multiset<std::string> urls = queued(checkpoint);
+    EXPECT_EQ(urls.size(), 375);
+    EXPECT_EQ(std::set<std::string>(urls.begin(), urls.end()), expected);
+    ASSERT_EQ(checkpoint.seen.size(), 2);
+    ASSERT_EQ(checkpoint.seenDeltas.size(), 2);
+
+    // Every url added before the last delta, taken or not, is seen.
+    auto frontier = make(2);
+    ASSERT_TRUE(frontier->loadSeen(path, checkpoint.seen));
+    for (const std::vector<uint64_t>& offsets : checkpoint.seenDeltas) {
+        ASSERT_TRUE(
+            frontier->loadSeenDelta(Checkpoint::deltaPath(path), offsets));
+    }
+    addRange(*frontier, 0, 450);
+    EXPECT_EQ(frontier->size(), 0);
+    addRange(*frontier, 450, 460);
+    EXPECT_EQ(frontier->size(), 10);
+}
+
+TEST_F(CheckpointTest, TornDeltaEndsTheChain) {
+    {
+        auto frontier = make(1);
+        CheckpointWriter writer(path);
+        addRange(*frontier, 0, 100);
+        writer.write(frontier->snapshot(true));
+        addRange(*frontier, 100, 150);
+        writer.write(frontier->snapshot(false));
+        addRange(*frontier, 150, 200);
+        writer.write(frontier->snapshot(false));
+    }
+    // A crash in the middle of appending the last delta.
+    std::string delta = Checkpoint::deltaPath(path);
+    fs::resize_file(delta, fs::file_size(delta) - 3);
+
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(queued(checkpoint).size(), 150);
+    EXPECT_EQ(checkpoint.seenDeltas.size(), 1);
+}
+
+TEST_F(CheckpointTest, DeltasOfAnOlderBaseAreIgnored) {
+    std::string delta = Checkpoint::deltaPath(path);
+    std::string stale = dir + "/stale.delta";
+    {
+        auto frontier = make(1);
+        CheckpointWriter writer(path);
+        addRange(*frontier, 0, 100);
+        writer.write(frontier->snapshot(true));
+        addRange(*frontier, 100, 150);
+        writer.write(frontier->snapshot(false));
+        writer.wait();
+        fs::copy_file(delta, stale);
+
+        writer.write(frontier->snapshot(true));
+    }
+    EXPECT_EQ(Checkpoint::read(path).numQueued, 150);
+
+    // The base moved on, so the old deltas must not be replayed on top.
+    fs::copy_file(stale, delta, fs::copy_options::overwrite_existing);
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(queued(checkpoint).size(), 150);
+    EXPECT_TRUE(checkpoint.seenDeltas.empty());
+
+    // A new writer continues the generation rather than reusing one.
+    {
+        auto frontier = make(1);
+        CheckpointWriter writer(path);
+        writer.write(frontier->snapshot(true));
+    }
+    fs::copy_file(stale, delta, fs::copy_options::overwrite_existing);
+    EXPECT_TRUE(Checkpoint::read(path).seenDeltas.empty());
+}
+
+// Test that deltas after a base that failed are not appended to the base
+// before it, and count as failed until a base is written.
+TEST_F(CheckpointTest, DeltasFailUntilABaseIsWritten) {
+    auto frontier = make(1);
+    CheckpointWriter writer(path);
+    addRange(*frontier, 0, 100);
+    writer.write(frontier->snapshot(true), 1);
+    writer.wait();
+
+    // The next base can't be created.
+    fs::create_directory(path + ".tmp");
+    writer.write(frontier->snapshot(true), 2);
+    addRange(*frontier, 100, 150);
+    writer.write(frontier->snapshot(false), 3);
+    writer.wait();
+    CheckpointWriter::Stats stats = writer.stats();
+    EXPECT_TRUE(stats.failed);
+    EXPECT_EQ(stats.written, 1);
+    EXPECT_EQ(stats.logSegment, 1);
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(queued(checkpoint).size(), 100);
+    EXPECT_TRUE(checkpoint.seenDeltas.empty());
+
+    fs::remove(path + ".tmp");
+    writer.write(frontier->snapshot(true), 4);
+    addRange(*frontier, 150, 160);
+    writer.write(frontier->snapshot(false), 5);
+    writer.wait();
+    stats = writer.stats();
+    EXPECT_FALSE(stats.failed);
+    EXPECT_EQ(stats.logSegment, 5);
+    checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(queued(checkpoint).size(), 160);
+}
+
+TEST_F(CheckpointTest, FirstSnapshotMustBeFull) {
+    auto frontier = make(1);
+    CheckpointWriter writer(path);
+    EXPECT_THROW(writer.write(frontier->snapshot(false)), std::logic_error);
+}
+
+TEST_F(CheckpointTest, ReadRejectsMissingOrForeignFiles) {
+    EXPECT_THROW(Checkpoint::read(path), std::runtime_error);
+    std::ofstream(path) << "not a checkpoint";
+    EXPECT_THROW(Checkpoint::read(path), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, FingerprintStoreDeltasRestoreSeen) {
+    {
+        auto frontier = make(2, "exact");
+        CheckpointWriter writer(path);
+        addRange(*frontier, 0, 200);
+        writer.write(frontier->snapshot(true));
+        addRange(*frontier, 200, 300);
+        writer.write(frontier->snapshot(false));
+    }
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(checkpoint.numQueued, 300);
+
+    auto frontier = make(2, "exact");
+    ASSERT_TRUE(frontier->loadSeen(path, checkpoint.seen));
+    for (const std::vector<uint64_t>& offsets : checkpoint.seenDeltas) {
+        ASSERT_TRUE(
+            frontier->loadSeenDelta(Checkpoint::deltaPath(path), offsets));
+    }
+    addRange(*frontier, 0, 300);
+    EXPECT_EQ(frontier->size(), 0);
+}
+
+TEST_F(CheckpointTest, ReadRejectsADamagedBase) {
+    {
+        auto frontier = make(1);
+        CheckpointWriter writer(path);
+        addRange(*frontier, 0, 100);
+        writer.write(frontier->snapshot(true));
+    }
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(queued(checkpoint).size(), 100);
+
+    // In the queued urls, in the dedup store and in the table at the end.
+    uint64_t size = fs::file_size(path);
+    for (uint64_t offset : {uint64_t(100), checkpoint.seen[0] + 10,
+                            size - 30}) {
+        std::string copy = dir + "/damaged.ckpt";
+        fs::copy_file(path, copy, fs::copy_options::overwrite_existing);
+        std::fstream file(copy,
+                          std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(offset));
+        char c = static_cast<char>(file.get());
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.put(static_cast<char>(c ^ 1));
+        file.close();
+        EXPECT_THROW(Checkpoint::read(copy), std::runtime_error) << offset;
+    }
+}
+
+TEST_F(CheckpointTest, RestoresShardsInParallelFromTheBase) {
+    std::vector<std::multiset<std::string>> expected(4);
+    {
+        auto frontier = make(4);
+        CheckpointWriter writer(path);
+        addRange(*frontier, 0, 2000);
+        writer.write(frontier->snapshot(true));
+        for (int i = 0; i < 2000; ++i)
+            expected[frontier->shardOf(url(i))].insert(url(i));
+    }
+
+    Checkpoint checkpoint = Checkpoint::read(path);
+    ASSERT_EQ(checkpoint.numShards(), 4);
+    std::vector<std::multiset<std::string>> restored(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i]() {
+            for (std::string& u : checkpoint.restore(i).queued)
+                restored[i].insert(std::move(u));
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    EXPECT_EQ(restored, expected);
+
+    auto frontier = make(4);
+    ASSERT_TRUE(frontier->loadSeen(path, checkpoint.seen));
+    Checkpoint again = Checkpoint::read(path);
+    frontier->restore([&](size_t i) { return again.restore(i); });
+    EXPECT_EQ(frontier->size(), 2000);
+    addRange(*frontier, 0, 2000);
+    EXPECT_EQ(frontier->size(), 2000);
+}
+
+TEST(Crc32c, KnownValues) {
+    EXPECT_EQ(crc32c::hash(""), 0u);
+    EXPECT_EQ(crc32c::hash("123456789"), 0xE3069283u);
+    std::string data(1000, 'a');
+    EXPECT_EQ(crc32c::extend(crc32c::hash(data.substr(0, 333)),
+                             data.data() + 333, 667),
+              crc32c::hash(data));
+}
+
+TEST_F(CheckpointTest, LogReplaysAcrossSegments) {
+    std::string logPath = Checkpoint::logPath(path);
+    std::vector<std::pair<WriteAheadLog::Op, std::string>> written;
+    uint64_t second = 0;
+    {
+        WriteAheadLog log(logPath);
+        for (int i = 0; i < 1000; ++i) {
+            log.add(url(i));
+            written.emplace_back(WriteAheadLog::Op::ADD, url(i));
+            if (i % 3 == 0) {
+                log.take(url(i));
+                written.emplace_back(WriteAheadLog::Op::TAKE, url(i));
+            }
+            if (i % 10 == 0)
+                log.mark();
+            if (i == 500)
+                second = log.rotate();
+        }
+        EXPECT_TRUE(log.waitFor(log.mark()));
+        WriteAheadLog::Stats stats = log.stats();
+        EXPECT_EQ(stats.records, written.size());
+        EXPECT_FALSE(stats.failed);
+        EXPECT_GE(stats.syncs, 1);
+        EXPECT_LE(stats.syncs, 102);
+    }
+    EXPECT_EQ(WriteAheadLog::segments(logPath),
+              (std::vector<uint64_t>{1, second}));
+
+    std::vector<std::pair<WriteAheadLog::Op, std::string>> replayed;
+    auto collect = [&](WriteAheadLog::Op op, std::string_view u) {
+        replayed.emplace_back(op, std::string(u));
+    };
+    WriteAheadLog::ReplayStats stats = WriteAheadLog::replay(logPath, 0, collect);
+    EXPECT_EQ(stats.segments, 2);
+    EXPECT_EQ(stats.torn, 0);
+    EXPECT_EQ(replayed, written);
+
+    // From the second segment on only.
+    replayed.clear();
+    WriteAheadLog::replay(logPath, second, collect);
+    EXPECT_EQ(replayed.front().second, url(501));
+    EXPECT_EQ(replayed.back(), written.back());
+
+    // A new log continues after the existing segments and deletes them
+    // once released.
+    WriteAheadLog log(logPath);
+    log.add(url(0));
+    log.waitFor(log.mark());
+    log.release(second + 1);
+    for (int i = 0; i < 100 && WriteAheadLog::segments(logPath).size() > 1; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(WriteAheadLog::segments(logPath),
+              std::vector<uint64_t>{second + 1});
+}
+
+TEST_F(CheckpointTest, LogStopsAtATornOrCorruptBlock) {
+    std::string logPath = Checkpoint::logPath(path);
+    {
+        WriteAheadLog log(logPath);
+        for (int block = 0; block < 3; ++block) {
+            for (int i = 0; i < 10; ++i)
+                log.add(url(block * 10 + i));
+            log.waitFor(log.mark());
+        }
+    }
+    std::string segment = WriteAheadLog::segmentPath(logPath, 1);
+    uint64_t size = fs::file_size(segment);
+    auto count = [&]() {
+        uint64_t n = 0;
+        WriteAheadLog::ReplayStats stats = WriteAheadLog::replay(
+            logPath, 1, [&](WriteAheadLog::Op, std::string_view) { ++n; });
+        EXPECT_EQ(stats.records, n);
+        return std::make_pair(n, stats.torn);
+    };
+    EXPECT_EQ(count(), std::make_pair(uint64_t(30), uint64_t(0)));
+
+    // Cut short in the last block.
+    fs::resize_file(segment, size - 5);
+    EXPECT_EQ(count(), std::make_pair(uint64_t(20), uint64_t(1)));
+
+    // A flipped byte in the second block.
+    std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(size / 2));
+    char c;
+    file.seekg(static_cast<std::streamoff>(size / 2));
+    file.get(c);
+    file.seekp(static_cast<std::streamoff>(size / 2));
+    file.put(static_cast<char>(c ^ 1));
+    file.close();
+    EXPECT_EQ(count(), std::make_pair(uint64_t(10), uint64_t(1)));
+}
+
+TEST_F(CheckpointTest, RecoversChangesLoggedAfterTheLastSnapshot) {
+    std::set<std::string> taken;
+    {
+        auto frontier = make(2);
+        CheckpointWriter writer(path);
+        WriteAheadLog log(Checkpoint::logPath(path));
+        addRange(*frontier, 0, 200);
+        writer.write(frontier->snapshot(true), log.rotate());
+        for (int i = 200; i < 300; ++i) {
+            frontier->add(url(i), true);
+            log.add(url(i));
+        }
+        // A url already queued comes in again.
+        frontier->add(url(5), true);
+        log.add(url(5));
+        frontier->sync();
+        for (std::string& u : frontier->take(150)) {
+            log.take(u);
+            taken.insert(u);
+        }
+        log.waitFor(log.mark());
+        writer.wait();
+        // Crash: the frontier is gone without another snapshot.
+    }
+
+    Checkpoint checkpoint = Checkpoint::read(path);
+    EXPECT_EQ(checkpoint.log.records, 101 + 150);
+    EXPECT_EQ(checkpoint.numLogged, 101);
+
+    auto frontier = make(2);
+    ASSERT_TRUE(frontier->loadSeen(path, checkpoint.seen));
+    frontier->restore([&](size_t i) { return checkpoint.restore(i); });
+    EXPECT_EQ(frontier->size(), 150);
+
+    // The taken urls are neither queued nor new.
+    std::set<std::string> queued;
+    while (frontier->size() > 0) {
+        for (std::string& u : frontier->take(64, 100))
+            queued.insert(std::move(u));
+    }
+    EXPECT_EQ(queued.size(), 150);
+    for (const std::string& u : taken)
+        EXPECT_EQ(queued.count(u), 0);
+    addRange(*frontier, 0, 300);
+    EXPECT_EQ(frontier->size(), 0);
+}
+
+TEST_F(CheckpointTest, RequeuedUrlsSurviveReplay) {
+    std::string requeued;
+    {
+        auto frontier = make(1);
+        CheckpointWriter writer(path);
+        WriteAheadLog log(Checkpoint::logPath(path));
+        addRange(*frontier, 0, 10);
+        writer.write(frontier->snapshot(true), log.rotate());
+        std::vector<std::string> out = frontier->take(1, 100);
+        ASSERT_EQ(out.size(), 1);
+        requeued = out[0];
+        log.take(requeued);
+        // Its fetch failed: it goes back without the dedup check.
+        frontier->add(requeued, false);
+        log.requeue(requeued);
+        log.waitFor(log.mark());
+        writer.wait();
+    }
+
+    Checkpoint checkpoint = Checkpoint::read(path);
+    auto frontier = make(1);
+    ASSERT_TRUE(frontier->loadSeen(path, checkpoint.seen));
+    frontier->restore([&](size_t i) { return checkpoint.restore(i); });
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 10);
+    std::set<std::string> queued;
+    while (frontier->size() > 0) {
+        for (std::string& u : frontier->take(64, 100))
+            queued.insert(std::move(u));
+    }
+    EXPECT_EQ(queued.count(requeued), 1);
+}
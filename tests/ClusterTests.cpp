@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "ClusterMap.hpp"
+#include "PeerExchange.hpp"
+
+namespace {
+
+// Loopback nodes on ports unlikely to be taken on a test machine.
+std::vector<ClusterNode> loopback(int n, int base) {
+    std::vector<ClusterNode> nodes;
+    for (int i = 0; i < n; ++i)
+        nodes.push_back({"127.0.0.1", base + i, base + 100 + i});
+    return nodes;
+}
+
+std::string url(int i) {
+    return "https://host" + std::to_string(i % 251) + ".org/page/" +
+           std::to_string(i);
+}
+
+// Polls until pred holds or a few seconds pass.
+template <typename Pred>
+bool eventually(Pred pred) {
+    for (int i = 0; i < 500; ++i) {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pred();
+}
+
+PeerExchange::Options fastOptions() {
+    PeerExchange::Options options;
+    options.flushMs = 0;
+    options.heartbeatMs = 20;
+    options.peerTimeoutMs = 200;
+    return options;
+}
+
+}  // namespace
+
+TEST(ClusterMap, ParsesNodeList) {
+    auto nodes = ClusterMap::parse("127.0.0.1:8000:9000,10.0.0.2:8001:9001");
+    ASSERT_EQ(nodes.size(), 2);
+    EXPECT_EQ(nodes[1].ip, "10.0.0.2");
+    EXPECT_EQ(nodes[1].workerPort, 8001);
+    EXPECT_EQ(nodes[1].peerPort, 9001);
+    EXPECT_EQ(nodes[0].workerAddress(), "127.0.0.1:8000");
+
+    EXPECT_THROW(ClusterMap::parse(""), std::invalid_argument);
+    EXPECT_THROW(ClusterMap::parse("127.0.0.1:8000"), std::invalid_argument);
+    EXPECT_THROW(ClusterMap::parse("127.0.0.1:80x:9000"), std::invalid_argument);
+    EXPECT_THROW(ClusterMap(nodes, 2), std::invalid_argument);
+}
+
+TEST(ClusterMap, EveryNodeAgreesOnOneOwnerPerHost) {
+    auto nodes = loopback(4, 41000);
+    std::vector<ClusterMap> maps;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        maps.emplace_back(nodes, i);
+
+    std::set<size_t> owners;
+    for (int i = 0; i < 2000; ++i) {
+        size_t owner = maps[0].ownerOf(url(i));
+        owners.insert(owner);
+        int owning = 0;
+        for (const ClusterMap& map : maps) {
+            EXPECT_EQ(map.ownerOf(url(i)), owner);
+            owning += map.owns(url(i));
+        }
+        EXPECT_EQ(owning, 1);
+        // Ownership goes by host, not by url.
+        EXPECT_EQ(maps[0].ownerOf("http://host" + std::to_string(i % 251) +
+                                  ".org/"),
+                  owner);
+    }
+    EXPECT_EQ(owners.size(), 4);
+    EXPECT_EQ(ClusterMap().ownerOf(url(1)), 0);
+}
+
+TEST(PeerExchange, ForwardsBatchesOverLoopback) {
+    auto nodes = loopback(2, 41100);
+    PeerExchange a(ClusterMap(nodes, 0), fastOptions());
+    PeerExchange b(ClusterMap(nodes, 1), fastOptions());
+    ASSERT_TRUE(a.start());
+    ASSERT_TRUE(b.start());
+
+    std::set<std::string> expected;
+    for (int i = 0; i < 10000; ++i) {
+        a.forward(1, url(i));
+        expected.insert(url(i));
+    }
+    a.flush(true);
+
+    std::vector<std::string> got;
+    EXPECT_TRUE(eventually([&]() {
+        b.receive(got);
+        return got.size() >= expected.size();
+    }));
+    EXPECT_EQ(std::set<std::string>(got.begin(), got.end()), expected);
+    EXPECT_EQ(a.stats().sent, 10000);
+    EXPECT_EQ(b.stats().received, 10000);
+}
+
+TEST(PeerExchange, HeartbeatsCarryLoad) {
+    auto nodes = loopback(2, 41200);
+    PeerExchange a(ClusterMap(nodes, 0), fastOptions());
+    PeerExchange b(ClusterMap(nodes, 1), fastOptions());
+    ASSERT_TRUE(a.start());
+    ASSERT_TRUE(b.start());
+    b.setLoad(1234, 7);
+
+    EXPECT_TRUE(eventually([&]() { return a.peerLoad(1).workers == 7; }));
+    PeerExchange::PeerLoad load = a.peerLoad(1);
+    EXPECT_TRUE(load.alive);
+    EXPECT_EQ(load.queued, 1234);
+
+    b.stop();
+    EXPECT_TRUE(eventually([&]() { return !a.peerLoad(1).alive; }));
+}
+
+TEST(PeerExchange, KeepsUrlsUntilThePeerComesUp) {
+    auto nodes = loopback(2, 41300);
+    PeerExchange a(ClusterMap(nodes, 0), fastOptions());
+    ASSERT_TRUE(a.start());
+    for (int i = 0; i < 100; ++i)
+        a.forward(1, url(i));
+    a.flush(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(a.stats().sent, 0);
+
+    PeerExchange b(ClusterMap(nodes, 1), fastOptions());
+    ASSERT_TRUE(b.start());
+    std::vector<std::string> got;
+    EXPECT_TRUE(eventually([&]() {
+        b.receive(got);
+        return got.size() >= 100;
+    }));
+    EXPECT_EQ(got.size(), 100);
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "DedupStore.hpp"
+#include "FingerprintStore.hpp"
+
+namespace fs = std::filesystem;
+
+class DedupTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        dir = (fs::temp_directory_path() /
+               ("dedup_" + std::string(::testing::UnitTest::GetInstance()
+                                           ->current_test_info()
+                                           ->name())))
+                  .string();
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    std::string url(int i) { return "https://host" + std::to_string(i % 97) +
+                                    ".com/page/" + std::to_string(i); }
+
+    std::string dir;
+};
+
+TEST_F(DedupTest, FingerprintStoreIsExactAcrossRunsAndMerges) {
+    // 64 slots flush every 32 urls, so this writes and merges many runs.
+    FingerprintStore store(dir + "/seen", 64, 2);
+    for (int i = 0; i < 5000; ++i) {
+        EXPECT_TRUE(store.insertIfAbsent(url(i))) << i;
+    }
+    store.waitForMerge();
+    EXPECT_LE(store.numRuns(), 3);
+    EXPECT_EQ(store.size(), 5000);
+
+    for (int i = 0; i < 5000; ++i) {
+        EXPECT_TRUE(store.contains(url(i))) << i;
+        EXPECT_FALSE(store.insertIfAbsent(url(i))) << i;
+    }
+    for (int i = 5000; i < 10000; ++i) {
+        EXPECT_FALSE(store.contains(url(i))) << i;
+    }
+}
+
+TEST_F(DedupTest, FingerprintStoreSaveAndLoad) {
+    std::string path = dir + "/checkpoint";
+    {
+        FingerprintStore store(dir + "/seen", 64, 2);
+        for (int i = 0; i < 1000; ++i)
+            store.insertIfAbsent(url(i));
+        std::ofstream out(path, std::ios::binary);
+        out << "prefix";
+        store.save(out);
+    }
+
+    FingerprintStore loaded(dir + "/seen", 64, 2);
+    ASSERT_TRUE(loaded.load(path, 6));
+    EXPECT_EQ(loaded.size(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_FALSE(loaded.insertIfAbsent(url(i))) << i;
+    }
+    EXPECT_TRUE(loaded.insertIfAbsent(url(1000)));
+
+    BloomDedup bloom(1000, 0.01);
+    EXPECT_FALSE(bloom.load(path, 6));
+}
+
+TEST_F(DedupTest, BloomBackendSaveAndLoad) {
+    std::string path = dir + "/checkpoint";
+    std::unique_ptr<DedupStore> store = makeDedupStore("bloom", 1000, dir);
+    ASSERT_NE(store, nullptr);
+    // A Bloom filter may already report a few new urls as seen.
+    int fresh = 0;
+    for (int i = 0; i < 1000; ++i)
+        fresh += store->insertIfAbsent(url(i));
+    EXPECT_GT(fresh, 970);
+    {
+        std::ofstream out(path, std::ios::binary);
+        store->save(out);
+    }
+
+    std::unique_ptr<DedupStore> loaded = makeDedupStore("bloom", 1000, dir);
+    ASSERT_TRUE(loaded->load(path, 0));
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_TRUE(loaded->contains(url(i)));
+
+    FingerprintStore exact(dir + "/seen");
+    EXPECT_FALSE(exact.load(path, 0));
+    EXPECT_EQ(makeDedupStore("cuckoo", 1000, dir), nullptr);
+}
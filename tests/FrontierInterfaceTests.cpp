@@ -216,3 +216,162 @@ TEST(FrontierInterface, HandlesMassiveNumberOfURLs) {
     EXPECT_EQ(decoded.type, decoded.type);
     EXPECT_EQ(decoded.urls, decoded.urls);
 }
+
+TEST(FrontierInterface, EncodeIntoBuffer) {
+    FrontierMessage message{FrontierMessageType::URLS,
+                            {"https://example.com", ""},
+                            {"https://failed.com"}};
+    std::string expected = FrontierInterface::Encode(message);
+    EXPECT_EQ(FrontierInterface::EncodedSize(message), expected.size());
+
+    std::vector<char> buffer(expected.size());
+    EXPECT_EQ(FrontierInterface::EncodeInto(message, buffer.data(),
+                                            buffer.size()),
+              expected.size());
+    EXPECT_EQ(std::string(buffer.begin(), buffer.end()), expected);
+    EXPECT_THROW(FrontierInterface::EncodeInto(message, buffer.data(),
+                                               buffer.size() - 1),
+                 std::runtime_error);
+
+    std::string out;
+    FrontierInterface::EncodeInto(message, out);
+    EXPECT_EQ(out, expected);
+}
+
+TEST(FrontierInterface, DecodeViewPointsIntoMessage) {
+    FrontierMessage message{FrontierMessageType::ROBOTS,
+                            {"https://a.com/robots.txt", "https://b.org"},
+                            {"https://c.net"}};
+    std::string encoded = FrontierInterface::Encode(message);
+
+    FrontierMessageView view;
+    FrontierInterface::DecodeView(encoded, view);
+    EXPECT_EQ(view.type, FrontierMessageType::ROBOTS);
+    ASSERT_EQ(view.urls.size(), 2);
+    ASSERT_EQ(view.failed.size(), 1);
+    EXPECT_EQ(view.urls[0], "https://a.com/robots.txt");
+    EXPECT_EQ(view.urls[1], "https://b.org");
+    EXPECT_EQ(view.failed[0], "https://c.net");
+    EXPECT_GE(view.urls[0].data(), encoded.data());
+    EXPECT_LT(view.urls[0].data(), encoded.data() + encoded.size());
+
+    // Reusing the view replaces its contents.
+    FrontierInterface::DecodeView(
+        FrontierInterface::Encode({FrontierMessageType::START, {}}), view);
+    EXPECT_EQ(view.type, FrontierMessageType::START);
+    EXPECT_TRUE(view.urls.empty());
+    EXPECT_TRUE(view.failed.empty());
+}
+
+TEST(FrontierInterface, RejectsTruncatedMessages) {
+    std::string encoded = FrontierInterface::Encode(
+        {FrontierMessageType::URLS, {"https://example.com"}, {"x"}});
+    for (size_t len = 0; len < encoded.size(); ++len) {
+        EXPECT_THROW(FrontierInterface::Decode(encoded.substr(0, len)),
+                     std::runtime_error)
+            << len;
+    }
+}
+
+TEST(FrontierInterface, CompactRoundTrip) {
+    FrontierMessage message{
+        FrontierMessageType::URLS,
+        {"https://en.wikipedia.org/wiki/A", "https://en.wikipedia.org/wiki/AB",
+         "https://en.wikipedia.org/wiki/B", "", "http://other.com/\xff"},
+        {"https://fail.com/1", "https://fail.com/12"}};
+    std::string legacy = FrontierInterface::Encode(message);
+    std::string compact =
+        FrontierInterface::Encode(message, FrontierProtocol::COMPACT);
+    EXPECT_LT(compact.size(), legacy.size());
+    EXPECT_EQ(FrontierInterface::EncodedSize(message, FrontierProtocol::COMPACT),
+              compact.size());
+    EXPECT_EQ(FrontierInterface::ProtocolOf(compact),
+              FrontierProtocol::COMPACT);
+    EXPECT_EQ(FrontierInterface::ProtocolOf(legacy), FrontierProtocol::LEGACY);
+
+    FrontierMessage decoded = FrontierInterface::Decode(compact);
+    EXPECT_EQ(decoded.type, message.type);
+    EXPECT_EQ(decoded.urls, message.urls);
+    EXPECT_EQ(decoded.failed, message.failed);
+
+    for (auto type : {FrontierMessageType::START, FrontierMessageType::END,
+                      FrontierMessageType::ROBOTS,
+                      FrontierMessageType::REDIRECT}) {
+        std::string encoded = FrontierInterface::Encode(
+            {type, {}}, FrontierProtocol::COMPACT);
+        EXPECT_EQ(encoded.size(), 3);
+        EXPECT_EQ(FrontierInterface::Decode(encoded).type, type);
+    }
+}
+
+TEST(FrontierInterface, RedirectRoundTrip) {
+    FrontierMessage message{FrontierMessageType::REDIRECT, {"127.0.0.1:8001"}};
+    for (auto protocol : {FrontierProtocol::LEGACY, FrontierProtocol::COMPACT}) {
+        FrontierMessage decoded =
+            FrontierInterface::Decode(FrontierInterface::Encode(message, protocol));
+        EXPECT_EQ(decoded.type, FrontierMessageType::REDIRECT);
+        EXPECT_EQ(decoded.urls, message.urls);
+    }
+}
+
+TEST(FrontierInterface, CompactLargeBatch) {
+    FrontierMessage message{FrontierMessageType::URLS, {}, {}};
+    for (int i = 0; i < 10000; ++i) {
+        message.urls.push_back("https://en.wikipedia.org/wiki/Page_" +
+                               std::to_string(i * 7919));
+    }
+    std::string legacy = FrontierInterface::Encode(message);
+    std::string compact =
+        FrontierInterface::Encode(message, FrontierProtocol::COMPACT);
+    EXPECT_LT(compact.size() * 3, legacy.size());
+
+    FrontierMessageView view;
+    FrontierInterface::DecodeView(compact, view);
+    ASSERT_EQ(view.urls.size(), message.urls.size());
+    for (size_t i = 0; i < view.urls.size(); ++i)
+        EXPECT_EQ(view.urls[i], message.urls[i]);
+}
+
+TEST(FrontierInterface, RejectsTruncatedCompactMessages) {
+    FrontierMessage message{FrontierMessageType::URLS,
+                            {"https://example.com/a", "https://example.com/b"},
+                            {"x"}};
+    std::string encoded =
+        FrontierInterface::Encode(message, FrontierProtocol::COMPACT);
+    for (size_t len = 1; len < encoded.size(); ++len) {
+        EXPECT_THROW(FrontierInterface::Decode(encoded.substr(0, len)),
+                     std::runtime_error)
+            << len;
+    }
+
+    std::string future = encoded;
+    future[0] = static_cast<char>(future[0] + 0x10);
+    EXPECT_THROW(FrontierInterface::Decode(future), std::runtime_error);
+}
+
+// Test that a small message whose urls each repeat all of the previous one
+// is rejected before it can expand to gigabytes.
+TEST(FrontierInterface, RejectsCompactMessagesThatExpandTooFar) {
+    std::string encoded = FrontierInterface::Encode(
+        {FrontierMessageType::URLS, {}, {}}, FrontierProtocol::COMPACT);
+    encoded.resize(1);
+    // 100000 urls: the first is 4096 bytes, the rest share all of it.
+    auto varint = [&](uint64_t value) {
+        while (value >= 0x80) {
+            encoded += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        encoded += static_cast<char>(value);
+    };
+    varint(100000);
+    varint(0);
+    varint(4096);
+    encoded.append(4096, 'a');
+    for (int i = 1; i < 100000; ++i) {
+        varint(4096);
+        varint(0);
+    }
+    varint(0);
+    ASSERT_LT(encoded.size(), 400000);
+    EXPECT_THROW(FrontierInterface::Decode(encoded), std::runtime_error);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LeaseTable.hpp"
+
+namespace {
+
+std::vector<std::string> expire(LeaseTable& leases, int64_t nowMs) {
+    std::vector<std::string> urls;
+    leases.expire(nowMs,
+                  [&](std::string_view url) { urls.emplace_back(url); });
+    return urls;
+}
+
+std::vector<std::string> batch(const std::string& prefix, int n) {
+    std::vector<std::string> urls;
+    for (int i = 0; i < n; ++i)
+        urls.push_back("https://" + prefix + ".com/" + std::to_string(i));
+    return urls;
+}
+
+}  // namespace
+
+TEST(LeaseTableTest, AckedLeaseNeverExpires) {
+    LeaseTable leases(10000);
+    leases.lease(3, batch("a", 5), 0);
+    EXPECT_EQ(leases.inFlight(), 5);
+    EXPECT_EQ(leases.numLeases(), 1);
+    leases.ack(3);
+    EXPECT_EQ(leases.inFlight(), 0);
+    EXPECT_TRUE(expire(leases, 60000).empty());
+    EXPECT_EQ(leases.expired(), 0);
+}
+
+TEST(LeaseTableTest, ExpiredLeaseIsRedispatchedOnce) {
+    LeaseTable leases(10000);
+    std::vector<std::string> urls = batch("a", 4);
+    leases.lease(1, urls, 500);
+    leases.lease(2, batch("b", 2), 2000);
+    EXPECT_TRUE(expire(leases, 10000).empty());
+    EXPECT_EQ(expire(leases, 10500), urls);
+    EXPECT_EQ(leases.inFlight(), 2);
+    EXPECT_TRUE(expire(leases, 11000).empty());
+    EXPECT_EQ(expire(leases, 12000), batch("b", 2));
+    EXPECT_EQ(leases.expired(), 6);
+    EXPECT_EQ(leases.numLeases(), 0);
+    // The worker's late ack finds nothing.
+    leases.ack(1);
+    EXPECT_EQ(leases.inFlight(), 0);
+}
+
+TEST(LeaseTableTest, NewLeaseReturnsThePreviousOne) {
+    LeaseTable leases(10000);
+    leases.lease(1, batch("a", 3), 0);
+    leases.lease(1, batch("b", 2), 5000);
+    EXPECT_EQ(leases.inFlight(), 2);
+    // Only the second lease's deadline counts.
+    EXPECT_TRUE(expire(leases, 10000).empty());
+    EXPECT_EQ(expire(leases, 15000), batch("b", 2));
+}
+
+TEST(LeaseTableTest, RevokeRedispatchesAtOnce) {
+    LeaseTable leases(10000);
+    leases.lease(4, batch("a", 3), 0);
+    std::vector<std::string> urls;
+    leases.revoke(4, [&](std::string_view url) { urls.emplace_back(url); });
+    EXPECT_EQ(urls, batch("a", 3));
+    EXPECT_EQ(leases.revoked(), 3);
+    EXPECT_TRUE(expire(leases, 20000).empty());
+}
+
+TEST(LeaseTableTest, DeadlinesPastOneTurnOfTheWheel) {
+    // 4096 one-second slots; a two-hour deadline goes round twice.
+    LeaseTable leases(7200000);
+    leases.lease(1, batch("a", 1), 0);
+    for (int64_t t = 0; t < 7200000; t += 60000)
+        EXPECT_TRUE(expire(leases, t).empty());
+    EXPECT_EQ(expire(leases, 7200000), batch("a", 1));
+}
+
+TEST(LeaseTableTest, ZeroTimeoutLeasesNothing) {
+    LeaseTable leases(0);
+    leases.lease(1, batch("a", 3), 0);
+    EXPECT_EQ(leases.inFlight(), 0);
+    EXPECT_TRUE(expire(leases, 1000000).empty());
+}
+
+TEST(LeaseTableTest, ManyWorkers) {
+    LeaseTable leases(30000);
+    for (int sock = 0; sock < 1000; ++sock)
+        leases.lease(sock, batch("h" + std::to_string(sock), 50), sock * 10);
+    EXPECT_EQ(leases.inFlight(), 50000);
+    // Half the workers come back; the others' leases run out.
+    for (int sock = 0; sock < 1000; sock += 2)
+        leases.ack(sock);
+    EXPECT_EQ(expire(leases, 60000).size(), 25000);
+    EXPECT_EQ(leases.inFlight(), 0);
+    EXPECT_EQ(leases.leased(), 50000);
+}
@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+#include "RequestPipeline.hpp"
+#include "SpscQueue.hpp"
+
+TEST(SpscQueue, PreservesOrderAcrossThreads) {
+    SpscQueue<int> queue(64);
+    constexpr int kItems = 200000;
+    std::thread producer([&]() {
+        for (int i = 0; i < kItems; ++i)
+            ASSERT_TRUE(queue.push(i));
+        queue.close();
+    });
+
+    int expected = 0;
+    int value;
+    while (queue.pop(value)) {
+        ASSERT_EQ(value, expected);
+        ++expected;
+    }
+    producer.join();
+    EXPECT_EQ(expected, kItems);
+}
+
+TEST(SpscQueue, TryPushFailsWhenFull) {
+    SpscQueue<std::string> queue(4);
+    EXPECT_EQ(queue.capacity(), 4);
+    for (int i = 0; i < 4; ++i) {
+        std::string s = std::to_string(i);
+        EXPECT_TRUE(queue.tryPush(s));
+    }
+    std::string extra = "extra";
+    EXPECT_FALSE(queue.tryPush(extra));
+    EXPECT_EQ(extra, "extra");
+
+    std::string out;
+    EXPECT_TRUE(queue.tryPop(out));
+    EXPECT_EQ(out, "0");
+    EXPECT_TRUE(queue.tryPush(extra));
+    EXPECT_EQ(queue.size(), 4);
+}
+
+TEST(SpscQueue, CloseWakesBlockedConsumer) {
+    SpscQueue<int> queue(4);
+    std::thread closer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.close();
+    });
+    int value;
+    EXPECT_FALSE(queue.pop(value));
+    closer.join();
+    EXPECT_FALSE(queue.push(1));
+}
+
+TEST(LatencyHistogram, Percentiles) {
+    LatencyHistogram h;
+    EXPECT_EQ(h.percentile(50), 0);
+    for (uint64_t v = 1; v <= 1000; ++v)
+        h.record(v);
+    EXPECT_EQ(h.count(), 1000);
+    EXPECT_EQ(h.max(), 1000);
+    // Within one bucket, about 6%, of the exact value.
+    EXPECT_NEAR(h.percentile(50), 500, 32);
+    EXPECT_NEAR(h.percentile(99), 990, 64);
+    EXPECT_EQ(h.percentile(100), 1000);
+
+    h.record(7);
+    h.reset();
+    h.record(7);
+    EXPECT_EQ(h.percentile(50), 7);
+}
+
+// In-process stand-in for the Gateway server: workers push requests into
+// an inbox and get replies in per-socket mailboxes.
+struct Message {
+    std::string senderIp;
+    int senderPort = 0;
+    int senderSock = 0;
+    int receiverSock = 0;
+    std::string msg;
+};
+
+class FakeServer {
+   public:
+    explicit FakeServer(int workers) : replies(workers) {}
+
+    std::vector<Message> GetMessagesBlocking() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return !inbox.empty() || closed; });
+        std::vector<Message> messages(inbox.begin(), inbox.end());
+        inbox.clear();
+        return messages;
+    }
+
+    void SendMessage(Message m) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies[m.receiverSock].push_back(std::move(m.msg));
+        cv.notify_all();
+    }
+
+    void send(int worker, std::string msg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        inbox.push_back(Message{"127.0.0.1", worker, worker, 0, std::move(msg)});
+        cv.notify_all();
+    }
+
+    std::string receive(int worker) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return !replies[worker].empty(); });
+        std::string msg = std::move(replies[worker].front());
+        replies[worker].pop_front();
+        return msg;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        cv.notify_all();
+    }
+
+   private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Message> inbox;
+    std::vector<std::deque<std::string>> replies;
+    bool closed = false;
+};
+
+TEST(RequestPipeline, ServesWorkersInTheirProtocol) {
+    constexpr int kWorkers = 4;
+    constexpr int kRounds = 200;
+    FakeServer server(kWorkers);
+
+    // Echoes the request's urls back, counting requests on the core thread.
+    int handled = 0;
+    RequestPipeline<FakeServer> pipeline(
+        server,
+        [&](const Message&, const FrontierMessageView& request) {
+            ++handled;
+            FrontierMessage response{FrontierMessageType::URLS, {}};
+            response.urls.assign(request.urls.begin(), request.urls.end());
+            return response;
+        },
+        8);
+    int decodeErrors = 0;
+    pipeline.onDecodeError(
+        [&](const Message&, const std::exception&) { ++decodeErrors; });
+    std::vector<uint64_t> reported;
+    pipeline.onLatency(100, [&](const LatencyHistogram& latency) {
+        reported.push_back(latency.count());
+    });
+
+    std::thread core([&]() { pipeline.run(); });
+
+    server.send(0, "garbage");
+    std::vector<std::thread> workers;
+    for (int w = 0; w < kWorkers; ++w) {
+        workers.emplace_back([&, w]() {
+            FrontierProtocol protocol =
+                w % 2 ? FrontierProtocol::COMPACT : FrontierProtocol::LEGACY;
+            for (int i = 0; i < kRounds; ++i) {
+                std::string url = "https://w" + std::to_string(w) + ".com/" +
+                                  std::to_string(i);
+                server.send(w, FrontierInterface::Encode(
+                                   {FrontierMessageType::URLS, {url}}, protocol));
+                std::string reply = server.receive(w);
+                ASSERT_EQ(FrontierInterface::ProtocolOf(reply), protocol);
+                FrontierMessage decoded = FrontierInterface::Decode(reply);
+                ASSERT_EQ(decoded.urls, std::vector<std::string>{url});
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    pipeline.stop();
+    server.close();
+    core.join();
+
+    EXPECT_EQ(handled, kWorkers * kRounds);
+    EXPECT_EQ(decodeErrors, 1);
+    EXPECT_EQ(reported, std::vector<uint64_t>(8, 100));
+}
+
+TEST(RequestPipeline, HoldsResponsesUntilCommitted) {
+    FakeServer server(1);
+    uint64_t marked = 0;  // core thread
+    std::atomic<uint64_t> committed{0};
+    std::atomic<uint64_t> sentBefore{0};
+    RequestPipeline<FakeServer> pipeline(
+        server, [](const Message&, const FrontierMessageView&) {
+            return FrontierMessage{FrontierMessageType::URLS, {}};
+        });
+    pipeline.onCommit([&]() { return ++marked; },
+                      [&](uint64_t ticket) {
+                          while (committed.load() < ticket)
+                              std::this_thread::yield();
+                          sentBefore.store(ticket);
+                      });
+    std::thread core([&]() { pipeline.run(); });
+
+    std::string start = FrontierInterface::Encode(
+        {FrontierMessageType::START, {}}, FrontierProtocol::LEGACY);
+    server.send(0, start);
+    server.send(0, start);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(sentBefore.load(), 0);
+
+    // One commit releases both responses.
+    committed.store(2);
+    server.receive(0);
+    server.receive(0);
+    EXPECT_EQ(sentBefore.load(), 2);
+
+    pipeline.stop();
+    server.close();
+    core.join();
+}
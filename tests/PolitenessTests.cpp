@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "Politeness.hpp"
+
+TEST(Politeness, DisabledByDefault) {
+    Politeness p;
+    EXPECT_FALSE(p.enabled());
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+}
+
+TEST(Politeness, MinimumDelay) {
+    Politeness p(100);
+    p.ensure(0);
+    EXPECT_TRUE(p.tryDispatch(0, 1000));
+    EXPECT_FALSE(p.tryDispatch(0, 1050));
+    EXPECT_EQ(p.readyAt(0, 1050), 1100);
+    EXPECT_TRUE(p.tryDispatch(0, 1100));
+}
+
+TEST(Politeness, TokenBucketAllowsBurst) {
+    Politeness p(100, 3);
+    p.ensure(0);
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_FALSE(p.tryDispatch(0, 0));
+    // One token comes back every 100ms.
+    EXPECT_FALSE(p.tryDispatch(0, 99));
+    EXPECT_TRUE(p.tryDispatch(0, 100));
+}
+
+TEST(Politeness, PerHostDelayOverride) {
+    Politeness p(10);
+    p.ensure(1);
+    p.setDelay(1, 1000);
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_TRUE(p.tryDispatch(1, 0));
+    EXPECT_TRUE(p.tryDispatch(0, 10));
+    EXPECT_FALSE(p.tryDispatch(1, 10));
+    EXPECT_EQ(p.readyAt(1, 10), 1000);
+}
+
+TEST(Politeness, PerHostDelayWithoutDefault) {
+    Politeness p;
+    p.setDelay(1, 1000);
+    EXPECT_TRUE(p.enabled());
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_TRUE(p.tryDispatch(1, 0));
+    EXPECT_FALSE(p.tryDispatch(1, 500));
+    EXPECT_EQ(p.readyAt(1, 500), 1000);
+    // Hosts added later are not limited either.
+    p.ensure(5);
+    EXPECT_TRUE(p.tryDispatch(5, 0));
+    EXPECT_TRUE(p.tryDispatch(5, 0));
+}
+
+TEST(Politeness, PerHostDelayNeverBelowDefault) {
+    Politeness p(100);
+    p.ensure(0);
+    p.setDelay(0, 10);
+    EXPECT_TRUE(p.tryDispatch(0, 0));
+    EXPECT_FALSE(p.tryDispatch(0, 50));
+}
+
+TEST(Politeness, ReleaseParkedHosts) {
+    Politeness p(10);
+    p.ensure(2);
+    p.park(0, 5);
+    p.park(1, 20);
+    p.park(2, 5000);  // more than one wheel revolution ahead
+    EXPECT_EQ(p.parked(), 3);
+
+    std::vector<uint32_t> released;
+    auto collect = [&released](uint32_t host) { released.push_back(host); };
+    p.release(4, collect);
+    EXPECT_TRUE(released.empty());
+    p.release(20, collect);
+    EXPECT_EQ(released, (std::vector<uint32_t>{0, 1}));
+    p.release(4999, collect);
+    EXPECT_EQ(released.size(), 2);
+    p.release(5000, collect);
+    EXPECT_EQ(released, (std::vector<uint32_t>{0, 1, 2}));
+    EXPECT_EQ(p.parked(), 0);
+}
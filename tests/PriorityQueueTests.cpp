@@ -1,8 +1,11 @@
 // PriorityQueue_test.cpp
+#include <algorithm>
+#include <map>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include "PriorityQueue.hpp"
+#include "UrlArena.hpp"
 #include "gtest/gtest.h"
 
 // Test fixture: each test gets its own instance of PriorityQueue,
@@ -89,3 +92,287 @@ TEST_F(PriorityQueueTest, PopNTest) {
     std::vector<std::string> result = pq.popN(4);
     EXPECT_EQ(result, expected);
 }
+
+// Test that queued urls pick up a TLD adjustment made after they were pushed.
+TEST_F(PriorityQueueTest, QueuedEntriesFollowTldAdjustment) {
+    PriorityQueue pq;
+    pq.push("a.com");  // 2
+    pq.push("c.com");  // 2
+
+    // Popping "a.com" raises .com to 3 while "c.com" is still queued.
+    EXPECT_EQ(pq.pop(), "a.com");
+    pq.push("d.org");  // 3
+
+    // "c.com" must be compared with the new .com priority (3), so the tie
+    // with .org is broken alphabetically.
+    EXPECT_EQ(pq.pop(), "c.com");
+    EXPECT_EQ(pq.pop(), "d.org");
+}
+
+// Test that a priority change is applied on the next pop even with many
+// TLDs scheduled, when rekey() sifts the one TLD that changed instead of
+// rebuilding the heap.
+TEST_F(PriorityQueueTest, SinglePopsFollowPriorityAmongManyTlds) {
+    PriorityQueue pq(2000);
+    for (int i = 0; i < 1000; ++i)
+        pq.push("m.t" + std::to_string(i));
+    pq.push("a.x");
+    pq.push("z.x");
+
+    // "a.x" goes first by name, which raises .x above the other TLDs, so
+    // "z.x" comes next although it sorts last.
+    EXPECT_EQ(pq.pop(), "a.x");
+    EXPECT_EQ(pq.pop(), "z.x");
+    EXPECT_EQ(pq.pop(), "m.t0");
+    EXPECT_EQ(pq.pop(), "m.t1");
+}
+
+// Test that a host with many queued urls does not starve other hosts.
+TEST_F(PriorityQueueTest, HostsAreServedRoundRobin) {
+    PriorityQueue pq;
+    pq.push("https://a.com/1");
+    pq.push("https://a.com/2");
+    pq.push("https://a.com/3");
+    pq.push("https://b.net/1");
+    EXPECT_EQ(pq.numHosts(), 2);
+
+    // a.com wins the first round on priority, but must wait for b.net to be
+    // served before it gets a second url.
+    std::vector<std::string> expected = {"https://a.com/1", "https://b.net/1",
+                                         "https://a.com/2", "https://a.com/3"};
+    EXPECT_EQ(pq.popN(4), expected);
+    EXPECT_EQ(pq.numHosts(), 0);
+}
+
+// Test that a demoted host sits out rounds between its urls.
+TEST_F(PriorityQueueTest, DemotedHostSkipsRounds) {
+    PriorityQueue pq;
+    for (int i = 1; i <= 4; ++i) {
+        pq.push("https://a.com/" + std::to_string(i));
+        pq.push("https://b.com/" + std::to_string(i));
+    }
+    pq.demote("a.com", 2);
+    pq.demote("unknown.com", 2);
+
+    std::vector<std::string> expected = {
+        "https://a.com/1", "https://b.com/1", "https://b.com/2",
+        "https://b.com/3", "https://a.com/2", "https://b.com/4",
+        "https://a.com/3", "https://a.com/4"};
+    EXPECT_EQ(pq.popN(8), expected);
+}
+
+// Test that every engine serves hosts round-robin, and that the heaps,
+// which order the same keys, serve the same urls.
+TEST_F(PriorityQueueTest, EnginesServeRoundRobin) {
+    const char* tlds[] = {".com", ".org", ".net", ".io", ".edu"};
+    std::vector<std::string> urls;
+    std::map<std::string, int> total;
+    for (int h = 0; h < 60; ++h) {
+        std::string host = "h" + std::to_string(h) + tlds[h % 5];
+        for (int i = 0; i <= h % 7; ++i) {
+            urls.push_back("https://" + host + "/" + std::to_string(i));
+            ++total[host];
+        }
+    }
+
+    std::vector<std::vector<std::string>> orders;
+    for (PriorityQueue::Engine engine :
+         {PriorityQueue::Engine::BINARY_HEAP, PriorityQueue::Engine::QUAD_HEAP,
+          PriorityQueue::Engine::BUCKETS}) {
+        PriorityQueue pq(1000, engine);
+        // Half one by one, half in bulk, with a demotion in between.
+        for (size_t i = 0; i < urls.size() / 2; ++i)
+            pq.push(urls[i]);
+        pq.demote("h6.io", 3);
+        std::vector<std::string> rest(urls.begin() + urls.size() / 2,
+                                      urls.end());
+        pq.pushN(rest);
+
+        std::vector<std::string> order;
+        std::map<std::string, int> served;
+        while (pq.size() > 0) {
+            for (std::string& url : pq.popN(7)) {
+                std::string host(PriorityQueue::hostOf(url));
+                // No host with urls left may be a round behind this one,
+                // save the demoted one.
+                for (const auto& [other, n] : total) {
+                    if (other != "h6.io" && host != "h6.io" &&
+                        served[other] < n) {
+                        EXPECT_GE(served[other], served[host]) << url;
+                    }
+                }
+                ++served[host];
+                order.push_back(std::move(url));
+            }
+        }
+        EXPECT_EQ(order.size(), urls.size());
+        orders.push_back(std::move(order));
+    }
+    EXPECT_EQ(orders[0], orders[1]);
+}
+
+// Test host extraction from urls with and without a scheme.
+TEST_F(PriorityQueueTest, HostOf) {
+    EXPECT_EQ(PriorityQueue::hostOf("https://en.wikipedia.org/wiki/X"),
+              "en.wikipedia.org");
+    EXPECT_EQ(PriorityQueue::hostOf("http://x.com?q=1"), "x.com");
+    EXPECT_EQ(PriorityQueue::hostOf("a.edu"), "a.edu");
+}
+
+// Test that a host in cooldown is not served until its delay has passed.
+TEST_F(PriorityQueueTest, PolitenessDelaysHost) {
+    PriorityQueue pq;
+    pq.setPoliteness(1000);
+    pq.push("https://a.com/1");
+    pq.push("https://a.com/2");
+    pq.push("https://b.com/1");
+
+    std::vector<std::string> first = {"https://a.com/1", "https://b.com/1"};
+    EXPECT_EQ(pq.popN(10, 0), first);
+    EXPECT_EQ(pq.numParkedHosts(), 1);
+    EXPECT_TRUE(pq.popN(10, 999).empty());
+
+    std::vector<std::string> second = {"https://a.com/2"};
+    EXPECT_EQ(pq.popN(10, 1000), second);
+    EXPECT_EQ(pq.size(), 0);
+}
+
+// Test that a host's own crawl delay applies without a default delay, and
+// to urls queued after it was set.
+TEST_F(PriorityQueueTest, CrawlDelayWithoutDefaultDelay) {
+    PriorityQueue pq;
+    pq.setCrawlDelay("a.com", 1000);
+    pq.push("https://a.com/1");
+    pq.push("https://a.com/2");
+    pq.push("https://b.com/1");
+    pq.push("https://b.com/2");
+
+    std::vector<std::string> first = {"https://a.com/1", "https://b.com/1",
+                                      "https://b.com/2"};
+    EXPECT_EQ(pq.popN(10, 0), first);
+    EXPECT_TRUE(pq.popN(10, 999).empty());
+    std::vector<std::string> second = {"https://a.com/2"};
+    EXPECT_EQ(pq.popN(10, 1000), second);
+}
+
+// Test that a bulk load serves urls in the same order as single pushes,
+// also on top of urls already queued, and stops at capacity.
+TEST_F(PriorityQueueTest, PushNMatchesPush) {
+    std::vector<std::string> urls;
+    const char* tlds[] = {".com", ".org", ".io", ".edu", ".net"};
+    for (int i = 0; i < 2000; ++i) {
+        urls.push_back("https://h" + std::to_string(i % 97) +
+                       tlds[i % 5] + "/" + std::to_string(i));
+    }
+
+    PriorityQueue one(10000);
+    PriorityQueue bulk(10000);
+    for (int i = 0; i < 300; ++i) {
+        one.push(urls[i]);
+        bulk.push(urls[i]);
+    }
+    EXPECT_EQ(one.popN(50), bulk.popN(50));
+
+    std::vector<std::string> rest(urls.begin() + 300, urls.end());
+    for (const std::string& url : rest)
+        one.push(url);
+    EXPECT_EQ(bulk.pushN(rest), rest.size());
+    EXPECT_EQ(bulk.size(), one.size());
+    EXPECT_EQ(bulk.numHosts(), one.numHosts());
+    while (one.size() > 0)
+        EXPECT_EQ(one.popN(64), bulk.popN(64));
+    EXPECT_EQ(bulk.size(), 0);
+
+    PriorityQueue small(10);
+    std::vector<std::string> some(urls.begin(), urls.begin() + 25);
+    EXPECT_EQ(small.pushN(some), 10);
+    EXPECT_TRUE(small.full());
+    EXPECT_EQ(some[10], urls[10]);
+}
+
+// Test that small batches, which sift hosts and TLDs up one by one
+// instead of rebuilding the heaps, keep the order of single pushes with
+// every engine, while short pops rekey only the TLDs they served.
+TEST_F(PriorityQueueTest, SmallBatchesMatchPush) {
+    std::vector<std::string> urls;
+    for (int i = 0; i < 3000; ++i) {
+        urls.push_back("https://h" + std::to_string(i % 211) + ".t" +
+                       std::to_string(i % 40) + "/" + std::to_string(i));
+    }
+    for (PriorityQueue::Engine engine :
+         {PriorityQueue::Engine::BINARY_HEAP, PriorityQueue::Engine::QUAD_HEAP,
+          PriorityQueue::Engine::BUCKETS}) {
+        PriorityQueue one(10000, engine);
+        PriorityQueue batched(10000, engine);
+        std::vector<std::string> batch;
+        for (size_t i = 0; i < urls.size(); ++i) {
+            one.push(urls[i]);
+            batch.push_back(urls[i]);
+            if (batch.size() == 5 || i + 1 == urls.size()) {
+                EXPECT_EQ(batched.pushN(batch), batch.size());
+                batch.clear();
+                EXPECT_EQ(one.popN(3), batched.popN(3));
+            }
+        }
+        EXPECT_EQ(batched.size(), one.size());
+        while (one.size() > 0)
+            EXPECT_EQ(one.popN(2), batched.popN(2));
+        EXPECT_EQ(batched.size(), 0);
+    }
+}
+
+TEST(UrlArenaTest, ReusesAndFreesChunks) {
+    UrlArena arena;
+    std::vector<UrlArena::Ref> refs;
+    std::string url(100, 'x');
+    for (int i = 0; i < 100000; ++i)
+        refs.push_back(arena.add(url + std::to_string(i)));
+    EXPECT_EQ(arena.get(refs[12345]), url + "12345");
+    size_t full = arena.bytes();
+    EXPECT_LT(full, 100000 * 110);
+
+    for (UrlArena::Ref ref : refs)
+        arena.release(ref);
+    EXPECT_EQ(arena.liveBytes(), 0);
+    // Only a few spare chunks keep their memory.
+    EXPECT_LT(arena.bytes(), full / 4);
+
+    // Urls longer than a chunk get one of their own.
+    std::string huge(1 << 20, 'y');
+    UrlArena::Ref ref = arena.add(huge);
+    EXPECT_EQ(arena.get(ref), huge);
+    arena.release(ref);
+    EXPECT_LT(arena.bytes(), full / 4);
+}
+
+// Test that popping most urls gives back the memory they held, even though
+// every chunk keeps a few urls alive, and that the urls left are intact.
+TEST_F(PriorityQueueTest, ArenaIsCompactedAsUrlsArePopped) {
+    PriorityQueue pq(100000);
+    std::vector<std::string> pushed;
+    std::string pad(80, 'p');
+    // Host by host, so popping round-robin leaves urls in every chunk.
+    for (int h = 0; h < 1000; ++h) {
+        for (int i = 0; i < 50; ++i) {
+            pushed.push_back("https://h" + std::to_string(h) + ".com/" + pad +
+                             std::to_string(i));
+            pq.push(pushed.back());
+        }
+    }
+    size_t full = pq.urlBytes();
+
+    std::vector<std::string> popped;
+    while (popped.size() < 45000) {
+        for (std::string& url : pq.popN(100))
+            popped.push_back(std::move(url));
+    }
+    EXPECT_LT(pq.urlBytes(), full / 4);
+
+    while (pq.size() > 0) {
+        for (std::string& url : pq.popN(100))
+            popped.push_back(std::move(url));
+    }
+    std::sort(pushed.begin(), pushed.end());
+    std::sort(popped.begin(), popped.end());
+    EXPECT_EQ(popped, pushed);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "RetryQueue.hpp"
+
+namespace {
+
+struct Released {
+    std::vector<std::string> urls;
+    std::vector<std::pair<std::string, uint32_t>> demotions;
+};
+
+Released release(RetryQueue& retries, int64_t nowMs) {
+    Released out;
+    retries.release(
+        nowMs, [&](std::string_view url) { out.urls.emplace_back(url); },
+        [&](std::string_view host, uint32_t rounds) {
+            out.demotions.emplace_back(host, rounds);
+        });
+    return out;
+}
+
+RetryQueue::Options options() {
+    RetryQueue::Options options;
+    options.baseDelayMs = 1000;
+    options.maxDelayMs = 60000;
+    options.demoteAfter = 0;
+    return options;
+}
+
+}  // namespace
+
+TEST(RetryQueueTest, BacksOffThenGivesUp) {
+    RetryQueue retries(options());
+    std::string url = "https://a.com/x";
+    EXPECT_TRUE(retries.fail(url, 0));
+    EXPECT_EQ(retries.pending(), 1);
+    EXPECT_TRUE(release(retries, 999).urls.empty());
+    EXPECT_EQ(release(retries, 1000).urls, std::vector<std::string>{url});
+
+    EXPECT_TRUE(retries.fail(url, 1000));
+    EXPECT_TRUE(release(retries, 2999).urls.empty());
+    EXPECT_EQ(release(retries, 3000).urls.size(), 1);
+
+    // The third fetch was the last.
+    EXPECT_FALSE(retries.fail(url, 3000));
+    EXPECT_EQ(retries.pending(), 0);
+    EXPECT_EQ(retries.failures(), 3);
+    EXPECT_EQ(retries.retries(), 2);
+    EXPECT_EQ(retries.givenUp(), 1);
+}
+
+// Test that a host failing over and over makes each of its urls wait
+// longer, while other hosts are unaffected.
+TEST(RetryQueueTest, BacksOffPerHost) {
+    RetryQueue retries(options());
+    for (int i = 0; i < 4; ++i)
+        retries.fail("https://a.com/" + std::to_string(i), 0);
+    retries.fail("https://b.com/0", 0);
+
+    EXPECT_EQ(release(retries, 1000).urls,
+              (std::vector<std::string>{"https://a.com/0", "https://b.com/0"}));
+    EXPECT_EQ(release(retries, 2000).urls,
+              std::vector<std::string>{"https://a.com/1"});
+    EXPECT_TRUE(release(retries, 3999).urls.empty());
+    EXPECT_EQ(release(retries, 4000).urls,
+              std::vector<std::string>{"https://a.com/2"});
+    EXPECT_EQ(release(retries, 8000).urls,
+              std::vector<std::string>{"https://a.com/3"});
+
+    // A failure long after the last one starts the run over.
+    retries.fail("https://a.com/4", 100000);
+    EXPECT_EQ(release(retries, 101000).urls.size(), 1);
+}
+
+TEST(RetryQueueTest, DemotesAndRestoresHosts) {
+    RetryQueue::Options o = options();
+    o.demoteAfter = 2;
+    o.maxDelayMs = 10000;
+    RetryQueue retries(o);
+    using Demotions = std::vector<std::pair<std::string, uint32_t>>;
+
+    retries.fail("https://a.com/1", 0);
+    EXPECT_TRUE(release(retries, 0).demotions.empty());
+    retries.fail("https://a.com/2", 0);
+    EXPECT_EQ(release(retries, 0).demotions, (Demotions{{"a.com", 1}}));
+    EXPECT_EQ(retries.numDemoted(), 1);
+    retries.fail("https://a.com/3", 5000);
+    retries.fail("https://a.com/4", 5000);
+    EXPECT_EQ(release(retries, 5000).demotions, (Demotions{{"a.com", 3}}));
+
+    // Restored once a.com has gone maxDelayMs without failing.
+    EXPECT_TRUE(release(retries, 14999).demotions.empty());
+    EXPECT_EQ(release(retries, 15000).demotions, (Demotions{{"a.com", 0}}));
+    EXPECT_EQ(retries.numDemoted(), 0);
+}
+
+// Test that attempt counts survive one generation change but not two.
+TEST(RetryQueueTest, ForgetsOldGenerations) {
+    RetryQueue::Options o = options();
+    o.maxAttempts = 2;
+    o.maxTracked = 4;
+    std::string url = "https://a.com/x";
+
+    RetryQueue once(o);
+    once.fail(url, 0);
+    for (int i = 0; i < 3; ++i)
+        once.fail("https://b.com/" + std::to_string(i), 0);
+    EXPECT_FALSE(once.fail(url, 0));
+
+    RetryQueue twice(o);
+    twice.fail(url, 0);
+    for (int i = 0; i < 7; ++i)
+        twice.fail("https://b.com/" + std::to_string(i), 0);
+    EXPECT_TRUE(twice.fail(url, 0));
+}
+
+TEST(RetryQueueTest, DelaysLongerThanTheWheel) {
+    RetryQueue::Options o = options();
+    o.baseDelayMs = 5000000;
+    o.maxDelayMs = 10000000;
+    RetryQueue retries(o);
+    retries.fail("https://a.com/x", 0);
+    // Same slot, one turn early.
+    EXPECT_TRUE(release(retries, 904000).urls.empty());
+    EXPECT_EQ(release(retries, 5000000).urls.size(), 1);
+    EXPECT_EQ(retries.pending(), 0);
+}
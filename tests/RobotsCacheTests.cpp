@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "RobotsCache.hpp"
+
+using Access = RobotsCache::Access;
+
+TEST(RobotsCacheTest, UnknownHostsAreUnknown) {
+    RobotsCache robots;
+    EXPECT_EQ(robots.check("https://a.com/x"), Access::UNKNOWN);
+    robots.set("a.com", {});
+    EXPECT_EQ(robots.check("https://a.com/x"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://b.com/x"), Access::UNKNOWN);
+}
+
+// Test that the longest matching rule decides and Allow wins ties.
+TEST(RobotsCacheTest, LongestMatchWins) {
+    RobotsCache robots;
+    robots.set("a.com", {{"/private", false},
+                         {"/private/public", true},
+                         {"/private/public/secret", false},
+                         {"/tie", false},
+                         {"/tie", true},
+                         {"/p", false},
+                         {"/pa", true}});
+    EXPECT_EQ(robots.check("https://a.com/"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/private"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/private/x"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/private/public/x"),
+              Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/private/public/secret/1"),
+              Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/tie"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/pb"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/pa"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/privat"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/x"), Access::ALLOWED);
+}
+
+TEST(RobotsCacheTest, Wildcards) {
+    RobotsCache robots;
+    robots.set("a.com", {{"/*.pdf$", false},
+                         {"/search*q=", false},
+                         {"/search/about", true},
+                         {"/", true}});
+    EXPECT_EQ(robots.check("https://a.com/docs/a.pdf"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/docs/a.pdf?x"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/search?q=1"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/search/about"), Access::ALLOWED);
+}
+
+TEST(RobotsCacheTest, SetReplacesRules) {
+    RobotsCache robots;
+    robots.set("a.com", {{"/", false}});
+    EXPECT_EQ(robots.check("https://a.com/x"), Access::DISALLOWED);
+    robots.set("a.com", {{"/y", false}});
+    EXPECT_EQ(robots.check("https://a.com/x"), Access::ALLOWED);
+    EXPECT_EQ(robots.numHosts(), 1);
+}
+
+TEST(RobotsCacheTest, LoadsMessageLines) {
+    RobotsCache robots;
+    std::vector<std::string_view> lines = {
+        "https://a.com/robots.txt", "User-agent: *", "Disallow: /admin",
+        "allow: /admin/help",       "https://b.org", "Disallow:",
+        "https://c.net:8080/",      "  DISALLOW : /  "};
+    EXPECT_EQ(robots.load(lines), 3);
+    EXPECT_EQ(robots.check("https://a.com/admin/x"), Access::DISALLOWED);
+    EXPECT_EQ(robots.check("https://a.com/admin/help"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://b.org/anything"), Access::ALLOWED);
+    EXPECT_EQ(robots.check("https://c.net:8080/x"), Access::DISALLOWED);
+}
+
+TEST(RobotsCacheTest, LoadsCrawlDelays) {
+    RobotsCache robots;
+    std::vector<std::string_view> lines = {
+        "https://A.com/robots.txt", "Crawl-delay: 2.5", "Disallow: /x",
+        "https://b.org",            "crawl-delay: 86400",
+        "https://c.net",            "Crawl-delay: soon"};
+    std::vector<std::pair<std::string, uint32_t>> delays;
+    EXPECT_EQ(robots.load(lines,
+                          [&](std::string_view host, uint32_t delayMs) {
+                              delays.emplace_back(host, delayMs);
+                          }),
+              3);
+    std::vector<std::pair<std::string, uint32_t>> expected = {
+        {"a.com", 2500}, {"b.org", 60000}};
+    EXPECT_EQ(delays, expected);
+    EXPECT_EQ(robots.check("https://a.com/x"), Access::DISALLOWED);
+}
+
+// Urls are checked in canonical form, so rules for a host reported in
+// mixed case must apply to its lowercase urls.
+TEST(RobotsCacheTest, HostsAreMatchedInLowercase) {
+    RobotsCache robots;
+    std::vector<std::string_view> lines = {"HTTPS://WWW.Example.COM/robots.txt",
+                                           "Disallow: /private"};
+    EXPECT_EQ(robots.load(lines), 1);
+    EXPECT_EQ(robots.check("https://www.example.com/private/x"),
+              Access::DISALLOWED);
+    robots.set("B.org", {{"/", false}});
+    EXPECT_EQ(robots.check("https://b.org/x"), Access::DISALLOWED);
+    EXPECT_EQ(robots.numHosts(), 2);
+}
+
+// Test that the least recently used hosts go first once over the bound,
+// and that lookups still find every host that was kept.
+TEST(RobotsCacheTest, EvictsLeastRecentlyUsed) {
+    RobotsCache probe;
+    probe.set("h0.com", {{"/x", false}});
+    size_t perHost = probe.bytes();
+
+    RobotsCache robots(100 * perHost);
+    for (int i = 0; i < 100; ++i)
+        robots.set("h" + std::to_string(i) + ".com", {{"/x", false}});
+    EXPECT_EQ(robots.numHosts(), 100);
+    EXPECT_EQ(robots.evictions(), 0);
+
+    // Touch h0 so h1 and h2 are the oldest.
+    EXPECT_EQ(robots.check("https://h0.com/x"), Access::DISALLOWED);
+    robots.set("h100.com", {{"/x", false}});
+    robots.set("h101.com", {{"/x", false}});
+    EXPECT_EQ(robots.evictions(), 2);
+    EXPECT_EQ(robots.numHosts(), 100);
+    EXPECT_LE(robots.bytes(), 100 * perHost);
+    EXPECT_EQ(robots.check("https://h1.com/x"), Access::UNKNOWN);
+    EXPECT_EQ(robots.check("https://h2.com/x"), Access::UNKNOWN);
+    for (int i : {0, 3, 50, 99, 100, 101}) {
+        EXPECT_EQ(robots.check("https://h" + std::to_string(i) + ".com/x"),
+                  Access::DISALLOWED);
+    }
+}
+
+TEST(RobotsCacheTest, ManyHostsSurviveChurn) {
+    RobotsCache probe;
+    probe.set("h0.com", {{"/x", false}});
+    RobotsCache robots(1000 * probe.bytes());
+    for (int i = 0; i < 20000; ++i)
+        robots.set("h" + std::to_string(i) + ".com", {{"/x", false}});
+    EXPECT_EQ(robots.numHosts(), 1000);
+    for (int i = 19000; i < 20000; ++i) {
+        ASSERT_EQ(robots.check("https://h" + std::to_string(i) + ".com/x"),
+                  Access::DISALLOWED);
+    }
+    EXPECT_EQ(robots.check("https://h18999.com/x"), Access::UNKNOWN);
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SeedList.hpp"
+
+namespace fs = std::filesystem;
+
+class SeedListTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        path = (fs::temp_directory_path() /
+                ("seeds_" + std::string(::testing::UnitTest::GetInstance()
+                                            ->current_test_info()
+                                            ->name()) +
+                 ".txt"))
+                   .string();
+    }
+
+    void TearDown() override { fs::remove(path); }
+
+    void write(const std::string& contents) {
+        std::ofstream(path, std::ios::binary) << contents;
+    }
+
+    std::vector<std::string> read() {
+        SeedList seeds = SeedList::read(path);
+        return std::vector<std::string>(seeds.urls().begin(),
+                                        seeds.urls().end());
+    }
+
+    std::string path;
+};
+
+TEST_F(SeedListTest, SplitsAndTrimsLines) {
+    write("https://a.com/\r\n\n  https://b.org/x \n# comment\n\t\r\nc.net");
+    std::vector<std::string> expected = {"https://a.com/", "https://b.org/x",
+                                         "c.net"};
+    EXPECT_EQ(read(), expected);
+}
+
+TEST_F(SeedListTest, EmptyFileHasNoSeeds) {
+    write("");
+    EXPECT_TRUE(read().empty());
+    write("\n\n");
+    EXPECT_TRUE(read().empty());
+}
+
+TEST_F(SeedListTest, MissingFileThrows) {
+    EXPECT_THROW(SeedList::read(path), std::runtime_error);
+}
+
+TEST_F(SeedListTest, ReadsTheRepoSeedList) {
+    SeedList seeds = SeedList::read(PROJECT_ROOT "seedList.txt");
+    EXPECT_GT(seeds.size(), 50);
+    for (std::string_view url : seeds.urls())
+        EXPECT_EQ(url.substr(0, 4), "http");
+}
@@ -0,0 +1,325 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShardedFrontier.hpp"
+
+namespace fs = std::filesystem;
+
+class ShardedFrontierTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        dir = (fs::temp_directory_path() /
+               ("shards_" + std::string(::testing::UnitTest::GetInstance()
+                                            ->current_test_info()
+                                            ->name())))
+                  .string();
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    std::unique_ptr<ShardedFrontier> make(size_t n, size_t capacity = 10000,
+                                          const std::string& kind = "exact",
+                                          uint32_t maxUrlsPerHost = 0,
+                                          uint32_t crawlDelayMs = 0) {
+        std::vector<std::unique_ptr<DedupStore>> seen;
+        for (size_t i = 0; i < n; ++i) {
+            seen.push_back(makeDedupStore(
+                kind, 100000, ShardedFrontier::shardDir(dir + "/seen", i, n)));
+        }
+        ShardedFrontier::Options options;
+        options.capacity = capacity;
+        options.spillDir = dir + "/spill";
+        options.maxUrlsPerHost = maxUrlsPerHost;
+        options.crawlDelayMs = crawlDelayMs;
+        return std::make_unique<ShardedFrontier>(std::move(seen), options);
+    }
+
+    std::string url(int i) {
+        return "https://host" + std::to_string(i % 101) + ".com/page/" +
+               std::to_string(i);
+    }
+
+    // Takes until every queued url is out.
+    std::multiset<std::string> drain(ShardedFrontier& frontier) {
+        std::multiset<std::string> out;
+        while (frontier.size() > 0) {
+            for (std::string& u : frontier.take(64, 100))
+                out.insert(std::move(u));
+        }
+        return out;
+    }
+
+    std::string dir;
+};
+
+TEST_F(ShardedFrontierTest, HostAlwaysMapsToTheSameShard) {
+    auto frontier = make(4);
+    std::set<size_t> used;
+    for (int i = 0; i < 1000; ++i) {
+        size_t shard = frontier->shardOf(url(i));
+        EXPECT_EQ(shard, frontier->shardOf("http://host" +
+                                           std::to_string(i % 101) +
+                                           ".com/other"));
+        used.insert(shard);
+    }
+    EXPECT_EQ(used.size(), 4);
+}
+
+TEST_F(ShardedFrontierTest, TakesEveryNewUrlOnce) {
+    auto frontier = make(4);
+    for (int i = 0; i < 2000; ++i) {
+        frontier->add(url(i), true);
+        frontier->add(url(i), true);
+    }
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 2000);
+
+    std::multiset<std::string> out = drain(*frontier);
+    EXPECT_EQ(out.size(), 2000);
+    EXPECT_EQ(std::set<std::string>(out.begin(), out.end()).size(), 2000);
+
+    // Seen urls stay seen after they were taken.
+    frontier->add(url(0), true);
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 0);
+}
+
+TEST_F(ShardedFrontierTest, TakeInterleavesShards) {
+    auto frontier = make(4);
+    for (int i = 0; i < 400; ++i)
+        frontier->add(url(i), true);
+    frontier->sync();
+
+    std::set<size_t> shards;
+    for (const std::string& u : frontier->take(4))
+        shards.insert(frontier->shardOf(u));
+    EXPECT_EQ(shards.size(), 4);
+}
+
+TEST_F(ShardedFrontierTest, OverflowSpillsAndComesBack) {
+    auto frontier = make(2, 100);
+    for (int i = 0; i < 1000; ++i)
+        frontier->add(url(i), true);
+    frontier->sync();
+    EXPECT_GT(frontier->spilled(), 0);
+    EXPECT_EQ(drain(*frontier).size(), 1000);
+}
+
+// Test that clear() drops spilled urls too, on disk as well, so a restart
+// does not read them back.
+TEST_F(ShardedFrontierTest, ClearDropsSpilledUrls) {
+    {
+        auto frontier = make(2, 100);
+        for (int i = 0; i < 1000; ++i)
+            frontier->add(url(i), true);
+        frontier->sync();
+        ASSERT_GT(frontier->spilled(), 0);
+        frontier->clear();
+        EXPECT_EQ(frontier->spilled(), 0);
+        EXPECT_EQ(frontier->size(), 0);
+        frontier->add("https://fresh.com/", true);
+        frontier->sync();
+        EXPECT_EQ(drain(*frontier).size(), 1);
+    }
+    auto frontier = make(2, 100);
+    EXPECT_EQ(frontier->spilled(), 0);
+}
+
+TEST_F(ShardedFrontierTest, FullSnapshotHoldsEveryQueuedUrl) {
+    std::string path = dir + "/seen.ckpt";
+    std::vector<uint64_t> offsets;
+    {
+        auto frontier = make(3);
+        for (int i = 0; i < 500; ++i)
+            frontier->add(url(i), true);
+        frontier->sync();
+        // Some urls are out already and some sit in the ready queues.
+        EXPECT_EQ(frontier->take(50).size(), 50);
+
+        ShardedFrontier::Snapshot snap = frontier->snapshot(true);
+        EXPECT_TRUE(snap.full);
+        ASSERT_EQ(snap.shards.size(), 3);
+        uint64_t count = 0;
+        for (const auto& shard : snap.shards)
+            count += shard.numQueued;
+        EXPECT_EQ(count, 450);
+
+        // Urls taken back from the ready queues are still served.
+        EXPECT_EQ(drain(*frontier).size(), 450);
+
+        // Stores start on page boundaries so they can be mapped.
+        std::ofstream out(path, std::ios::binary);
+        for (const auto& shard : snap.shards) {
+            size_t pos = static_cast<size_t>(out.tellp());
+            size_t aligned = (pos + 4095) / 4096 * 4096;
+            out << std::string(aligned - pos, '\0');
+            offsets.push_back(aligned);
+            out << shard.seen;
+        }
+    }
+
+    auto frontier = make(3);
+    ASSERT_TRUE(frontier->loadSeen(path, offsets));
+    for (int i = 0; i < 500; ++i)
+        frontier->add(url(i), true);
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 0);
+    EXPECT_FALSE(frontier->loadSeen(path, {offsets[0]}));
+}
+
+TEST_F(ShardedFrontierTest, DeltaSnapshotLogsAddsAndTakes) {
+    auto frontier = make(2);
+    for (int i = 0; i < 100; ++i)
+        frontier->add(url(i), true);
+    frontier->sync();
+    frontier->snapshot(true);
+
+    for (int i = 100; i < 150; ++i)
+        frontier->add(url(i), true);
+    frontier->sync();
+    std::vector<std::string> taken = frontier->take(20);
+    ASSERT_EQ(taken.size(), 20);
+
+    ShardedFrontier::Snapshot snap = frontier->snapshot(false);
+    EXPECT_FALSE(snap.full);
+    uint64_t adds = 0, takes = 0;
+    for (const auto& shard : snap.shards) {
+        adds += shard.numQueued;
+        takes += shard.numTaken;
+        // Taken urls are logged with the shard that queued them.
+        const char* p = shard.taken.data();
+        for (uint64_t i = 0; i < shard.numTaken; ++i) {
+            size_t len;
+            std::memcpy(&len, p, 8);
+            std::string taken(p + 8, len);
+            EXPECT_EQ(size_t(&shard - snap.shards.data()),
+                      frontier->shardOf(taken));
+            p += 8 + len;
+        }
+    }
+    EXPECT_EQ(adds, 50);
+    EXPECT_EQ(takes, 20);
+
+    // The logs start over after every snapshot.
+    snap = frontier->snapshot(false);
+    for (const auto& shard : snap.shards) {
+        EXPECT_TRUE(shard.queued.empty());
+        EXPECT_TRUE(shard.taken.empty());
+    }
+}
+
+TEST_F(ShardedFrontierTest, RestoreFillsEveryShard) {
+    auto frontier = make(3, 100);
+    std::vector<ShardedFrontier::Restored> restored(3);
+    for (int i = 0; i < 500; ++i)
+        restored[frontier->shardOf(url(i))].queued.push_back(url(i));
+    // Logged urls are deduplicated, unless requeued; taken ones are only
+    // marked seen.
+    std::vector<std::pair<int, bool>> logged = {
+        {500, false}, {501, false}, {502, false},
+        {500, false}, {503, false}, {501, true}};
+    for (const auto& [i, requeued] : logged) {
+        auto& shard = restored[frontier->shardOf(url(i))];
+        shard.logged.push_back(url(i));
+        shard.loggedTaken.push_back(i == 502);
+        shard.loggedRequeued.push_back(requeued);
+    }
+
+    std::atomic<int> calls{0};
+    frontier->restore([&](size_t i) {
+        ++calls;
+        return std::move(restored[i]);
+    });
+    EXPECT_EQ(calls, 3);
+    // Most of them only fit in the spill tier.
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 504);
+
+    frontier->add(url(502), true);
+    frontier->add(url(600), true);
+    frontier->sync();
+    std::multiset<std::string> out = drain(*frontier);
+    EXPECT_EQ(out.size(), 505);
+    EXPECT_EQ(out.count(url(500)), 1);
+    EXPECT_EQ(out.count(url(501)), 2);
+    EXPECT_EQ(out.count(url(502)), 0);
+    EXPECT_EQ(out.count(url(600)), 1);
+}
+
+TEST_F(ShardedFrontierTest, AddBulkDeduplicatesAndSpills) {
+    auto frontier = make(3, 100);
+    std::vector<std::string> urls;
+    for (int i = 0; i < 600; ++i)
+        urls.push_back(url(i % 500));
+    std::vector<std::string_view> views(urls.begin(), urls.end());
+    frontier->addBulk(views, true);
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 500);
+
+    // The urls are seen now.
+    frontier->add(url(7), true);
+    frontier->add(url(1000), true);
+    frontier->sync();
+    std::multiset<std::string> out = drain(*frontier);
+    EXPECT_EQ(out.size(), 501);
+    EXPECT_EQ(out.count(url(7)), 1);
+
+    // Without dedup every copy is queued.
+    auto plain = make(1);
+    plain->addBulk(views, false);
+    plain->sync();
+    EXPECT_EQ(plain->size(), 600);
+}
+
+// Test that a host takes no more urls once it has its cap of new ones,
+// while other hosts are unaffected.
+TEST_F(ShardedFrontierTest, CapsUrlsPerHost) {
+    auto frontier = make(2, 10000, "exact", 3);
+    for (int i = 0; i < 10; ++i)
+        frontier->add("https://trap.com/day/" + std::to_string(i), true);
+    frontier->add("https://trap.com/day/0", true);
+    frontier->add("https://other.com/", true);
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 4);
+    EXPECT_EQ(frontier->overQuota(), 8);
+
+    // Without dedup, as for seeds, the cap doesn't apply.
+    frontier->add("https://trap.com/day/9", false);
+    frontier->sync();
+    EXPECT_EQ(frontier->size(), 5);
+    EXPECT_EQ(frontier->overQuota(), 8);
+}
+
+// Test that urls popped ahead of take() keep a host's delay: they come out
+// of take() one at a time, a delay apart, however long they waited.
+TEST_F(ShardedFrontierTest, TakeSpacesAHostsUrlsByItsDelay) {
+    auto frontier = make(2, 10000, "exact", 0, 200);
+    for (int i = 0; i < 4; ++i)
+        frontier->add("https://slow.com/" + std::to_string(i), true);
+    frontier->sync();
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+
+    std::vector<std::chrono::steady_clock::time_point> times;
+    while (times.size() < 4) {
+        std::vector<std::string> urls = frontier->take(50, 10);
+        ASSERT_LE(urls.size(), 1);
+        if (!urls.empty())
+            times.push_back(std::chrono::steady_clock::now());
+    }
+    for (size_t i = 1; i < times.size(); ++i) {
+        EXPECT_GE(std::chrono::duration_cast<std::chrono::milliseconds>(
+                      times[i] - times[i - 1])
+                      .count(),
+                  195);
+    }
+}
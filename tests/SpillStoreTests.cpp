@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "SpillStore.hpp"
+
+namespace fs = std::filesystem;
+
+class SpillStoreTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        dir = (fs::temp_directory_path() /
+               ("spill_" + std::string(::testing::UnitTest::GetInstance()
+                                           ->current_test_info()
+                                           ->name())))
+                  .string();
+        fs::remove_all(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+
+    std::string dir;
+};
+
+TEST_F(SpillStoreTest, RefillsHighestPriorityFirst) {
+    SpillStore spill(dir, 2);
+    spill.append("a.com/1", 2);
+    spill.append("a.com/2", 2);
+    spill.append("b.edu/1", 5);
+    spill.append("c.net/1", 1);
+    EXPECT_EQ(spill.size(), 4);
+
+    std::vector<std::string> expected = {"b.edu/1", "a.com/1", "a.com/2",
+                                         "c.net/1"};
+    EXPECT_EQ(spill.refill(10), expected);
+    EXPECT_EQ(spill.size(), 0);
+    EXPECT_TRUE(spill.refill(10).empty());
+}
+
+TEST_F(SpillStoreTest, RefillOnlyTakesWholeSegmentsThatFit) {
+    SpillStore spill(dir, 3);
+    for (int i = 0; i < 6; ++i)
+        spill.append("a.com/" + std::to_string(i), 2);
+
+    EXPECT_TRUE(spill.refill(2).empty());
+    EXPECT_EQ(spill.refill(5).size(), 3);
+    EXPECT_EQ(spill.size(), 3);
+    EXPECT_EQ(spill.refill(5).size(), 3);
+}
+
+TEST_F(SpillStoreTest, RecoversSegmentsFromDisk) {
+    {
+        SpillStore spill(dir, 2);
+        spill.append("a.com/1", 2);
+        spill.append("a.com/2", 2);
+        spill.append("a.com/3", 2);  // left in an open segment
+        spill.flush();
+    }
+    SpillStore spill(dir, 2);
+    EXPECT_EQ(spill.size(), 3);
+    std::vector<std::string> expected = {"a.com/1", "a.com/2", "a.com/3"};
+    EXPECT_EQ(spill.refill(10), expected);
+}
+
+TEST_F(SpillStoreTest, KeepsFewSegmentsOpen) {
+    SpillStore spill(dir, 100);
+    for (int priority = 0; priority < 40; ++priority)
+        spill.append("a.com/" + std::to_string(priority), priority);
+    size_t open = 0;
+    for (const auto& entry : fs::directory_iterator(dir))
+        open += entry.path().extension() == ".open";
+    EXPECT_LE(open, 8);
+    EXPECT_EQ(spill.size(), 40);
+    std::vector<std::string> urls = spill.refill(100);
+    ASSERT_EQ(urls.size(), 40);
+    EXPECT_EQ(urls.front(), "a.com/39");
+    EXPECT_EQ(urls.back(), "a.com/0");
+}
+
+TEST_F(SpillStoreTest, KeepsRefilledSegmentsUntilReleased) {
+    {
+        SpillStore spill(dir, 2);
+        for (int i = 0; i < 4; ++i)
+            spill.append("a.com/" + std::to_string(i), 2);
+        EXPECT_EQ(spill.refill(2).size(), 2);
+        spill.markCheckpoint(1);
+        EXPECT_EQ(spill.refill(2).size(), 2);
+        EXPECT_EQ(spill.numConsumed(), 2);
+        // Checkpoint 1 covers the first segment only.
+        spill.release(1);
+        EXPECT_EQ(spill.numConsumed(), 1);
+    }
+    // The second segment is not covered by a checkpoint, so a restart
+    // reads it again.
+    SpillStore spill(dir, 2);
+    EXPECT_EQ(spill.size(), 2);
+    std::vector<std::string> expected = {"a.com/2", "a.com/3"};
+    EXPECT_EQ(spill.refill(10), expected);
+}
@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "TimingWheel.hpp"
+
+TEST(TimingWheel, HandsBackItemsOnceDue) {
+    TimingWheel<int> wheel(1000, 8);
+    wheel.add(1, 1500);
+    wheel.add(2, 2500);
+    wheel.add(3, 20500);  // more than one turn ahead
+    EXPECT_EQ(wheel.size(), 3);
+
+    std::vector<int> due;
+    auto collect = [&due](int item) { due.push_back(item); };
+    wheel.advance(1499, collect);
+    EXPECT_TRUE(due.empty());
+    wheel.advance(2500, collect);
+    EXPECT_EQ(due, (std::vector<int>{1, 2}));
+    wheel.advance(20499, collect);
+    EXPECT_EQ(due.size(), 2);
+    wheel.advance(20500, collect);
+    EXPECT_EQ(due, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimingWheel, ItemsAddedLateWaitForTheNextAdvance) {
+    TimingWheel<int> wheel(1000, 8);
+    wheel.add(1, 5000);
+    std::vector<int> due;
+    // An item added from the callback is handed back next time, even if
+    // it is due already.
+    wheel.advance(5000, [&](int item) {
+        due.push_back(item);
+        if (item == 1)
+            wheel.add(2, 100);
+    });
+    EXPECT_EQ(due, (std::vector<int>{1}));
+    wheel.advance(5000, [&](int item) { due.push_back(item); });
+    EXPECT_EQ(due, (std::vector<int>{1, 2}));
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "UrlFilter.hpp"
+
+using Verdict = UrlFilter::Verdict;
+
+UrlFilter withRules(std::vector<std::string> rules) {
+    UrlFilter::Options options;
+    options.deny = std::move(rules);
+    return UrlFilter(options);
+}
+
+TEST(UrlFilterTest, AcceptsPlainUrls) {
+    UrlFilter filter;
+    EXPECT_EQ(filter.check("https://en.wikipedia.org/wiki/Article"),
+              Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://x.com/"), Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://x.com"), Verdict::ACCEPT);
+}
+
+TEST(UrlFilterTest, DeniesRuleMatches) {
+    UrlFilter filter = withRules(
+        {"/wiki/Special:", "/wiki/File:", "sessionid=", "he", "she", "hers"});
+    EXPECT_EQ(filter.numRules(), 6);
+    EXPECT_EQ(filter.check("https://en.wikipedia.org/wiki/Special:Random"),
+              Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://en.wikipedia.org/wiki/File:A.jpg"),
+              Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://shop.com/cart?sessionid=42"),
+              Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://en.wikipedia.org/wiki/Files"),
+              Verdict::ACCEPT);
+    // Overlapping rules are found through suffix links: "ushers" holds
+    // "she", "he" and "hers".
+    EXPECT_EQ(filter.check("https://x.com/ushers"), Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://x.com/usrs"), Verdict::ACCEPT);
+}
+
+TEST(UrlFilterTest, AnchoredRulesMatchTheHostOnly) {
+    UrlFilter filter = withRules({"^web.archive.org/", "^ads."});
+    EXPECT_EQ(filter.check("https://web.archive.org/web/2020/x"),
+              Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://ads.x.com/a"), Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://x.com/web.archive.org/"), Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://uploads.x.com/a"), Verdict::ACCEPT);
+}
+
+TEST(UrlFilterTest, LimitsLengthAndDepth) {
+    UrlFilter::Options options;
+    options.maxLength = 40;
+    options.maxDepth = 3;
+    UrlFilter filter(options);
+    EXPECT_EQ(filter.check("https://x.com/a/b/c"), Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://x.com/a/b/c/"), Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://x.com/a/b/c/d"), Verdict::TOO_DEEP);
+    EXPECT_EQ(filter.check("https://x.com/a/b?q=/c/d/e"), Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://x.com/" + std::string(40, 'a')),
+              Verdict::TOO_LONG);
+}
+
+TEST(UrlFilterTest, DetectsRepeatedSegments) {
+    UrlFilter filter;
+    EXPECT_EQ(filter.check("https://x.com/a/b/a/b/a/b"), Verdict::ACCEPT);
+    EXPECT_EQ(filter.check("https://x.com/a/b/a/b/a/b/a/b"), Verdict::LOOP);
+    EXPECT_EQ(filter.check("https://x.com/img/img/img/img/x.png"),
+              Verdict::LOOP);
+}
+
+TEST(UrlFilterTest, ReadsTheRepoRules) {
+    std::vector<std::string> rules =
+        UrlFilter::readRules(PROJECT_ROOT "urlFilter.txt");
+    ASSERT_FALSE(rules.empty());
+    for (const std::string& rule : rules)
+        EXPECT_NE(rule[0], '#');
+    UrlFilter filter = withRules(rules);
+    EXPECT_EQ(filter.check("https://hu.wikipedia.org/wiki/F%C3%A1jl:A.png"),
+              Verdict::DENIED);
+    EXPECT_EQ(filter.check("https://en.wikipedia.org/wiki/English_language"),
+              Verdict::ACCEPT);
+    EXPECT_THROW(UrlFilter::readRules(PROJECT_ROOT "no-such-rules.txt"),
+                 std::runtime_error);
+}
+
+TEST(HostQuotaTest, CapsEachHost) {
+    HostQuota quota(2);
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_TRUE(quota.allows("a.com"));
+        quota.count("a.com");
+    }
+    EXPECT_FALSE(quota.allows("a.com"));
+    EXPECT_TRUE(quota.allows("b.com"));
+}
+
+TEST(HostQuotaTest, GrowsPastItsFirstTable) {
+    HostQuota quota(1);
+    for (int i = 0; i < 1000; ++i)
+        quota.count("host" + std::to_string(i));
+    EXPECT_EQ(quota.numHosts(), 1000);
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_FALSE(quota.allows("host" + std::to_string(i)));
+    EXPECT_TRUE(quota.allows("host1000"));
+}
+
+TEST(HostQuotaTest, ZeroMeansNoLimit) {
+    HostQuota quota;
+    quota.count("a.com");
+    EXPECT_TRUE(quota.allows("a.com"));
+    EXPECT_EQ(quota.numHosts(), 0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "Url.hpp"
+
+std::string canonical(std::string_view url,
+                      UrlCanonicalizer::Options options = {}) {
+    UrlCanonicalizer canonicalizer(options);
+    return std::string(canonicalizer.canonicalize(url));
+}
+
+// Test that the variants of one page share a canonical form.
+TEST(UrlTest, VariantsShareOneForm) {
+    std::string expected = "https://x.com/a";
+    EXPECT_EQ(canonical("http://x.com/a"), expected);
+    EXPECT_EQ(canonical("https://X.com/a/"), expected);
+    EXPECT_EQ(canonical("https://x.com/a#frag"), expected);
+    EXPECT_EQ(canonical("https://x.com/a?utm_source=feed"), expected);
+    EXPECT_EQ(canonical("  HTTPS://user@x.com.:443/./b/../a\r\n"), expected);
+}
+
+TEST(UrlTest, KeepsWhatNamesAnotherPage) {
+    EXPECT_EQ(canonical("http://x.com:8080/a"), "http://x.com:8080/a");
+    EXPECT_EQ(canonical("https://x.com:8443"), "https://x.com:8443/");
+    EXPECT_EQ(canonical("https://x.com/A"), "https://x.com/A");
+    EXPECT_EQ(canonical("https://x.com/"), "https://x.com/");
+    EXPECT_EQ(canonical("https://x.com"), "https://x.com/");
+}
+
+TEST(UrlTest, ResolvesDotSegments) {
+    EXPECT_EQ(canonical("https://x.com/a/b/c/./../../g"), "https://x.com/a/g");
+    EXPECT_EQ(canonical("https://x.com/../../a"), "https://x.com/a");
+    EXPECT_EQ(canonical("https://x.com/a/b/.."), "https://x.com/a");
+    UrlCanonicalizer::Options keepSlash;
+    keepSlash.dropTrailingSlash = false;
+    EXPECT_EQ(canonical("https://x.com/a/b/..", keepSlash),
+              "https://x.com/a/");
+    EXPECT_EQ(canonical("https://x.com/a/%2e/b", keepSlash),
+              "https://x.com/a/b");
+}
+
+TEST(UrlTest, NormalizesEscapes) {
+    EXPECT_EQ(canonical("https://x.com/%7euser/%2fa%2F"),
+              "https://x.com/~user/%2Fa%2F");
+    EXPECT_EQ(canonical("https://x.com/100%"), "https://x.com/100%");
+}
+
+TEST(UrlTest, StripsTrackingAndSortsQuery) {
+    EXPECT_EQ(canonical("https://x.com/s?q=1&utm_medium=x&a=2&gclid=9&&"),
+              "https://x.com/s?a=2&q=1");
+    EXPECT_EQ(canonical("https://x.com/s?"), "https://x.com/s");
+    UrlCanonicalizer::Options unsorted;
+    unsorted.sortQuery = false;
+    EXPECT_EQ(canonical("https://x.com/s?q=1&a=2", unsorted),
+              "https://x.com/s?q=1&a=2");
+}
+
+TEST(UrlTest, RejectsWhatIsNotHttp) {
+    EXPECT_EQ(canonical(""), "");
+    EXPECT_EQ(canonical("mailto:a@x.com"), "");
+    EXPECT_EQ(canonical("javascript:void(0)"), "");
+    EXPECT_EQ(canonical("ftp://x.com/a"), "");
+    EXPECT_EQ(canonical("x.com/a"), "");
+    EXPECT_EQ(canonical("https:///a"), "");
+    EXPECT_EQ(canonical("https://x.com:http/a"), "");
+}
+
+TEST(UrlTest, UpgradeCanBeTurnedOff) {
+    UrlCanonicalizer::Options options;
+    options.upgradeHttp = false;
+    EXPECT_EQ(canonical("http://x.com:80/a", options), "http://x.com/a");
+    EXPECT_EQ(canonical("https://x.com/a", options), "https://x.com/a");
+}
+
+// Test that parts() describes the canonical form.
+TEST(UrlTest, PartsOfTheCanonicalForm) {
+    UrlCanonicalizer canonicalizer;
+    canonicalizer.canonicalize("HTTP://News.BBC.co.uk:8080/a?b=1#c");
+    const Url& parts = canonicalizer.parts();
+    EXPECT_EQ(parts.scheme, "http");
+    EXPECT_EQ(parts.host, "news.bbc.co.uk");
+    EXPECT_EQ(parts.port, "8080");
+    EXPECT_EQ(parts.path, "/a");
+    EXPECT_EQ(parts.query, "b=1");
+    EXPECT_EQ(parts.domain, "bbc.co.uk");
+    EXPECT_EQ(parts.tld, ".uk");
+}
+
+TEST(UrlTest, Parse) {
+    Url parts;
+    ASSERT_TRUE(Url::parse("https://u:p@[::1]:81/p?q#f", parts));
+    EXPECT_EQ(parts.scheme, "https");
+    EXPECT_EQ(parts.host, "[::1]");
+    EXPECT_EQ(parts.port, "81");
+    EXPECT_EQ(parts.path, "/p");
+    EXPECT_EQ(parts.query, "q");
+    EXPECT_EQ(parts.fragment, "f");
+    EXPECT_EQ(parts.tld, "");
+    EXPECT_FALSE(Url::parse("no scheme", parts));
+}
+
+TEST(UrlTest, HostOf) {
+    EXPECT_EQ(Url::hostOf("https://en.wikipedia.org/wiki/X"),
+              "en.wikipedia.org");
+    EXPECT_EQ(Url::hostOf("https://u@a.com:81?q"), "a.com");
+    EXPECT_EQ(Url::hostOf("a.edu"), "a.edu");
+    EXPECT_EQ(Url::hostOf("http://[::1]:80/"), "[::1]");
+}
+
+TEST(UrlTest, DomainAndTld) {
+    EXPECT_EQ(Url::tldOf("en.wikipedia.org"), ".org");
+    EXPECT_EQ(Url::tldOf("localhost"), "");
+    EXPECT_EQ(Url::tldOf("10.0.0.1"), "");
+    EXPECT_EQ(Url::domainOf("en.wikipedia.org"), "wikipedia.org");
+    EXPECT_EQ(Url::domainOf("wikipedia.org"), "wikipedia.org");
+    EXPECT_EQ(Url::domainOf("www.abc.net.au"), "abc.net.au");
+    EXPECT_EQ(Url::domainOf("co.uk"), "co.uk");
+    EXPECT_EQ(Url::domainOf("a.b.github.io"), "github.io");
+    EXPECT_EQ(Url::domainOf("10.0.0.1"), "10.0.0.1");
+}